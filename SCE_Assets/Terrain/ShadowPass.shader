@@ -26,16 +26,24 @@ _{
 
     #define MAX_RAY_STEPS 86
     #define MAX_HEIGHT_INC 2.0
+    #define PI 3.14159265
+    //sine range over which the sun fades behind the horizon
+    #define HORIZON_SOFTNESS 0.03
 
     uniform vec3        SunPosition_worldspace;
     uniform sampler2D   PositionTex;
     uniform sampler2D   FinalTex;
 
     uniform vec2        SCE_ScreenSize;
+    uniform vec3        SCE_RootPosition;
 
     uniform sampler2D   TerrainHeightMap;
     uniform mat4        WorldToTerrainSpace;
     uniform float       HeightScale;
+    //one layer per 4 azimuths, sine of the horizon elevation in each channel
+    uniform sampler2DArray HorizonMap;
+    //0 when there is no horizon map, the shadow is ray marched
+    uniform int         HorizonDirectionCount;
 
 
 
@@ -46,7 +54,21 @@ _{
     {
         vec4 pos_terrainspace = WorldToTerrainSpace * vec4(pos_worldspace, 1.0);
         vec2 terrainUV = pos_terrainspace.zx * 0.5 + vec2(0.5);
-        return texture(TerrainHeightMap, terrainUV).a;//only get height
+        return texture(TerrainHeightMap, terrainUV).a * HeightScale;//only get height, stored normalized
+    }
+
+    //horizon toward dir, between the two baked azimuths around it. The gbuffer is in scene space
+    float horizonSineAt(vec3 pos_scenespace, vec3 dir_worldspace)
+    {
+        vec4 pos_terrainspace = WorldToTerrainSpace * vec4(pos_scenespace + SCE_RootPosition, 1.0);
+        vec2 terrainUV = pos_terrainspace.zx * 0.5 + vec2(0.5);
+        float azimuth = atan(dir_worldspace.z, dir_worldspace.x) / (2.0 * PI);
+        float direction = fract(azimuth) * float(HorizonDirectionCount);
+        int first = int(direction) % HorizonDirectionCount;
+        int second = (first + 1) % HorizonDirectionCount;
+        float firstSine = texture(HorizonMap, vec3(terrainUV, float(first / 4)))[first % 4];
+        float secondSine = texture(HorizonMap, vec3(terrainUV, float(second / 4)))[second % 4];
+        return mix(firstSine, secondSine, fract(direction));
     }
 
     float raymarchTerrainShadow(vec3 start_worldspace, vec3 dir_worldspace, float maxLen, float rayStep)
@@ -126,7 +148,14 @@ _{
         float maxDot = dot(maxTerrainStep, upVec);
         float dirDot = dot(dirToSun, upVec);
 
-        if(occludedByScene > 0.0 && maxDot >= dirDot)
+        if(occludedByScene > 0.0 && HorizonDirectionCount > 0)
+        {
+            //lit when the sun is above the terrain horizon
+            float horizonSine = horizonSineAt(pos_worldspace, dirToSun);
+            float light = smoothstep(horizonSine - HORIZON_SOFTNESS, horizonSine + HORIZON_SOFTNESS, dirDot);
+            color = finalColor*clamp(light, 0.2, 1.0);
+        }
+        else if(occludedByScene > 0.0 && maxDot >= dirDot)
         {
             float currentHeight = terrainHeightAt(pos_worldspace);
             //correct worldspace position height (because low poly terrain might have a 'wrong' height)
@@ -10,19 +10,25 @@ _{
 #version 430 core
 
     uniform mat4 WorldToTerrainSpace;
-    uniform mat4 M;    
+    uniform float PatchSize;
 
     in vec3 vertexPosition_modelspace;
+    //per instance : patch corner in xyz, patch size in w, see TerrainQuadtree::SelectPatches
+    in vec4 patchPosition_worldspace;
 
     out vec2 VS_terrainTexCoord;
+    out float VS_patchScale;
 
     void main()
     {
-        vec4 pos_terrainspace = WorldToTerrainSpace * M * vec4(vertexPosition_modelspace, 1.0);
+        vec4 position_worldspace = vec4(patchPosition_worldspace.xyz +
+                                        vertexPosition_modelspace * patchPosition_worldspace.w, 1.0);
+        vec4 pos_terrainspace = WorldToTerrainSpace * position_worldspace;
         VS_terrainTexCoord = pos_terrainspace.zx * 0.5 + vec2(0.5);
 //        VS_terrainTexCoord.x = mod(VS_terrainTexCoord.x, 1.0);
 //        VS_terrainTexCoord.y = mod(VS_terrainTexCoord.y, 1.0);
-        gl_Position = vec4(vertexPosition_modelspace, 1.0);
+        VS_patchScale = patchPosition_worldspace.w / PatchSize;
+        gl_Position = position_worldspace;
     }
 _}
 
@@ -31,16 +37,22 @@ _{
 #version 430 core
 
     uniform sampler2D TerrainHeightMap;
+    uniform sampler2DArray ClipmapTextures;
+    uniform int ClipmapLevelCount;
+    //xy : uv of the scenespace origin, z : uv per scenespace unit, see TerrainClipmap::BindUniforms
+    uniform vec4 ClipmapLevelUv[8];
+    //resident part of each level, scenespace xz min in xy and max in zw
+    uniform vec4 ClipmapLevelBounds[8];
+    uniform float HeightScale;
     uniform float MaxTessDistance;
     uniform float TessLodMultiplier;
     uniform float PatchSize;
-    uniform mat4 M;
     uniform mat4 V;
-    uniform mat4 MVP;
     uniform vec3 SCE_RootPosition;
 
     //in
     in vec2 VS_terrainTexCoord[];
+    in float VS_patchScale[];
 
     //out
     layout(vertices = 4) out;
@@ -50,21 +62,37 @@ _{
 
     out vec2 TCS_terrainTexCoord[];
 
+    //finest streamed level holding the position, the whole terrain heightmap when none does
+    vec4 sampleTerrain(vec3 pos_scenespace, vec2 terrainUv)
+    {
+        for(int level = 0; level < ClipmapLevelCount; ++level)
+        {
+            vec4 bounds = ClipmapLevelBounds[level];
+            if(all(greaterThanEqual(pos_scenespace.xz, bounds.xy)) &&
+               all(lessThanEqual(pos_scenespace.xz, bounds.zw)))
+            {
+                vec4 levelUv = ClipmapLevelUv[level];
+                return texture(ClipmapTextures, vec3(pos_scenespace.zx * levelUv.z + levelUv.xy, float(level)));
+            }
+        }
+        return texture(TerrainHeightMap, terrainUv);
+    }
+
     float tesselationFromDist(vec4 p0, vec4 p1, vec2 t0, vec2 t1)
     {
         vec2 centerUv = (t0 - t1) * 0.5 + t1;
-        float height = texture(TerrainHeightMap, centerUv).a;
-
-        mat4 modelMatrix = M;
-        modelMatrix[3] -= vec4(SCE_RootPosition, 0.0);
+        vec4 center_scenespace = (p0 - p1) * 0.5 + p1 - vec4(SCE_RootPosition, 0.0);
+        float height = sampleTerrain(center_scenespace.xyz, centerUv).a * HeightScale;
 
         float farDist = MaxTessDistance + 10.0;
-        vec4 center_cameraspace = V * ( modelMatrix * ((p0 - p1) * 0.5 + p1) + vec4(0.0, height, 0.0, 0.0));
+        vec4 center_cameraspace = V * (center_scenespace + vec4(0.0, height, 0.0, 0.0));
         float dist = length(center_cameraspace);
         float tess = 1.0 - clamp((dist - PatchSize)/ farDist, 0.0, 1.0);//map to 0..64 range
         tess = pow(tess, 12.0) / TessLodMultiplier;
 
-        return clamp(tess * 64.0, 4.0, 64.0);//between 0 and 64
+        //merged patches are only selected far enough to be at the minimum level,
+        //scale it so they keep the vertex density of the single patches around them
+        return clamp(tess * 64.0, 4.0 * VS_patchScale[0], 64.0);//between 0 and 64
     }
 
     void main(void)
@@ -107,14 +135,21 @@ _}
 _{
 #version 430 core
 
-    uniform mat4 M;
     uniform mat4 V;
     uniform mat4 P;
     uniform sampler2D TerrainHeightMap;
+    uniform sampler2DArray ClipmapTextures;
+    uniform int ClipmapLevelCount;
+    //xy : uv of the scenespace origin, z : uv per scenespace unit, see TerrainClipmap::BindUniforms
+    uniform vec4 ClipmapLevelUv[8];
+    //resident part of each level, scenespace xz min in xy and max in zw
+    uniform vec4 ClipmapLevelBounds[8];
+    uniform float HeightScale;
     uniform vec3 SCE_RootPosition;
 
     //in
-    layout(quads, fractional_odd_spacing, ccw) in;
+    //even spacing : a merged patch edge at 4*n splits exactly like the n single patch edges at 4
+    layout(quads, fractional_even_spacing, ccw) in;
 //    layout(quads, equal_spacing, ccw) in;
 
     patch in float gl_TessLevelOuter[4];
@@ -127,6 +162,35 @@ _{
     out vec3 TES_Position_worldspace;
     out vec2 TES_terrainTexCoord;
 
+    //rg : octahedral normal, a : height / HeightScale, see Heightmap::GPUTexel
+    vec4 decodeNormalAndHeight(vec4 texel)
+    {
+        vec2 encoded = texel.rg * 2.0 - 1.0;
+        vec3 normal = vec3(encoded.x, 1.0 - abs(encoded.x) - abs(encoded.y), encoded.y);
+        if(normal.y < 0.0)
+        {
+            vec2 signs = vec2(normal.x >= 0.0 ? 1.0 : -1.0, normal.z >= 0.0 ? 1.0 : -1.0);
+            normal.xz = (1.0 - abs(normal.zx)) * signs;
+        }
+        return vec4(normalize(normal), texel.a * HeightScale);
+    }
+
+    //finest streamed level holding the position, the whole terrain heightmap when none does
+    vec4 sampleTerrain(vec3 pos_scenespace, vec2 terrainUv)
+    {
+        for(int level = 0; level < ClipmapLevelCount; ++level)
+        {
+            vec4 bounds = ClipmapLevelBounds[level];
+            if(all(greaterThanEqual(pos_scenespace.xz, bounds.xy)) &&
+               all(lessThanEqual(pos_scenespace.xz, bounds.zw)))
+            {
+                vec4 levelUv = ClipmapLevelUv[level];
+                return texture(ClipmapTextures, vec3(pos_scenespace.zx * levelUv.z + levelUv.xy, float(level)));
+            }
+        }
+        return texture(TerrainHeightMap, terrainUv);
+    }
+
     void main()
     {
         //Interpolate position
@@ -139,17 +203,15 @@ _{
         vec2 topTerrainUv = mix(TCS_terrainTexCoord[3], TCS_terrainTexCoord[2], gl_TessCoord.x);
         vec2 terrainTexCoord = mix(bottomTerrainUv, topTerrainUv, gl_TessCoord.y);
 
-        vec4 normAndHeight = texture(TerrainHeightMap, terrainTexCoord);
+        vec4 normAndHeight = decodeNormalAndHeight(sampleTerrain(position.xyz - SCE_RootPosition,
+                                                                 terrainTexCoord));
 //        vec4 normAndHeight = vec4(0.0, 1.0, 0.0, 0.0);
         vec3 norm = normAndHeight.xyz;
 
         float height = normAndHeight.a;
 
-        mat4 modelMatrix = M;
-        modelMatrix[3] -= vec4(SCE_RootPosition, 0.0);
-
         TES_tessLevel = gl_TessLevelOuter[0];
-        TES_Position_worldspace = (modelMatrix * position).xyz;
+        TES_Position_worldspace = position.xyz - SCE_RootPosition;
         TES_Position_worldspace.y += height;
         TES_terrainTexCoord = terrainTexCoord;
 
@@ -239,11 +301,16 @@ _{
 //#define WIREFRAME
 
     uniform sampler2D TerrainHeightMap;
+    uniform sampler2DArray ClipmapTextures;
+    uniform int ClipmapLevelCount;
+    //xy : uv of the scenespace origin, z : uv per scenespace unit, see TerrainClipmap::BindUniforms
+    uniform vec4 ClipmapLevelUv[8];
+    //resident part of each level, scenespace xz min in xy and max in zw
+    uniform vec4 ClipmapLevelBounds[8];
     uniform sampler2D GrassTex;
     uniform sampler2D DirtTex;
     uniform sampler2D SnowTex;
     uniform sampler2D RockTex;
-    uniform mat4 M;
     uniform vec2 SCE_ScreenSize;
     uniform float HeightScale;
     uniform float TextureTileScale;
@@ -262,6 +329,35 @@ _{
     layout (location = 1) out vec3 oColor;
     layout (location = 2) out vec4 oNormal;
 
+    //rg : octahedral normal, a : height / HeightScale, see Heightmap::GPUTexel
+    vec4 decodeNormalAndHeight(vec4 texel)
+    {
+        vec2 encoded = texel.rg * 2.0 - 1.0;
+        vec3 normal = vec3(encoded.x, 1.0 - abs(encoded.x) - abs(encoded.y), encoded.y);
+        if(normal.y < 0.0)
+        {
+            vec2 signs = vec2(normal.x >= 0.0 ? 1.0 : -1.0, normal.z >= 0.0 ? 1.0 : -1.0);
+            normal.xz = (1.0 - abs(normal.zx)) * signs;
+        }
+        return vec4(normalize(normal), texel.a * HeightScale);
+    }
+
+    //finest streamed level holding the position, the whole terrain heightmap when none does
+    vec4 sampleTerrain(vec3 pos_scenespace, vec2 terrainUv)
+    {
+        for(int level = 0; level < ClipmapLevelCount; ++level)
+        {
+            vec4 bounds = ClipmapLevelBounds[level];
+            if(all(greaterThanEqual(pos_scenespace.xz, bounds.xy)) &&
+               all(lessThanEqual(pos_scenespace.xz, bounds.zw)))
+            {
+                vec4 levelUv = ClipmapLevelUv[level];
+                return texture(ClipmapTextures, vec3(pos_scenespace.zx * levelUv.z + levelUv.xy, float(level)));
+            }
+        }
+        return texture(TerrainHeightMap, terrainUv);
+    }
+
     vec4 TerrainColor(vec4 normAndHeight, vec2 uv)
     {
         uv *= TextureTileScale;
@@ -304,7 +400,7 @@ _{
     void main()
     {
         vec2 uv = gl_FragCoord.xy / SCE_ScreenSize;
-        vec4 normAndHeight = texture(TerrainHeightMap, GS_terrainTexCoord);
+        vec4 normAndHeight = decodeNormalAndHeight(sampleTerrain(Position_worldspace, GS_terrainTexCoord));
 
         vec4 colorAndRough = TerrainColor(normAndHeight, GS_terrainTexCoord);
 
@@ -8,8 +8,7 @@ _{
     layout(location = 3)in vec3 vertexTangent;
     layout(location = 4)in vec3 vertexBitangent;
 
-    layout(location = 5)in vec4 instanceCustomData;
-    layout(location = 6)in mat4 instanceMatrix;
+    layout(location = 5)in uvec4 instanceData;
 
     out vec2 FragUV;
     out mat3 TangentToWorldspace;
@@ -18,6 +17,38 @@ _{
     uniform mat4 V;
     uniform mat4 P;
     uniform vec3 SCE_RootPosition;
+    //quad to tree size
+    uniform mat4 ImpostorScaleMatrix;
+    //atlas cells per side, and their border
+    uniform float ImpostorAtlasSize;
+    uniform float ImpostorAtlasBorder;
+
+    //same unpacking as TreeLayout::GetInstanceMatrix : worldspace position, then
+    //yaw (14 bits), scale (12 bits) and LOD or atlas cell (6 bits)
+    mat4 getInstanceMatrix(uvec4 data, out uint index)
+    {
+        const float MaxScale = 4.0;
+        float yaw = float(data.w & 0x3FFFu)*(6.28318530718/16384.0);
+        float scale = float((data.w >> 14) & 0xFFFu)*(MaxScale/4095.0);
+        index = data.w >> 26;
+
+        float c = cos(yaw)*scale;
+        float s = sin(yaw)*scale;
+        return mat4(vec4(c, 0.0, -s, 0.0),
+                    vec4(0.0, scale, 0.0, 0.0),
+                    vec4(s, 0.0, c, 0.0),
+                    vec4(uintBitsToFloat(data.xyz), 1.0));
+    }
+
+    //same as TreeLayout::GetImpostorViewMapping : uv rect (start, size) of the atlas cell
+    vec4 getImpostorMapping(uint view)
+    {
+        uint root = uint(ImpostorAtlasSize);
+        float scaledHalfBorder = ImpostorAtlasBorder/ImpostorAtlasSize*0.5;
+        float size = 1.0/ImpostorAtlasSize - scaledHalfBorder;
+        vec2 start = vec2(float(view/root), float(view%root))/ImpostorAtlasSize + scaledHalfBorder;
+        return vec4(start, size, size);
+    }
 
     float map(float f, vec2 m)
     {
@@ -26,14 +57,11 @@ _{
 
     void main()
     {
-        FragUV = vertexUV;
-        vec4 mapping = instanceCustomData;
-//        if(gl_InstanceID%2 == 0)
-        {
+        uint view;
+        mat4 modelMatrix = getInstanceMatrix(instanceData, view)*ImpostorScaleMatrix;
 
-            FragUV = vec2(map(FragUV.x, mapping.xz), map(FragUV.y, mapping.yw));
-        }
-        mat4 modelMatrix = instanceMatrix;
+        vec4 mapping = getImpostorMapping(view);
+        FragUV = vec2(map(vertexUV.x, mapping.xz), map(vertexUV.y, mapping.yw));
         modelMatrix[3] -= vec4(SCE_RootPosition, 0.0);
 
         Position_worldspace = (modelMatrix*vec4(vertexPosition_modelspace, 1.0)).xyz;
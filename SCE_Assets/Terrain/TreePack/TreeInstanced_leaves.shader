@@ -5,7 +5,7 @@ _{
     in vec3 vertexPosition_modelspace;
     in vec2 vertexUV;
     in vec3 vertexNormal_modelspace;
-    in mat4 instanceMatrix;
+    in uvec4 instanceData;
 
     out vec2 fragUV;
     out vec3 Normal_worldspace;
@@ -15,10 +15,28 @@ _{
     uniform mat4 P;    
     uniform vec3 SCE_RootPosition;
 
+    //same unpacking as TreeLayout::GetInstanceMatrix : worldspace position, then
+    //yaw (14 bits), scale (12 bits) and LOD or atlas cell (6 bits)
+    mat4 getInstanceMatrix(uvec4 data, out uint index)
+    {
+        const float MaxScale = 4.0;
+        float yaw = float(data.w & 0x3FFFu)*(6.28318530718/16384.0);
+        float scale = float((data.w >> 14) & 0xFFFu)*(MaxScale/4095.0);
+        index = data.w >> 26;
+
+        float c = cos(yaw)*scale;
+        float s = sin(yaw)*scale;
+        return mat4(vec4(c, 0.0, -s, 0.0),
+                    vec4(0.0, scale, 0.0, 0.0),
+                    vec4(s, 0.0, c, 0.0),
+                    vec4(uintBitsToFloat(data.xyz), 1.0));
+    }
+
     void main()
     {
         fragUV = vertexUV;
-        mat4 modelMatrix = instanceMatrix;
+        uint lod;
+        mat4 modelMatrix = getInstanceMatrix(instanceData, lod);
         modelMatrix[3] -= vec4(SCE_RootPosition, 0.0);
 
         Position_worldspace = ( modelMatrix * vec4(vertexPosition_modelspace, 1.0) ).xyz;
@@ -0,0 +1,380 @@
+/******PROJECT:Sand Castle Engine******/
+/**************************************/
+/*********AUTHOR:Gwenn AUBERT**********/
+/**********FILE:SCEBench.cpp***********/
+/**************************************/
+
+#include "SCEBench.hpp"
+#include "../headers/SCETools.hpp"
+
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <cstring>
+#include <cctype>
+#include <cstdlib>
+
+namespace SCE
+{
+
+namespace Bench
+{
+    namespace
+    {
+        volatile float consumeSink = 0.0f;
+
+        std::string formatNs(double ns)
+        {
+            std::ostringstream stream;
+            stream << std::fixed << std::setprecision(1);
+            if(ns < 1000.0)
+            {
+                stream << ns << " ns";
+            }
+            else if(ns < 1000000.0)
+            {
+                stream << ns / 1000.0 << " us";
+            }
+            else
+            {
+                stream << ns / 1000000.0 << " ms";
+            }
+            return stream.str();
+        }
+
+        //Reads the JSON written by ToJSON, whatever its layout. Only the "benchmarks" objects are
+        //kept, the other values are parsed and skipped
+        class BaselineReader
+        {
+        public :
+            BaselineReader(const std::string& text) : mText(text), mPos(0) {}
+
+            bool Read(std::map<std::string, double>& medianNs)
+            {
+                if(!accept('{'))
+                {
+                    return false;
+                }
+                if(peek() == '}')
+                {
+                    ++mPos;
+                    return true;
+                }
+                do
+                {
+                    std::string key;
+                    if(!readString(key) || !accept(':'))
+                    {
+                        return false;
+                    }
+                    if(!(key == "benchmarks" ? readBenchmarks(medianNs) : skipValue()))
+                    {
+                        return false;
+                    }
+                }
+                while(accept(','));
+                return accept('}');
+            }
+
+        private :
+
+            char peek()
+            {
+                while(mPos < mText.size() && isspace((unsigned char)mText[mPos]))
+                {
+                    ++mPos;
+                }
+                return mPos < mText.size() ? mText[mPos] : '\0';
+            }
+
+            bool accept(char c)
+            {
+                if(peek() != c)
+                {
+                    return false;
+                }
+                ++mPos;
+                return true;
+            }
+
+            bool readString(std::string& value)
+            {
+                if(!accept('"'))
+                {
+                    return false;
+                }
+                value.clear();
+                while(mPos < mText.size() && mText[mPos] != '"')
+                {
+                    //benchmark names never need more than the escaped character itself
+                    if(mText[mPos] == '\\' && mPos + 1 < mText.size())
+                    {
+                        ++mPos;
+                    }
+                    value += mText[mPos++];
+                }
+                return accept('"');
+            }
+
+            bool readNumber(double& value)
+            {
+                peek();
+                const char* start = mText.c_str() + mPos;
+                char* end = nullptr;
+                value = strtod(start, &end);
+                if(end == start)
+                {
+                    return false;
+                }
+                mPos += size_t(end - start);
+                return true;
+            }
+
+            bool skipValue()
+            {
+                char c = peek();
+                if(c == '"')
+                {
+                    std::string ignored;
+                    return readString(ignored);
+                }
+                if(c == '{' || c == '[')
+                {
+                    char close = c == '{' ? '}' : ']';
+                    ++mPos;
+                    if(accept(close))
+                    {
+                        return true;
+                    }
+                    do
+                    {
+                        std::string ignored;
+                        if(c == '{' && (!readString(ignored) || !accept(':')))
+                        {
+                            return false;
+                        }
+                        if(!skipValue())
+                        {
+                            return false;
+                        }
+                    }
+                    while(accept(','));
+                    return accept(close);
+                }
+                for(const char* literal : {"true", "false", "null"})
+                {
+                    size_t length = strlen(literal);
+                    if(mText.compare(mPos, length, literal) == 0)
+                    {
+                        mPos += length;
+                        return true;
+                    }
+                }
+                double ignored;
+                return readNumber(ignored);
+            }
+
+            //[ { "name" : ..., "median_ns" : ..., ... }, ... ]
+            bool readBenchmarks(std::map<std::string, double>& medianNs)
+            {
+                if(!accept('['))
+                {
+                    return false;
+                }
+                if(accept(']'))
+                {
+                    return true;
+                }
+                do
+                {
+                    if(!accept('{'))
+                    {
+                        return false;
+                    }
+                    std::string name;
+                    double median = -1.0;
+                    if(peek() != '}')
+                    {
+                        do
+                        {
+                            std::string key;
+                            if(!readString(key) || !accept(':'))
+                            {
+                                return false;
+                            }
+                            bool isRead = key == "name" ? readString(name) :
+                                          key == "median_ns" ? readNumber(median) : skipValue();
+                            if(!isRead)
+                            {
+                                return false;
+                            }
+                        }
+                        while(accept(','));
+                    }
+                    if(!accept('}'))
+                    {
+                        return false;
+                    }
+                    if(!name.empty() && median >= 0.0)
+                    {
+                        medianNs[name] = median;
+                    }
+                }
+                while(accept(','));
+                return accept(']');
+            }
+
+            const std::string&  mText;
+            size_t              mPos;
+        };
+    }
+
+    Result Run(const std::string& name, ui32 iterations, ui64 itemsPerIteration, const Body& body)
+    {
+        typedef std::chrono::steady_clock Clock;
+
+        Debug::Assert(iterations > 0, "Benchmark needs at least one iteration");
+
+        Result result;
+        result.name = name;
+        result.iterations = iterations;
+        result.itemsPerIteration = itemsPerIteration;
+
+        //caches, lazy allocations...
+        body();
+
+        std::vector<double> timings;
+        timings.reserve(iterations);
+        for(ui32 i = 0; i < iterations; ++i)
+        {
+            Clock::time_point start = Clock::now();
+            body();
+            Clock::time_point end = Clock::now();
+            timings.push_back(std::chrono::duration<double, std::nano>(end - start).count());
+        }
+
+        std::sort(begin(timings), end(timings));
+        double sum = 0.0;
+        for(double t : timings)
+        {
+            sum += t;
+        }
+
+        result.minNs = timings.front();
+        result.medianNs = timings[timings.size() / 2];
+        result.meanNs = sum / double(timings.size());
+
+        Debug::Log(name + " : " + formatNs(result.medianNs) + " (min " + formatNs(result.minNs) + ")");
+
+        return result;
+    }
+
+    void Consume(float value)
+    {
+        consumeSink = consumeSink + value;
+    }
+
+    std::string ToJSON(const std::vector<Result>& results)
+    {
+        std::ostringstream json;
+        json << std::fixed << std::setprecision(1);
+        json << "{\n";
+        json << "    \"version\" : 1,\n";
+        json << "    \"benchmarks\" : [\n";
+
+        for(size_t i = 0; i < results.size(); ++i)
+        {
+            const Result& res = results[i];
+            double nsPerItem = res.itemsPerIteration > 0 ?
+                        res.medianNs / double(res.itemsPerIteration) : res.medianNs;
+            json << "        { \"name\" : \"" << res.name << "\""
+                 << ", \"iterations\" : " << res.iterations
+                 << ", \"items\" : " << res.itemsPerIteration
+                 << ", \"min_ns\" : " << res.minNs
+                 << ", \"median_ns\" : " << res.medianNs
+                 << ", \"mean_ns\" : " << res.meanNs
+                 << ", \"ns_per_item\" : " << std::setprecision(3) << nsPerItem << std::setprecision(1)
+                 << " }" << (i + 1 < results.size() ? "," : "") << "\n";
+        }
+
+        json << "    ]\n";
+        json << "}\n";
+        return json.str();
+    }
+
+    bool WriteJSON(const std::string& filename, const std::vector<Result>& results)
+    {
+        std::ofstream file(filename.c_str(), std::ios::out | std::ios::trunc);
+        if(!file.is_open())
+        {
+            Debug::LogError("Could not open benchmark output file : " + filename);
+            return false;
+        }
+        file << ToJSON(results);
+        return true;
+    }
+
+    bool LoadBaseline(const std::string& filename, std::map<std::string, double>& medianNs)
+    {
+        std::ifstream file(filename.c_str(), std::ios::in);
+        if(!file.is_open())
+        {
+            Debug::LogError("Could not open benchmark baseline : " + filename);
+            return false;
+        }
+
+        std::stringstream text;
+        text << file.rdbuf();
+        if(!BaselineReader(text.str()).Read(medianNs))
+        {
+            Debug::LogError("Invalid benchmark baseline : " + filename);
+            return false;
+        }
+
+        if(medianNs.empty())
+        {
+            Debug::LogError("No benchmark found in baseline : " + filename);
+            return false;
+        }
+        return true;
+    }
+
+    ui32 CompareToBaseline(const std::vector<Result>& results,
+                           const std::map<std::string, double>& baselineMedianNs,
+                           float tolerance)
+    {
+        ui32 regressionCount = 0;
+
+        for(const Result& res : results)
+        {
+            auto it = baselineMedianNs.find(res.name);
+            if(it == baselineMedianNs.end() || it->second <= 0.0)
+            {
+                Debug::Log(res.name + " : not in baseline");
+                continue;
+            }
+
+            double ratio = res.medianNs / it->second;
+            std::ostringstream line;
+            line << std::fixed << std::setprecision(2);
+            line << res.name << " : " << formatNs(it->second) << " -> " << formatNs(res.medianNs)
+                 << " (x" << ratio << ")";
+
+            if(ratio > 1.0 + double(tolerance))
+            {
+                ++regressionCount;
+                Debug::LogError(line.str() + " REGRESSION");
+            }
+            else
+            {
+                Debug::Log(line.str());
+            }
+        }
+
+        return regressionCount;
+    }
+}
+
+}
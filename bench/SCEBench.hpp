@@ -0,0 +1,56 @@
+/******PROJECT:Sand Castle Engine******/
+/**************************************/
+/*********AUTHOR:Gwenn AUBERT**********/
+/**********FILE:SCEBench.hpp***********/
+/**************************************/
+#ifndef SCE_BENCH_HPP
+#define SCE_BENCH_HPP
+
+#include "../headers/SCEDefines.hpp"
+#include <functional>
+#include <map>
+
+//Minimal benchmark harness : times a body a fixed number of times and keeps the median,
+//results are written as JSON and can be compared against a previous run.
+namespace SCE
+{
+
+    namespace Bench
+    {
+        typedef std::function<void()> Body;
+
+        struct Result
+        {
+            Result() : name(), iterations(0), itemsPerIteration(0),
+                minNs(0.0), medianNs(0.0), meanNs(0.0) {}
+            std::string name;
+            ui32        iterations;
+            ui64        itemsPerIteration;
+            double      minNs;
+            double      medianNs;
+            double      meanNs;
+        };
+
+        //one untimed warmup run, then iterations timed runs
+        Result      Run(const std::string& name, ui32 iterations, ui64 itemsPerIteration,
+                        const Body& body);
+
+        //keep the compiler from removing work whose result is otherwise unused
+        void        Consume(float value);
+
+        std::string ToJSON(const std::vector<Result>& results);
+        bool        WriteJSON(const std::string& filename, const std::vector<Result>& results);
+
+        //reads back a file written by WriteJSON, median time per benchmark name
+        bool        LoadBaseline(const std::string& filename, std::map<std::string, double>& medianNs);
+
+        //logs the ratio to the baseline for every benchmark and returns how many
+        //are slower than the baseline by more than tolerance (0.1 = 10%)
+        ui32        CompareToBaseline(const std::vector<Result>& results,
+                                      const std::map<std::string, double>& baselineMedianNs,
+                                      float tolerance);
+    }
+
+}
+
+#endif
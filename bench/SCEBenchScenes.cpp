@@ -0,0 +1,105 @@
+/******PROJECT:Sand Castle Engine******/
+/**************************************/
+/*********AUTHOR:Gwenn AUBERT**********/
+/*******FILE:SCEBenchScenes.cpp********/
+/**************************************/
+
+#include "SCEBenchScenes.hpp"
+#include "../headers/SCEFrustrumCulling.hpp"
+#include "../headers/SCEQuality.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+//reference ray march step, in texels
+#define RAYCAST_MARCH_STEP 0.25f
+//texels per frame, and a teleport every few hundred frames
+#define CLIPMAP_CAMERA_SPEED 6.0f
+#define CLIPMAP_JUMP_FRAMES 500
+
+namespace SCE
+{
+
+namespace BenchScenes
+{
+    glm::mat4 Projection()
+    {
+        return glm::perspective(45.0f, 16.0f/9.0f, 1.0f, SCE::Quality::CameraFarPlane);
+    }
+
+    bool MarchRay(const Heightmap::Heightfield& field, const glm::vec3& origin, const glm::vec3& direction,
+                  float maxDistance, float& distance)
+    {
+        float step = RAYCAST_MARCH_STEP / glm::length(glm::vec2(direction.x, direction.z));
+        for(float t = 0.0f; t <= maxDistance; t += step)
+        {
+            glm::vec3 pos = origin + direction*t;
+            if(pos.y <= Heightmap::SampleHeight(field, pos.x, pos.z, Heightmap::FILTER_BILINEAR))
+            {
+                distance = t;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void PatchVisibility(const TerrainQuadtree::Quadtree& tree, const glm::mat4& worldToCamera,
+                         std::vector<bool>& visible)
+    {
+        ui32 patchesPerSide = tree.patchesPerSide;
+        visible.assign(patchesPerSide*patchesPerSide, false);
+        for(const TerrainQuadtree::Node& node : tree.nodes)
+        {
+            if(node.size != 1)
+            {
+                continue;
+            }
+            glm::vec3 extent = node.boundsMax - node.boundsMin;
+            glm::vec4 center = worldToCamera*glm::vec4((node.boundsMin + node.boundsMax)*0.5f, 1.0f);
+            visible[node.x*patchesPerSide + node.z] =
+                    FrustrumCulling::IsBoxInFrustrum(center,
+                                                     worldToCamera*glm::vec4(extent.x, 0.0f, 0.0f, 0.0f),
+                                                     worldToCamera*glm::vec4(0.0f, extent.y, 0.0f, 0.0f),
+                                                     worldToCamera*glm::vec4(0.0f, 0.0f, extent.z, 0.0f));
+        }
+    }
+
+    TerrainBrush::TexelRect DeformHeightfield(Heightmap::CompactTexel* texels, ui32 size, float terrainSize,
+                                              float heightScale, HeightPyramid::Pyramid& pyramid,
+                                              const TerrainBrush::Brush& brush,
+                                              std::vector<Heightmap::GPUTexel>& upload)
+    {
+        TerrainBrush::ApplyBrush(texels, size, heightScale, brush);
+        TerrainBrush::TexelRect heightsRect = TerrainBrush::GetBrushRect(brush, size);
+        TerrainBrush::TexelRect normalsRect = TerrainBrush::GetNormalsRect(heightsRect, size);
+        TerrainBrush::TexelRect parts[4];
+        ui32 partCount = TerrainBrush::SplitWrapped(normalsRect, size, parts);
+        for(ui32 i = 0; i < partCount; ++i)
+        {
+            upload.resize(TerrainBrush::GetTexelCount(parts[i]));
+            TerrainBrush::UpdateNormals(texels, size, terrainSize, heightScale, parts[i], upload.data());
+        }
+
+        Heightmap::Heightfield field;
+        field.texels = texels;
+        field.size = size;
+        field.heightScale = heightScale;
+        HeightPyramid::UpdateRegion(field, pyramid, heightsRect.minX, heightsRect.minZ,
+                                    heightsRect.maxX, heightsRect.maxZ);
+        return normalsRect;
+    }
+
+    glm::vec2 ClipmapCameraPath(ui32 frame, ui32 size)
+    {
+        float center = float(size)*0.5f;
+        float radius = float(size)*0.3f;
+        float angle = float(frame)*CLIPMAP_CAMERA_SPEED/radius;
+        glm::vec2 position = glm::vec2(center) + glm::vec2(glm::cos(angle), glm::sin(angle))*radius;
+        if((frame / CLIPMAP_JUMP_FRAMES) % 2 == 1)
+        {
+            position = glm::vec2(float(size)) - position;
+        }
+        return position;
+    }
+}
+
+}
@@ -0,0 +1,46 @@
+/******PROJECT:Sand Castle Engine******/
+/**************************************/
+/*********AUTHOR:Gwenn AUBERT**********/
+/*******FILE:SCEBenchScenes.hpp********/
+/**************************************/
+#ifndef SCE_BENCH_SCENES_HPP
+#define SCE_BENCH_SCENES_HPP
+
+#include "../headers/SCEDefines.hpp"
+#include "../headers/SCEHeightmap.hpp"
+#include "../headers/SCEHeightPyramid.hpp"
+#include "../headers/SCETerrainBrush.hpp"
+#include "../headers/SCETerrainQuadtree.hpp"
+
+//Scenes timed by sce_bench, also built by sce_tests so that the tests check what is timed
+namespace SCE
+{
+
+    namespace BenchScenes
+    {
+        glm::mat4               Projection();
+
+        //ray marching with small steps, the only way to ray cast before the height pyramid.
+        //Goes on past the heightfield edges, like the pyramid
+        bool                    MarchRay(const Heightmap::Heightfield& field, const glm::vec3& origin,
+                                         const glm::vec3& direction, float maxDistance, float& distance);
+
+        //boxes of every patch of the grid, the way the quadtree leaves see them
+        void                    PatchVisibility(const TerrainQuadtree::Quadtree& tree, const glm::mat4& worldToCamera,
+                                                std::vector<bool>& visible);
+
+        //what Terrain::DeformTerrain does on the CPU : heights, normals of the dirty rect and pyramid.
+        //Returns the rect of the changed normals
+        TerrainBrush::TexelRect DeformHeightfield(Heightmap::CompactTexel* texels, ui32 size, float terrainSize,
+                                                  float heightScale, HeightPyramid::Pyramid& pyramid,
+                                                  const TerrainBrush::Brush& brush,
+                                                  std::vector<Heightmap::GPUTexel>& upload);
+
+        //camera in level 0 texels of a clipmap of the given size : a slow loop around the middle,
+        //teleported to the other side every few hundred frames
+        glm::vec2               ClipmapCameraPath(ui32 frame, ui32 size);
+    }
+
+}
+
+#endif
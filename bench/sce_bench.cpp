@@ -0,0 +1,1352 @@
+/******PROJECT:Sand Castle Engine******/
+/**************************************/
+/*********AUTHOR:Gwenn AUBERT**********/
+/**********FILE:sce_bench.cpp**********/
+/**************************************/
+
+//CPU hot paths benchmarks, runs without a window or a GL context.
+//usage : sce_bench [--out results.json] [--baseline baseline.json] [--tolerance 0.15]
+//                  [--filter name] [--quick]
+//Returns 1 when a benchmark is slower than the baseline by more than the tolerance.
+//Only times the code, the results are checked by sce_tests.
+
+#include "SCEBench.hpp"
+#include "SCEBenchScenes.hpp"
+#include "../headers/SCETools.hpp"
+#include "../headers/SCEPerlin.hpp"
+#include "../headers/SCEHeightmap.hpp"
+#include "../headers/SCEHeightPyramid.hpp"
+#include "../headers/SCEParallel.hpp"
+#include "../headers/SCEFrustrumCulling.hpp"
+#include "../headers/SCETerrainQuadtree.hpp"
+#include "../headers/SCETerrainBrush.hpp"
+#include "../headers/SCEHorizonMap.hpp"
+#include "../headers/SCEImpostorCache.hpp"
+#include "../headers/SCEClipmap.hpp"
+#include "../headers/SCETiledHeightfield.hpp"
+#include "../headers/SCETreeLayout.hpp"
+#include "../headers/SCEMeshLoader.hpp"
+#include "../headers/SCEQuality.hpp"
+#include "../headers/SCEScene.hpp"
+#include "../headers/Transform.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <fstream>
+#include <algorithm>
+#include <chrono>
+
+#define DEFAULT_OUTPUT_FILE "bench_results.json"
+#define DEFAULT_TOLERANCE 0.15f
+
+#define PERLIN_GRID_SIZE 1024
+#define HEIGHTMAP_SIZE 256
+#define NORMALS_SIZE 512
+#define HEIGHTMAP_TERRAIN_SIZE 9000.0f
+#define HEIGHTMAP_SCALING_SIZES {512, 1024, 4096}
+#define HEIGHTFIELD_QUERY_COUNT 100000
+//final quality terrain size, the float version doesn't fit in the caches
+#define HEIGHTFIELD_QUERY_SIZE 4096
+#define HEIGHTFIELD_QUERY_SPREAD 64
+#define HEIGHTFIELD_SAMPLE_COUNT (64*1024)
+#define RAYCAST_COUNT 4096
+//horizon map of the 512 heightfield
+#define HORIZON_MAP_SIZE 128
+#define HORIZON_DIRECTION_COUNT 8
+#define HORIZON_MAX_DISTANCE 128.0f
+#define CULLING_OBJECT_COUNT 100000
+//iterations of the timed brushes, alternating up and down so that the heights don't saturate
+#define BRUSH_TIMED_COUNT 64
+#define BRUSH_SMALL_RADIUS 16.0f
+#define BRUSH_LARGE_RADIUS 128.0f
+#define TREES_HALF_TERRAIN_SIZE 8000.0f
+//tree density multipliers of the visibility benchmarks
+#define TREES_DENSITIES {1, 2, 4}
+//camera walking back and forth a few meters per update, over a dense forest
+#define TREES_WALK_STEPS 40
+#define TREES_WALK_STEP 2.0f
+#define TREES_WALK_DENSITY 4
+//dense forests over growing worlds, half sizes in km, drawn as far as the low quality settings
+#define TREES_WORLD_HALF_SIZES {8, 32, 128}
+#define TREES_WORLD_DENSITY 4
+#define TREES_WORLD_DRAW_DISTANCE 4000.0f
+//one cell over the whole world, so every group is tested like before the grid
+#define TREES_SCAN_CELL_SIZE 1e9f
+#define TERRAIN_PATCHES_PER_SIDE 128
+#define TERRAIN_PATCH_SIZE 125.0f
+#define TERRAIN_BOUNDS_PATCH_TEXELS 16
+#define HEIGHT_RANGE_QUERY_COUNT 4096
+//a 16k heightfield streamed by 5 levels of 4x4 tiles of 256 texels
+#define CLIPMAP_SIZE 16384
+#define CLIPMAP_TILE_SIZE 256
+#define CLIPMAP_LEVEL_COUNT 5
+#define CLIPMAP_TILES_PER_LEVEL 4
+#define CLIPMAP_PAGES_PER_FRAME 4
+#define CLIPMAP_FRAME_COUNT 2000
+#define TILED_HEIGHTFIELD_SIZE 1024
+#define TILED_HEIGHTFIELD_TILE_SIZE 128
+#define TILED_HEIGHTFIELD_FILE "bench_heightfield.tiles"
+//impostor instances made per iteration, as matrices and mappings or as compact instances
+#define INSTANCE_ENCODE_COUNT 100000
+//atlas of 6x6 views, like the trees, with smaller views
+#define IMPOSTOR_CACHE_ANGLES (6*6)
+#define IMPOSTOR_CACHE_VIEW_SIZE 128
+#define IMPOSTOR_CACHE_FILE "bench_impostor.cache"
+//jobs handed to the background worker, against a thread created for each of them
+#define WORKER_JOB_COUNT 256
+//instance lists a producer thread hands to a consumer thread, and their size
+#define HANDOFF_PUBLISH_COUNT 500
+#define HANDOFF_INSTANCE_COUNT 100000
+#define HIERARCHY_CHAIN_COUNT 64
+#define HIERARCHY_DEPTH 8
+#define COMPONENT_LOOKUP_COUNT 100000
+#define BENCH_MESH_NAME "Terrain/TreePack/tree_5/1/lod0_leaves.obj"
+
+using namespace SCE;
+
+namespace
+{
+    struct BenchOptions
+    {
+        BenchOptions() : outputFile(DEFAULT_OUTPUT_FILE), baselineFile(),
+            filter(), tolerance(DEFAULT_TOLERANCE), iterationScale(1.0f) {}
+        std::string outputFile;
+        std::string baselineFile;
+        std::string filter;
+        float       tolerance;
+        float       iterationScale;
+    };
+
+    //used to pad containers so that GetComponent has to walk past other components
+    template<int N>
+    class BenchComponent : public Component
+    {
+    protected :
+        BenchComponent(SCEHandle<Container>& container)
+            : Component(container, "BenchComponent" + std::to_string(N)) {}
+    };
+
+    BenchOptions            options;
+    std::vector<Bench::Result> results;
+
+    bool isFilteredOut(const std::string& name)
+    {
+        return !options.filter.empty() && name.find(options.filter) == std::string::npos;
+    }
+
+    //returns false when the benchmark is filtered out
+    bool runBench(const std::string& name, ui32 iterations, ui64 itemsPerIteration,
+                  const Bench::Body& body)
+    {
+        if(isFilteredOut(name))
+        {
+            return false;
+        }
+        ui32 scaledIterations = glm::max(1u, ui32(float(iterations)*options.iterationScale));
+        results.push_back(Bench::Run(name, scaledIterations, itemsPerIteration, body));
+        return true;
+    }
+
+    void benchMeshParsing()
+    {
+        std::string indicesFile = std::string(ENGINE_RESSOURCE_PATH) + BENCH_MESH_NAME + "_convert.indices";
+        if(!std::ifstream(indicesFile.c_str()))
+        {
+            Debug::Log("mesh_parse : skipped, run from a directory containing " ENGINE_RESSOURCE_PATH);
+            return;
+        }
+
+        runBench("mesh_parse", 20, 1, []()
+        {
+            //the loader caches meshes by name, delete it so that every run parses the files
+            ui16 meshId = MeshLoader::CreateMeshFromFile(BENCH_MESH_NAME);
+            Bench::Consume(float(MeshLoader::GetMeshData(meshId).vertices.size()));
+            MeshLoader::DeleteMesh(meshId);
+        });
+    }
+
+    void benchPerlin()
+    {
+        Perlin::MakePerlin(PERLIN_GRID_SIZE, 42);
+
+        int sampleSide = 256;
+        runBench("perlin_get_at", 20, sampleSide*sampleSide, [sampleSide]()
+        {
+            float sum = 0.0f;
+            for(int x = 0; x < sampleSide; ++x)
+            {
+                for(int z = 0; z < sampleSide; ++z)
+                {
+                    sum += Perlin::GetPerlinAt(float(x)*0.37f, float(z)*0.37f, 64.0f);
+                }
+            }
+            Bench::Consume(sum);
+        });
+
+        runBench("perlin_layered", 20, sampleSide*sampleSide, [sampleSide]()
+        {
+            float sum = 0.0f;
+            for(int x = 0; x < sampleSide; ++x)
+            {
+                for(int z = 0; z < sampleSide; ++z)
+                {
+                    sum += Perlin::GetLayeredPerlinAt(float(x)*0.01f, float(z)*0.01f, 8, 2.0f);
+                }
+            }
+            Bench::Consume(sum);
+        });
+
+        //same samples, laid out for the batch functions
+        std::vector<float> xs, zs, layeredXs, layeredZs;
+        for(int x = 0; x < sampleSide; ++x)
+        {
+            for(int z = 0; z < sampleSide; ++z)
+            {
+                xs.push_back(float(x)*0.37f);
+                zs.push_back(float(z)*0.37f);
+                layeredXs.push_back(float(x)*0.01f);
+                layeredZs.push_back(float(z)*0.01f);
+            }
+        }
+        int sampleCount = int(xs.size());
+        std::vector<float> batchResults(sampleCount), layeredResults(sampleCount);
+
+        runBench("perlin_batch_get_at", 20, sampleCount, [&]()
+        {
+            Perlin::GetPerlinBatch(xs.data(), zs.data(), 64.0f, batchResults.data(), sampleCount);
+            Bench::Consume(batchResults[sampleCount/2]);
+        });
+
+        runBench("perlin_batch_layered", 20, sampleCount, [&]()
+        {
+            Perlin::GetLayeredPerlinBatch(layeredXs.data(), layeredZs.data(), 8, 2.0f,
+                                          layeredResults.data(), sampleCount);
+            Bench::Consume(layeredResults[sampleCount/2]);
+        });
+
+    }
+
+    //serial against all cores
+    void benchHeightmapScaling()
+    {
+        for(int size : HEIGHTMAP_SCALING_SIZES)
+        {
+            std::string sizeName = std::to_string(size);
+            ui64 texelCount = ui64(size)*ui64(size);
+            //a 4096 map takes seconds, a single timed run is enough
+            ui32 iterations = size >= 4096 ? 1 : (size >= 1024 ? 3 : 5);
+
+            std::vector<float> heights[2];
+            std::vector<glm::vec4> normalAndHeight[2];
+            const char* modeNames[2] = { "_serial", "_parallel" };
+
+            bool allFilteredOut = true;
+            for(int mode = 0; mode < 2; ++mode)
+            {
+                allFilteredOut &= isFilteredOut("heightmap_generate_" + sizeName + modeNames[mode]) &&
+                        isFilteredOut("heightmap_normals_" + sizeName + modeNames[mode]);
+            }
+            if(allFilteredOut)
+            {
+                continue;
+            }
+
+            for(int mode = 0; mode < 2; ++mode)
+            {
+                Parallel::SetWorkerCount(mode == 0 ? 1 : 0);
+                std::vector<float>& modeHeights = heights[mode];
+                std::vector<glm::vec4>& modeNormals = normalAndHeight[mode];
+                modeHeights.resize(texelCount);
+                modeNormals.resize(texelCount);
+
+                auto generate = [&modeHeights, size]()
+                {
+                    Heightmap::GenerateHeights(modeHeights.data(), size, 0.0f, 1.0f, 10000.0f);
+                    Bench::Consume(modeHeights[modeHeights.size()/2]);
+                };
+                //the heights are needed by the normals even when filtered out
+                if(!runBench("heightmap_generate_" + sizeName + modeNames[mode], iterations,
+                             texelCount, generate))
+                {
+                    generate();
+                }
+
+                runBench("heightmap_normals_" + sizeName + modeNames[mode], iterations,
+                                       texelCount, [&modeHeights, &modeNormals, size]()
+                {
+                    Heightmap::ComputeNormalsAndHeight(modeHeights.data(), size, HEIGHTMAP_TERRAIN_SIZE,
+                                                       modeNormals.data());
+                    Bench::Consume(modeNormals[modeNormals.size()/2].y);
+                });
+            }
+            Parallel::SetWorkerCount(0);
+        }
+    }
+
+    //float maps against the packed GPU and Morton ordered CPU layouts
+    void benchHeightfieldSampling(const std::vector<Heightmap::CompactTexel>& compact, int size, float heightScale)
+    {
+        Heightmap::Heightfield field;
+        field.texels = compact.data();
+        field.size = size;
+        field.heightScale = heightScale;
+
+        //random positions, some of them outside of the map to go through the wrapping
+        std::vector<float> x(HEIGHTFIELD_SAMPLE_COUNT);
+        std::vector<float> z(HEIGHTFIELD_SAMPLE_COUNT);
+        Math::SeedRandomGenerator(13);
+        for(int i = 0; i < HEIGHTFIELD_SAMPLE_COUNT; ++i)
+        {
+            x[i] = Math::RandRange(-0.5f*size, 1.5f*size);
+            z[i] = Math::RandRange(-0.5f*size, 1.5f*size);
+        }
+
+        const char* filterNames[Heightmap::FILTER_COUNT] = { "nearest", "bilinear", "bicubic" };
+        std::vector<float> heights(HEIGHTFIELD_SAMPLE_COUNT);
+        std::vector<float> batchHeights(HEIGHTFIELD_SAMPLE_COUNT);
+        for(int f = 0; f < Heightmap::FILTER_COUNT; ++f)
+        {
+            Heightmap::Filter filter = Heightmap::Filter(f);
+            runBench(std::string("heightfield_sample_") + filterNames[f], 20, heights.size(), [&]()
+            {
+                for(int i = 0; i < HEIGHTFIELD_SAMPLE_COUNT; ++i)
+                {
+                    heights[i] = Heightmap::SampleHeight(field, x[i], z[i], filter);
+                }
+                Bench::Consume(heights[HEIGHTFIELD_SAMPLE_COUNT/2]);
+            });
+            runBench(std::string("heightfield_sample_") + filterNames[f] + "_batch", 20, batchHeights.size(), [&]()
+            {
+                Heightmap::SampleHeights(field, x.data(), z.data(), batchHeights.data(),
+                                         HEIGHTFIELD_SAMPLE_COUNT, filter);
+                Bench::Consume(batchHeights[HEIGHTFIELD_SAMPLE_COUNT/2]);
+            });
+
+        }
+
+        std::vector<glm::vec3> normals(HEIGHTFIELD_SAMPLE_COUNT);
+        runBench("heightfield_sample_normals_batch", 20, normals.size(), [&]()
+        {
+            Heightmap::SampleNormals(field, x.data(), z.data(), normals.data(),
+                                     HEIGHTFIELD_SAMPLE_COUNT, Heightmap::FILTER_BILINEAR);
+            Bench::Consume(normals[HEIGHTFIELD_SAMPLE_COUNT/2].y);
+        });
+
+    }
+
+    //culling of the patches of a real heightfield, with boxes around the patch center height
+    //like the terrain used to do, and with the height ranges under the patches
+    void benchTerrainBounds(const Heightmap::Heightfield& field, const HeightPyramid::Pyramid& pyramid)
+    {
+        ui32 texelsPerPatch = TERRAIN_BOUNDS_PATCH_TEXELS;
+        ui32 patchesPerSide = field.size / texelsPerPatch;
+        float toHeight = field.heightScale / 65535.0f;
+
+        std::vector<glm::vec2> tightRanges(patchesPerSide*patchesPerSide);
+        runBench("terrain_patch_bounds", 20, tightRanges.size(), [&]()
+        {
+            for(ui32 x = 0; x < patchesPerSide; ++x)
+            {
+                for(ui32 z = 0; z < patchesPerSide; ++z)
+                {
+                    HeightPyramid::HeightRange range =
+                            HeightPyramid::GetRange(field, pyramid, float(x*texelsPerPatch), float(z*texelsPerPatch),
+                                                    float((x + 1)*texelsPerPatch), float((z + 1)*texelsPerPatch));
+                    tightRanges[x*patchesPerSide + z] =
+                            glm::vec2(float(range.min)*toHeight - TERRAIN_BOUNDS_SKIRT,
+                                      float(range.max)*toHeight + TERRAIN_BOUNDS_SKIRT);
+                }
+            }
+            Bench::Consume(tightRanges[tightRanges.size()/2].y);
+        });
+    }
+
+    void benchHeightPyramid(const std::vector<Heightmap::CompactTexel>& compact, int size, float heightScale)
+    {
+        Heightmap::Heightfield field;
+        field.texels = compact.data();
+        field.size = size;
+        field.heightScale = heightScale;
+
+        HeightPyramid::Pyramid pyramid;
+        runBench("heightfield_pyramid_build", 10, compact.size(), [&]()
+        {
+            HeightPyramid::Build(field, pyramid);
+            Bench::Consume(float(pyramid.levels.back()[0].max));
+        });
+        HeightPyramid::Build(field, pyramid);
+
+        //from above the terrain, looking in every direction, mostly down
+        std::vector<glm::vec3> origins(RAYCAST_COUNT);
+        std::vector<glm::vec3> directions(RAYCAST_COUNT);
+        std::vector<glm::vec3> ends(RAYCAST_COUNT);
+        float maxDistance = float(size);
+        Math::SeedRandomGenerator(17);
+        for(int i = 0; i < RAYCAST_COUNT; ++i)
+        {
+            origins[i] = glm::vec3(Math::RandRange(0.5f, size + 0.5f), 0.0f, Math::RandRange(0.5f, size + 0.5f));
+            origins[i].y = Heightmap::SampleHeight(field, origins[i].x, origins[i].z, Heightmap::FILTER_BILINEAR) +
+                    Math::RandRange(0.001f, 0.3f)*heightScale;
+            float angle = Math::RandRange(0.0f, 2.0f*glm::pi<float>());
+            //height units per texel
+            float slope = Math::RandRange(-1.0f, 0.1f)*heightScale/size;
+            directions[i] = glm::vec3(glm::cos(angle), slope, glm::sin(angle));
+            ends[i] = origins[i] + directions[i]*maxDistance;
+        }
+
+        std::vector<HeightPyramid::RayHit> hits(RAYCAST_COUNT);
+        runBench("heightfield_raycast", 20, RAYCAST_COUNT, [&]()
+        {
+            for(int i = 0; i < RAYCAST_COUNT; ++i)
+            {
+                HeightPyramid::RayCast(field, pyramid, origins[i], directions[i], maxDistance, hits[i]);
+            }
+            Bench::Consume(hits[RAYCAST_COUNT/2].distance);
+        });
+
+        std::vector<HeightPyramid::RayHit> segmentHits(RAYCAST_COUNT);
+        runBench("heightfield_raycast_segments", 20, RAYCAST_COUNT, [&]()
+        {
+            HeightPyramid::IntersectSegments(field, pyramid, origins.data(), ends.data(),
+                                             segmentHits.data(), RAYCAST_COUNT);
+            Bench::Consume(segmentHits[RAYCAST_COUNT/2].distance);
+        });
+
+        std::vector<float> marchDistances(RAYCAST_COUNT);
+        std::vector<char> marchHits(RAYCAST_COUNT);
+        runBench("heightfield_raycast_march", 2, RAYCAST_COUNT, [&]()
+        {
+            for(int i = 0; i < RAYCAST_COUNT; ++i)
+            {
+                marchHits[i] = BenchScenes::MarchRay(field, origins[i], directions[i], maxDistance,
+                                                     marchDistances[i]);
+            }
+            Bench::Consume(marchDistances[RAYCAST_COUNT/2]);
+        });
+
+        //patch sized regions anywhere, some wrapping around the edges
+        std::vector<glm::vec4> regions(HEIGHT_RANGE_QUERY_COUNT);
+        for(glm::vec4& region : regions)
+        {
+            glm::vec2 start(Math::RandRange(-0.5f, float(size)), Math::RandRange(-0.5f, float(size)));
+            glm::vec2 extent(Math::RandRange(1.0f, 64.0f), Math::RandRange(1.0f, 64.0f));
+            region = glm::vec4(start, start + extent);
+        }
+        std::vector<HeightPyramid::HeightRange> ranges(HEIGHT_RANGE_QUERY_COUNT);
+        runBench("heightfield_pyramid_ranges", 20, HEIGHT_RANGE_QUERY_COUNT, [&]()
+        {
+            for(int i = 0; i < HEIGHT_RANGE_QUERY_COUNT; ++i)
+            {
+                const glm::vec4& region = regions[i];
+                ranges[i] = HeightPyramid::GetRange(field, pyramid, region.x, region.y, region.z, region.w);
+            }
+            Bench::Consume(float(ranges[HEIGHT_RANGE_QUERY_COUNT/2].max));
+        });
+
+        benchTerrainBounds(field, pyramid);
+    }
+
+    //the cost only depends on the brush, not on the heightfield size
+    void benchTerrainBrush(float heightScale)
+    {
+        if(isFilteredOut("terrain_brush"))
+        {
+            return;
+        }
+        float terrainSize = HEIGHTMAP_TERRAIN_SIZE;
+        std::vector<Heightmap::GPUTexel> upload;
+        ui32 timedSize = HEIGHTFIELD_QUERY_SIZE;
+        Heightmap::CompactTexel flatTexel = { 0x8000, 0, 0 };
+        std::vector<Heightmap::CompactTexel> timedTexels(ui64(timedSize)*ui64(timedSize), flatTexel);
+        Heightmap::Heightfield timedField;
+        timedField.texels = timedTexels.data();
+        timedField.size = timedSize;
+        timedField.heightScale = heightScale;
+        HeightPyramid::Pyramid timedPyramid;
+        HeightPyramid::Build(timedField, timedPyramid);
+
+        float radii[2] = { BRUSH_SMALL_RADIUS, BRUSH_LARGE_RADIUS };
+        for(float radius : radii)
+        {
+            TerrainBrush::Brush brush;
+            brush.type = TerrainBrush::BRUSH_CRATER;
+            brush.start = glm::vec3(0.5f*float(timedSize), 0.0f, 0.5f*float(timedSize));
+            brush.radius = radius;
+            ui32 brushTexels = TerrainBrush::GetTexelCount(
+                        TerrainBrush::GetNormalsRect(TerrainBrush::GetBrushRect(brush, timedSize), timedSize));
+            runBench("terrain_brush_r" + std::to_string(int(radius)), 5, ui64(BRUSH_TIMED_COUNT)*brushTexels, [&]()
+            {
+                for(int i = 0; i < BRUSH_TIMED_COUNT; ++i)
+                {
+                    brush.strength = (i % 2 == 0 ? 0.01f : -0.01f)*heightScale;
+                    BenchScenes::DeformHeightfield(timedTexels.data(), timedSize, terrainSize, heightScale,
+                                                   timedPyramid, brush, upload);
+                }
+                Bench::Consume(float(upload[upload.size()/2].height));
+            });
+        }
+
+        //what every edit would cost without the dirty rects
+        runBench("terrain_brush_full_update", 1, timedTexels.size(), [&]()
+        {
+            TerrainBrush::TexelRect timedRect = { 0, 0, i32(timedSize) - 1, i32(timedSize) - 1 };
+            upload.resize(TerrainBrush::GetTexelCount(timedRect));
+            TerrainBrush::UpdateNormals(timedTexels.data(), timedSize, terrainSize, heightScale,
+                                        timedRect, upload.data());
+            HeightPyramid::Build(timedField, timedPyramid);
+            Bench::Consume(float(upload[upload.size()/2].height));
+        });
+    }
+
+    void benchHorizonMap(const std::vector<Heightmap::CompactTexel>& compact, int size, float heightScale)
+    {
+        Heightmap::Heightfield field;
+        field.texels = compact.data();
+        field.size = size;
+        field.heightScale = heightScale;
+
+        HorizonMap::Settings settings;
+        settings.size = HORIZON_MAP_SIZE;
+        settings.directionCount = HORIZON_DIRECTION_COUNT;
+        settings.maxDistance = HORIZON_MAX_DISTANCE;
+        settings.texelSpacing = HEIGHTMAP_TERRAIN_SIZE/float(size);
+        ui64 itemCount = ui64(HORIZON_MAP_SIZE)*HORIZON_MAP_SIZE*HORIZON_DIRECTION_COUNT;
+
+        //serial against all cores
+        HorizonMap::Map map;
+        const char* modeNames[2] = { "horizon_bake_serial", "horizon_bake_parallel" };
+        for(int mode = 0; mode < 2; ++mode)
+        {
+            Parallel::SetWorkerCount(mode == 0 ? 1 : 0);
+            runBench(modeNames[mode], 3, itemCount, [&]()
+            {
+                HorizonMap::Bake(field, settings, map);
+                Bench::Consume(float(map.texels[map.texels.size()/2]));
+            });
+        }
+        Parallel::SetWorkerCount(0);
+    }
+
+    void benchHeightfieldPacking(const std::vector<glm::vec4>& normalAndHeight)
+    {
+        int size = NORMALS_SIZE;
+        float heightScale = 10000.0f;
+        std::vector<Heightmap::GPUTexel> texels(normalAndHeight.size());
+        std::vector<Heightmap::CompactTexel> compact(normalAndHeight.size());
+
+        runBench("heightfield_pack_gpu", 10, texels.size(), [&]()
+        {
+            Heightmap::PackGPUTexels(normalAndHeight.data(), size, heightScale, texels.data());
+            Bench::Consume(float(texels[texels.size()/2].height));
+        });
+        Heightmap::PackGPUTexels(normalAndHeight.data(), size, heightScale, texels.data());
+
+        runBench("heightfield_pack_compact", 10, compact.size(), [&]()
+        {
+            Heightmap::PackCompactTexels(texels.data(), size, compact.data());
+            Bench::Consume(float(compact[compact.size()/2].height));
+        });
+        Heightmap::PackCompactTexels(texels.data(), size, compact.data());
+
+        //clusters of neighbour queries, like trees of a group or objects around the player.
+        //The content doesn't matter for the timings, the map is only filled
+        int querySize = HEIGHTFIELD_QUERY_SIZE;
+        std::vector<glm::vec4> queryFloatMap(querySize*querySize, glm::vec4(0.0f, 1.0f, 0.0f, 100.0f));
+        Heightmap::CompactTexel flatTexel = { 655, 0, 0 };
+        std::vector<Heightmap::CompactTexel> queryCompactMap(queryFloatMap.size(), flatTexel);
+
+        std::vector<glm::ivec2> queries;
+        queries.reserve(HEIGHTFIELD_QUERY_COUNT);
+        Math::SeedRandomGenerator(11);
+        while(queries.size() < HEIGHTFIELD_QUERY_COUNT)
+        {
+            glm::ivec2 center(rand() % querySize, rand() % querySize);
+            for(int i = 0; i < 16; ++i)
+            {
+                queries.push_back(glm::ivec2((center.x + rand() % HEIGHTFIELD_QUERY_SPREAD) % querySize,
+                                             (center.y + rand() % HEIGHTFIELD_QUERY_SPREAD) % querySize));
+            }
+        }
+
+        runBench("heightfield_queries_float", 20, queries.size(), [&]()
+        {
+            float sum = 0.0f;
+            for(const glm::ivec2& q : queries)
+            {
+                sum += queryFloatMap[q.x*querySize + q.y].w;
+            }
+            Bench::Consume(sum);
+        });
+
+        runBench("heightfield_queries_compact", 20, queries.size(), [&]()
+        {
+            float sum = 0.0f;
+            for(const glm::ivec2& q : queries)
+            {
+                sum += Heightmap::DecodeHeight(queryCompactMap[Heightmap::MortonIndex(q.x, q.y)], heightScale);
+            }
+            Bench::Consume(sum);
+        });
+
+        benchHeightfieldSampling(compact, size, heightScale);
+        benchHeightPyramid(compact, size, heightScale);
+        benchTerrainBrush(heightScale);
+        benchHorizonMap(compact, size, heightScale);
+    }
+
+    void benchHeightmap()
+    {
+        std::vector<float> heights(HEIGHTMAP_SIZE*HEIGHTMAP_SIZE);
+        runBench("heightmap_generate", 5, heights.size(), [&heights]()
+        {
+            Heightmap::GenerateHeights(heights.data(), HEIGHTMAP_SIZE, 0.0f, 1.0f, 10000.0f);
+            Bench::Consume(heights[heights.size()/2]);
+        });
+
+        std::vector<float> normalHeights(NORMALS_SIZE*NORMALS_SIZE);
+        Heightmap::GenerateHeights(normalHeights.data(), NORMALS_SIZE, 0.0f, 1.0f, 10000.0f);
+        std::vector<glm::vec4> normalAndHeight(normalHeights.size());
+        //needed by the packing benchmarks, even if this one is filtered out
+        Heightmap::ComputeNormalsAndHeight(normalHeights.data(), NORMALS_SIZE, HEIGHTMAP_TERRAIN_SIZE,
+                                           normalAndHeight.data());
+        runBench("heightmap_normals", 10, normalHeights.size(), [&normalHeights, &normalAndHeight]()
+        {
+            Heightmap::ComputeNormalsAndHeight(normalHeights.data(), NORMALS_SIZE, HEIGHTMAP_TERRAIN_SIZE,
+                                               normalAndHeight.data());
+            Bench::Consume(normalAndHeight[normalAndHeight.size()/2].y);
+        });
+
+        benchHeightfieldPacking(normalAndHeight);
+        benchHeightmapScaling();
+
+        Perlin::DestroyPerlin();
+    }
+
+    void benchFrustumCulling()
+    {
+        FrustrumCulling::UpdateCulling(BenchScenes::Projection());
+
+        std::vector<glm::vec4> positions;
+        positions.reserve(CULLING_OBJECT_COUNT);
+        Math::SeedRandomGenerator(7);
+        for(int i = 0; i < CULLING_OBJECT_COUNT; ++i)
+        {
+            positions.push_back(glm::vec4(Math::RandRange(-5000.0f, 5000.0f),
+                                          Math::RandRange(-5000.0f, 5000.0f),
+                                          Math::RandRange(-10000.0f, 100.0f), 1.0f));
+        }
+
+        runBench("frustum_spheres", 50, positions.size(), [&positions]()
+        {
+            ui32 visible = 0;
+            for(const glm::vec4& pos : positions)
+            {
+                visible += FrustrumCulling::IsSphereInFrustrum(pos, 50.0f) ? 1 : 0;
+            }
+            Bench::Consume(float(visible));
+        });
+
+        glm::vec4 R(50.0f, 0.0f, 0.0f, 0.0f);
+        glm::vec4 S(0.0f, 50.0f, 0.0f, 0.0f);
+        glm::vec4 T(0.0f, 0.0f, 50.0f, 0.0f);
+        runBench("frustum_boxes", 50, positions.size(), [&positions, R, S, T]()
+        {
+            ui32 visible = 0;
+            for(const glm::vec4& pos : positions)
+            {
+                visible += FrustrumCulling::IsBoxInFrustrum(pos, R, S, T) ? 1 : 0;
+            }
+            Bench::Consume(float(visible));
+        });
+    }
+
+    void benchTerrainQuadtree()
+    {
+        //same rolling hills as the trees, patches as high as they are wide around them
+        ui32 patchesPerSide = TERRAIN_PATCHES_PER_SIDE;
+        float patchSize = TERRAIN_PATCH_SIZE;
+        float halfSize = float(patchesPerSide)*patchSize*0.5f;
+        glm::vec3 origin(-halfSize, 0.0f, -halfSize);
+        std::vector<glm::vec2> heightRanges(patchesPerSide*patchesPerSide);
+        for(ui32 x = 0; x < patchesPerSide; ++x)
+        {
+            for(ui32 z = 0; z < patchesPerSide; ++z)
+            {
+                glm::vec3 center = origin + glm::vec3(float(x) + 0.5f, 0.0f, float(z) + 0.5f)*patchSize;
+                float height = 20.0f*glm::sin(center.x*0.001f)*glm::cos(center.z*0.001f);
+                heightRanges[x*patchesPerSide + z] = glm::vec2(height - patchSize*0.5f, height + patchSize*0.5f);
+            }
+        }
+
+        TerrainQuadtree::Quadtree tree;
+        runBench("terrain_quadtree_build", 20, heightRanges.size(), [&]()
+        {
+            TerrainQuadtree::Build(patchesPerSide, patchSize, origin, heightRanges, tree);
+            Bench::Consume(float(tree.nodes.size()));
+        });
+        if(tree.nodes.empty())
+        {
+            TerrainQuadtree::Build(patchesPerSide, patchSize, origin, heightRanges, tree);
+        }
+
+        FrustrumCulling::UpdateCulling(BenchScenes::Projection());
+        glm::vec3 cameraPosition(0.0f, 200.0f, 0.0f);
+        glm::mat4 viewMatrix = glm::lookAt(cameraPosition, glm::vec3(1000.0f, 150.0f, 300.0f),
+                                           glm::vec3(0.0f, 1.0f, 0.0f));
+        TerrainQuadtree::LodSettings lod;
+        lod.maxTessDistance = halfSize*2.0f;
+        lod.lodMultiplier = Quality::TerrainLodMultiplier;
+
+        std::vector<glm::vec4> instances;
+        TerrainQuadtree::SelectionStats stats;
+        runBench("terrain_quadtree_select", 200, heightRanges.size(), [&]()
+        {
+            instances.clear();
+            stats = TerrainQuadtree::SelectionStats();
+            TerrainQuadtree::SelectPatches(tree, viewMatrix, cameraPosition, lod, instances, stats);
+            Bench::Consume(float(instances.size()));
+        });
+
+        std::vector<bool> visible;
+        runBench("terrain_patches_bruteforce", 200, heightRanges.size(), [&]()
+        {
+            BenchScenes::PatchVisibility(tree, viewMatrix, visible);
+            Bench::Consume(float(visible.size()));
+        });
+        if(isFilteredOut("terrain_quadtree_select"))
+        {
+            return;
+        }
+        Debug::Log("terrain_quadtree_select : " + std::to_string(stats.instanceCount) + " instances for " +
+                   std::to_string(stats.drawnPatches) + " patches, " + std::to_string(stats.visitedNodes) +
+                   " nodes visited");
+    }
+
+    void benchClipmap()
+    {
+        Clipmap::Settings settings;
+        settings.levelCount = CLIPMAP_LEVEL_COUNT;
+        settings.tilesPerLevel = CLIPMAP_TILES_PER_LEVEL;
+        settings.tileSize = CLIPMAP_TILE_SIZE;
+        settings.size = CLIPMAP_SIZE;
+
+        Clipmap::State state;
+        std::vector<Clipmap::Page> pages;
+        runBench("clipmap_update", 20, CLIPMAP_FRAME_COUNT, [&]()
+        {
+            Clipmap::Init(settings, state);
+            for(ui32 frame = 0; frame < CLIPMAP_FRAME_COUNT; ++frame)
+            {
+                glm::vec2 camera = BenchScenes::ClipmapCameraPath(frame, CLIPMAP_SIZE);
+                Clipmap::Update(state, camera.x, camera.y);
+                Clipmap::TakePages(state, CLIPMAP_PAGES_PER_FRAME, pages);
+            }
+            Bench::Consume(float(state.uploadedPages));
+        });
+        if(!isFilteredOut("clipmap_update"))
+        {
+            Debug::Log("clipmap_update : " + std::to_string(state.uploadedPages) + " pages over " +
+                       std::to_string(CLIPMAP_FRAME_COUNT) + " frames");
+        }
+    }
+
+    void benchTiledHeightfield()
+    {
+        ui32 size = TILED_HEIGHTFIELD_SIZE;
+        ui32 tileSize = TILED_HEIGHTFIELD_TILE_SIZE;
+        float heightScale = 1000.0f;
+        TiledHeightfield::HeightSource getHeight = [heightScale](ui32 x, ui32 z) -> float
+        {
+            return heightScale*(0.5f + 0.25f*glm::sin(float(x)*0.02f) + 0.2f*glm::cos(float(z)*0.013f));
+        };
+
+        bool written = false;
+        runBench("tiled_heightfield_write", 5, ui64(size)*ui64(size), [&]()
+        {
+            written = TiledHeightfield::Write(TILED_HEIGHTFIELD_FILE, size, tileSize, heightScale, 2.0f, getHeight);
+            Bench::Consume(written ? 1.0f : 0.0f);
+        });
+        if(isFilteredOut("tiled_heightfield_write"))
+        {
+            return;
+        }
+
+        TiledHeightfield::File file;
+        if(!written || !TiledHeightfield::Open(TILED_HEIGHTFIELD_FILE, file))
+        {
+            Debug::LogError("tiled_heightfield_write : could not write and open " TILED_HEIGHTFIELD_FILE);
+            std::remove(TILED_HEIGHTFIELD_FILE);
+            return;
+        }
+
+        //regions of up to a few tiles, some of them over the edges
+        std::vector<glm::vec4> regions(HEIGHT_RANGE_QUERY_COUNT);
+        Math::SeedRandomGenerator(17);
+        for(glm::vec4& region : regions)
+        {
+            glm::vec2 start(Math::RandRange(-8.0f, float(size)), Math::RandRange(-8.0f, float(size)));
+            glm::vec2 extent(Math::RandRange(1.0f, 300.0f), Math::RandRange(1.0f, 300.0f));
+            region = glm::vec4(start, start + extent);
+        }
+        std::vector<HeightPyramid::HeightRange> ranges(regions.size());
+        runBench("tiled_heightfield_ranges", 100, regions.size(), [&]()
+        {
+            for(ui32 i = 0; i < regions.size(); ++i)
+            {
+                ranges[i] = TiledHeightfield::GetRange(file, regions[i].x, regions[i].y, regions[i].z, regions[i].w);
+            }
+            Bench::Consume(float(ranges.back().max));
+        });
+        TiledHeightfield::Close(file);
+        std::remove(TILED_HEIGHTFIELD_FILE);
+    }
+
+    void benchTrees()
+    {
+        //low rolling hills, flat enough for trees to spawn wherever the noise allows it
+        TreeLayout::HeightQuery getHeight = [](const glm::vec3& pos) -> float
+        {
+            return 20.0f*glm::sin(pos.x*0.001f)*glm::cos(pos.z*0.001f);
+        };
+        TreeLayout::NormalQuery getNormal = [](const glm::vec3&) -> glm::vec3
+        {
+            return glm::vec3(0.0f, 1.0f, 0.0f);
+        };
+        TreeLayout::HeightBatchQuery getHeights = [&getHeight](const float* x, const float* z,
+                                                               float* heights, int count)
+        {
+            for(int i = 0; i < count; ++i)
+            {
+                heights[i] = getHeight(glm::vec3(x[i], 0.0f, z[i]));
+            }
+        };
+
+        std::vector<TreeLayout::TreeGroup> groups;
+        runBench("trees_generate_groups", 10, 1, [&groups, &getHeight, &getNormal]()
+        {
+            groups.clear();
+            TreeLayout::GenerateTreeGroups(0.0f, 0.0f, 1.0f, 10000.0f, TREES_HALF_TERRAIN_SIZE,
+                                           getHeight, getNormal, groups);
+            Bench::Consume(float(groups.size()));
+        });
+
+        FrustrumCulling::UpdateCulling(BenchScenes::Projection());
+        glm::vec3 cameraPosition(0.0f, 200.0f, 0.0f);
+        glm::vec3 cameraTarget(1000.0f, 150.0f, 300.0f);
+        glm::mat4 viewMatrix = glm::lookAt(cameraPosition, cameraTarget, glm::vec3(0.0f, 1.0f, 0.0f));
+        TreeLayout::GroupGrid grid;
+        TreeLayout::GroupGrid scanGrid;
+        float halfTerrainSize = TREES_HALF_TERRAIN_SIZE;
+        Parallel::CancelToken notCancelled(false);
+        auto generateGroups = [&]()
+        {
+            groups.clear();
+            TreeLayout::GenerateTreeGroups(0.0f, 0.0f, 1.0f, 10000.0f, halfTerrainSize, getHeight, getNormal, groups);
+            TreeLayout::BuildGroupGrid(groups, TREE_GROUP_GRID_CELL_SIZE, grid);
+            TreeLayout::BuildGroupGrid(groups, TREES_SCAN_CELL_SIZE, scanGrid);
+        };
+        auto computeVisibility = [&](const TreeLayout::GroupGrid& groupGrid, TreeLayout::PlacementCache& cache,
+                                     TreeLayout::TreeInstances& instances)
+        {
+            TreeLayout::ComputeVisibilityAndLOD(groups, groupGrid, viewMatrix, glm::vec3(0.0f), cameraPosition,
+                                                halfTerrainSize, getHeights, notCancelled, cache, instances);
+        };
+        auto getTreeCount = [](const TreeLayout::TreeInstances& instances)
+        {
+            ui64 treeCount = instances.impostors.size();
+            for(int lod = 0; lod < TREE_LOD_COUNT; ++lod)
+            {
+                treeCount += instances.trees[lod].size();
+            }
+            return treeCount;
+        };
+
+        //placing the trees from scratch at every update, against the cached placements,
+        //for more and more trees
+        float baseSpacing = Quality::Trees::BaseSpacing;
+        TreeLayout::TreeInstances instances;
+        TreeLayout::TreeInstances reference;
+        for(int density : TREES_DENSITIES)
+        {
+            std::string suffix = density == 1 ? "" : "_x" + std::to_string(density);
+            Quality::Trees::BaseSpacing = baseSpacing/glm::sqrt(float(density));
+            generateGroups();
+
+            TreeLayout::PlacementCache cache;
+            computeVisibility(grid, cache, instances);
+            ui64 treeCount = getTreeCount(instances);
+            runBench("trees_visibility_cold" + suffix, 5, treeCount, [&computeVisibility, &grid, &instances]()
+            {
+                TreeLayout::PlacementCache coldCache;
+                computeVisibility(grid, coldCache, instances);
+                Bench::Consume(float(instances.impostors.size()));
+            });
+            runBench("trees_visibility_lod" + suffix, 10, treeCount,
+                     [&computeVisibility, &grid, &cache, &instances]()
+            {
+                computeVisibility(grid, cache, instances);
+                Bench::Consume(float(instances.impostors.size()));
+            });
+            Debug::Log("trees visibility x" + std::to_string(density) + " : " + std::to_string(treeCount) +
+                       " trees, " + std::to_string(TreeLayout::GetPlacementCacheBytes(cache)/1024) +
+                       " KB of cached placements");
+        }
+
+        //the grid keeps the cost to the groups around the camera, however big the world
+        float maxDrawDistance = Quality::Trees::MaxDrawDistance;
+        Quality::Trees::MaxDrawDistance = TREES_WORLD_DRAW_DISTANCE;
+        Quality::Trees::BaseSpacing = baseSpacing/glm::sqrt(float(TREES_WORLD_DENSITY));
+        for(int halfSizeKm : TREES_WORLD_HALF_SIZES)
+        {
+            std::string suffix = "_" + std::to_string(2*halfSizeKm) + "km";
+            halfTerrainSize = 1000.0f*float(halfSizeKm);
+            generateGroups();
+            TreeLayout::PlacementCache cache;
+            TreeLayout::PlacementCache scanCache;
+            computeVisibility(grid, cache, instances);
+            computeVisibility(scanGrid, scanCache, instances);
+            runBench("trees_visibility_scan" + suffix, 5, groups.size(),
+                     [&computeVisibility, &scanGrid, &scanCache, &instances]()
+            {
+                computeVisibility(scanGrid, scanCache, instances);
+                Bench::Consume(float(instances.impostors.size()));
+            });
+            runBench("trees_visibility_grid" + suffix, 10, groups.size(),
+                     [&computeVisibility, &grid, &cache, &instances]()
+            {
+                computeVisibility(grid, cache, instances);
+                Bench::Consume(float(instances.impostors.size()));
+            });
+            Debug::Log("trees visibility " + std::to_string(2*halfSizeKm) + " km : " + std::to_string(groups.size()) +
+                       " groups, " + std::to_string(instances.visibleGroupCount) + " visible");
+        }
+        Quality::Trees::MaxDrawDistance = maxDrawDistance;
+        Quality::Trees::BaseSpacing = baseSpacing;
+        halfTerrainSize = TREES_HALF_TERRAIN_SIZE;
+
+        //small camera moves : every LOD computed again at each update, against only the groups that need it
+        Quality::Trees::BaseSpacing = baseSpacing/glm::sqrt(float(TREES_WALK_DENSITY));
+        generateGroups();
+        ui32 walkStep = 0;
+        auto walk = [&]()
+        {
+            //back and forth, so that each walk starts where the last one ended
+            ui32 step = walkStep++ % (2*TREES_WALK_STEPS);
+            float along = TREES_WALK_STEP*float(step < TREES_WALK_STEPS ? step : 2*TREES_WALK_STEPS - step);
+            glm::vec3 offset = glm::normalize(cameraTarget - glm::vec3(0.0f, 200.0f, 0.0f))*along;
+            cameraPosition = glm::vec3(0.0f, 200.0f, 0.0f) + offset;
+            viewMatrix = glm::lookAt(cameraPosition, cameraTarget + offset, glm::vec3(0.0f, 1.0f, 0.0f));
+        };
+        TreeLayout::PlacementCache walkCache;
+        TreeLayout::PlacementCache fullCache;
+        walk();
+        computeVisibility(grid, walkCache, instances);
+        computeVisibility(grid, fullCache, reference);
+        ui64 treeCount = getTreeCount(instances);
+        runBench("trees_visibility_walk_full", 2*TREES_WALK_STEPS, treeCount, [&]()
+        {
+            walk();
+            TreeLayout::InvalidateLods(fullCache);
+            computeVisibility(grid, fullCache, reference);
+            Bench::Consume(float(reference.impostors.size()));
+        });
+        walkStep = 0;
+        ui64 relodCount = 0;
+        ui64 visibleCount = 0;
+        runBench("trees_visibility_walk_incremental", 2*TREES_WALK_STEPS, treeCount, [&]()
+        {
+            walk();
+            computeVisibility(grid, walkCache, instances);
+            relodCount += instances.relodGroupCount;
+            visibleCount += instances.visibleGroupCount;
+            Bench::Consume(float(instances.impostors.size()));
+        });
+        Debug::Log("trees visibility walk : " + std::to_string(treeCount) + " trees, LODs computed again for " +
+                   std::to_string(relodCount) + " of " + std::to_string(visibleCount) + " visible groups");
+        Quality::Trees::BaseSpacing = baseSpacing;
+    }
+
+    //impostors made the way the visibility update used to, a matrix and an atlas mapping each,
+    //against compact instances
+    void benchInstanceEncoding()
+    {
+        glm::vec3 cameraPosition(0.0f, 300.0f, 0.0f);
+        glm::mat4 impostorScaleMat = glm::scale(glm::mat4(1.0f), glm::vec3(10.0f, 20.0f, 10.0f));
+        Math::SeedRandomGenerator(47);
+        std::vector<glm::vec3> positions(INSTANCE_ENCODE_COUNT);
+        std::vector<float> scales(INSTANCE_ENCODE_COUNT);
+        std::vector<float> noises(INSTANCE_ENCODE_COUNT);
+        for(int i = 0; i < INSTANCE_ENCODE_COUNT; ++i)
+        {
+            positions[i] = glm::vec3(Math::RandRange(-TREES_HALF_TERRAIN_SIZE, TREES_HALF_TERRAIN_SIZE),
+                                     Math::RandRange(0.0f, 100.0f),
+                                     Math::RandRange(-TREES_HALF_TERRAIN_SIZE, TREES_HALF_TERRAIN_SIZE));
+            scales[i] = Math::RandRange(0.8f, 1.8f);
+            noises[i] = Math::RandRange(-0.6f, 0.6f);
+        }
+        auto getAngle = [&](int i) -> float
+        {
+            glm::vec3 dirToCam = glm::normalize(cameraPosition - positions[i]);
+            return glm::atan(-1.0f, 0.0f) - glm::atan(dirToCam.z, dirToCam.x);
+        };
+
+        std::vector<glm::mat4> matrices;
+        std::vector<glm::vec4> mappings;
+        runBench("instance_encode_mat4", 10, INSTANCE_ENCODE_COUNT, [&]()
+        {
+            matrices.clear();
+            mappings.clear();
+            for(int i = 0; i < INSTANCE_ENCODE_COUNT; ++i)
+            {
+                float angle = getAngle(i);
+                matrices.push_back(glm::translate(glm::mat4(1.0f), positions[i])*
+                                   glm::rotate(glm::mat4(1.0f), angle, glm::vec3(0.0f, 1.0f, 0.0f))*
+                                   glm::scale(glm::mat4(1.0f), glm::vec3(scales[i]))*impostorScaleMat);
+                mappings.push_back(TreeLayout::GetImpostorMapping(noises[i]*-10.0f + angle, NB_IMPOSTOR_ANGLES,
+                                                                  IMPOSTOR_FLIP_X, BILLBOARD_BORDER));
+            }
+            Bench::Consume(matrices[0][3].x + mappings[0].x);
+        });
+
+        std::vector<TreeLayout::CompactInstance> compact;
+        runBench("instance_encode_compact", 10, INSTANCE_ENCODE_COUNT, [&]()
+        {
+            compact.clear();
+            for(int i = 0; i < INSTANCE_ENCODE_COUNT; ++i)
+            {
+                float angle = getAngle(i);
+                compact.push_back(TreeLayout::EncodeInstance(
+                                      positions[i], scales[i], angle,
+                                      TreeLayout::GetImpostorView(noises[i]*-10.0f + angle, NB_IMPOSTOR_ANGLES)));
+            }
+            Bench::Consume(compact[0].x);
+        });
+        Debug::Log("instance encoding : " + std::to_string(sizeof(glm::mat4) + sizeof(glm::vec4)) +
+                   " bytes per impostor, " + std::to_string(sizeof(glm::mat4)) + " per tree model, " +
+                   std::to_string(sizeof(TreeLayout::CompactInstance)) + " compact");
+    }
+
+    //views of a disc in the middle of each atlas cell, empty around like the captured trees
+    void benchImpostorCache()
+    {
+        ImpostorCache::Settings settings;
+        settings.nbAngles = IMPOSTOR_CACHE_ANGLES;
+        settings.texSize = IMPOSTOR_CACHE_VIEW_SIZE;
+        settings.border = 0.05f;
+
+        ImpostorCache::Atlas atlas;
+        atlas.size = ImpostorCache::GetAtlasSize(settings);
+        atlas.billboardSize = glm::vec3(5.0f, 12.0f, 5.0f);
+        atlas.diffuse.assign(ui64(atlas.size)*ui64(atlas.size), 0);
+        atlas.normal.assign(atlas.diffuse.size(), 0);
+        Math::SeedRandomGenerator(50);
+        float radius = 0.4f*float(settings.texSize);
+        for(ui32 y = 0; y < atlas.size; ++y)
+        {
+            for(ui32 x = 0; x < atlas.size; ++x)
+            {
+                glm::vec2 cellPosition = glm::vec2(float(x % settings.texSize), float(y % settings.texSize)) -
+                        0.5f*float(settings.texSize);
+                if(glm::length(cellPosition) < radius)
+                {
+                    ui64 texel = ui64(Math::RandRange(1.0f, 65535.0f)) | (ui64(0xFFFF) << 48);
+                    atlas.diffuse[y*atlas.size + x] = texel;
+                    atlas.normal[y*atlas.size + x] = texel ^ 0x0000FFFF0000ull;
+                }
+            }
+        }
+
+        ui64 hash = ImpostorCache::Hash(settings, std::vector<std::string>(), std::vector<float>());
+        ui64 texelCount = atlas.diffuse.size() + atlas.normal.size();
+        runBench("impostor_cache_save", 3, texelCount, [&]()
+        {
+            ImpostorCache::Save(IMPOSTOR_CACHE_FILE, settings, hash, atlas);
+        });
+        ImpostorCache::Save(IMPOSTOR_CACHE_FILE, settings, hash, atlas);
+
+        ImpostorCache::Atlas loaded;
+        runBench("impostor_cache_load", 10, texelCount, [&]()
+        {
+            ImpostorCache::Load(IMPOSTOR_CACHE_FILE, settings, hash, loaded);
+            Bench::Consume(float(loaded.diffuse[loaded.diffuse.size()/2] & 0xFFFF));
+        });
+
+        std::ifstream file(IMPOSTOR_CACHE_FILE, std::ios::in | std::ios::binary | std::ios::ate);
+        ui64 fileBytes = ui64(file.tellg());
+        file.close();
+        Debug::Log("impostor cache : " + std::to_string(fileBytes/1024) + " KB for " +
+                   std::to_string(texelCount*sizeof(ui64)/1024) + " KB of texels");
+        std::remove(IMPOSTOR_CACHE_FILE);
+    }
+
+    //same job on the persistent worker and on a thread per job, like the tree visibility update used to
+    void benchBackgroundWorker()
+    {
+        std::atomic<ui32> jobCount(0);
+        Parallel::Job countJob = [&jobCount](const Parallel::CancelToken&)
+        {
+            ++jobCount;
+        };
+
+        Parallel::BackgroundWorker worker;
+        runBench("worker_job_latency", 5, WORKER_JOB_COUNT, [&worker, &countJob]()
+        {
+            for(int i = 0; i < WORKER_JOB_COUNT; ++i)
+            {
+                worker.Submit(countJob);
+                worker.Wait();
+            }
+        });
+        runBench("thread_per_job_latency", 5, WORKER_JOB_COUNT, [&countJob]()
+        {
+            Parallel::CancelToken notCancelled(false);
+            for(int i = 0; i < WORKER_JOB_COUNT; ++i)
+            {
+                std::thread thread(countJob, std::ref(notCancelled));
+                thread.join();
+            }
+        });
+    }
+
+    //Instance lists going from the visibility update to the main thread, behind a mutex held while
+    //they are written, against the triple buffer. The consumer times each attempt to take them
+    void benchInstanceHandoff()
+    {
+        struct Handoff
+        {
+            ui64    consumedCount;
+            double  maxWait;
+        };
+        auto getSeconds = []()
+        {
+            return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        };
+        Handoff mutexHandoff = { 0, 0.0 };
+        ui64 blockedCount = 0;
+        runBench("instance_handoff_mutex", 1, HANDOFF_PUBLISH_COUNT, [&]()
+        {
+            mutexHandoff = { 0, 0.0 };
+            blockedCount = 0;
+            std::mutex lock;
+            std::vector<ui64> shared;
+            std::vector<ui64> uploaded;
+            bool isFresh = false;
+            std::atomic<bool> isDone(false);
+            std::thread producer([&]()
+            {
+                for(ui64 value = 1; value <= HANDOFF_PUBLISH_COUNT; ++value)
+                {
+                    std::lock_guard<std::mutex> guard(lock);
+                    shared.assign(HANDOFF_INSTANCE_COUNT, value);
+                    isFresh = true;
+                }
+                isDone = true;
+            });
+            while(!isDone)
+            {
+                double start = getSeconds();
+                bool hasNewList = false;
+                if(!lock.try_lock())
+                {
+                    ++blockedCount;
+                    lock.lock();
+                }
+                mutexHandoff.maxWait = glm::max(mutexHandoff.maxWait, getSeconds() - start);
+                if(isFresh)
+                {
+                    uploaded = shared;
+                    isFresh = false;
+                    hasNewList = true;
+                }
+                lock.unlock();
+                if(hasNewList)
+                {
+                    ++mutexHandoff.consumedCount;
+                    Bench::Consume(float(uploaded[0]));
+                }
+                std::this_thread::yield();
+            }
+            producer.join();
+        });
+
+        Handoff tripleHandoff = { 0, 0.0 };
+        ui64 droppedCount = 0;
+        runBench("instance_handoff_triple", 1, HANDOFF_PUBLISH_COUNT, [&]()
+        {
+            tripleHandoff = { 0, 0.0 };
+            Parallel::TripleBuffer<std::vector<ui64>> lists;
+            std::atomic<bool> isDone(false);
+            std::thread producer([&]()
+            {
+                for(ui64 value = 1; value <= HANDOFF_PUBLISH_COUNT; ++value)
+                {
+                    lists.GetWriteBuffer().assign(HANDOFF_INSTANCE_COUNT, value);
+                    lists.Publish();
+                }
+                isDone = true;
+            });
+            bool isLast = false;
+            while(!isLast)
+            {
+                isLast = isDone;
+                double start = getSeconds();
+                bool hasNewList = lists.Consume();
+                tripleHandoff.maxWait = glm::max(tripleHandoff.maxWait, getSeconds() - start);
+                if(hasNewList)
+                {
+                    ++tripleHandoff.consumedCount;
+                    Bench::Consume(float(lists.GetReadBuffer()[0]));
+                }
+                std::this_thread::yield();
+            }
+            producer.join();
+            droppedCount = lists.GetDroppedCount();
+        });
+
+        Debug::Log("instance handoff : longest consumer wait " + std::to_string(mutexHandoff.maxWait*1e6) +
+                   " us with a mutex, blocked " + std::to_string(blockedCount) + " times out of " +
+                   std::to_string(mutexHandoff.consumedCount) + " lists, " + std::to_string(tripleHandoff.maxWait*1e6) + " us with the triple buffer, " +
+                   std::to_string(tripleHandoff.consumedCount) + " lists consumed and " +
+                   std::to_string(droppedCount) + " dropped");
+    }
+
+    void benchContainers()
+    {
+        std::vector<SCEHandle<Container>> containers;
+        std::vector<SCEHandle<Transform>> leaves;
+
+        for(int chain = 0; chain < HIERARCHY_CHAIN_COUNT; ++chain)
+        {
+            SCEHandle<Transform> parent;
+            for(int depth = 0; depth < HIERARCHY_DEPTH; ++depth)
+            {
+                SCEHandle<Container> container = SCEScene::CreateContainer("BenchContainer");
+                container->AddComponent<BenchComponent<0>>();
+                container->AddComponent<BenchComponent<1>>();
+                container->AddComponent<BenchComponent<2>>();
+                container->AddComponent<BenchComponent<3>>();
+                SCEHandle<Transform> transform = container->AddComponent<Transform>();
+                transform->SetLocalPosition(glm::vec3(1.0f, 2.0f, 3.0f));
+                transform->SetLocalOrientation(glm::vec3(0.0f, 10.0f*float(depth), 5.0f));
+                transform->SetLocalScale(glm::vec3(1.01f));
+                if(parent)
+                {
+                    parent->AddChild(transform);
+                }
+                parent = transform;
+                containers.push_back(container);
+            }
+            leaves.push_back(parent);
+        }
+
+        runBench("transform_hierarchy", 50, leaves.size(), [&leaves]()
+        {
+            float sum = 0.0f;
+            for(SCEHandle<Transform>& leaf : leaves)
+            {
+                sum += leaf->GetSceneTransform()[3].x;
+                sum += leaf->GetScenePosition().y;
+            }
+            Bench::Consume(sum);
+        });
+
+        runBench("container_get_component", 20, COMPONENT_LOOKUP_COUNT, [&containers]()
+        {
+            float sum = 0.0f;
+            for(int i = 0; i < COMPONENT_LOOKUP_COUNT; ++i)
+            {
+                SCEHandle<Container>& container = containers[i % containers.size()];
+                sum += container->GetComponent<Transform>()->GetLocalPosition().x;
+            }
+            Bench::Consume(sum);
+        });
+
+        for(SCEHandle<Container>& container : containers)
+        {
+            SCEScene::DestroyContainer(container);
+        }
+    }
+
+    bool parseArguments(int argc, char** argv)
+    {
+        for(int i = 1; i < argc; ++i)
+        {
+            std::string arg = argv[i];
+            bool hasValue = i + 1 < argc;
+            if(arg == "--out" && hasValue)
+            {
+                options.outputFile = argv[++i];
+            }
+            else if(arg == "--baseline" && hasValue)
+            {
+                options.baselineFile = argv[++i];
+            }
+            else if(arg == "--tolerance" && hasValue)
+            {
+                options.tolerance = float(atof(argv[++i]));
+            }
+            else if(arg == "--filter" && hasValue)
+            {
+                options.filter = argv[++i];
+            }
+            else if(arg == "--quick")
+            {
+                options.iterationScale = 0.2f;
+            }
+            else
+            {
+                Debug::LogError("Unknown argument : " + arg);
+                Debug::Log("usage : sce_bench [--out file] [--baseline file] [--tolerance ratio]"
+                           " [--filter name] [--quick]");
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if(!parseArguments(argc, argv))
+    {
+        return 2;
+    }
+
+    std::map<std::string, double> baseline;
+    if(!options.baselineFile.empty() && !Bench::LoadBaseline(options.baselineFile, baseline))
+    {
+        return 2;
+    }
+
+    benchMeshParsing();
+    benchPerlin();
+    benchHeightmap();
+    benchFrustumCulling();
+    benchTerrainQuadtree();
+    benchClipmap();
+    benchTiledHeightfield();
+    benchTrees();
+    benchInstanceEncoding();
+    benchImpostorCache();
+    benchBackgroundWorker();
+    benchInstanceHandoff();
+    benchContainers();
+
+    if(!Bench::WriteJSON(options.outputFile, results))
+    {
+        return 2;
+    }
+    Debug::Log("Results written to " + options.outputFile);
+
+
+    if(!baseline.empty())
+    {
+        ui32 regressionCount = Bench::CompareToBaseline(results, baseline, options.tolerance);
+        if(regressionCount > 0)
+        {
+            Debug::LogError(std::to_string(regressionCount) + " benchmark(s) slower than the baseline");
+            return 1;
+        }
+    }
+
+    return 0;
+}
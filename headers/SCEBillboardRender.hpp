@@ -22,10 +22,12 @@ namespace SCE
                                            const vec3 &center, const vec3 &dimensions,
                                       GLuint* diffuseTex, GLuint* normalTex,
                                       RenderCallback renderCallback);
-        glm::vec4 GetMappingForAgnle(float angleRad, ui16 nbAngles);
-        glm::vec4 GetMappingForAgnle(float angleRad, ui16 nbAngles, bool flipX);
-        glm::vec4 GetMappingForAgnle(float angleRad, ui16 nbAngles, float borderRatio);
-        glm::vec4 GetMappingForAgnle(float angleRad, ui16 nbAngles, bool flipX, float borderRatio);
+        //atlas cells are looked up with TreeLayout::GetImpostorViewMapping
+
+        //RGBA16 texels of the first mip of a generated texture, size*size of them
+        void ReadTexture(GLuint texture, ui32 size, ui64* texels);
+        //same format, filtering and mipmaps as the generated textures
+        GLuint CreateTexture(ui32 size, const ui64* texels);
     }
 }
 
@@ -0,0 +1,91 @@
+/******PROJECT:Sand Castle Engine******/
+/**************************************/
+/*********AUTHOR:Gwenn AUBERT**********/
+/**********FILE:SCEClipmap.hpp*********/
+/**************************************/
+#ifndef SCE_CLIPMAP_HPP
+#define SCE_CLIPMAP_HPP
+
+#include "SCEDefines.hpp"
+#include <vector>
+
+//same array size in the terrain shader
+#define CLIPMAP_MAX_LEVELS 8
+
+//Page residency of a clipmap, no GL calls in here.
+//Level l is a window of tilesPerLevel x tilesPerLevel tiles of the heightfield mip l, centered
+//on the camera. Levels are stored toroidally : tile (x, z) always goes to the slot
+//(x % tilesPerLevel, z % tilesPerLevel), so moving a window only replaces the tiles that left it.
+//Tiles are handed out a few at a time, the caller uploads them and they count as resident.
+namespace SCE
+{
+
+    namespace Clipmap
+    {
+        struct Settings
+        {
+            Settings() : levelCount(0), tilesPerLevel(0), tileSize(0), size(0) {}
+            ui32    levelCount;
+            ui32    tilesPerLevel;
+            ui32    tileSize;
+            //level 0 texels per side of the heightfield
+            ui32    size;
+        };
+
+        //[min, max[ in tiles of one level
+        struct TileRect
+        {
+            i32     minX;
+            i32     minZ;
+            i32     maxX;
+            i32     maxZ;
+        };
+
+        struct Page
+        {
+            ui32    level;
+            ui32    tileX;
+            ui32    tileZ;
+            ui32    slotX;
+            ui32    slotZ;
+        };
+
+        struct Level
+        {
+            //tiles that should be resident
+            TileRect                window;
+            //tiles that are resident, the part of the window the shader can read
+            TileRect                valid;
+            //tile held by each slot, x*tilesPerLevel + z, -1 when empty
+            std::vector<glm::ivec2> slots;
+        };
+
+        struct State
+        {
+            State() : uploadedPages(0) {}
+            Settings            settings;
+            std::vector<Level>  levels;
+            //coarse levels first, then the closest tiles
+            std::vector<Page>   pending;
+            ui64                uploadedPages;
+        };
+
+        void    Init(const Settings& settings, State& state);
+
+        //camera in level 0 texels, queues the tiles that entered the windows
+        void    Update(State& state, float cameraX, float cameraZ);
+
+        //hands out at most maxPages pending pages, they are resident once returned
+        void    TakePages(State& state, ui32 maxPages, std::vector<Page>& pages);
+
+        bool    IsResident(const State& state, ui32 level, i32 tileX, i32 tileZ);
+
+        inline bool IsEmpty(const TileRect& rect)
+        {
+            return rect.minX >= rect.maxX || rect.minZ >= rect.maxZ;
+        }
+    }
+
+}
+
+#endif
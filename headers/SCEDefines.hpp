@@ -29,10 +29,12 @@ using namespace glm;
 #define TEXTURE_METADATA_SUFIX ".texData"
 
 
+typedef int8_t i8;
 typedef int16_t i16;
 typedef int32_t i32;
 typedef int64_t i64;
 
+typedef uint8_t ui8;
 typedef uint16_t ui16;
 typedef uint32_t ui32;
 typedef uint64_t ui64;
@@ -13,6 +13,13 @@ namespace SCE
 
     namespace FrustrumCulling
     {
+        enum BoxCulling
+        {
+            BOX_OUTSIDE = 0,
+            BOX_INTERSECTING,
+            BOX_INSIDE
+        };
+
         void UpdateCulling(const glm::mat4& projectionMatrix);
 
         bool IsSphereInFrustrum(const glm::vec4& pos_cameraspace,
@@ -22,6 +29,13 @@ namespace SCE
                              const glm::vec4& R_cameraspace,
                              const glm::vec4& S_cameraspace,
                              const glm::vec4& T_cameraspace);
+
+        //same test as IsBoxInFrustrum, but also tells when the box is entirely inside,
+        //so that hierarchies can skip testing what the box contains
+        BoxCulling ClassifyBox(const glm::vec4& pos_cameraspace,
+                               const glm::vec4& R_cameraspace,
+                               const glm::vec4& S_cameraspace,
+                               const glm::vec4& T_cameraspace);
     }
 
 }
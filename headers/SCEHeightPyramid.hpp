@@ -0,0 +1,79 @@
+/******PROJECT:Sand Castle Engine******/
+/**************************************/
+/*********AUTHOR:Gwenn AUBERT**********/
+/*******FILE:SCEHeightPyramid.hpp******/
+/**************************************/
+#ifndef SCE_HEIGHT_PYRAMID_HPP
+#define SCE_HEIGHT_PYRAMID_HPP
+
+#include "SCEDefines.hpp"
+#include "SCEHeightmap.hpp"
+#include <vector>
+
+//Ray casts against the bilinear surface of a heightfield (same surface as FILTER_BILINEAR).
+//Rays are in heightfield space : x and z in texels, y in height units (0 to heightScale).
+//A min/max pyramid lets the traversal skip whole blocks of cells the ray passes above.
+//The pyramid holds one period of the heightfield, cells between texel centers :
+//[0.5, size + 0.5[ on x and z, the last row of cells joins the last texels with the first ones.
+//The surface repeats past it like the sampling does, rays go through as many periods as they cross.
+namespace SCE
+{
+
+    namespace HeightPyramid
+    {
+        //raw 16 bits heights, as in CompactTexel
+        struct HeightRange
+        {
+            ui16    min;
+            ui16    max;
+        };
+
+        //level l groups 2^l x 2^l cells, levels[l - 1][x*levelSize + z].
+        //Single cells aren't stored, the ray cast reads their 4 texels directly
+        struct Pyramid
+        {
+            Pyramid() : size(0) {}
+            ui32                                    size;
+            std::vector<std::vector<HeightRange>>   levels;
+        };
+
+        struct RayHit
+        {
+            RayHit() : hasHit(false), position(0.0f), normal(0.0f, 1.0f, 0.0f), distance(0.0f) {}
+            bool        hasHit;
+            glm::vec3   position;
+            glm::vec3   normal;
+            //along the ray, in multiples of the direction length
+            float       distance;
+        };
+
+        //the heightfield size must be a power of two, at least 2
+        void    Build(const Heightmap::Heightfield& field, Pyramid& pyramid);
+        ui64    GetByteSize(const Pyramid& pyramid);
+
+        //refreshes the nodes over texels [minX, maxX] x [minZ, maxZ] after their heights changed.
+        //The rect may go past the heightfield edges, it wraps around like the sampling
+        void    UpdateRegion(const Heightmap::Heightfield& field, Pyramid& pyramid,
+                             i32 minX, i32 minZ, i32 maxX, i32 maxZ);
+
+        //min and max raw heights of the surface over [minX, maxX] x [minZ, maxZ], in heightfield space.
+        //The region wraps around the heightfield like the GPU texture does
+        HeightRange GetRange(const Heightmap::Heightfield& field, const Pyramid& pyramid,
+                             float minX, float minZ, float maxX, float maxZ);
+
+        //first intersection between origin and origin + direction*maxDistance.
+        //A ray starting under the surface hits where it enters the heightfield
+        bool    RayCast(const Heightmap::Heightfield& field, const Pyramid& pyramid,
+                        const glm::vec3& origin, const glm::vec3& direction, float maxDistance,
+                        RayHit& hit);
+
+        //one ray cast per [starts[i], ends[i]] segment, distances are in [0, 1].
+        //Big batches are spread over Parallel workers
+        void    IntersectSegments(const Heightmap::Heightfield& field, const Pyramid& pyramid,
+                                  const glm::vec3* starts, const glm::vec3* ends,
+                                  RayHit* hits, int count);
+    }
+
+}
+
+#endif
@@ -0,0 +1,138 @@
+/******PROJECT:Sand Castle Engine******/
+/**************************************/
+/*********AUTHOR:Gwenn AUBERT**********/
+/*********FILE:SCEHeightmap.hpp********/
+/**************************************/
+#ifndef SCE_HEIGHTMAP_HPP
+#define SCE_HEIGHTMAP_HPP
+
+#include "SCEDefines.hpp"
+
+//CPU side of the terrain generation, no GL calls in here.
+//Maps are square, stored with x as the major axis : map[x*size + z]
+namespace SCE
+{
+
+    namespace Heightmap
+    {
+        //Texture layout, uploaded as GL_RGBA16 : octahedral normal in rg (remapped to 0..1),
+        //height / heightScale in a, b is unused. Same x major order as the float maps.
+        struct GPUTexel
+        {
+            ui16    normalX;
+            ui16    normalY;
+            ui16    unused;
+            ui16    height;
+        };
+
+        //CPU layout, stored in Morton order : 16 bits height / heightScale,
+        //8 bits signed octahedral normal
+        struct CompactTexel
+        {
+            ui16        height;
+            signed char normalX;
+            signed char normalY;
+        };
+
+        enum Filter
+        {
+            FILTER_NEAREST = 0,
+            FILTER_BILINEAR,
+            //Catmull-Rom, smooth slopes for things moving over the terrain, 16 texels per sample
+            FILTER_BICUBIC,
+            FILTER_COUNT
+        };
+
+        //Read only view of a compact heightfield. Sample coordinates are in texels : like GL
+        //texture filtering, texel (x, z) holds the value at (x + 0.5, z + 0.5) and the field repeats.
+        //Sampling never writes, any number of threads can share a view
+        struct Heightfield
+        {
+            Heightfield() : texels(nullptr), size(0), heightScale(0.0f) {}
+            const CompactTexel* texels;
+            ui32                size;
+            float               heightScale;
+        };
+
+        //Everything the generated heights and normals depend on
+        struct Params
+        {
+            Params() : size(0), offset(0.0f), startScale(1.0f), heightScale(10000.0f),
+                terrainSize(0.0f), seed(0) {}
+            ui32    size;
+            float   offset;
+            float   startScale;
+            float   heightScale;
+            float   terrainSize;
+            ui32    seed;
+        };
+
+        //parameters used by Terrain::Init, terrainSize is rounded down to a multiple of patchSize
+        Params  GetTerrainParams(float terrainSize, float patchSize, ui32 textureSize);
+
+        //changes whenever the generated data would, including with the generator's compile time options
+        ui64    HashParams(const Params& params);
+
+        //Fill heightmap with layered perlin noise, Perlin::MakePerlin must have been called before
+        void    GenerateHeights(float* heightmap, int size, float offset,
+                                float startScale, float heightScale);
+
+        //Smooth per vertex normals, packed with the height in the alpha channel
+        void    ComputeNormalsAndHeight(const float* heightmap, int size, float terrainSize,
+                                        glm::vec4* normalAndHeight);
+
+        //normals with y >= 0 map to the inner diamond, so that filtering doesn't cross a seam
+        glm::vec2   EncodeOctahedral(const glm::vec3& normal);
+        glm::vec3   DecodeOctahedral(const glm::vec2& encoded);
+
+
+        //heights are expected in [0, heightScale]
+        GPUTexel    PackGPUTexel(const glm::vec3& normal, float height, float heightScale);
+        void        PackGPUTexels(const glm::vec4* normalAndHeight, int size, float heightScale,
+                                  GPUTexel* texels);
+        CompactTexel PackCompactTexel(const GPUTexel& texel);
+        //size must be a power of two, compact[MortonIndex(x, z)] is texel (x, z)
+        void        PackCompactTexels(const GPUTexel* texels, int size, CompactTexel* compact);
+
+        float       SampleHeight(const Heightfield& field, float x, float z, Filter filter);
+        //normals are filtered in their octahedral encoding, same as the GPU does
+        glm::vec3   SampleNormal(const Heightfield& field, float x, float z, Filter filter);
+
+        //Same results as the single sample versions, for count points given as separate
+        //x and z arrays. Bilinear heights are filtered 4 at a time when SSE2 is available
+        void        SampleHeights(const Heightfield& field, const float* x, const float* z,
+                                  float* heights, int count, Filter filter);
+        void        SampleNormals(const Heightfield& field, const float* x, const float* z,
+                                  glm::vec3* normals, int count, Filter filter);
+
+        //spreads the 16 low bits of val over the even bits
+        inline ui32 SpreadBits(ui32 val)
+        {
+            val &= 0x0000FFFF;
+            val = (val | (val << 8)) & 0x00FF00FF;
+            val = (val | (val << 4)) & 0x0F0F0F0F;
+            val = (val | (val << 2)) & 0x33333333;
+            val = (val | (val << 1)) & 0x55555555;
+            return val;
+        }
+
+        //interleaves the bits of x and z, neighbour texels end up close in memory
+        inline ui32 MortonIndex(ui32 x, ui32 z)
+        {
+            return (SpreadBits(x) << 1) | SpreadBits(z);
+        }
+
+        inline float DecodeHeight(const CompactTexel& texel, float heightScale)
+        {
+            return float(texel.height) * (heightScale / 65535.0f);
+        }
+
+        inline glm::vec3 DecodeNormal(const CompactTexel& texel)
+        {
+            return DecodeOctahedral(glm::vec2(float(texel.normalX), float(texel.normalY)) / 127.0f);
+        }
+    }
+
+}
+
+#endif
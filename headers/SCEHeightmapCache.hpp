@@ -0,0 +1,46 @@
+/******PROJECT:Sand Castle Engine******/
+/**************************************/
+/*********AUTHOR:Gwenn AUBERT**********/
+/******FILE:SCEHeightmapCache.hpp******/
+/**************************************/
+#ifndef SCE_HEIGHTMAP_CACHE_HPP
+#define SCE_HEIGHTMAP_CACHE_HPP
+
+#include "SCEDefines.hpp"
+#include "SCEHeightmap.hpp"
+
+//bump when the file layout changes
+#define HEIGHTMAP_CACHE_VERSION 2
+
+//Generated terrain data saved to disk, one file per heightmap size.
+//A file is only used if it was written with the same version and the same
+//Heightmap::HashParams, otherwise the caller regenerates and overwrites it.
+namespace SCE
+{
+
+    namespace HeightmapCache
+    {
+        struct CachedHeightmap
+        {
+            CachedHeightmap() : texels(nullptr), size(0), mapping(nullptr), mappingSize(0) {}
+            //points into the mapping, writes stay in memory (copy on write)
+            Heightmap::GPUTexel* texels;
+            ui32        size;
+            void*       mapping;
+            ui64        mappingSize;
+        };
+
+        std::string GetCacheFilename(ui32 size);
+
+        //maps the file in memory, fails if it is missing, truncated or out of date
+        bool        Load(const std::string& filename, ui64 paramsHash, ui32 size,
+                         CachedHeightmap& cached);
+        void        Release(CachedHeightmap& cached);
+
+        bool        Save(const std::string& filename, ui64 paramsHash, ui32 size,
+                         const Heightmap::GPUTexel* texels);
+    }
+
+}
+
+#endif
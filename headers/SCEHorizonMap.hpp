@@ -0,0 +1,79 @@
+/******PROJECT:Sand Castle Engine******/
+/**************************************/
+/*********AUTHOR:Gwenn AUBERT**********/
+/********FILE:SCEHorizonMap.hpp********/
+/**************************************/
+#ifndef SCE_HORIZON_MAP_HPP
+#define SCE_HORIZON_MAP_HPP
+
+#include "SCEDefines.hpp"
+#include "SCEHeightmap.hpp"
+#include "SCETerrainBrush.hpp"
+#include <vector>
+
+//bump when the bake or the file layout changes
+#define HORIZON_MAP_VERSION 1
+//directions are stored in the channels of RGBA8 layers
+#define HORIZON_DIRECTIONS_PER_LAYER 4
+
+//Terrain self shadowing baked per texel : for N azimuths, the sine of the elevation of the
+//terrain horizon, up to maxDistance texels away. A point is lit when the sun is higher than
+//its horizon, so lighting only needs a texture lookup instead of a ray march or a depth pass.
+//No GL calls in here.
+namespace SCE
+{
+
+    namespace HorizonMap
+    {
+        struct Settings
+        {
+            Settings() : size(0), directionCount(8), maxDistance(256.0f), texelSpacing(1.0f) {}
+            //map texels per side, a power of two not bigger than the heightfield
+            ui32    size;
+            //a multiple of HORIZON_DIRECTIONS_PER_LAYER, direction i has the azimuth 2*pi*i/directionCount
+            //in the heightfield (x, z) plane
+            ui32    directionCount;
+            //in heightfield texels
+            float   maxDistance;
+            //worldspace distance between two heightfield texels
+            float   texelSpacing;
+        };
+
+        struct Map
+        {
+            Settings            settings;
+            //layer major, then x major rows like the heightmap texture :
+            //texels[((layer*size + x)*size + z)*4 + direction%4], layer = direction/4
+            std::vector<ui8>    texels;
+        };
+
+        //parallel over the map rows
+        void        Bake(const Heightmap::Heightfield& field, const Settings& settings, Map& map);
+
+        //bakes again the map texels whose horizon depends on the heights of heightsRect, a rect of
+        //heightfield texels. Returns the rebaked rect, in map texels
+        TerrainBrush::TexelRect UpdateRegion(const Heightmap::Heightfield& field, Map& map,
+                                             const TerrainBrush::TexelRect& heightsRect);
+
+        //sine of the horizon elevation, in [0, 1]
+        float       GetHorizonSine(const Map& map, ui32 x, ui32 z, ui32 direction);
+
+        //at the map texel under heightfield position (x, z), interpolated between the two azimuths
+        //around direction_xz, like the shadow pass does
+        float       SampleHorizonSine(const Map& map, ui32 fieldSize, float x, float z,
+                                      const glm::vec2& direction_xz);
+
+        glm::vec2   GetDirection(const Map& map, ui32 direction);
+        ui32        GetLayerCount(const Map& map);
+
+        //from the heights themselves, so that the cache follows any change to the terrain
+        ui64        Hash(const Heightmap::Heightfield& field, const Settings& settings);
+
+        //fails if the file is missing, truncated or was written for other settings or heights
+        bool        Load(const std::string& filename, const Settings& settings, ui64 hash, Map& map);
+        bool        Save(const std::string& filename, ui64 hash, const Map& map);
+    }
+
+}
+
+#endif
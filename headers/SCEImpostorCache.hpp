@@ -0,0 +1,64 @@
+/******PROJECT:Sand Castle Engine******/
+/**************************************/
+/*********AUTHOR:Gwenn AUBERT**********/
+/******FILE:SCEImpostorCache.hpp*******/
+/**************************************/
+#ifndef SCE_IMPOSTOR_CACHE_HPP
+#define SCE_IMPOSTOR_CACHE_HPP
+
+#include "SCEDefines.hpp"
+#include <vector>
+
+//bump when the capture or the file layout changes
+#define IMPOSTOR_CACHE_VERSION 1
+
+//Impostor atlases rendered by BillboardRender::GenerateTexturesFromMesh, saved to disk so that
+//the next launches upload them instead of capturing every view again.
+//The key hashes the bytes of every file the capture reads (meshes, textures, shader) with the
+//capture settings, so changing any of them regenerates the atlases. No GL calls in here.
+namespace SCE
+{
+
+    namespace ImpostorCache
+    {
+        struct Settings
+        {
+            Settings() : nbAngles(0), texSize(0), border(0.0f) {}
+            //views in the atlas, a square number
+            ui32    nbAngles;
+            //texels per side of a view
+            ui32    texSize;
+            float   border;
+        };
+
+        struct Atlas
+        {
+            Atlas() : size(0), billboardSize(0.0f) {}
+            //texels per side, sqrt(nbAngles)*texSize
+            ui32                size;
+            //half size of the captured volume, as returned by GenerateTexturesFromMesh
+            glm::vec3           billboardSize;
+            //RGBA16 texels of the first mip, row major like glGetTexImage, the other mips are generated
+            //again on upload
+            std::vector<ui64>   diffuse;
+            std::vector<ui64>   normal;
+        };
+
+        ui32        GetAtlasSize(const Settings& settings);
+
+        std::string GetCacheFilename(const std::string& name, const Settings& settings);
+
+        //sourceFiles are asset names, looked up like the loaders do : in the application ressources
+        //first, then in SCE_Assets. values are the other inputs of the capture, like material constants
+        ui64        Hash(const Settings& settings, const std::vector<std::string>& sourceFiles,
+                         const std::vector<float>& values);
+
+        //fails if the file is missing, truncated or was written for other settings or sources
+        bool        Load(const std::string& filename, const Settings& settings, ui64 hash, Atlas& atlas);
+        //the empty texels around the views are stored as runs, the atlases are mostly empty
+        bool        Save(const std::string& filename, const Settings& settings, ui64 hash, const Atlas& atlas);
+    }
+
+}
+
+#endif
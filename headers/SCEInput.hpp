@@ -25,7 +25,11 @@ namespace SCE
             Count
         };
 
-        void        UpdateKeyStates(GLFWwindow *window);
+        //returns GLFW_PRESS or GLFW_RELEASE for the given key
+        typedef int (*KeyStateSource)(int key);
+
+        //poll every key from the source, once per frame
+        void        UpdateKeyStates(KeyStateSource source);
         KeyAction   GetKeyAction(int key);
     }
 }
@@ -0,0 +1,107 @@
+/******PROJECT:Sand Castle Engine******/
+/**************************************/
+/*********AUTHOR:Gwenn AUBERT**********/
+/**********FILE:SCELogger.hpp**********/
+/**************************************/
+#ifndef SCE_LOGGER_HPP
+#define SCE_LOGGER_HPP
+
+#include <string>
+
+//Asynchronous logger : any thread pushes records in a lock free ring buffer,
+//a writer thread prefixes them (time, level, category, thread) and hands them to the sinks.
+//Before Init and after Shutdown records are written synchronously instead.
+
+//Levels below this one are compiled out of the SCE_LOG macros
+#ifndef SCE_LOG_COMPILE_LEVEL
+    #if defined(SCE_DEBUG)
+        #define SCE_LOG_COMPILE_LEVEL SCE::Logger::LOG_TRACE
+    #elif defined(SCE_DEBUG_ENGINE)
+        #define SCE_LOG_COMPILE_LEVEL SCE::Logger::LOG_DEBUG
+    #else
+        #define SCE_LOG_COMPILE_LEVEL SCE::Logger::LOG_INFO
+    #endif
+#endif
+
+//The message expression is only evaluated when the record passes both filters,
+//so string building for disabled levels or categories costs nothing
+#define SCE_LOG(level, category, message) \
+    do { \
+        if((level) >= SCE_LOG_COMPILE_LEVEL && SCE::Logger::IsEnabled((level), (category))) \
+        { \
+            SCE::Logger::Write((level), (category), (message)); \
+        } \
+    } while(0)
+
+#define SCE_LOG_TRACE(category, message)    SCE_LOG(SCE::Logger::LOG_TRACE, category, message)
+#define SCE_LOG_DEBUG(category, message)    SCE_LOG(SCE::Logger::LOG_DEBUG, category, message)
+#define SCE_LOG_INFO(category, message)     SCE_LOG(SCE::Logger::LOG_INFO, category, message)
+#define SCE_LOG_WARNING(category, message)  SCE_LOG(SCE::Logger::LOG_WARNING, category, message)
+#define SCE_LOG_ERROR(category, message)    SCE_LOG(SCE::Logger::LOG_ERROR, category, message)
+
+namespace SCE
+{
+
+    namespace Logger
+    {
+        enum LogLevel
+        {
+            LOG_TRACE = 0,
+            LOG_DEBUG,
+            LOG_INFO,
+            LOG_WARNING,
+            LOG_ERROR,
+            LOG_LEVEL_COUNT
+        };
+
+        enum LogCategory
+        {
+            CAT_GENERAL = 0,
+            CAT_ENGINE,
+            CAT_RENDER,
+            CAT_TERRAIN,
+            CAT_TREES,
+            CAT_RESOURCES,
+            CAT_SCENE,
+            LOG_CATEGORY_COUNT
+        };
+
+        //start and stop the writer thread, Shutdown writes everything still queued
+        void        Init();
+        void        Shutdown();
+
+        //runtime filters, records below the minimum level or in a disabled category are ignored
+        void        SetMinLevel(LogLevel level);
+        LogLevel    GetMinLevel();
+        void        SetCategoryEnabled(LogCategory category, bool enabled);
+        bool        IsEnabled(LogLevel level, LogCategory category);
+
+        //queue a record without checking the filters, prefer the SCE_LOG macros.
+        //When the ring is full, errors wait for room and other levels are dropped (and counted)
+        void        Write(LogLevel level, LogCategory category, std::string message);
+
+        //blocks until every record queued before the call reached the sinks
+        void        Flush();
+
+        //records that went through the ring since the start : queued, written from it, and dropped
+        //because it was full. Records written synchronously are not counted
+        size_t      GetPushedCount();
+        size_t      GetWrittenCount();
+        size_t      GetDroppedCount();
+
+        //for the tests : while paused the writer thread leaves the records in the ring.
+        //Flush and errors pushed to a full ring wait until it resumes, Shutdown still drains the ring
+        void        SetWriterPaused(bool paused);
+
+        //sinks, console is enabled by default : stdout, warnings and errors on stderr
+        void        SetConsoleSinkEnabled(bool enabled);
+        bool        OpenFileSink(const std::string& filename);
+        void        CloseFileSink();
+
+        const char* GetLevelName(LogLevel level);
+        const char* GetCategoryName(LogCategory category);
+    }
+
+}
+
+#endif
@@ -0,0 +1,93 @@
+/******PROJECT:Sand Castle Engine******/
+/**************************************/
+/*********AUTHOR:Gwenn AUBERT**********/
+/**********FILE:SCEMemory.hpp**********/
+/**************************************/
+#ifndef SCE_MEMORY_HPP
+#define SCE_MEMORY_HPP
+
+#include "SCEDefines.hpp"
+
+//Memory accounting per engine subsystem, for both CPU heap and GL resources.
+//Nothing is intercepted : systems report what they allocate and free.
+//All functions are thread safe.
+namespace SCE
+{
+
+    namespace Memory
+    {
+        enum MemoryTag
+        {
+            TAG_GENERAL = 0,
+            TAG_PERLIN,
+            TAG_TERRAIN,
+            TAG_TREES,
+            TAG_MESHES,
+            TAG_TEXTURES,
+            TAG_RENDER_TARGETS,
+            TAG_TEXT,
+            MEMORY_TAG_COUNT
+        };
+
+        enum MemoryKind
+        {
+            CPU_HEAP = 0,
+            GPU_TEXTURE,
+            GPU_BUFFER,
+            GPU_RENDERBUFFER,
+            MEMORY_KIND_COUNT
+        };
+
+        struct Snapshot
+        {
+            Snapshot();
+            i64     bytes[MEMORY_TAG_COUNT][MEMORY_KIND_COUNT];
+            ui32    liveGLResources;
+        };
+
+        //CPU side
+        void        TrackAllocation(MemoryTag tag, ui64 bytes);
+        void        TrackDeallocation(MemoryTag tag, ui64 bytes);
+        //use when a container grew or shrank, old size must be what was previously reported
+        void        TrackResize(MemoryTag tag, ui64 oldBytes, ui64 newBytes);
+
+        //GL side, keyed by object name. Tracking an already tracked name replaces its size
+        //(ie : glBufferData called again on the same buffer)
+        void        TrackGLTexture(MemoryTag tag, GLuint textureId, ui64 bytes);
+        void        UntrackGLTexture(GLuint textureId);
+        void        TrackGLBuffer(MemoryTag tag, GLuint bufferId, ui64 bytes);
+        void        UntrackGLBuffer(GLuint bufferId);
+        void        TrackGLRenderbuffer(MemoryTag tag, GLuint renderbufferId, ui64 bytes);
+        void        UntrackGLRenderbuffer(GLuint renderbufferId);
+
+        //size of a texture as the driver will most likely store it
+        ui64        ComputeTextureSize(ui32 width, ui32 height, ui32 depth,
+                                       GLenum internalFormat, bool hasMipmaps);
+
+        i64         GetCurrentBytes(MemoryTag tag, MemoryKind kind);
+        //highest value reached since startup
+        i64         GetPeakBytes(MemoryTag tag, MemoryKind kind);
+        //highest value reached since the last call to ResetHighWaterMarks
+        i64         GetHighWaterBytes(MemoryTag tag, MemoryKind kind);
+        void        ResetHighWaterMarks();
+
+        std::string GetReport();
+        void        LogReport();
+
+        Snapshot    TakeSnapshot();
+        //returns an empty string when nothing changed between the two snapshots
+        std::string DiffSnapshots(const Snapshot& before, const Snapshot& after);
+
+        const char* GetTagName(MemoryTag tag);
+        const char* GetKindName(MemoryKind kind);
+
+        template<typename T>
+        ui64 VectorBytes(const std::vector<T>& vect)
+        {
+            return ui64(vect.capacity()) * sizeof(T);
+        }
+    }
+
+}
+
+#endif
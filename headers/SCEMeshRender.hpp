@@ -23,6 +23,17 @@ namespace SCE
                                              GLenum drawType);
         void                SetInstanceCustomData(ui16 meshId, void* data, uint size, GLenum drawType,
                                        uint nbComponents, GLenum componentType);
+        //16 bytes per instance, read by the shader as a uvec4 "instanceData" attribute,
+        //for shaders that make their model matrix themselves instead of reading instanceMatrix
+        void                SetMeshInstanceData(ui16 meshId, const void* instanceData, uint instanceCount,
+                                                GLenum drawType);
+        //The same buffer updated in place : Reserve makes room for instanceCapacity instances and
+        //draws none, Update writes instanceCount of them from firstInstance, SetMeshInstanceCount
+        //sets how many of them are drawn
+        void                ReserveMeshInstanceData(ui16 meshId, uint instanceCapacity, GLenum drawType);
+        void                UpdateMeshInstanceData(ui16 meshId, const void* instanceData,
+                                                   uint firstInstance, uint instanceCount);
+        void                SetMeshInstanceCount(ui16 meshId, uint instanceCount);
         void                DrawInstances(ui16 meshId,  const mat4& projectionMatrix,
                                           const mat4& viewMatrix);
         void                RenderMesh( ui16 meshId, const mat4& projectionMatrix,
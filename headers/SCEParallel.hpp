@@ -0,0 +1,150 @@
+/******PROJECT:Sand Castle Engine******/
+/**************************************/
+/*********AUTHOR:Gwenn AUBERT**********/
+/*********FILE:SCEParallel.hpp*********/
+/**************************************/
+#ifndef SCE_PARALLEL_HPP
+#define SCE_PARALLEL_HPP
+
+#include "SCEDefines.hpp"
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+//Fork/join helper for long CPU jobs (terrain generation...), not meant for per frame work :
+//worker threads are created for each call.
+//BackgroundWorker is the per frame counterpart : one long lived thread running jobs in the background.
+//TripleBuffer hands the results of such jobs to the thread using them, without a lock.
+namespace SCE
+{
+
+    namespace Parallel
+    {
+        //processes [rangeBegin, rangeEnd[
+        typedef std::function<void(int rangeBegin, int rangeEnd)> RangeBody;
+
+        //0 means one worker per hardware thread, 1 runs everything on the calling thread
+        void    SetWorkerCount(ui32 workerCount);
+        ui32    GetWorkerCount();
+
+        //splits [begin, end[ in blocks of blockSize and hands them to the workers,
+        //returns once every block is processed. The calling thread works too.
+        void    For(int begin, int end, int blockSize, const RangeBody& body);
+
+        //set when the running job should stop early, jobs check it between their steps
+        typedef std::atomic<bool> CancelToken;
+        typedef std::function<void(const CancelToken& cancel)> Job;
+
+        //Runs the submitted jobs one at a time on a thread created once. Jobs are snapshots of
+        //the work to do : a job submitted while another one waits replaces it.
+        class BackgroundWorker
+        {
+        public :
+
+            BackgroundWorker();
+            //cancels the running job and stops the thread
+            ~BackgroundWorker();
+
+            void    Submit(const Job& job);
+            //drops the waiting job and asks the running one to stop
+            void    Cancel();
+            //returns once no job is waiting or running
+            void    Wait();
+            bool    IsBusy();
+            //seconds from the submission of the last finished job to its end
+            double  GetLastLatency();
+
+        private :
+
+            BackgroundWorker(const BackgroundWorker&);
+            BackgroundWorker& operator=(const BackgroundWorker&);
+
+            void    run();
+
+            std::thread             mThread;
+            std::mutex              mLock;
+            std::condition_variable mJobCondition;
+            std::condition_variable mIdleCondition;
+            Job                     mPendingJob;
+            CancelToken             mCancel;
+            bool                    mHasPendingJob;
+            bool                    mIsRunning;
+            bool                    mIsStopping;
+            double                  mPendingSubmitTime;
+            double                  mLastLatency;
+        };
+
+        //Lock free handoff of the latest value from one producer thread to one consumer thread.
+        //The producer fills its buffer then publishes it, the consumer takes the last published one :
+        //neither side ever waits for the other. A value published again before being consumed is dropped.
+        template<typename T>
+        class TripleBuffer
+        {
+        public :
+
+            TripleBuffer()
+                : mState(1), mWriteIndex(0), mReadIndex(2),
+                  mPublishedCount(0), mConsumedCount(0), mDroppedCount(0)
+            {}
+
+            //producer side, the buffer to fill. It holds an older value, to overwrite
+            T&          GetWriteBuffer() { return mBuffers[mWriteIndex]; }
+            void        Publish()
+            {
+                ui32 previous = mState.exchange(mWriteIndex | FRESH_BIT, std::memory_order_acq_rel);
+                mWriteIndex = previous & INDEX_MASK;
+                mPublishedCount.fetch_add(1, std::memory_order_relaxed);
+                if(previous & FRESH_BIT)
+                {
+                    mDroppedCount.fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+
+            //consumer side, returns true when the read buffer changed since the last call
+            bool        Consume()
+            {
+                //only the consumer clears the bit, so it is still set for the exchange
+                if(!(mState.load(std::memory_order_relaxed) & FRESH_BIT))
+                {
+                    return false;
+                }
+                ui32 previous = mState.exchange(mReadIndex, std::memory_order_acq_rel);
+                mReadIndex = previous & INDEX_MASK;
+                mConsumedCount.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+            const T&    GetReadBuffer() const { return mBuffers[mReadIndex]; }
+
+            //any of the three buffers, only to read their size from the producer
+            const T&    GetBuffer(ui32 index) const { return mBuffers[index]; }
+            static ui32 GetBufferCount() { return 3; }
+
+            ui64        GetPublishedCount() const { return mPublishedCount.load(std::memory_order_relaxed); }
+            ui64        GetConsumedCount() const { return mConsumedCount.load(std::memory_order_relaxed); }
+            ui64        GetDroppedCount() const { return mDroppedCount.load(std::memory_order_relaxed); }
+
+        private :
+
+            TripleBuffer(const TripleBuffer&);
+            TripleBuffer& operator=(const TripleBuffer&);
+
+            //state is the index of the buffer between the two sides, and whether it is not consumed yet
+            static const ui32 INDEX_MASK = 3;
+            static const ui32 FRESH_BIT = 4;
+
+            T                   mBuffers[3];
+            std::atomic<ui32>   mState;
+            //each only used by its side
+            ui32                mWriteIndex;
+            ui32                mReadIndex;
+            std::atomic<ui64>   mPublishedCount;
+            std::atomic<ui64>   mConsumedCount;
+            std::atomic<ui64>   mDroppedCount;
+        };
+    }
+
+}
+
+#endif
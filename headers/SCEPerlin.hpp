@@ -8,15 +8,29 @@
 
 #include "SCEDefines.hpp"
 
+#define PERLIN_BATCH_WIDTH 4
+#define PERLIN_DEFAULT_SEED 1337
+
 namespace SCE
 {
     namespace Perlin
     {
 
-        void    MakePerlin(ui16 gridSize);
+        //gridSize is the period of the noise, in grid cells. The same seed gives
+        //the same noise on every run and platform
+        void    MakePerlin(ui16 gridSize, ui32 seed = PERLIN_DEFAULT_SEED);
         float   GetPerlinAt(float x, float y, float period);
         float   GetPerlinAt(float x, float y);
         float   GetLayeredPerlinAt(float x, float y, int layers, float persistence);
+
+        //Batched versions of the above : results[i] = GetPerlinAt(x[i], y[i], period).
+        //Samples are evaluated PERLIN_BATCH_WIDTH at a time with SSE2 when available,
+        //any count is accepted. Coordinates must fit in an int.
+        void    GetPerlinBatch(const float* x, const float* y, float period,
+                               float* results, int count);
+        //all octaves are accumulated in registers, results[i] = GetLayeredPerlinAt(x[i], y[i], ...)
+        void    GetLayeredPerlinBatch(const float* x, const float* y, int layers, float persistence,
+                                      float* results, int count);
         void    DestroyPerlin();
 
     }
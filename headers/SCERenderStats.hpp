@@ -0,0 +1,85 @@
+/******PROJECT:Sand Castle Engine******/
+/**************************************/
+/*********AUTHOR:Gwenn AUBERT**********/
+/*******FILE:SCERenderStats.hpp********/
+/**************************************/
+#ifndef SCE_RENDER_STATS_HPP
+#define SCE_RENDER_STATS_HPP
+
+#include "SCEDefines.hpp"
+
+//Per frame rendering counters. Everything here must be called from the render thread,
+//worker threads have to hand their numbers over to the render thread to report them.
+namespace SCE
+{
+
+    namespace RenderStats
+    {
+        enum RenderPass
+        {
+            UPDATE_PASS = 0, //culling updates and buffer uploads done before drawing anything
+            SHADOW_PASS,
+            GEOMETRY_PASS,
+            LIGHTING_PASS,
+            POST_PROCESS_PASS,
+            RENDER_PASS_COUNT
+        };
+
+        struct PassStats
+        {
+            PassStats()
+                : drawCalls(0), instancedDrawCalls(0), instances(0), triangles(0),
+                  patches(0), programSwitches(0), textureBinds(0), framebufferBinds(0),
+                  bufferBytesUploaded(0), uniformCalls(0), visibleObjects(0), culledObjects(0)
+            {}
+            ui32    drawCalls;
+            ui32    instancedDrawCalls;
+            ui32    instances;
+            ui64    triangles;
+            ui32    patches;
+            ui32    programSwitches;
+            ui32    textureBinds;
+            ui32    framebufferBinds;
+            ui64    bufferBytesUploaded;
+            ui32    uniformCalls;
+            ui32    visibleObjects;
+            ui32    culledObjects;
+        };
+
+        struct FrameStats
+        {
+            FrameStats() : frameIndex(0), cpuTimeMs(0.0) {}
+            ui64        frameIndex;
+            double      cpuTimeMs;
+            PassStats   passes[RENDER_PASS_COUNT];
+            PassStats   total;
+        };
+
+        void                BeginFrame();
+        void                EndFrame();
+        void                SetCurrentPass(RenderPass pass);
+        RenderPass          GetCurrentPass();
+
+        void                CountDraw(GLenum mode, ui32 indiceCount);
+        void                CountInstancedDraw(GLenum mode, ui32 indiceCount, ui32 instanceCount);
+        void                CountPatches(ui32 patchCount);
+        void                CountProgramBind(GLuint program);
+        void                CountTextureBind(ui32 bindCount = 1);
+        void                CountFramebufferBind(GLuint fboId);
+        void                CountBufferUpload(ui64 bytes);
+        void                CountUniformCalls(ui32 callCount = 1);
+        void                CountVisibility(ui32 visibleCount, ui32 culledCount);
+
+        //stats of the last completed frame
+        const FrameStats&   GetLastFrameStats();
+        const char*         GetPassName(RenderPass pass);
+
+        //CSV export, one line per pass and per frame
+        bool                StartCSVExport(const std::string& filename);
+        void                StopCSVExport();
+        bool                IsExportingCSV();
+    }
+
+}
+
+#endif
@@ -0,0 +1,55 @@
+/******PROJECT:Sand Castle Engine******/
+/**************************************/
+/*********AUTHOR:Gwenn AUBERT**********/
+/***********FILE:SCESimd.hpp***********/
+/**************************************/
+#ifndef SCE_SIMD_HPP
+#define SCE_SIMD_HPP
+
+#include "SCEDefines.hpp"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define SCE_USE_SSE2 1
+#else
+#define SCE_USE_SSE2 0
+#endif
+
+//Internal SSE2 helpers shared by the 4 wide CPU paths (Perlin noise, heightfield sampling).
+//Lane by lane, they do the same float operations in the same order as their scalar versions
+#if SCE_USE_SSE2
+namespace SCE
+{
+
+    namespace Simd
+    {
+        inline __m128 Floor4(__m128 v)
+        {
+            //truncate, then step down for negative non integer values
+            __m128 truncated = _mm_cvtepi32_ps(_mm_cvttps_epi32(v));
+            __m128 tooBig = _mm_cmpgt_ps(truncated, v);
+            return _mm_sub_ps(truncated, _mm_and_ps(tooBig, _mm_set1_ps(1.0f)));
+        }
+
+        //a + t*(b - a), like glm::mix
+        inline __m128 Mix4(__m128 a, __m128 b, __m128 t)
+        {
+            return _mm_add_ps(a, _mm_mul_ps(t, _mm_sub_ps(b, a)));
+        }
+
+        //Heightmap::SpreadBits on each lane
+        inline __m128i SpreadBits4(__m128i val)
+        {
+            val = _mm_and_si128(val, _mm_set1_epi32(0x0000FFFF));
+            val = _mm_and_si128(_mm_or_si128(val, _mm_slli_epi32(val, 8)), _mm_set1_epi32(0x00FF00FF));
+            val = _mm_and_si128(_mm_or_si128(val, _mm_slli_epi32(val, 4)), _mm_set1_epi32(0x0F0F0F0F));
+            val = _mm_and_si128(_mm_or_si128(val, _mm_slli_epi32(val, 2)), _mm_set1_epi32(0x33333333));
+            val = _mm_and_si128(_mm_or_si128(val, _mm_slli_epi32(val, 1)), _mm_set1_epi32(0x55555555));
+            return val;
+        }
+    }
+
+}
+#endif
+
+#endif
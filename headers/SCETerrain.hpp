@@ -7,6 +7,9 @@
 #define SCE_TERRAIN_HPP
 
 #include "SCEDefines.hpp"
+#include "SCEHeightmap.hpp"
+#include "SCEHeightPyramid.hpp"
+#include "SCETerrainBrush.hpp"
 
 //TODO make terrain textures and texture sizes customizable
 
@@ -29,10 +32,37 @@ namespace SCE
         void RenderTrees(const glm::mat4& projectionMatrix, const glm::mat4& viewMatrix,
                          bool isShadowPass = false);
 
+        //Terrain queries only read the heightfield, they can run on any thread between Init and Cleanup,
+        //as long as DeformTerrain isn't running.
+        //Bilinear, same as the rendered terrain
         float GetTerrainHeight(const vec3 &pos_worldspace);
 
         glm::vec3 GetTerrainNormal(const vec3& pos_worldspace);
 
+        float SampleTerrainHeight(const vec3& pos_worldspace, SCE::Heightmap::Filter filter);
+
+        glm::vec3 SampleTerrainNormal(const vec3& pos_worldspace, SCE::Heightmap::Filter filter);
+
+        //batch versions, positions are given as separate worldspace x and z arrays
+        void GetTerrainHeights(const float* x_worldspace, const float* z_worldspace, float* heights,
+                               int count, SCE::Heightmap::Filter filter = SCE::Heightmap::FILTER_BILINEAR);
+
+        void GetTerrainNormals(const float* x_worldspace, const float* z_worldspace, glm::vec3* normals,
+                               int count, SCE::Heightmap::Filter filter = SCE::Heightmap::FILTER_BILINEAR);
+
+        //line of sight, picking and collisions : first hit against the rendered (bilinear) surface,
+        //hit.distance is in world units
+        bool RaycastTerrain(const vec3& origin_worldspace, const vec3& direction_worldspace,
+                            float maxDistance, SCE::HeightPyramid::RayHit& hit);
+
+        void IntersectTerrainSegments(const vec3* starts_worldspace, const vec3* ends_worldspace,
+                                      SCE::HeightPyramid::RayHit* hits, int count);
+
+        //Edits the heightfield under the brush, on the main thread. Positions and radius are in
+        //worldspace, start.y and end.y are the target heights of the flatten and road brushes.
+        //Only the texels, patches and tree groups under the brush are updated
+        void DeformTerrain(const SCE::TerrainBrush::Brush& brush_worldspace);
+
         void Cleanup();
     }
 }
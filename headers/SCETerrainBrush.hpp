@@ -0,0 +1,81 @@
+/******PROJECT:Sand Castle Engine******/
+/**************************************/
+/*********AUTHOR:Gwenn AUBERT**********/
+/*******FILE:SCETerrainBrush.hpp*******/
+/**************************************/
+#ifndef SCE_TERRAIN_BRUSH_HPP
+#define SCE_TERRAIN_BRUSH_HPP
+
+#include "SCEDefines.hpp"
+#include "SCEHeightmap.hpp"
+
+//Runtime edits of a compact heightfield, no GL calls in here.
+//Brushes are in heightfield space, like the ray casts : x and z in texels, y in height units.
+//The work only depends on the brush size : the heights under the brush change, then the
+//normals of those texels and of their neighbours are recomputed, ready for a partial upload.
+namespace SCE
+{
+
+    namespace TerrainBrush
+    {
+        enum BrushType
+        {
+            //adds strength at the center, negative values dig
+            BRUSH_RAISE = 0,
+            //bowl of strength depth with a raised rim, falloff is unused
+            BRUSH_CRATER,
+            //blends the heights toward start.y, strength in [0, 1]
+            BRUSH_FLATTEN,
+            //flatten along [start, end], the target height goes from start.y to end.y
+            BRUSH_ROAD,
+            BRUSH_TYPE_COUNT
+        };
+
+        struct Brush
+        {
+            Brush() : type(BRUSH_RAISE), start(0.0f), end(0.0f), radius(1.0f), falloff(0.5f), strength(1.0f) {}
+            BrushType   type;
+            glm::vec3   start;
+            glm::vec3   end;
+            float       radius;
+            //outer part of the radius where the brush fades out, in [0, 1]
+            float       falloff;
+            float       strength;
+        };
+
+        //[minX, maxX] x [minZ, maxZ] in texels, bounds included. Like the sampling, the heightfield
+        //repeats : the rect may go past its edges, it is never wider than the heightfield
+        struct TexelRect
+        {
+            i32     minX;
+            i32     minZ;
+            i32     maxX;
+            i32     maxZ;
+        };
+
+        //texels whose height the brush can change
+        TexelRect   GetBrushRect(const Brush& brush, ui32 size);
+
+        //texels whose normal depends on the heights in rect
+        TexelRect   GetNormalsRect(const TexelRect& heightsRect, ui32 size);
+
+        //changes the heights in GetBrushRect, texels are in Morton order like Heightfield::texels
+        void        ApplyBrush(Heightmap::CompactTexel* texels, ui32 size, float heightScale, const Brush& brush);
+
+        //Same normals as Heightmap::ComputeNormalsAndHeight, for the texels of rect only.
+        //Updates the compact normals and fills gpuTexels, an x major copy of rect to upload
+        void        UpdateNormals(Heightmap::CompactTexel* texels, ui32 size, float terrainSize, float heightScale,
+                                  const TexelRect& rect, Heightmap::GPUTexel* gpuTexels);
+
+        //splits a rect into at most 4 rects inside [0, size[, returns their count
+        ui32        SplitWrapped(const TexelRect& rect, ui32 size, TexelRect wrapped[4]);
+
+        inline ui32 GetTexelCount(const TexelRect& rect)
+        {
+            return ui32(rect.maxX - rect.minX + 1)*ui32(rect.maxZ - rect.minZ + 1);
+        }
+    }
+
+}
+
+#endif
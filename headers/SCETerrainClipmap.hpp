@@ -0,0 +1,56 @@
+/******PROJECT:Sand Castle Engine******/
+/**************************************/
+/*********AUTHOR:Gwenn AUBERT**********/
+/******FILE:SCETerrainClipmap.hpp******/
+/**************************************/
+#ifndef SCE_TERRAINCLIPMAP_HPP
+#define SCE_TERRAINCLIPMAP_HPP
+
+#include "SCEDefines.hpp"
+#include "SCEClipmap.hpp"
+#include "SCETiledHeightfield.hpp"
+
+//texture unit of the ClipmapTextures sampler, bound even when there is no clipmap
+//so that it never shares a unit with a sampler2D
+#define CLIPMAP_TEXTURE_UNIT 5
+
+namespace SCE
+{
+    //GL side of the streamed terrain : one texture array layer per clipmap level, filled with
+    //the tiles of a TiledHeightfield as the camera moves. The file is centered on the world origin
+    class TerrainClipmap
+    {
+    public :
+
+        TerrainClipmap();
+        ~TerrainClipmap();
+        bool Open(const std::string& filename);
+        void Close();
+        //also needed when no file is open, to set the terrain shader uniforms
+        void InitRenderData(GLuint terrainProgram);
+        bool IsActive() const;
+        const TiledHeightfield::File& GetFile() const;
+        //from worldspace to level 0 texels of the file
+        glm::vec2 WorldToTexel(float x_worldspace, float z_worldspace) const;
+
+        //queues the tiles around the camera and uploads a few of them
+        void Update(const glm::vec3& cameraPosition_worldspace);
+        //level transforms are relative to the root, precise far from the world origin
+        void BindUniforms(const glm::vec3& rootPosition_worldspace);
+        ui32 GetPendingPageCount() const;
+
+    private :
+
+        TiledHeightfield::File      mFile;
+        Clipmap::State              mState;
+        std::vector<Clipmap::Page>  mPages;
+
+        GLuint  mTexture;
+        GLint   mTexturesUniform;
+        GLint   mLevelCountUniform;
+        GLint   mLevelUvUniform;
+        GLint   mLevelBoundsUniform;
+    };
+}
+
+#endif
@@ -0,0 +1,98 @@
+/******PROJECT:Sand Castle Engine******/
+/**************************************/
+/*********AUTHOR:Gwenn AUBERT**********/
+/******FILE:SCETerrainQuadtree.hpp*****/
+/**************************************/
+#ifndef SCE_TERRAIN_QUADTREE_HPP
+#define SCE_TERRAIN_QUADTREE_HPP
+
+#include "SCEDefines.hpp"
+#include <vector>
+#include <functional>
+
+//tessellation levels clamps of the terrain TCS
+#define TERRAIN_MIN_TESS_LEVEL 4.0f
+#define TERRAIN_MAX_TESS_LEVEL 64.0f
+//biggest merged patch, in patches per side. The TCS scales the min tessellation
+//of a merged patch by its size, this keeps it under the max
+#define TERRAIN_MAX_MERGED_PATCHES 16
+//worldspace margin above and below the patch height ranges. The tessellated surface stays
+//between the heights of the texels under it, this only covers the GPU filtering rounding
+#define TERRAIN_BOUNDS_SKIRT 1.0f
+
+//CPU side of the terrain patches : a quadtree over the patch grid, culled against the frustrum
+//and turned into one instance per patch to draw. No GL calls in here.
+//Far nodes whose patches would all be tessellated at the minimum level are drawn as one
+//bigger patch with a scaled minimum level : same vertices, fewer patches. The TCS uses an
+//even spacing, so the edges shared with single patches line up and there is no crack.
+namespace SCE
+{
+
+    namespace TerrainQuadtree
+    {
+        struct Node
+        {
+            glm::vec3   boundsMin;
+            glm::vec3   boundsMax;
+            //-1 when there is no child : leaves, or children outside of the patch grid
+            i32         children[4];
+            //first patch and patches per side, a power of two
+            ui16        x;
+            ui16        z;
+            ui16        size;
+        };
+
+        struct Quadtree
+        {
+            Quadtree() : patchesPerSide(0), patchSize(0.0f), origin_worldspace(0.0f) {}
+            ui32                patchesPerSide;
+            float               patchSize;
+            //corner of patch (0, 0), y is the height of the patch quads
+            glm::vec3           origin_worldspace;
+            //root first
+            std::vector<Node>   nodes;
+        };
+
+        //uniforms of the terrain TCS that the tessellation level depends on
+        struct LodSettings
+        {
+            LodSettings() : maxTessDistance(0.0f), lodMultiplier(1.0f) {}
+            float   maxTessDistance;
+            float   lodMultiplier;
+        };
+
+        struct SelectionStats
+        {
+            SelectionStats() : visitedNodes(0), culledPatches(0), drawnPatches(0), instanceCount(0) {}
+            ui32    visitedNodes;
+            //in single patches, a merged instance counts all the patches it covers
+            ui32    culledPatches;
+            ui32    drawnPatches;
+            ui32    instanceCount;
+        };
+
+        //patchHeightRanges[x*patchesPerSide + z] holds the min and max worldspace heights of a patch
+        void    Build(ui32 patchesPerSide, float patchSize, const glm::vec3& origin_worldspace,
+                      const std::vector<glm::vec2>& patchHeightRanges, Quadtree& tree);
+
+        //min and max worldspace heights of patch (x, z)
+        typedef std::function<glm::vec2(ui32 x, ui32 z)> PatchHeightQuery;
+
+        //refits the patches of [minX, maxX] x [minZ, maxZ] and the nodes above them,
+        //the rest of the tree is left as it is
+        void    UpdateHeightRanges(Quadtree& tree, ui32 minX, ui32 minZ, ui32 maxX, ui32 maxZ,
+                                   const PatchHeightQuery& getHeightRange);
+
+        //same formula as the terrain TCS, for an edge at the given distance from the camera
+        float   GetTessellationLevel(float distance, float patchSize, const LodSettings& lod);
+
+        //Cull against the frustrum set by FrustrumCulling::UpdateCulling and append one instance
+        //per patch to draw : worldspace corner in xyz, size in w
+        void    SelectPatches(const Quadtree& tree, const glm::mat4& worldToCamera,
+                              const glm::vec3& cameraPosition_worldspace, const LodSettings& lod,
+                              std::vector<glm::vec4>& instances, SelectionStats& stats);
+    }
+
+}
+
+#endif
@@ -8,6 +8,10 @@
 
 #include "SCEDefines.hpp"
 
+//terrain self shadowing from a baked horizon map, a texture lookup in the screen space shadow pass.
+//Replaces the terrain in the shadow cascades, see SCELighting.cpp
+#define TERRAIN_HORIZON_SHADOW 0
+
 namespace SCE
 {
     class SCE_GBuffer;
@@ -18,7 +22,8 @@ namespace SCE
 
         TerrainShadow();
         void RenderShadow(const mat4& projectionMatrix, const mat4& viewMatrix,
-                          const vec3 &sunPosition, SCE_GBuffer &gbuffer, const glm::mat4 &worldToTerrainspace, uint terrainTexture, float heightScale);
+                          const vec3 &sunPosition, SCE_GBuffer &gbuffer, const glm::mat4 &worldToTerrainspace, uint terrainTexture, float heightScale,
+                          uint horizonTexture, int horizonDirectionCount);
 
     private :
 
@@ -29,6 +34,8 @@ namespace SCE
         GLint  mFinalTexUniform;
         GLint  mSunPositionUniform;
         GLint  mHeightScaleUniform;
+        GLint  mHorizonMapUniform;
+        GLint  mHorizonDirectionCountUniform;
 
     };
 }
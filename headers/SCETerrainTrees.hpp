@@ -7,11 +7,9 @@
 #define SCE_SCETERRAINTREES_HPP
 
 #include "SCEDefines.hpp"
+#include "SCETreeLayout.hpp"
+#include "SCEParallel.hpp"
 #include <vector>
-#include <thread>
-#include <mutex>
-
-#define TREE_LOD_COUNT 3
 
 namespace SCE
 {
@@ -26,11 +24,43 @@ namespace SCE
         void SpawnTreeInstances(const glm::mat4 &viewMatrix, const glm::mat4 &worldToTerrainspaceMatrix,
                                 const glm::vec3 &cameraPosition, float maxDistFromCenter);
         void RenderTrees(const glm::mat4& projectionMatrix, const glm::mat4& viewMatrix, bool isShadowPass);
+        //the visibility update reads the terrain heights, wait for it before changing them
+        void WaitForUpdate();
+        //places the tree groups again over a deformed part of the terrain
+        void InvalidateRegion(const glm::vec2& min_worldspace, const glm::vec2& max_worldspace);
+#if USE_IMPOSTORS
+        //impostor atlases saved by the constructor, see ImpostorCache
+        static std::string GetImpostorCacheFilename();
+#endif
 
     private :
 
-        void UpdateVisibilityAndLOD(glm::mat4 viewMatrix, glm::mat4 worldToTerrainspaceMatrix,
-                                    glm::vec3 cameraPosition_scenespace, float maxDistFromCenter, mat4 impostorScaleMat);
+        //camera state of one visibility update, copied so that the main thread can move on
+        struct VisibilitySnapshot
+        {
+            glm::mat4   viewMatrix;
+            glm::vec3   cameraPosition_scenespace;
+            glm::vec3   rootPosition_worldspace;
+            float       maxDistFromCenter;
+        };
+
+        void UpdateVisibilityAndLOD(VisibilitySnapshot snapshot, const Parallel::CancelToken& cancel);
+        //uploads the pages of the list written since the last upload
+        void UploadInstanceList(const TreeLayout::TreeInstances& instances, ui32 list);
+#if USE_IMPOSTORS
+        //creates the impostor textures, returns the half size of the captured volume
+        glm::vec3 InitializeImpostorAtlases();
+#endif
+
+        //GenerateTreeGroups parameters, kept for the partial updates
+        struct LayoutParams
+        {
+            float   xOffset;
+            float   zOffset;
+            float   startScale;
+            float   heightScale;
+            float   halfTerrainSize;
+        };
 
         struct ImpostorGLData
         {
@@ -39,6 +69,9 @@ namespace SCE
             GLint       textureUniform;
             GLuint      normalTexture;
             GLint       normalUniform;
+            GLint       scaleMatrixUniform;
+            GLint       atlasSizeUniform;
+            GLint       atlasBorderUniform;
             GLuint      shaderProgram;
         };
 
@@ -63,22 +96,24 @@ namespace SCE
             ImpostorGLData impostorData;
         };
 
-        struct TreeGroup
-        {
-            glm::vec2 position;
-            float radius;
-            float spacing;
-        };
-
-        TreeGLData              mTreeGlData;
-        std::vector<TreeGroup>  mTreeGroups;
-        std::vector<glm::mat4>  mTreeMatrices[TREE_LOD_COUNT];
-        std::vector<glm::mat4>  mTreeImpostorMatrices;
-        std::vector<glm::vec4>  mTreeImpostorTexMapping;
-
-        std::unique_ptr<std::thread> mUpdateThread;
-        std::mutex  mTreeInstanceLock;
-        bool        mInstancesUpToDate;
+        TreeGLData                          mTreeGlData;
+        std::vector<TreeLayout::TreeGroup>  mTreeGroups;
+        TreeLayout::GroupGrid               mGroupGrid;
+        LayoutParams                        mLayoutParams;
+        //written by the visibility update, uploaded and drawn by the main thread
+        Parallel::TripleBuffer<TreeLayout::TreeInstances> mTreeInstances;
+        //only used by the visibility update
+        TreeLayout::PlacementCache          mPlacementCache;
+
+        //instances each list's buffers have room for, and the update of the uploaded lists
+        ui32                                mInstanceCapacities[TREE_LIST_COUNT];
+        ui32                                mUploadedUpdate;
+
+        Parallel::BackgroundWorker  mUpdateWorker;
+        double      mLastUpdateTime;
+        ui64        mTrackedInstanceBytes;
+        //longest the main thread took to take new instances, in seconds
+        double      mMaxConsumeTime;
         glm::mat4   mImpostorScaleMat;
     };
 }
@@ -0,0 +1,85 @@
+/******PROJECT:Sand Castle Engine******/
+/**************************************/
+/*********AUTHOR:Gwenn AUBERT**********/
+/*****FILE:SCETiledHeightfield.hpp*****/
+/**************************************/
+#ifndef SCE_TILED_HEIGHTFIELD_HPP
+#define SCE_TILED_HEIGHTFIELD_HPP
+
+#include "SCEDefines.hpp"
+#include "SCEHeightmap.hpp"
+#include "SCEHeightPyramid.hpp"
+#include <functional>
+
+//bump when the file layout changes
+#define TILED_HEIGHTFIELD_VERSION 1
+
+//Heightfields too big to be loaded at once, streamed by the clipmap terrain.
+//The file holds a mip chain of GPUTexel maps : level l is size >> l texels wide, down to a
+//single tile. Each level is cut in square tiles stored one after the other, so that a tile
+//is one contiguous block of the mapping and one glTexSubImage upload.
+//Tiles are in the same x major order as the maps : tile[x*tileSize + z].
+namespace SCE
+{
+
+    namespace TiledHeightfield
+    {
+        struct TileInfo
+        {
+            //from the start of the file
+            ui64    offset;
+            //raw heights of the tile texels
+            ui16    minHeight;
+            ui16    maxHeight;
+            ui32    padding;
+        };
+
+        struct File
+        {
+            File() : size(0), tileSize(0), levelCount(0), heightScale(0.0f), texelSpacing(0.0f),
+                tiles(nullptr), mapping(nullptr), mappingSize(0) {}
+            //level 0 texels per side
+            ui32                size;
+            ui32                tileSize;
+            ui32                levelCount;
+            float               heightScale;
+            //worldspace distance between two level 0 texels
+            float               texelSpacing;
+            //first entry of each level in tiles
+            std::vector<ui32>   levelFirstTile;
+            const TileInfo*     tiles;
+            void*               mapping;
+            ui64                mappingSize;
+        };
+
+        //height of level 0 texel (x, z), in [0, heightScale]. Called from several threads
+        typedef std::function<float(ui32 x, ui32 z)> HeightSource;
+
+        //size and tileSize must be powers of two, tileSize <= size <= 65536 and size/tileSize <= 32768.
+        //Open refuses the files that break these rules
+        bool    Write(const std::string& filename, ui32 size, ui32 tileSize, float heightScale,
+                      float texelSpacing, const HeightSource& getHeight);
+
+        //maps the file in memory read only, tiles are paged in by the OS when first read
+        bool    Open(const std::string& filename, File& file);
+        void    Close(File& file);
+
+        inline ui32 GetTilesPerSide(const File& file, ui32 level)
+        {
+            return (file.size >> level) / file.tileSize;
+        }
+
+        const TileInfo&             GetTileInfo(const File& file, ui32 level, ui32 tileX, ui32 tileZ);
+        const Heightmap::GPUTexel*  GetTile(const File& file, ui32 level, ui32 tileX, ui32 tileZ);
+
+        //copies a whole level into an x major map of (size >> level)^2 texels
+        void    ReadLevel(const File& file, ui32 level, Heightmap::GPUTexel* texels);
+
+        //Conservative range of the raw heights over [minX, maxX] x [minZ, maxZ] in level 0 texels,
+        //from the ranges of the tiles under it. The region is clamped to the file
+        HeightPyramid::HeightRange GetRange(const File& file, float minX, float minZ, float maxX, float maxZ);
+    }
+
+}
+
+#endif
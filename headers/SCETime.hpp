@@ -13,6 +13,9 @@ namespace SCE
 
 namespace Time
 {
+        //returns a time in seconds, only differences between two calls are used
+        typedef double (*ClockSource)();
+
         void     Init();
         void     CleanUp();
         void     Update();
@@ -21,6 +24,8 @@ namespace Time
         double   RealTimeInSeconds();
         float    GetTimeSpeed();
         void     SetTimeSpeed(float value);
+        //call before Init, nullptr restores the default steady clock
+        void     SetClockSource(ClockSource source);
 }
 
 }
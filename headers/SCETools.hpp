@@ -17,6 +17,20 @@ namespace Tools
     int         HashFromString(const std::string& str);
     std::string ToLowerCase(const std::string &str);
     uint FloatToColorRange(float val);
+
+    struct FileChunk
+    {
+        const void* data;
+        ui64        bytes;
+    };
+
+    //Writes the chunks one after the other to a temporary file, then renames it to filename, so that
+    //a crash never leaves a valid looking, truncated file. On failure filename is left as it was
+    bool        WriteFileAtomically(const std::string& filename, const std::vector<FileChunk>& chunks);
+    //the same in two steps, for files written another way : the file to write, then the rename.
+    //ReplaceWithTemporaryFile replaces filename in one step and removes the temporary file if it fails
+    std::string GetTemporaryFilename(const std::string& filename);
+    bool        ReplaceWithTemporaryFile(const std::string& filename);
 }
 
 namespace Debug
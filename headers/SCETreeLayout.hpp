@@ -0,0 +1,241 @@
+/******PROJECT:Sand Castle Engine******/
+/**************************************/
+/*********AUTHOR:Gwenn AUBERT**********/
+/********FILE:SCETreeLayout.hpp********/
+/**************************************/
+#ifndef SCE_TREE_LAYOUT_HPP
+#define SCE_TREE_LAYOUT_HPP
+
+#include "SCEDefines.hpp"
+#include "SCEParallel.hpp"
+#include <vector>
+#include <functional>
+#include <unordered_map>
+
+#define TREE_LOD_COUNT 3
+//instance lists : one per LOD, then the impostors
+#define TREE_IMPOSTOR_LIST TREE_LOD_COUNT
+#define TREE_LIST_COUNT (TREE_LOD_COUNT + 1)
+//list of the trees that aren't drawn
+#define TREE_LOD_HIDDEN 0xFF
+//the lists changes are tracked and uploaded by pages of instances, 4 KB
+#define TREE_INSTANCE_PAGE_SIZE 256
+
+#define USE_IMPOSTORS 1
+#define NB_IMPOSTOR_ANGLES (6*6)
+#define BILLBOARD_BORDER 0.05f
+#define IMPOSTOR_FLIP_X 0
+#define IMPOSTOR_FACE_Z 0
+//border of the atlas cells the impostors are mapped to
+#if IMPOSTOR_FACE_Z
+#define IMPOSTOR_ATLAS_BORDER 0.0f
+#else
+#define IMPOSTOR_ATLAS_BORDER BILLBOARD_BORDER
+#endif
+//how far from the camera an impostor may face before it is turned again, in radians
+#define TREE_IMPOSTOR_REFACE_ANGLE 0.02f
+
+//packing of CompactInstance::packed, the tree shaders unpack it the same way
+#define TREE_INSTANCE_YAW_BITS 14
+#define TREE_INSTANCE_SCALE_BITS 12
+#define TREE_INSTANCE_INDEX_BITS 6
+#define TREE_INSTANCE_MAX_SCALE 4.0f
+
+//side of the cells of the tree group grid, in world units
+#define TREE_GROUP_GRID_CELL_SIZE 1000.0f
+
+//CPU side of the terrain trees : tree groups placement, culling and LOD selection.
+//No GL calls in here, terrain queries go through the given callbacks so that
+//this can run on a worker thread or without a terrain at all.
+namespace SCE
+{
+
+    namespace TreeLayout
+    {
+        typedef std::function<float(const glm::vec3& pos_worldspace)>       HeightQuery;
+        typedef std::function<glm::vec3(const glm::vec3& pos_worldspace)>   NormalQuery;
+        typedef std::function<void(const float* x_worldspace, const float* z_worldspace,
+                                   float* heights, int count)>              HeightBatchQuery;
+
+        struct TreeGroup
+        {
+            glm::vec2 position;
+            float radius;
+            float spacing;
+            //ground height at position, worldspace
+            float height;
+            //grid point the group was generated from, unique among the groups
+            ui32 gridIndex;
+        };
+
+        //Uniform grid over the groups, the visibility update only looks at the cells in range and in view
+        struct GroupGrid
+        {
+            GroupGrid() : origin(0.0f), cellSize(0.0f), cellsPerSide(0), maxReach(0.0f) {}
+            glm::vec2               origin;
+            float                   cellSize;
+            ui32                    cellsPerSide;
+            //farthest a tree is from its group center, over every group
+            float                   maxReach;
+            //groups of cell i = x*cellsPerSide + z are cellGroups[cellStarts[i], cellStarts[i + 1][
+            std::vector<ui32>       cellStarts;
+            std::vector<ui32>       cellGroups;
+            //box around the culling spheres of the groups of each cell, worldspace
+            std::vector<glm::vec3>  cellMin;
+            std::vector<glm::vec3>  cellMax;
+        };
+
+        //What the GPU gets for each tree, 16 bytes instead of a matrix and an atlas mapping.
+        //The vertex shaders make the model matrix translate*rotateY(yaw)*scale from it
+        struct CompactInstance
+        {
+            //worldspace
+            float   x;
+            float   y;
+            float   z;
+            //yaw | scale << TREE_INSTANCE_YAW_BITS | index << (TREE_INSTANCE_YAW_BITS + TREE_INSTANCE_SCALE_BITS)
+            //index is the LOD for tree models, the atlas cell for impostors
+            ui32    packed;
+        };
+        static_assert(sizeof(CompactInstance) == 16, "Tree instances are uploaded as uvec4");
+        static_assert(NB_IMPOSTOR_ANGLES <= (1 << TREE_INSTANCE_INDEX_BITS), "Impostor views don't fit the instances");
+
+        //Trees of the groups close to the camera. They only depend on the group and on the terrain
+        //under it, so they are placed once when the group comes in range and dropped when it leaves.
+        //Each cached group owns a slot of slotCapacity trees in the arrays.
+        //The LOD of the trees of a slot is kept too, and only computed again once the camera moved
+        //enough for a tree to change LOD or for an impostor to face too far from the camera.
+        //The instance lists are patched from one update to the next : a tree keeps its place in its
+        //list until it leaves it, its place is then taken by the last tree of the list
+        struct PlacementCache
+        {
+            PlacementCache();
+            //per tree : worldspace position, already sunk in the ground, scale and rotation noise
+            std::vector<float>  treeX;
+            std::vector<float>  treeY;
+            std::vector<float>  treeZ;
+            std::vector<float>  treeScales;
+            std::vector<float>  treeNoises;
+            //per slot : tree count, and the group circle (x, z, radius) around every tree
+            std::vector<ui32>       slotTreeCounts;
+            std::vector<glm::vec3>  slotBounds;
+            std::vector<ui32>       slotGroups;
+            std::vector<ui32>       freeSlots;
+            //slot of each cached group, by grid index
+            std::unordered_map<ui32, ui32> groupSlots;
+            ui32                    slotCapacity;
+
+            //per tree : the list its LOD puts it in, TREE_LOD_HIDDEN when it isn't drawn,
+            //and its impostor, already facing the camera
+            std::vector<ui8>        treeLods;
+            std::vector<CompactInstance> treeImpostors;
+            //per slot : camera (x, z) the LODs were computed from, and how far it can go before they
+            //are computed again. Negative when they must be computed at the next update
+            std::vector<glm::vec3>  slotLodStates;
+            //settings the LODs were computed with, any change computes them again
+            float                   lodDistances[TREE_LOD_COUNT];
+            float                   lodMaxDrawDistance;
+            float                   lodMaxDistFromCenter;
+
+            //the lists as the last update left them : per list the instances and the tree of each,
+            //and the update each page was last written at. Per tree the list it is in and its place
+            std::vector<CompactInstance> drawnInstances[TREE_LIST_COUNT];
+            std::vector<ui32>       drawnTrees[TREE_LIST_COUNT];
+            std::vector<ui32>       drawnPageUpdates[TREE_LIST_COUNT];
+            std::vector<ui8>        treeLists;
+            std::vector<ui32>       treePlaces;
+            //slots in the lists, and per slot the last update it was visible at, 0 when not in the lists
+            std::vector<ui32>       drawnSlots;
+            std::vector<ui32>       slotDrawnUpdates;
+            //counts the updates, kept when the cache is reset, and tells the caches apart
+            ui32                    update;
+            ui32                    id;
+        };
+
+        //The lists hold the trees of the visible groups in no particular order, see PlacementCache.
+        //pageUpdates tells which pages of TREE_INSTANCE_PAGE_SIZE instances each update wrote, so that
+        //a copy of the lists made at an older update only needs the pages written since
+        struct TreeInstances
+        {
+            TreeInstances() : visibleGroupCount(0), culledGroupCount(0), relodGroupCount(0), update(0), cacheId(0) {}
+            std::vector<CompactInstance>    trees[TREE_LOD_COUNT];
+            std::vector<CompactInstance>    impostors;
+            ui32                    visibleGroupCount;
+            ui32                    culledGroupCount;
+            //visible groups whose LODs were computed again during the update
+            ui32                    relodGroupCount;
+            //per list, the LODs then the impostors
+            std::vector<ui32>       pageUpdates[TREE_LIST_COUNT];
+            //cache and update the lists were written from, update is 0 when they must be written whole
+            ui32                    update;
+            ui32                    cacheId;
+        };
+
+        inline const std::vector<CompactInstance>& GetInstanceList(const TreeInstances& instances, ui32 list)
+        {
+            return list == TREE_IMPOSTOR_LIST ? instances.impostors : instances.trees[list];
+        }
+
+        //Spread tree groups over the terrain, on low and flat areas
+        void        GenerateTreeGroups(float xOffset, float zOffset, float startScale,
+                                       float heightScale, float halfTerrainSize,
+                                       const HeightQuery& getHeight, const NormalQuery& getNormal,
+                                       std::vector<TreeGroup>& groups);
+
+        //Regenerates the groups of the grid points in [min, max] after the terrain there changed,
+        //same parameters as GenerateTreeGroups. The other groups are kept, the order is not
+        void        UpdateTreeGroups(float xOffset, float zOffset, float startScale,
+                                     float heightScale, float halfTerrainSize,
+                                     const HeightQuery& getHeight, const NormalQuery& getNormal,
+                                     const glm::vec2& min_worldspace, const glm::vec2& max_worldspace,
+                                     std::vector<TreeGroup>& groups);
+
+        //indexes the groups by position, to build again once the groups change
+        void        BuildGroupGrid(const std::vector<TreeGroup>& groups, float cellSize, GroupGrid& grid);
+
+        //Cull the groups in range of the camera against the frustrum and update the instance lists.
+        //Only the cells of the grid around the camera are visited.
+        //FrustrumCulling::UpdateCulling must have been called with the camera projection.
+        //getHeights is only called for the groups coming in range of the camera, the LODs of the trees
+        //only computed again for the groups the camera moved enough from, and only the trees that
+        //changed list or impostor written again. instances can be any copy an older update wrote.
+        //Returns between cells and groups once cancel is set, instances are then left empty
+        void        ComputeVisibilityAndLOD(const std::vector<TreeGroup>& groups,
+                                            const GroupGrid& grid,
+                                            const glm::mat4& viewMatrix,
+                                            const glm::vec3& rootPosition_worldspace,
+                                            const glm::vec3& cameraPosition_scenespace,
+                                            float maxDistFromCenter,
+                                            const HeightBatchQuery& getHeights,
+                                            const Parallel::CancelToken& cancel,
+                                            PlacementCache& cache,
+                                            TreeInstances& instances);
+
+        //drops the cached trees that may stand in [min, max], after the terrain there changed
+        void        InvalidatePlacements(const glm::vec2& min_worldspace, const glm::vec2& max_worldspace,
+                                         PlacementCache& cache);
+        //the next update computes the LODs of every tree again, the placements are kept
+        void        InvalidateLods(PlacementCache& cache);
+
+        ui64        GetGroupGridBytes(const GroupGrid& grid);
+        ui64        GetPlacementCacheBytes(const PlacementCache& cache);
+
+        //yaw in radians, wrapped to [0, 2*pi[, scale clamped to [0, TREE_INSTANCE_MAX_SCALE]
+        CompactInstance EncodeInstance(const glm::vec3& position_worldspace, float scale, float yawRad,
+                                       ui32 index);
+        void        DecodeInstance(const CompactInstance& instance, glm::vec3& position_worldspace,
+                                   float& scale, float& yawRad, ui32& index);
+        //model matrix the tree shaders make from the instance
+        glm::mat4   GetInstanceMatrix(const CompactInstance& instance);
+
+        //atlas cell closest to the given angle
+        ui32        GetImpostorView(float angleRad, ui16 nbAngles);
+        //uv rect (start, size) of an atlas cell, the impostor shader computes the same
+        glm::vec4   GetImpostorViewMapping(ui32 view, ui16 nbAngles, bool flipX, float borderRatio);
+        //uv rect (start, size) of the atlas cell closest to the given angle
+        glm::vec4   GetImpostorMapping(float angleRad, ui16 nbAngles, bool flipX, float borderRatio);
+    }
+
+}
+
+#endif
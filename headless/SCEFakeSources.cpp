@@ -0,0 +1,90 @@
+/******PROJECT:Sand Castle Engine******/
+/**************************************/
+/*********AUTHOR:Gwenn AUBERT**********/
+/*******FILE:SCEFakeSources.cpp********/
+/**************************************/
+
+#include "SCEFakeSources.hpp"
+#include "../headers/SCETime.hpp"
+#include "../headers/SCEInput.hpp"
+#include "../headers/SCETools.hpp"
+
+namespace SCE
+{
+
+namespace FakeTime
+{
+    namespace
+    {
+        double fakeTime = 0.0;
+
+        double fakeClock()
+        {
+            return fakeTime;
+        }
+    }
+
+    void Install(double startTime)
+    {
+        fakeTime = startTime;
+        SCE::Time::SetClockSource(fakeClock);
+        SCE::Time::Init();
+    }
+
+    void Uninstall()
+    {
+        SCE::Time::SetClockSource(nullptr);
+    }
+
+    void Advance(double seconds)
+    {
+        Debug::Assert(seconds >= 0.0, "Fake time can only move forward");
+        fakeTime += seconds;
+    }
+
+    void Step(double frameDuration)
+    {
+        Advance(frameDuration);
+        SCE::Time::Update();
+    }
+
+    double Now()
+    {
+        return fakeTime;
+    }
+}
+
+namespace FakeInput
+{
+#define FAKE_KEY_COUNT (GLFW_KEY_LAST + 1)
+    namespace
+    {
+        bool fakeKeyDown[FAKE_KEY_COUNT] = { false };
+
+        int fakeKeyState(int key)
+        {
+            return fakeKeyDown[key] ? GLFW_PRESS : GLFW_RELEASE;
+        }
+    }
+
+    void SetKeyDown(int key, bool isDown)
+    {
+        Debug::Assert(key >= 0 && key < FAKE_KEY_COUNT, "Invalid key");
+        fakeKeyDown[key] = isDown;
+    }
+
+    void ReleaseAllKeys()
+    {
+        for(int i = 0; i < FAKE_KEY_COUNT; ++i)
+        {
+            fakeKeyDown[i] = false;
+        }
+    }
+
+    void Update()
+    {
+        SCE::Input::UpdateKeyStates(fakeKeyState);
+    }
+}
+
+}
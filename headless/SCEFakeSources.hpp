@@ -0,0 +1,38 @@
+/******PROJECT:Sand Castle Engine******/
+/**************************************/
+/*********AUTHOR:Gwenn AUBERT**********/
+/*******FILE:SCEFakeSources.hpp********/
+/**************************************/
+#ifndef SCE_FAKE_SOURCES_HPP
+#define SCE_FAKE_SOURCES_HPP
+
+#include "../headers/SCEDefines.hpp"
+
+//Scripted replacements for the clock and the keyboard, so that code depending on
+//SCE::Time and SCE::Input can run deterministically without a window.
+namespace SCE
+{
+
+    namespace FakeTime
+    {
+        //makes SCE::Time read the fake clock and resets it to startTime
+        void    Install(double startTime = 0.0);
+        //restores the default clock
+        void    Uninstall();
+        void    Advance(double seconds);
+        //Advance then SCE::Time::Update, ie : simulate one frame of the given duration
+        void    Step(double frameDuration);
+        double  Now();
+    }
+
+    namespace FakeInput
+    {
+        void    SetKeyDown(int key, bool isDown);
+        void    ReleaseAllKeys();
+        //latch the current fake key states into SCE::Input, same as one frame of polling
+        void    Update();
+    }
+
+}
+
+#endif
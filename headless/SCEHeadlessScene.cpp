@@ -0,0 +1,45 @@
+/******PROJECT:Sand Castle Engine******/
+/**************************************/
+/*********AUTHOR:Gwenn AUBERT**********/
+/*****FILE:SCEHeadlessScene.cpp********/
+/**************************************/
+
+//The headless core does not link the renderer, so SCEScene.cpp is left out and the
+//container functions are provided here instead, without any rendering attached.
+//Only the functions below are available, everything else in SCEScene needs the full engine.
+
+#include "../headers/SCEScene.hpp"
+
+namespace SCE
+{
+
+namespace
+{
+    std::vector<Container*> headlessContainers;
+    int                     headlessLastId = 0;
+}
+
+SCEHandle<Container> SCEScene::CreateContainer(const std::string& name)
+{
+    Container* cont = new Container(name, ++headlessLastId);
+    headlessContainers.push_back(cont);
+    return SCEHandle<Container>(cont);
+}
+
+void SCEScene::DestroyContainer(const SCEHandle<Container>& container)
+{
+    RemoveContainer(container->GetContainerId());
+}
+
+void SCEScene::RemoveContainer(int objId)
+{
+    auto objIt = std::find_if(begin(headlessContainers), end(headlessContainers),
+                              [&objId](Container* cont) { return cont->GetContainerId() == objId; });
+    if(objIt != end(headlessContainers))
+    {
+        delete(*objIt);
+        headlessContainers.erase(objIt);
+    }
+}
+
+}
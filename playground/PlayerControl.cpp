@@ -120,6 +120,22 @@ void PlayerControl::Update()
 #endif
     }
 
+    //dig a crater where we are looking
+    if (GetKeyAction( GLFW_KEY_C ) == KeyAction::Press)
+    {
+        SCE::HeightPyramid::RayHit hit;
+        glm::vec3 origin = mTransform->GetScenePosition() + SCEScene::GetFrameRootPosition();
+        if(SCE::Terrain::RaycastTerrain(origin, mTransform->Forward(), 5000.0f, hit))
+        {
+            SCE::TerrainBrush::Brush crater;
+            crater.type = SCE::TerrainBrush::BRUSH_CRATER;
+            crater.start = hit.position;
+            crater.radius = 60.0f;
+            crater.strength = 25.0f;
+            SCE::Terrain::DeformTerrain(crater);
+        }
+    }
+
     vec3 yAxis(0.0, 1.0, 0.0);
     vec3 xAxis(mTransform->LocalToSceneDir(vec3(1.0, 0.0, 0.0)));
     xAxis.y = 0.0f;
@@ -168,7 +184,8 @@ void PlayerControl::Update()
     vec3 position = mTransform->GetScenePosition();
     position += mTransform->Forward()*deltaTime*speed;
     //this height is worldspace, not scene space
-    float height = SCE::Terrain::GetTerrainHeight(position + rootPosition);
+    //bicubic so that the height follows the slopes smoothly instead of by texel sized steps
+    float height = SCE::Terrain::SampleTerrainHeight(position + rootPosition, SCE::Heightmap::FILTER_BICUBIC);
     float heightAvgDur = 0.1f;
     //need to offset for scene root
     averageHeight = (averageHeight*heightAvgDur + height*deltaTime)/(heightAvgDur + deltaTime);
@@ -13,6 +13,7 @@
 #include "../headers/SCERender.hpp"
 #include "../headers/SCECore.hpp"
 #include "../headers/SCEMeshLoader.hpp"
+#include "../headers/SCELogger.hpp"
 
 using namespace std;
 using namespace glm;
@@ -163,7 +164,7 @@ void Light::bindRenderDataForShader(const vec3& cameraPosition)
             glUniform1f(unifId, maxDot);
             break;
         default :
-            SCE::Debug::LogError(std::string("Unknown ligth uniform type : ") + std::to_string(type));
+            SCE_LOG_ERROR(Logger::CAT_RENDER, std::string("Unknown ligth uniform type : ") + std::to_string(type));
         }
     }
 }
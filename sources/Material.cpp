@@ -12,6 +12,7 @@
 #include "../headers/Transform.hpp"
 #include "../headers/SCETools.hpp"
 #include "../headers/SCEMetadataParser.hpp"
+#include "../headers/SCELogger.hpp"
 
 #include <iostream>
 #include <fstream>
@@ -58,7 +59,7 @@ void Material::LoadMaterial(const string &filename)
     {
         string currLine;
         mMaterialName = filename;
-        Internal::Log("Parsing material : " + mMaterialName);
+        SCE_LOG_DEBUG(Logger::CAT_RESOURCES, "Parsing material : " + mMaterialName);
         map<string, string> lineData;
 
 
@@ -8,6 +8,7 @@
 #include "../headers/SCETools.hpp"
 #include "../headers/SCERender.hpp"
 #include "../headers/SCEPostProcess.hpp"
+#include "../headers/SCEMemory.hpp"
 #include <glm/gtc/matrix_transform.hpp>
 
 
@@ -19,6 +20,30 @@ namespace BillboardRender
 #define BILLBOARD_INTERNAL_FORMAT GL_RGBA16
 #define GENERATE_MIPMAPS 1
 
+namespace
+{
+    //tracks the texture, then builds its mipmaps and sets its sampling
+    void setupAtlasTexture(GLuint texture, ui32 size)
+    {
+        SCE::Memory::TrackGLTexture(SCE::Memory::TAG_TEXTURES, texture,
+                                    SCE::Memory::ComputeTextureSize(size, size, 1,
+                                                                    BILLBOARD_INTERNAL_FORMAT,
+                                                                    GENERATE_MIPMAPS));
+        glBindTexture(GL_TEXTURE_2D, texture);
+#if GENERATE_MIPMAPS
+        glGenerateMipmap(GL_TEXTURE_2D);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+#else
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+#endif
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+}
+
 glm::vec3 GenerateTexturesFromMesh(ui16 nbAngles, ui16 texSize, float borderRatio,
                               glm::vec3 const& center, glm::vec3 const& dimensions,
                               GLuint* diffuseTex, GLuint* normalTex,
@@ -140,18 +165,7 @@ glm::vec3 GenerateTexturesFromMesh(ui16 nbAngles, ui16 texSize, float borderRati
 
     for(int i = 0; i < 2; ++i)
     {
-        glBindTexture(GL_TEXTURE_2D, textures[i]);
-#if GENERATE_MIPMAPS
-        glGenerateMipmap(GL_TEXTURE_2D);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-#else
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-#endif
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        setupAtlasTexture(textures[i], fullSize);
     }
 
     /*SCE::PostProcess::BlurTexture2D(textures[0], ivec4(0, 0, root*texSize, root*texSize),
@@ -163,51 +177,25 @@ glm::vec3 GenerateTexturesFromMesh(ui16 nbAngles, ui16 texSize, float borderRati
     return glm::vec3(biggestXZDim, biggestYDim, biggestXZDim);
 }
 
-
-glm::vec4 GetMappingForAgnle(float angleInRad, ui16 nbAngles, bool flipX, float borderRatio)
-{
-    ui16 root = (ui16)glm::sqrt(nbAngles);
-    nbAngles = root*root;
-
-    float PI2 = 2.0f*glm::pi<float>();
-    angleInRad = glm::mod(angleInRad + PI2, PI2);
-    ui16 prevAng = ui16(angleInRad/PI2*float(nbAngles));
-
-    ui16 xInd = prevAng/root;
-    ui16 yInd = prevAng%root;
-
-    float fRoot = (float)root;
-    float scaledHalfBorder = borderRatio/fRoot * 0.5f;
-    float width = 1.0f/fRoot - scaledHalfBorder;
-    float height = 1.0f/fRoot - scaledHalfBorder;
-
-    float xStart = (float)xInd/fRoot + scaledHalfBorder;
-    float yStart = (float)yInd/fRoot + scaledHalfBorder;
-
-    if(flipX)
-    {
-        return vec4(xStart + width, yStart, -width, height);
-    }
-    else
-    {
-        return vec4(xStart, yStart, width, height);
-    }
-}
-
-vec4 GetMappingForAgnle(float angleRad, ui16 nbAngles, float borderRatio)
+void ReadTexture(GLuint texture, ui32 size, ui64* texels)
 {
-    return GetMappingForAgnle(angleRad, nbAngles, false, borderRatio);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    GLint textureSize = 0;
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &textureSize);
+    Debug::Assert(ui32(textureSize) == size, "Billboard texture is not " + std::to_string(size) + " texels wide");
+    glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_SHORT, texels);
 }
 
-vec4 GetMappingForAgnle(float angleRad, ui16 nbAngles, bool flipX)
+GLuint CreateTexture(ui32 size, const ui64* texels)
 {
-    return GetMappingForAgnle(angleRad, nbAngles, flipX, 0.0f);
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, BILLBOARD_INTERNAL_FORMAT, size, size, 0, GL_RGBA, GL_UNSIGNED_SHORT, texels);
+    setupAtlasTexture(texture, size);
+    return texture;
 }
 
-vec4 GetMappingForAgnle(float angleRad, ui16 nbAngles)
-{
-    return GetMappingForAgnle(angleRad, nbAngles, false, 0.0f);
-}
 
 }
 }
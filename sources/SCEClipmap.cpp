@@ -0,0 +1,153 @@
+/******PROJECT:Sand Castle Engine******/
+/**************************************/
+/*********AUTHOR:Gwenn AUBERT**********/
+/**********FILE:SCEClipmap.cpp*********/
+/**************************************/
+
+#include "../headers/SCEClipmap.hpp"
+#include "../headers/SCETools.hpp"
+
+#include <algorithm>
+
+namespace SCE
+{
+
+namespace Clipmap
+{
+
+    namespace
+    {
+        TileRect intersectRects(const TileRect& a, const TileRect& b)
+        {
+            TileRect rect = { glm::max(a.minX, b.minX), glm::max(a.minZ, b.minZ),
+                              glm::min(a.maxX, b.maxX), glm::min(a.maxZ, b.maxZ) };
+            return rect;
+        }
+
+        ui32 getGridTiles(const Settings& settings, ui32 level)
+        {
+            return (settings.size >> level) / settings.tileSize;
+        }
+
+        //the tiles around the camera, kept inside the heightfield
+        TileRect computeWindow(const Settings& settings, ui32 level, float cameraX, float cameraZ)
+        {
+            i32 gridTiles = i32(getGridTiles(settings, level));
+            i32 tiles = glm::min(i32(settings.tilesPerLevel), gridTiles);
+            float tileTexels = float(settings.tileSize << level);
+            i32 minX = i32(glm::floor(cameraX/tileTexels - float(tiles)*0.5f + 0.5f));
+            i32 minZ = i32(glm::floor(cameraZ/tileTexels - float(tiles)*0.5f + 0.5f));
+            minX = glm::clamp(minX, 0, gridTiles - tiles);
+            minZ = glm::clamp(minZ, 0, gridTiles - tiles);
+            TileRect window = { minX, minZ, minX + tiles, minZ + tiles };
+            return window;
+        }
+
+        inline ui32 getSlot(const Settings& settings, i32 tileX, i32 tileZ)
+        {
+            return ui32(tileX % i32(settings.tilesPerLevel))*settings.tilesPerLevel +
+                    ui32(tileZ % i32(settings.tilesPerLevel));
+        }
+    }
+
+    void Init(const Settings& settings, State& state)
+    {
+        Debug::Assert(settings.levelCount > 0 && settings.levelCount <= CLIPMAP_MAX_LEVELS,
+                      "Invalid clipmap level count");
+        Debug::Assert((settings.size >> (settings.levelCount - 1)) >= settings.tileSize,
+                      "Clipmap levels need at least one tile of heightfield");
+
+        state = State();
+        state.settings = settings;
+        state.levels.resize(settings.levelCount);
+        TileRect empty = { 0, 0, 0, 0 };
+        for(Level& level : state.levels)
+        {
+            level.window = empty;
+            level.valid = empty;
+            level.slots.assign(settings.tilesPerLevel*settings.tilesPerLevel, glm::ivec2(-1));
+        }
+    }
+
+    void Update(State& state, float cameraX, float cameraZ)
+    {
+        const Settings& settings = state.settings;
+        state.pending.clear();
+        std::vector<Page> missing;
+        for(i32 levelId = i32(settings.levelCount) - 1; levelId >= 0; --levelId)
+        {
+            Level& level = state.levels[levelId];
+            level.window = computeWindow(settings, ui32(levelId), cameraX, cameraZ);
+
+            missing.clear();
+            for(i32 x = level.window.minX; x < level.window.maxX; ++x)
+            {
+                for(i32 z = level.window.minZ; z < level.window.maxZ; ++z)
+                {
+                    ui32 slot = getSlot(settings, x, z);
+                    if(level.slots[slot] != glm::ivec2(x, z))
+                    {
+                        Page page = { ui32(levelId), ui32(x), ui32(z), slot / settings.tilesPerLevel,
+                                      slot % settings.tilesPerLevel };
+                        missing.push_back(page);
+                    }
+                }
+            }
+
+            //the tiles under the camera first
+            float tileTexels = float(settings.tileSize << levelId);
+            glm::vec2 camera_tilespace = glm::vec2(cameraX, cameraZ)/tileTexels - 0.5f;
+            std::sort(missing.begin(), missing.end(), [camera_tilespace](const Page& a, const Page& b)
+            {
+                glm::vec2 toA = glm::vec2(float(a.tileX), float(a.tileZ)) - camera_tilespace;
+                glm::vec2 toB = glm::vec2(float(b.tileX), float(b.tileZ)) - camera_tilespace;
+                return glm::dot(toA, toA) < glm::dot(toB, toB);
+            });
+            state.pending.insert(state.pending.end(), missing.begin(), missing.end());
+
+            //the slots of the missing tiles hold tiles out of the window,
+            //what was valid and is still in the window stays readable
+            level.valid = missing.empty() ? level.window : intersectRects(level.window, level.valid);
+        }
+    }
+
+    void TakePages(State& state, ui32 maxPages, std::vector<Page>& pages)
+    {
+        const Settings& settings = state.settings;
+        ui32 count = glm::min(maxPages, ui32(state.pending.size()));
+        pages.assign(state.pending.begin(), state.pending.begin() + count);
+        state.pending.erase(state.pending.begin(), state.pending.begin() + count);
+        state.uploadedPages += count;
+
+        for(const Page& page : pages)
+        {
+            state.levels[page.level].slots[page.slotX*settings.tilesPerLevel + page.slotZ] =
+                    glm::ivec2(page.tileX, page.tileZ);
+        }
+
+        //levels with nothing left to upload are complete
+        bool isPending[CLIPMAP_MAX_LEVELS] = { false };
+        for(const Page& page : state.pending)
+        {
+            isPending[page.level] = true;
+        }
+        for(ui32 level = 0; level < settings.levelCount; ++level)
+        {
+            if(!isPending[level])
+            {
+                state.levels[level].valid = state.levels[level].window;
+            }
+        }
+    }
+
+    bool IsResident(const State& state, ui32 level, i32 tileX, i32 tileZ)
+    {
+        if(tileX < 0 || tileZ < 0)
+        {
+            return false;
+        }
+        return state.levels[level].slots[getSlot(state.settings, tileX, tileZ)] == glm::ivec2(tileX, tileZ);
+    }
+}
+
+}
@@ -10,6 +10,8 @@
 #include "../headers/SCERender.hpp"
 #include "../headers/SCEDebug.hpp"
 #include "../headers/SCEInput.hpp"
+#include "../headers/SCETime.hpp"
+#include "../headers/SCELogger.hpp"
 
 #include <time.h>
 #include <glfw3.h>
@@ -21,6 +23,14 @@ GLFWwindow *    SCECore::s_window       = nullptr;
 int             SCECore::s_windowWidth  = 0;
 int             SCECore::s_windowHeight = 0;
 
+namespace
+{
+    int getWindowKeyState(int key)
+    {
+        return SCECore::GetWindow() ? glfwGetKey(SCECore::GetWindow(), key) : GLFW_RELEASE;
+    }
+}
+
 SCECore::~SCECore()
 {
     CleanUpEngine();
@@ -28,7 +38,8 @@ SCECore::~SCECore()
 
 void SCECore::InitEngine(const std::string &windowName)
 {
-    Internal::Log("Initializing engine");
+    SCE::Logger::Init();
+    SCE_LOG_DEBUG(Logger::CAT_ENGINE, "Initializing engine");
 
     // Initialise GLFW
     if( !glfwInit() )
@@ -59,7 +70,7 @@ void SCECore::InitEngine(const std::string &windowName)
 
 //    s_window = glfwCreateWindow( 1920, 1080, windowName.c_str(), NULL, NULL);
 
-    Internal::Log("Window created");
+    SCE_LOG_DEBUG(Logger::CAT_ENGINE, "Window created");
 
     if( s_window == NULL ){
         glfwTerminate();
@@ -96,15 +107,15 @@ void SCECore::InitEngine(const std::string &windowName)
 #ifdef SCE_DEBUG
 
     if(glDebugMessageCallbackAMD) {
-        Internal::Log("Linking GL debug with AMD callback");
+        SCE_LOG_DEBUG(Logger::CAT_RENDER, "Linking GL debug with AMD callback");
         glDebugMessageCallbackAMD(DebugCallbackAMD, NULL);
     }
     else if(glDebugMessageCallbackARB) {
-        Internal::Log("Linking GL debug with ARB callback");
+        SCE_LOG_DEBUG(Logger::CAT_RENDER, "Linking GL debug with ARB callback");
         glDebugMessageCallbackARB(DebugCallback, NULL);
     }
     else {
-        Internal::Log("Linking GL debug with standard callback");
+        SCE_LOG_DEBUG(Logger::CAT_RENDER, "Linking GL debug with standard callback");
         glDebugMessageCallback(DebugCallback, NULL);
     }
 
@@ -115,7 +126,7 @@ void SCECore::InitEngine(const std::string &windowName)
     GLenum errorCode;
     while((errorCode = glGetError()) != GL_NO_ERROR)
     {
-        Debug::Log("Warning : OpenGL error found : " + std::to_string(errorCode));
+        SCE_LOG_WARNING(Logger::CAT_RENDER, "OpenGL error found : " + std::to_string(errorCode));
     }
 
 #ifdef SCE_DEBUG
@@ -127,6 +138,7 @@ void SCECore::InitEngine(const std::string &windowName)
 #endif
 
     //Init Engine subcomponents in order
+    SCE::Time::SetClockSource(glfwGetTime);
     SCE::Time::Init();
     //Rendering
     SCE::Render::Init();
@@ -139,7 +151,7 @@ void SCECore::RunEngine()
     do
     {        
         SCE::Time::Update();
-        SCE::Input::UpdateKeyStates(s_window);
+        SCE::Input::UpdateKeyStates(getWindowKeyState);
         SCE::Debug::UpdateDebugMenu();
         SCEScene::Run();
 
@@ -158,13 +170,15 @@ void SCECore::RunEngine()
 
 void SCECore::CleanUpEngine()
 {
-    Internal::Log("Cleaning up engine");
+    SCE_LOG_DEBUG(Logger::CAT_ENGINE, "Cleaning up engine");
     SCEScene::DestroyScene();
 
     //clean engine subcomponents
     SCE::Render::CleanUp();
     // Close OpenGL window and terminate GLFW
     glfwTerminate();
+
+    SCE::Logger::Shutdown();
 }
 
 GLFWwindow *SCECore::GetWindow()
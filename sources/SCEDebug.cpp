@@ -15,9 +15,13 @@
 #include "../headers/SCETime.hpp"
 #include "../headers/SCELighting.hpp"
 #include "../headers/SCEScene.hpp"
+#include "../headers/SCERenderStats.hpp"
+#include "../headers/SCEMemory.hpp"
 
 #ifdef SCE_DEBUG_ENGINE
 
+#define RENDER_STATS_CSV_FILE "render_stats.csv"
+
 namespace SCE
 {
 namespace Debug
@@ -69,6 +73,26 @@ namespace Debug
             return 0;
         }
 
+        int debugRenderStatsExport()
+        {
+            if(SCE::RenderStats::IsExportingCSV())
+            {
+                SCE::RenderStats::StopCSVExport();
+                return 0;
+            }
+            else if(SCE::RenderStats::StartCSVExport(RENDER_STATS_CSV_FILE))
+            {
+                return 1;
+            }
+            return 0;
+        }
+
+        int debugMemoryReport()
+        {
+            SCE::Memory::LogReport();
+            return 0;
+        }
+
         typedef int (*debugCallback)();
 
         bool isEnabled = false;
@@ -78,7 +102,9 @@ namespace Debug
             "Toogle tonemapping",
             "Pause/Unpause game",
             "Reload Shaders",
-            "Reload Materials"
+            "Reload Materials",
+            "Export render stats",
+            "Log memory report"
         };
         std::vector<debugCallback> menuCallbacks =
         {
@@ -87,8 +113,10 @@ namespace Debug
             debugPauseGame,
             debugReloadShaders,
             debugReloadMaterialsAndShaders,
+            debugRenderStatsExport,
+            debugMemoryReport,
         };
-        std::vector<int> menuStates = {0, 0, 0, 0, 0};
+        std::vector<int> menuStates = {0, 0, 0, 0, 0, 0, 0};
 
         glm::vec3 stateColors[] =
         {
@@ -27,6 +27,15 @@ namespace FrustrumCulling
         };
 
         FrustrumCullingData cullingData;
+
+        //half the box extent seen along the plane normal
+        inline float projectedRadius(const glm::vec4& plane, const glm::vec4& R,
+                                     const glm::vec4& S, const glm::vec4& T)
+        {
+            return (glm::abs(glm::dot(plane, R)) +
+                    glm::abs(glm::dot(plane, S)) +
+                    glm::abs(glm::dot(plane, T)))*0.5f;
+        }
     }
 
     void UpdateCulling(const mat4 &projectionMatrix)
@@ -110,6 +119,35 @@ namespace FrustrumCulling
         return true;
     }
 
+
+    BoxCulling ClassifyBox(const vec4 &pos_cameraspace,
+                           const vec4 &R_cameraspace,
+                           const vec4 &S_cameraspace,
+                           const vec4 &T_cameraspace)
+    {
+        const glm::vec4* planes[6] =
+        {
+            &cullingData.leftPlane, &cullingData.rightPlane,
+            &cullingData.topPlane, &cullingData.bottomPlane,
+            &cullingData.nearPlane, &cullingData.farPlane
+        };
+
+        BoxCulling result = BOX_INSIDE;
+        for(int i = 0; i < 6; ++i)
+        {
+            float radius = projectedRadius(*planes[i], R_cameraspace, S_cameraspace, T_cameraspace);
+            float distance = glm::dot(*planes[i], pos_cameraspace);
+            if(distance < -radius)
+            {
+                return BOX_OUTSIDE;
+            }
+            if(distance < radius)
+            {
+                result = BOX_INTERSECTING;
+            }
+        }
+        return result;
+    }
 }
 
 }
@@ -0,0 +1,555 @@
+/******PROJECT:Sand Castle Engine******/
+/**************************************/
+/*********AUTHOR:Gwenn AUBERT**********/
+/*******FILE:SCEHeightPyramid.cpp******/
+/**************************************/
+
+#include "../headers/SCEHeightPyramid.hpp"
+#include "../headers/SCETools.hpp"
+#include "../headers/SCEParallel.hpp"
+
+#include <algorithm>
+
+//first level rows are handed to the workers in blocks of roughly this many nodes
+#define PYRAMID_BLOCK_NODES (16*1024)
+//rays handed to each worker at once, smaller batches stay on the calling thread
+#define SEGMENT_BLOCK_SIZE 256
+#define SEGMENT_PARALLEL_MIN_COUNT 4096
+//a node has at most 3 children left on the stack once the nearest one is popped,
+//enough for 16 levels (65536 texels heightfields)
+#define TRAVERSAL_STACK_SIZE (3*16 + 1)
+
+namespace SCE
+{
+
+namespace HeightPyramid
+{
+
+    namespace
+    {
+        //in cell space : cell (x, z) spans [x, x + 1] x [z, z + 1], texel centers are at the corners
+        struct Ray
+        {
+            glm::vec3 origin;
+            glm::vec3 direction;
+            glm::vec3 invDirection;
+        };
+
+        struct Node
+        {
+            int     level;
+            ui32    x;
+            ui32    z;
+            float   tEnter;
+            float   tExit;
+        };
+
+        inline ui16 rawHeight(const Heightmap::Heightfield& field, ui32 x, ui32 z)
+        {
+            ui32 mask = field.size - 1;
+            return field.texels[Heightmap::MortonIndex(x & mask, z & mask)].height;
+        }
+
+        //narrows [tEnter, tExit] to the part of the ray inside [min, max] on one axis
+        inline bool clipToSlab(float origin, float direction, float invDirection,
+                               float min, float max, float& tEnter, float& tExit)
+        {
+            if(direction == 0.0f)
+            {
+                return origin >= min && origin <= max;
+            }
+            float t0 = (min - origin)*invDirection;
+            float t1 = (max - origin)*invDirection;
+            if(t0 > t1)
+            {
+                std::swap(t0, t1);
+            }
+            tEnter = glm::max(tEnter, t0);
+            tExit = glm::min(tExit, t1);
+            return true;
+        }
+
+        inline bool clipToNode(const Ray& ray, int level, ui32 x, ui32 z, float& tEnter, float& tExit)
+        {
+            float nodeSize = float(1u << level);
+            float minX = float(x)*nodeSize;
+            float minZ = float(z)*nodeSize;
+            return clipToSlab(ray.origin.x, ray.direction.x, ray.invDirection.x,
+                              minX, minX + nodeSize, tEnter, tExit) &&
+                    clipToSlab(ray.origin.z, ray.direction.z, ray.invDirection.z,
+                               minZ, minZ + nodeSize, tEnter, tExit) &&
+                    tEnter <= tExit;
+        }
+
+        //exact intersection with the bilinear patch of one cell, in [tEnter, tExit]
+        bool intersectCell(const Heightmap::Heightfield& field, const Ray& ray, ui32 x, ui32 z,
+                           float tEnter, float tExit, float& tHit)
+        {
+            double toHeight = field.heightScale / 65535.0;
+            double h00 = rawHeight(field, x, z)*toHeight;
+            double h10 = rawHeight(field, x + 1, z)*toHeight;
+            double h01 = rawHeight(field, x, z + 1)*toHeight;
+            double h11 = rawHeight(field, x + 1, z + 1)*toHeight;
+            double a = h10 - h00;
+            double b = h01 - h00;
+            double c = h00 - h10 - h01 + h11;
+
+            //ray relative to the cell corner, t counted from tEnter
+            double s = double(ray.origin.x) + double(ray.direction.x)*tEnter - double(x);
+            double r = double(ray.origin.z) + double(ray.direction.z)*tEnter - double(z);
+            double y = double(ray.origin.y) + double(ray.direction.y)*tEnter;
+            double ds = ray.direction.x;
+            double dr = ray.direction.z;
+
+            //surface height under the ray is quadratic : A + B*t + C*t^2
+            double A = h00 + a*s + b*r + c*s*r;
+            double B = a*ds + b*dr + c*(s*dr + r*ds);
+            double C = c*ds*dr;
+
+            //f(t) = ray height - surface height, the hit is the first t where f <= 0
+            double qa = -C;
+            double qb = double(ray.direction.y) - B;
+            double qc = y - A;
+            if(qc <= 0.0)
+            {
+                tHit = tEnter;
+                return true;
+            }
+
+            double t = -1.0;
+            if(qa == 0.0)
+            {
+                if(qb < 0.0)
+                {
+                    t = -qc/qb;
+                }
+            }
+            else
+            {
+                double discriminant = qb*qb - 4.0*qa*qc;
+                if(discriminant >= 0.0)
+                {
+                    //no cancellation when qa is tiny
+                    double q = -0.5*(qb + (qb >= 0.0 ? glm::sqrt(discriminant) : -glm::sqrt(discriminant)));
+                    double t0 = q/qa;
+                    double t1 = q != 0.0 ? qc/q : t0;
+                    if(t0 > t1)
+                    {
+                        std::swap(t0, t1);
+                    }
+                    t = t0 >= 0.0 ? t0 : t1;
+                }
+            }
+
+            if(t >= 0.0 && t <= double(tExit - tEnter))
+            {
+                tHit = float(double(tEnter) + t);
+                return true;
+            }
+            return false;
+        }
+
+        //inclusive range of cells, all in [0, size[
+        struct CellRect
+        {
+            ui32 minX;
+            ui32 minZ;
+            ui32 maxX;
+            ui32 maxZ;
+        };
+
+        inline void mergeRange(HeightRange& range, ui16 min, ui16 max)
+        {
+            range.min = glm::min(range.min, min);
+            range.max = glm::max(range.max, max);
+        }
+
+        //nodes entirely in the rect use their stored range, the others are split until single cells
+        void accumulateRange(const Heightmap::Heightfield& field, const Pyramid& pyramid, const CellRect& rect,
+                             int level, ui32 x, ui32 z, HeightRange& range)
+        {
+            ui32 nodeMinX = x << level;
+            ui32 nodeMinZ = z << level;
+            ui32 nodeMaxX = nodeMinX + (1u << level) - 1;
+            ui32 nodeMaxZ = nodeMinZ + (1u << level) - 1;
+            if(nodeMinX > rect.maxX || nodeMaxX < rect.minX || nodeMinZ > rect.maxZ || nodeMaxZ < rect.minZ)
+            {
+                return;
+            }
+
+            if(level == 0)
+            {
+                for(ui32 i = 0; i < 4; ++i)
+                {
+                    ui16 height = rawHeight(field, x + (i >> 1), z + (i & 1));
+                    mergeRange(range, height, height);
+                }
+                return;
+            }
+
+            if(nodeMinX >= rect.minX && nodeMaxX <= rect.maxX && nodeMinZ >= rect.minZ && nodeMaxZ <= rect.maxZ)
+            {
+                const HeightRange& nodeRange = pyramid.levels[level - 1][x*(pyramid.size >> level) + z];
+                mergeRange(range, nodeRange.min, nodeRange.max);
+                return;
+            }
+
+            for(ui32 i = 0; i < 4; ++i)
+            {
+                accumulateRange(field, pyramid, rect, level - 1, x*2 + (i >> 1), z*2 + (i & 1), range);
+            }
+        }
+
+        //cells under [min, max] on one axis, split in two where they wrap around the heightfield.
+        //Returns the number of spans
+        int wrapCells(float min, float max, ui32 size, ui32 spanMin[2], ui32 spanMax[2])
+        {
+            //cell c joins the texel centers c + 0.5 and c + 1.5
+            i64 first = i64(glm::floor(min - 0.5f));
+            i64 last = i64(glm::floor(max - 0.5f));
+            if(last - first + 1 >= i64(size))
+            {
+                spanMin[0] = 0;
+                spanMax[0] = size - 1;
+                return 1;
+            }
+
+            ui32 begin = ui32(((first % i64(size)) + i64(size)) % i64(size));
+            ui32 end = begin + ui32(last - first);
+            if(end < size)
+            {
+                spanMin[0] = begin;
+                spanMax[0] = end;
+                return 1;
+            }
+            spanMin[0] = begin;
+            spanMax[0] = size - 1;
+            spanMin[1] = 0;
+            spanMax[1] = end - size;
+            return 2;
+        }
+
+        //range of the 3x3 texels under the 2x2 cells of level 1 node (x, z)
+        HeightRange firstLevelRange(const Heightmap::Heightfield& field, ui32 x, ui32 z)
+        {
+            HeightRange range = { 0xFFFF, 0 };
+            for(ui32 i = 0; i < 3; ++i)
+            {
+                for(ui32 j = 0; j < 3; ++j)
+                {
+                    ui16 height = rawHeight(field, x*2 + i, z*2 + j);
+                    range.min = glm::min(range.min, height);
+                    range.max = glm::max(range.max, height);
+                }
+            }
+            return range;
+        }
+
+        HeightRange parentRange(const std::vector<HeightRange>& children, ui32 childSize, ui32 x, ui32 z)
+        {
+            HeightRange range = { 0xFFFF, 0 };
+            for(ui32 i = 0; i < 4; ++i)
+            {
+                const HeightRange& child = children[(x*2 + (i >> 1))*childSize + z*2 + (i & 1)];
+                range.min = glm::min(range.min, child.min);
+                range.max = glm::max(range.max, child.max);
+            }
+            return range;
+        }
+
+        inline i64 floorDiv2(i64 val)
+        {
+            return val >= 0 ? val/2 : -((1 - val)/2);
+        }
+
+        //first hit in the period the root node covers, the ray clipped to it
+        bool castInPeriod(const Heightmap::Heightfield& field, const Pyramid& pyramid, const Ray& ray,
+                          const Node& root, float& tHit)
+        {
+            float toRaw = 65535.0f / field.heightScale;
+            Node stack[TRAVERSAL_STACK_SIZE];
+            int stackSize = 0;
+            stack[stackSize++] = root;
+
+            //nodes are popped in the order the ray goes through them
+            while(stackSize > 0)
+            {
+                Node node = stack[--stackSize];
+                if(node.level == 0)
+                {
+                    if(intersectCell(field, ray, node.x, node.z, node.tEnter, node.tExit, tHit))
+                    {
+                        return true;
+                    }
+                    continue;
+                }
+
+                const HeightRange& range = pyramid.levels[node.level - 1]
+                        [node.x*(pyramid.size >> node.level) + node.z];
+                float yEnter = (ray.origin.y + ray.direction.y*node.tEnter)*toRaw;
+                float yExit = (ray.origin.y + ray.direction.y*node.tExit)*toRaw;
+                //one raw step of margin for the rounding of the ray heights
+                if(glm::min(yEnter, yExit) > float(range.max) + 1.0f)
+                {
+                    //passes above everything in the node
+                    continue;
+                }
+                if(glm::max(yEnter, yExit) < float(range.min) - 1.0f)
+                {
+                    //every node before this one was missed, so the ray only
+                    //gets here under the surface when it started under it
+                    tHit = node.tEnter;
+                    return true;
+                }
+
+                Node children[4];
+                int childCount = 0;
+                for(int i = 0; i < 4; ++i)
+                {
+                    Node child = { node.level - 1, node.x*2 + ui32(i >> 1), node.z*2 + ui32(i & 1),
+                                   node.tEnter, node.tExit };
+                    if(clipToNode(ray, child.level, child.x, child.z, child.tEnter, child.tExit))
+                    {
+                        children[childCount++] = child;
+                    }
+                }
+                //farthest first, so that the nearest child is popped next
+                for(int i = 0; i < childCount; ++i)
+                {
+                    int farthest = i;
+                    for(int j = i + 1; j < childCount; ++j)
+                    {
+                        if(children[j].tEnter > children[farthest].tEnter)
+                        {
+                            farthest = j;
+                        }
+                    }
+                    std::swap(children[i], children[farthest]);
+                    stack[stackSize++] = children[i];
+                }
+            }
+            return false;
+        }
+
+        //the pyramid covers one period of the heightfield : the ray is wrapped into it,
+        //then moved back by a period each time it leaves the root node
+        bool castRay(const Heightmap::Heightfield& field, const Pyramid& pyramid, const Ray& unwrappedRay,
+                     float maxDistance, float& tHit)
+        {
+            float size = float(pyramid.size);
+            float toRaw = 65535.0f / field.heightScale;
+            const HeightRange& fieldRange = pyramid.levels.back()[0];
+            Ray ray = unwrappedRay;
+            ray.origin.x -= glm::floor(ray.origin.x/size)*size;
+            ray.origin.z -= glm::floor(ray.origin.z/size)*size;
+
+            float tStart = 0.0f;
+            while(true)
+            {
+                Node root = { int(pyramid.levels.size()), 0, 0, tStart, maxDistance };
+                if(!clipToNode(ray, root.level, root.x, root.z, root.tEnter, root.tExit))
+                {
+                    return false;
+                }
+                if(castInPeriod(field, pyramid, ray, root, tHit))
+                {
+                    return true;
+                }
+
+                //done, or above every texel and going up
+                float yExit = (ray.origin.y + ray.direction.y*root.tExit)*toRaw;
+                if(root.tExit >= maxDistance || (ray.direction.y >= 0.0f && yExit > float(fieldRange.max) + 1.0f))
+                {
+                    return false;
+                }
+
+                //same slab distances as clipToNode, so the axes the ray leaves through match tExit exactly
+                bool isMoved = false;
+                if(ray.direction.x != 0.0f &&
+                   ((ray.direction.x > 0.0f ? size : 0.0f) - ray.origin.x)*ray.invDirection.x <= root.tExit)
+                {
+                    ray.origin.x -= ray.direction.x > 0.0f ? size : -size;
+                    isMoved = true;
+                }
+                if(ray.direction.z != 0.0f &&
+                   ((ray.direction.z > 0.0f ? size : 0.0f) - ray.origin.z)*ray.invDirection.z <= root.tExit)
+                {
+                    ray.origin.z -= ray.direction.z > 0.0f ? size : -size;
+                    isMoved = true;
+                }
+                if(!isMoved)
+                {
+                    return false;
+                }
+                tStart = root.tExit;
+            }
+        }
+    }
+
+    void Build(const Heightmap::Heightfield& field, Pyramid& pyramid)
+    {
+        ui32 size = field.size;
+        Debug::Assert(size >= 2 && (size & (size - 1)) == 0, "Height pyramids need a power of two size");
+
+        int levelCount = 0;
+        while((1u << levelCount) < size)
+        {
+            ++levelCount;
+        }
+        pyramid.size = size;
+        pyramid.levels.assign(levelCount, std::vector<HeightRange>());
+
+        //level 1 from the texels : 2x2 cells span 3x3 texels
+        ui32 levelSize = size/2;
+        std::vector<HeightRange>& firstLevel = pyramid.levels[0];
+        firstLevel.resize(levelSize*levelSize);
+        HeightRange* ranges = firstLevel.data();
+        int blockRows = glm::max(1, PYRAMID_BLOCK_NODES / int(levelSize));
+        Parallel::For(0, int(levelSize), blockRows, [&field, ranges, levelSize](int xBegin, int xEnd)
+        {
+            for(ui32 x = ui32(xBegin); x < ui32(xEnd); ++x)
+            {
+                for(ui32 z = 0; z < levelSize; ++z)
+                {
+                    ranges[x*levelSize + z] = firstLevelRange(field, x, z);
+                }
+            }
+        });
+
+        for(int level = 1; level < levelCount; ++level)
+        {
+            const std::vector<HeightRange>& children = pyramid.levels[level - 1];
+            ui32 childSize = levelSize;
+            levelSize /= 2;
+            std::vector<HeightRange>& parents = pyramid.levels[level];
+            parents.resize(levelSize*levelSize);
+            for(ui32 x = 0; x < levelSize; ++x)
+            {
+                for(ui32 z = 0; z < levelSize; ++z)
+                {
+                    parents[x*levelSize + z] = parentRange(children, childSize, x, z);
+                }
+            }
+        }
+    }
+
+    void UpdateRegion(const Heightmap::Heightfield& field, Pyramid& pyramid,
+                      i32 minX, i32 minZ, i32 maxX, i32 maxZ)
+    {
+        Debug::Assert(pyramid.size == field.size, "Height pyramid built for another heightfield");
+
+        //level 1 node x spans the texels 2x to 2x + 2, the nodes above halve the range each time
+        i64 firstX = floorDiv2(i64(minX) - 2);
+        i64 firstZ = floorDiv2(i64(minZ) - 2);
+        i64 lastX = floorDiv2(maxX);
+        i64 lastZ = floorDiv2(maxZ);
+        ui32 levelSize = pyramid.size/2;
+        for(ui32 level = 0; level < pyramid.levels.size(); ++level)
+        {
+            //wrapped around the heightfield, each node once
+            i64 countX = glm::min(lastX - firstX + 1, i64(levelSize));
+            i64 countZ = glm::min(lastZ - firstZ + 1, i64(levelSize));
+            ui32 mask = levelSize - 1;
+            std::vector<HeightRange>& ranges = pyramid.levels[level];
+            for(i64 i = 0; i < countX; ++i)
+            {
+                ui32 x = ui32(firstX + i) & mask;
+                for(i64 j = 0; j < countZ; ++j)
+                {
+                    ui32 z = ui32(firstZ + j) & mask;
+                    ranges[x*levelSize + z] = level == 0 ? firstLevelRange(field, x, z) :
+                                                           parentRange(pyramid.levels[level - 1], levelSize*2, x, z);
+                }
+            }
+            firstX = floorDiv2(firstX);
+            firstZ = floorDiv2(firstZ);
+            lastX = floorDiv2(lastX);
+            lastZ = floorDiv2(lastZ);
+            levelSize /= 2;
+        }
+    }
+
+    ui64 GetByteSize(const Pyramid& pyramid)
+    {
+        ui64 bytes = 0;
+        for(const std::vector<HeightRange>& level : pyramid.levels)
+        {
+            bytes += level.size()*sizeof(HeightRange);
+        }
+        return bytes;
+    }
+
+    HeightRange GetRange(const Heightmap::Heightfield& field, const Pyramid& pyramid,
+                         float minX, float minZ, float maxX, float maxZ)
+    {
+        Debug::Assert(pyramid.size == field.size, "Height pyramid built for another heightfield");
+
+        HeightRange range = { 0xFFFF, 0 };
+        ui32 minXs[2], maxXs[2], minZs[2], maxZs[2];
+        int xSpans = wrapCells(minX, maxX, field.size, minXs, maxXs);
+        int zSpans = wrapCells(minZ, maxZ, field.size, minZs, maxZs);
+        int topLevel = int(pyramid.levels.size());
+        for(int i = 0; i < xSpans; ++i)
+        {
+            for(int j = 0; j < zSpans; ++j)
+            {
+                CellRect rect = { minXs[i], minZs[j], maxXs[i], maxZs[j] };
+                accumulateRange(field, pyramid, rect, topLevel, 0, 0, range);
+            }
+        }
+        return range;
+    }
+
+    bool RayCast(const Heightmap::Heightfield& field, const Pyramid& pyramid,
+                 const glm::vec3& origin, const glm::vec3& direction, float maxDistance,
+                 RayHit& hit)
+    {
+        Debug::Assert(pyramid.size == field.size, "Height pyramid built for another heightfield");
+
+        hit = RayHit();
+        if(maxDistance <= 0.0f || pyramid.levels.empty())
+        {
+            return false;
+        }
+
+        Ray ray;
+        ray.origin = origin - glm::vec3(0.5f, 0.0f, 0.5f);
+        ray.direction = direction;
+        ray.invDirection = 1.0f / direction;
+
+        float tHit;
+        if(castRay(field, pyramid, ray, maxDistance, tHit))
+        {
+            hit.hasHit = true;
+            hit.distance = tHit;
+            hit.position = origin + direction*tHit;
+            hit.normal = Heightmap::SampleNormal(field, hit.position.x, hit.position.z,
+                                                 Heightmap::FILTER_BILINEAR);
+        }
+        return hit.hasHit;
+    }
+
+    void IntersectSegments(const Heightmap::Heightfield& field, const Pyramid& pyramid,
+                           const glm::vec3* starts, const glm::vec3* ends,
+                           RayHit* hits, int count)
+    {
+        Parallel::RangeBody castSegments = [&field, &pyramid, starts, ends, hits](int begin, int end)
+        {
+            for(int i = begin; i < end; ++i)
+            {
+                RayCast(field, pyramid, starts[i], ends[i] - starts[i], 1.0f, hits[i]);
+            }
+        };
+
+        if(count < SEGMENT_PARALLEL_MIN_COUNT)
+        {
+            castSegments(0, count);
+        }
+        else
+        {
+            Parallel::For(0, count, SEGMENT_BLOCK_SIZE, castSegments);
+        }
+    }
+}
+
+}
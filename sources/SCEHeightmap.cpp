@@ -0,0 +1,547 @@
+/******PROJECT:Sand Castle Engine******/
+/**************************************/
+/*********AUTHOR:Gwenn AUBERT**********/
+/*********FILE:SCEHeightmap.cpp********/
+/**************************************/
+
+#include "../headers/SCEHeightmap.hpp"
+#include "../headers/SCETools.hpp"
+#include "../headers/SCEMemory.hpp"
+#include "../headers/SCEParallel.hpp"
+#include <vector>
+#include <algorithm>
+
+#define USE_STB_PERLIN 0
+#if USE_STB_PERLIN
+#define STB_PERLIN_IMPLEMENTATION
+#include <stb_perlin.h>
+#endif
+#include "../headers/SCEPerlin.hpp"
+
+#include "../headers/SCESimd.hpp"
+#define USE_SSE_HEIGHTFIELD SCE_USE_SSE2
+
+//#define ISLAND_MODE
+
+#define HEIGHTMAP_LAYER_COUNT 16
+//bump when the generation code changes, so that cached heightmaps are regenerated
+#define HEIGHTMAP_GENERATOR_VERSION 2
+
+//rows are handed to the workers in blocks of roughly this many texels
+#define HEIGHTMAP_BLOCK_TEXELS (16*1024)
+
+namespace SCE
+{
+
+namespace Heightmap
+{
+
+    namespace
+    {
+        void computeNormalsForQuad(int xCount, int zCount, int size, float terrainSize,
+                                   glm::vec3 *normals, const float* heightmap)
+        {
+            float x, z;
+            float y1, y2, y3, y4;
+            float stepSize = terrainSize / float(size);
+
+            x = float(xCount)*stepSize;
+            z = float(zCount)*stepSize;
+
+            int x0 = xCount;
+            int x1 = (xCount + 1)%size;
+            int z0 = zCount;
+            int z1 = (zCount + 1)%size;
+
+            y1 = heightmap[x0*size + z0];
+            y2 = heightmap[x1*size + z0];
+            y3 = heightmap[x0*size + z1];
+            y4 = heightmap[x1*size + z1];
+
+            glm::vec3 p1(x           , y1, z);
+            glm::vec3 p2(x + stepSize, y2, z);
+            glm::vec3 p3(x           , y3, z + stepSize);
+            glm::vec3 p4(x + stepSize, y4, z + stepSize);
+
+            glm::vec3 normal1 = cross(p3 - p1, p2 - p1);
+            glm::vec3 normal2 = cross(p2 - p4, p3 - p4);
+
+            //first is lower left corner
+            normals[(xCount*size + zCount)*2] = normal1;
+            //second is upper right corner
+            normals[(xCount*size + zCount)*2 + 1] = normal2;
+
+            /* following this pattern (le badass ascii art)
+            *     |\--|1
+            *     | \ |
+            *    0|__\|
+            */
+        }
+
+        void smoothNormalRows(const float* heightmap, const glm::vec3* normals, int size,
+                              glm::vec4* normalAndHeight, int xBegin, int xEnd)
+        {
+            int lookX, lookZ;
+            for(int xCount = xBegin; xCount < xEnd; ++xCount)
+            {
+                for(int zCount = 0; zCount < size; ++zCount)
+                {
+                    glm::vec3 normalSum(0.0f);
+
+                    //lower left tri
+                    if(xCount > 0 && zCount >0)
+                    {
+                        lookX = xCount - 1;
+                        lookZ = zCount - 1;
+                        normalSum += normals[(lookX*size + lookZ)*2 + 1];
+                    }
+                    //upper right tri
+                    normalSum += normals[(xCount*size + zCount)*2];
+                    //lower right tri
+                    if(zCount >0)
+                    {
+                        lookX = xCount;
+                        lookZ = zCount - 1;
+                        normalSum += normals[(lookX*size + lookZ)*2];
+                        normalSum += normals[(lookX*size + lookZ)*2 + 1];
+                    }
+                    //upper left tri
+                    if(xCount > 0)
+                    {
+                        lookX = xCount - 1;
+                        lookZ = zCount;
+                        normalSum += normals[(lookX*size + lookZ)*2];
+                        normalSum += normals[(lookX*size + lookZ)*2 + 1];
+                    }
+
+                    float y = heightmap[xCount*size + zCount];
+                    normalAndHeight[xCount*size + zCount] = glm::vec4(normalize(normalSum), y);
+                }
+            }
+        }
+
+        //FNV-1a
+        void hashBytes(ui64& hash, const void* data, size_t byteCount)
+        {
+            const unsigned char* bytes = (const unsigned char*)data;
+            for(size_t i = 0; i < byteCount; ++i)
+            {
+                hash ^= bytes[i];
+                hash *= 1099511628211ull;
+            }
+        }
+
+        float signNotZero(float val)
+        {
+            return val >= 0.0f ? 1.0f : -1.0f;
+        }
+
+        ui16 toUnorm16(float val)
+        {
+            return ui16(glm::clamp(val, 0.0f, 1.0f)*65535.0f + 0.5f);
+        }
+
+        signed char toSnorm8(float val)
+        {
+            return (signed char)(glm::round(glm::clamp(val, -1.0f, 1.0f)*127.0f));
+        }
+
+        int blockRows(int size)
+        {
+            return glm::max(1, HEIGHTMAP_BLOCK_TEXELS / size);
+        }
+
+        inline const CompactTexel& fetchTexel(const Heightfield& field, int x, int z)
+        {
+            //size is a power of two, masking wraps negative coordinates too
+            ui32 mask = field.size - 1;
+            return field.texels[MortonIndex(ui32(x) & mask, ui32(z) & mask)];
+        }
+
+        inline float texelHeight(const CompactTexel& texel)
+        {
+            return float(texel.height);
+        }
+
+        inline glm::vec2 texelNormal(const CompactTexel& texel)
+        {
+            return glm::vec2(float(texel.normalX), float(texel.normalY));
+        }
+
+        void catmullRomWeights(float t, float* weights)
+        {
+            float t2 = t*t;
+            float t3 = t2*t;
+            weights[0] = 0.5f*(-t3 + 2.0f*t2 - t);
+            weights[1] = 0.5f*(3.0f*t3 - 5.0f*t2 + 2.0f);
+            weights[2] = 0.5f*(-3.0f*t3 + 4.0f*t2 + t);
+            weights[3] = 0.5f*(t3 - t2);
+        }
+
+        //filters the raw values returned by texelValue for each texel
+        template<typename T, T (*texelValue)(const CompactTexel&)>
+        T filterTexels(const Heightfield& field, float x, float z, Filter filter)
+        {
+            if(filter == FILTER_NEAREST)
+            {
+                return texelValue(fetchTexel(field, int(glm::floor(x)), int(glm::floor(z))));
+            }
+
+            //values sit at the texel centers
+            float fx = x - 0.5f;
+            float fz = z - 0.5f;
+            float x0 = glm::floor(fx);
+            float z0 = glm::floor(fz);
+            float tx = fx - x0;
+            float tz = fz - z0;
+            int ix = int(x0);
+            int iz = int(z0);
+
+            if(filter == FILTER_BILINEAR)
+            {
+                T v0 = glm::mix(texelValue(fetchTexel(field, ix, iz)), texelValue(fetchTexel(field, ix + 1, iz)), tx);
+                T v1 = glm::mix(texelValue(fetchTexel(field, ix, iz + 1)),
+                                texelValue(fetchTexel(field, ix + 1, iz + 1)), tx);
+                return glm::mix(v0, v1, tz);
+            }
+
+            float xWeights[4];
+            float zWeights[4];
+            catmullRomWeights(tx, xWeights);
+            catmullRomWeights(tz, zWeights);
+            T sum(0.0f);
+            for(int i = 0; i < 4; ++i)
+            {
+                T column(0.0f);
+                for(int j = 0; j < 4; ++j)
+                {
+                    column += zWeights[j]*texelValue(fetchTexel(field, ix - 1 + i, iz - 1 + j));
+                }
+                sum += xWeights[i]*column;
+            }
+            return sum;
+        }
+
+#if USE_SSE_HEIGHTFIELD
+        inline __m128 gatherHeights4(const Heightfield& field, __m128i x, __m128i z)
+        {
+            int indices[4];
+            _mm_storeu_si128((__m128i*)indices,
+                             _mm_or_si128(_mm_slli_epi32(Simd::SpreadBits4(x), 1), Simd::SpreadBits4(z)));
+            //random lookups, the only part that stays scalar
+            return _mm_setr_ps(float(field.texels[indices[0]].height), float(field.texels[indices[1]].height),
+                               float(field.texels[indices[2]].height), float(field.texels[indices[3]].height));
+        }
+
+        //same operations as filterTexels, on the heights only
+        inline __m128 bilinearHeights4(const Heightfield& field, __m128 x, __m128 z)
+        {
+            __m128 fx = _mm_sub_ps(x, _mm_set1_ps(0.5f));
+            __m128 fz = _mm_sub_ps(z, _mm_set1_ps(0.5f));
+            __m128 x0 = Simd::Floor4(fx);
+            __m128 z0 = Simd::Floor4(fz);
+            __m128 tx = _mm_sub_ps(fx, x0);
+            __m128 tz = _mm_sub_ps(fz, z0);
+
+            __m128i mask = _mm_set1_epi32(int(field.size - 1));
+            __m128i one = _mm_set1_epi32(1);
+            __m128i ix0 = _mm_cvttps_epi32(x0);
+            __m128i iz0 = _mm_cvttps_epi32(z0);
+            __m128i ix1 = _mm_and_si128(_mm_add_epi32(ix0, one), mask);
+            __m128i iz1 = _mm_and_si128(_mm_add_epi32(iz0, one), mask);
+            ix0 = _mm_and_si128(ix0, mask);
+            iz0 = _mm_and_si128(iz0, mask);
+
+            __m128 h0 = Simd::Mix4(gatherHeights4(field, ix0, iz0), gatherHeights4(field, ix1, iz0), tx);
+            __m128 h1 = Simd::Mix4(gatherHeights4(field, ix0, iz1), gatherHeights4(field, ix1, iz1), tx);
+            return _mm_mul_ps(Simd::Mix4(h0, h1, tz), _mm_set1_ps(field.heightScale / 65535.0f));
+        }
+#endif
+
+        //every texel only depends on its coordinates, rows can be generated in any order.
+        //Each layer of a row is sampled with Perlin batches, then added to the texels of the row
+        void generateHeightRows(float* heightmap, int size, float offset, float startScale,
+                                float heightScale, int xBegin, int xEnd)
+        {
+            int nbLayers = HEIGHTMAP_LAYER_COUNT;
+            float exponentScaleFactor = 1.0f;
+            float persistence = 0.3f;
+            float k = 1.5f;
+
+            float edgeChange = 1.0f;
+#ifdef ISLAND_MODE
+            float xDist, zDist;
+#endif
+
+            std::vector<float> zs(size);
+            for(int zCount = 0; zCount < size; ++zCount)
+            {
+                zs[zCount] = float(zCount) / float(size);
+                zs[zCount] += offset;
+            }
+
+            //per texel sums of the row, and the coordinates and results of the current layer
+            std::vector<float> noise(size), amplitude(size), maxValue(size);
+            std::vector<float> layerXs(size), layerZs(size), layerNoise(size), layerExponent(size);
+
+            for(int xCount = xBegin; xCount < xEnd; ++xCount)
+            {
+                float x = float(xCount) / float(size);
+                x += offset;
+
+                std::fill(noise.begin(), noise.end(), 0.0f);
+                std::fill(amplitude.begin(), amplitude.end(), 1.0f);
+                std::fill(maxValue.begin(), maxValue.end(), 0.0f);
+                float scale = startScale;
+
+                for(int l = 0; l < nbLayers; ++l)
+                {
+                    //stb_perlin returns values between -0.6 & 0.6
+#if USE_STB_PERLIN
+                    for(int zCount = 0; zCount < size; ++zCount)
+                    {
+                        float tmpNoise = stb_perlin_noise3(x*scale, 0.0f, zs[zCount]*scale);
+                        layerNoise[zCount] = SCE::Math::MapToRange(-0.7f, 0.7f, 0.0f, 1.0f, tmpNoise);
+                        layerExponent[zCount] = 1.0f;
+                    }
+#else
+                    std::fill(layerXs.begin(), layerXs.end(), x*scale);
+                    for(int zCount = 0; zCount < size; ++zCount)
+                    {
+                        layerZs[zCount] = zs[zCount]*scale;
+                    }
+                    Perlin::GetPerlinBatch(layerXs.data(), layerZs.data(), scale, layerNoise.data(), size);
+
+                    float expScale = scale * exponentScaleFactor;
+                    std::fill(layerXs.begin(), layerXs.end(), (x + 0.5f)*expScale);
+                    for(int zCount = 0; zCount < size; ++zCount)
+                    {
+                        layerZs[zCount] = (zs[zCount] + 0.5f)*expScale;
+                    }
+                    Perlin::GetPerlinBatch(layerXs.data(), layerZs.data(), float(int(expScale)),
+                                           layerExponent.data(), size);
+                    for(int zCount = 0; zCount < size; ++zCount)
+                    {
+                        layerNoise[zCount] = SCE::Math::MapToRange(-0.5f, 0.5f, 0.0f, 1.0f, layerNoise[zCount]);
+                        layerExponent[zCount] = SCE::Math::MapToRange(-0.5f, 0.5f, 0.0f, 1.0f, layerExponent[zCount]);
+                    }
+#endif
+                    float layerWeight = 1.0f - pow(1.0f - (float)l/(float)nbLayers, 8.0f);
+                    for(int zCount = 0; zCount < size; ++zCount)
+                    {
+                        float exponent = SCE::Math::MapToRange(0.5f, 1.0f, 0.0f, 1.0f, layerExponent[zCount]);
+                        exponent = glm::exp(k*exponent - k);
+                        exponent = glm::mix(exponent, 1.0f, layerWeight);
+                        float tmpNoise = layerNoise[zCount]*exponent;
+                        noise[zCount] += tmpNoise*amplitude[zCount];
+                        maxValue[zCount] += amplitude[zCount];
+                        amplitude[zCount] *= persistence*(0.75f + tmpNoise);
+                    }
+                    scale *= 2.0f;
+                }
+
+                for(int zCount = 0; zCount < size; ++zCount)
+                {
+#ifdef ISLAND_MODE
+                    xDist = (0.5f - x);
+                    zDist = (0.5f - zs[zCount]);
+                    float distToCenter = sqrt(xDist*xDist + zDist*zDist);//min(xDist, zDist);
+                    edgeChange = SCE::Math::MapToRange(0.15f, 0.495f, 1.0f, 0.0f, distToCenter);
+                    //ease in-out
+                    edgeChange = 1.0f / (1.0f + exp(-(edgeChange - 0.5f)*8.0f));
+#endif
+                    float res = noise[zCount] / maxValue[zCount];
+#ifdef ISLAND_MODE
+                    res = SCE::Math::MapToRange(0.4f, 1.0f, 0.0f, 1.0f, res);
+#else
+                    res = SCE::Math::MapToRange(0.0f, 1.0f, 0.0f, 1.0f, res);
+#endif
+                    heightmap[xCount*size + zCount] = res*heightScale*edgeChange;
+                }
+            }
+        }
+    }
+
+    Params GetTerrainParams(float terrainSize, float patchSize, ui32 textureSize)
+    {
+        Params params;
+        params.size = textureSize;
+        params.terrainSize = floor(terrainSize/patchSize)*patchSize;
+        params.offset = 0.0f;
+        float scale = 1.0f*(params.terrainSize/9000.0f);
+        params.startScale = glm::pow(2.0f, glm::ceil(glm::log2(scale)));
+        params.heightScale = 10000.0f;//max height in meter
+        params.seed = PERLIN_DEFAULT_SEED;
+        return params;
+    }
+
+    ui64 HashParams(const Params& params)
+    {
+        ui64 hash = 14695981039346656037ull;
+        ui32 generator[4] = { HEIGHTMAP_GENERATOR_VERSION, HEIGHTMAP_LAYER_COUNT, USE_STB_PERLIN,
+#ifdef ISLAND_MODE
+                              1
+#else
+                              0
+#endif
+                            };
+        hashBytes(hash, generator, sizeof(generator));
+        hashBytes(hash, &params.size, sizeof(params.size));
+        hashBytes(hash, &params.offset, sizeof(params.offset));
+        hashBytes(hash, &params.startScale, sizeof(params.startScale));
+        hashBytes(hash, &params.heightScale, sizeof(params.heightScale));
+        hashBytes(hash, &params.terrainSize, sizeof(params.terrainSize));
+        hashBytes(hash, &params.seed, sizeof(params.seed));
+        return hash;
+    }
+
+    void GenerateHeights(float* heightmap, int size, float offset, float startScale, float heightScale)
+    {
+        Parallel::For(0, size, blockRows(size), [=](int xBegin, int xEnd)
+        {
+            generateHeightRows(heightmap, size, offset, startScale, heightScale, xBegin, xEnd);
+        });
+    }
+
+    void ComputeNormalsAndHeight(const float* heightmap, int size, float terrainSize,
+                                 glm::vec4* normalAndHeight)
+    {
+        ui64 normalsBytes = ui64(size)*ui64(size)*2*sizeof(glm::vec3);
+        glm::vec3 *normals = new glm::vec3[size*size*2];
+        SCE::Memory::TrackAllocation(SCE::Memory::TAG_TERRAIN, normalsBytes);
+
+        //compute per face normal
+        Parallel::For(0, size, blockRows(size), [=](int xBegin, int xEnd)
+        {
+            for(int xCount = xBegin; xCount < xEnd; ++xCount)
+            {
+                for(int zCount = 0; zCount < size; ++zCount)
+                {
+                    computeNormalsForQuad(xCount, zCount, size, terrainSize, normals, heightmap);
+                }
+            }
+        });
+
+        //compute smooth normals per vertex, once every face normal is known
+        Parallel::For(0, size, blockRows(size), [=](int xBegin, int xEnd)
+        {
+            smoothNormalRows(heightmap, normals, size, normalAndHeight, xBegin, xEnd);
+        });
+
+        delete[] normals;
+        SCE::Memory::TrackDeallocation(SCE::Memory::TAG_TERRAIN, normalsBytes);
+    }
+
+    glm::vec2 EncodeOctahedral(const glm::vec3& normal)
+    {
+        glm::vec3 n = normal / (glm::abs(normal.x) + glm::abs(normal.y) + glm::abs(normal.z));
+        glm::vec2 encoded(n.x, n.z);
+        if(n.y < 0.0f)
+        {
+            encoded = glm::vec2((1.0f - glm::abs(n.z))*signNotZero(n.x),
+                                (1.0f - glm::abs(n.x))*signNotZero(n.z));
+        }
+        return encoded;
+    }
+
+    glm::vec3 DecodeOctahedral(const glm::vec2& encoded)
+    {
+        glm::vec3 n(encoded.x, 1.0f - glm::abs(encoded.x) - glm::abs(encoded.y), encoded.y);
+        if(n.y < 0.0f)
+        {
+            float x = n.x;
+            n.x = (1.0f - glm::abs(n.z))*signNotZero(x);
+            n.z = (1.0f - glm::abs(x))*signNotZero(n.z);
+        }
+        return glm::normalize(n);
+    }
+
+    float SampleHeight(const Heightfield& field, float x, float z, Filter filter)
+    {
+        return filterTexels<float, texelHeight>(field, x, z, filter) * (field.heightScale / 65535.0f);
+    }
+
+    glm::vec3 SampleNormal(const Heightfield& field, float x, float z, Filter filter)
+    {
+        glm::vec2 encoded = filterTexels<glm::vec2, texelNormal>(field, x, z, filter);
+        return DecodeOctahedral(glm::clamp(encoded / 127.0f, -1.0f, 1.0f));
+    }
+
+    void SampleHeights(const Heightfield& field, const float* x, const float* z,
+                       float* heights, int count, Filter filter)
+    {
+        int i = 0;
+#if USE_SSE_HEIGHTFIELD
+        if(filter == FILTER_BILINEAR)
+        {
+            for(; i + 4 <= count; i += 4)
+            {
+                _mm_storeu_ps(heights + i, bilinearHeights4(field, _mm_loadu_ps(x + i), _mm_loadu_ps(z + i)));
+            }
+        }
+#endif
+        for(; i < count; ++i)
+        {
+            heights[i] = SampleHeight(field, x[i], z[i], filter);
+        }
+    }
+
+    void SampleNormals(const Heightfield& field, const float* x, const float* z,
+                       glm::vec3* normals, int count, Filter filter)
+    {
+        for(int i = 0; i < count; ++i)
+        {
+            normals[i] = SampleNormal(field, x[i], z[i], filter);
+        }
+    }
+
+    GPUTexel PackGPUTexel(const glm::vec3& normal, float height, float heightScale)
+    {
+        glm::vec2 encoded = EncodeOctahedral(normal)*0.5f + 0.5f;
+        GPUTexel texel;
+        texel.normalX = toUnorm16(encoded.x);
+        texel.normalY = toUnorm16(encoded.y);
+        texel.unused = 0;
+        texel.height = toUnorm16(height / heightScale);
+        return texel;
+    }
+
+    void PackGPUTexels(const glm::vec4* normalAndHeight, int size, float heightScale, GPUTexel* texels)
+    {
+        Parallel::For(0, size, blockRows(size), [=](int xBegin, int xEnd)
+        {
+            for(int i = xBegin*size; i < xEnd*size; ++i)
+            {
+                texels[i] = PackGPUTexel(glm::vec3(normalAndHeight[i]), normalAndHeight[i].w, heightScale);
+            }
+        });
+    }
+
+    CompactTexel PackCompactTexel(const GPUTexel& texel)
+    {
+        CompactTexel packed;
+        packed.height = texel.height;
+        packed.normalX = toSnorm8(float(texel.normalX)/65535.0f*2.0f - 1.0f);
+        packed.normalY = toSnorm8(float(texel.normalY)/65535.0f*2.0f - 1.0f);
+        return packed;
+    }
+
+    void PackCompactTexels(const GPUTexel* texels, int size, CompactTexel* compact)
+    {
+        Debug::Assert(size > 0 && size <= 0xFFFF && (size & (size - 1)) == 0,
+                      "Compact heightfields need a power of two size");
+
+        Parallel::For(0, size, blockRows(size), [=](int xBegin, int xEnd)
+        {
+            for(int x = xBegin; x < xEnd; ++x)
+            {
+                for(int z = 0; z < size; ++z)
+                {
+                    compact[MortonIndex(x, z)] = PackCompactTexel(texels[x*size + z]);
+                }
+            }
+        });
+    }
+}
+
+}
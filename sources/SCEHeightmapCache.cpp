@@ -0,0 +1,171 @@
+/******PROJECT:Sand Castle Engine******/
+/**************************************/
+/*********AUTHOR:Gwenn AUBERT**********/
+/******FILE:SCEHeightmapCache.cpp******/
+/**************************************/
+
+#include "../headers/SCEHeightmapCache.hpp"
+#include "../headers/SCEInternal.hpp"
+#include "../headers/SCETools.hpp"
+#include "../headers/SCEMemory.hpp"
+#include "../headers/SCELogger.hpp"
+
+#include <fstream>
+#include <cstring>
+
+#ifdef _WIN32
+#define USE_MMAP 0
+#else
+#define USE_MMAP 1
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#define CACHE_FILE_PREFIX ENGINE_RESSOURCE_PATH "Terrain/heightmap_"
+#define CACHE_FILE_EXTENSION ".cache"
+#define CACHE_MAGIC "SCEH"
+
+namespace SCE
+{
+
+namespace HeightmapCache
+{
+    namespace
+    {
+        //64 bytes so that the texels that follow stay aligned
+        struct CacheHeader
+        {
+            char    magic[4];
+            ui32    version;
+            ui64    paramsHash;
+            ui32    size;
+            ui32    texelBytes;
+            ui64    dataBytes;
+            char    padding[32];
+        };
+        static_assert(sizeof(CacheHeader) == 64, "Heightmap cache header must be 64 bytes");
+
+        bool isHeaderValid(const CacheHeader& header, ui64 paramsHash, ui32 size, ui64 fileBytes)
+        {
+            ui64 texelCount = ui64(size)*ui64(size);
+            return memcmp(header.magic, CACHE_MAGIC, 4) == 0 &&
+                    header.version == HEIGHTMAP_CACHE_VERSION &&
+                    header.paramsHash == paramsHash &&
+                    header.size == size &&
+                    header.texelBytes == sizeof(Heightmap::GPUTexel) &&
+                    header.dataBytes == texelCount*sizeof(Heightmap::GPUTexel) &&
+                    fileBytes >= sizeof(CacheHeader) + header.dataBytes;
+        }
+    }
+
+    std::string GetCacheFilename(ui32 size)
+    {
+        return CACHE_FILE_PREFIX + std::to_string(size) + CACHE_FILE_EXTENSION;
+    }
+
+    bool Load(const std::string& filename, ui64 paramsHash, ui32 size, CachedHeightmap& cached)
+    {
+        Debug::Assert(cached.mapping == nullptr, "Heightmap cache already loaded");
+
+#if USE_MMAP
+        int fd = open(filename.c_str(), O_RDONLY);
+        if(fd < 0)
+        {
+            return false;
+        }
+        struct stat fileStat;
+        if(fstat(fd, &fileStat) != 0 || ui64(fileStat.st_size) < sizeof(CacheHeader))
+        {
+            close(fd);
+            return false;
+        }
+        ui64 fileBytes = ui64(fileStat.st_size);
+        //private and writable : the terrain can modify its copy without touching the file
+        void* mapping = mmap(nullptr, fileBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if(mapping == MAP_FAILED)
+        {
+            return false;
+        }
+#else
+        std::ifstream file(filename.c_str(), std::ios::in | std::ios::binary | std::ios::ate);
+        if(!file.is_open())
+        {
+            return false;
+        }
+        ui64 fileBytes = ui64(file.tellg());
+        if(fileBytes < sizeof(CacheHeader))
+        {
+            return false;
+        }
+        file.seekg(0);
+        //glm::vec4 storage keeps the texels aligned
+        void* mapping = new glm::vec4[(fileBytes + sizeof(glm::vec4) - 1)/sizeof(glm::vec4)];
+        file.read((char*)mapping, fileBytes);
+        if(!file || ui64(file.gcount()) != fileBytes)
+        {
+            delete[] (glm::vec4*)mapping;
+            return false;
+        }
+#endif
+
+        const CacheHeader* header = (const CacheHeader*)mapping;
+        if(!isHeaderValid(*header, paramsHash, size, fileBytes))
+        {
+            SCE_LOG_DEBUG(Logger::CAT_TERRAIN, "Heightmap cache out of date : " + filename);
+            cached.mapping = mapping;
+            cached.mappingSize = fileBytes;
+            Release(cached);
+            return false;
+        }
+
+        cached.mapping = mapping;
+        cached.mappingSize = fileBytes;
+        cached.size = size;
+        cached.texels = (Heightmap::GPUTexel*)((char*)mapping + sizeof(CacheHeader));
+        SCE::Memory::TrackAllocation(SCE::Memory::TAG_TERRAIN, fileBytes);
+        return true;
+    }
+
+    void Release(CachedHeightmap& cached)
+    {
+        if(cached.mapping == nullptr)
+        {
+            return;
+        }
+        if(cached.texels != nullptr)
+        {
+            SCE::Memory::TrackDeallocation(SCE::Memory::TAG_TERRAIN, cached.mappingSize);
+        }
+#if USE_MMAP
+        munmap(cached.mapping, cached.mappingSize);
+#else
+        delete[] (glm::vec4*)cached.mapping;
+#endif
+        cached = CachedHeightmap();
+    }
+
+    bool Save(const std::string& filename, ui64 paramsHash, ui32 size, const Heightmap::GPUTexel* texels)
+    {
+        CacheHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, CACHE_MAGIC, 4);
+        header.version = HEIGHTMAP_CACHE_VERSION;
+        header.paramsHash = paramsHash;
+        header.size = size;
+        header.texelBytes = sizeof(Heightmap::GPUTexel);
+        header.dataBytes = ui64(size)*ui64(size)*sizeof(Heightmap::GPUTexel);
+
+        if(!Tools::WriteFileAtomically(filename, { { &header, sizeof(header) }, { texels, header.dataBytes } }))
+        {
+            SCE_LOG_ERROR(Logger::CAT_TERRAIN, "Could not write heightmap cache : " + filename);
+            return false;
+        }
+        SCE_LOG_DEBUG(Logger::CAT_TERRAIN, "Heightmap cache written : " + filename);
+        return true;
+    }
+}
+
+}
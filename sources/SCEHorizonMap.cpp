@@ -0,0 +1,273 @@
+/******PROJECT:Sand Castle Engine******/
+/**************************************/
+/*********AUTHOR:Gwenn AUBERT**********/
+/********FILE:SCEHorizonMap.cpp********/
+/**************************************/
+
+#include "../headers/SCEHorizonMap.hpp"
+#include "../headers/SCEParallel.hpp"
+#include "../headers/SCEInternal.hpp"
+#include "../headers/SCETools.hpp"
+#include "../headers/SCELogger.hpp"
+
+#include <glm/gtc/constants.hpp>
+#include <fstream>
+#include <cstring>
+
+//samples one texel apart close to the texel, then further apart : the farther the terrain,
+//the less a small feature changes the horizon elevation
+#define HORIZON_STEP_GROWTH (1.0f/16.0f)
+//map rows per parallel block
+#define HORIZON_BLOCK_ROWS 4
+#define HORIZON_FILE_MAGIC "SCEZ"
+
+namespace SCE
+{
+
+namespace HorizonMap
+{
+
+    namespace
+    {
+        struct FileHeader
+        {
+            char    magic[4];
+            ui32    version;
+            ui64    hash;
+            ui32    size;
+            ui32    directionCount;
+            ui64    dataBytes;
+            char    padding[32];
+        };
+        static_assert(sizeof(FileHeader) == 64, "Horizon map header must be 64 bytes");
+
+        void hashBytes(ui64& hash, const void* data, size_t byteCount)
+        {
+            const unsigned char* bytes = (const unsigned char*)data;
+            for(size_t i = 0; i < byteCount; ++i)
+            {
+                hash ^= bytes[i];
+                hash *= 1099511628211ull;
+            }
+        }
+
+        ui64 getTexelBytes(const Settings& settings)
+        {
+            return ui64(settings.size)*ui64(settings.size)*ui64(settings.directionCount);
+        }
+
+        //same for every texel and direction. Half a texel first, for the slope the center sits on
+        void getSampleDistances(const Settings& settings, std::vector<float>& distances)
+        {
+            distances.clear();
+            distances.push_back(0.5f);
+            for(float distance = 1.0f; distance <= settings.maxDistance;
+                distance += glm::max(1.0f, distance*HORIZON_STEP_GROWTH))
+            {
+                distances.push_back(distance);
+            }
+        }
+
+        ui8 encodeSine(float tanElevation)
+        {
+            float sine = tanElevation/glm::sqrt(1.0f + tanElevation*tanElevation);
+            return ui8(glm::clamp(sine, 0.0f, 1.0f)*255.0f + 0.5f);
+        }
+
+        //highest elevation seen from the texel center, for every direction of the map
+        void bakeTexel(const Heightmap::Heightfield& field, Map& map, const std::vector<float>& distances,
+                       ui32 x, ui32 z, std::vector<float>& sampleX, std::vector<float>& sampleZ,
+                       std::vector<float>& heights)
+        {
+            const Settings& settings = map.settings;
+            float fieldPerMap = float(field.size)/float(settings.size);
+            glm::vec2 center = (glm::vec2(float(x), float(z)) + 0.5f)*fieldPerMap;
+            float centerHeight = Heightmap::SampleHeight(field, center.x, center.y, Heightmap::FILTER_BILINEAR);
+            int sampleCount = int(distances.size());
+
+            for(ui32 direction = 0; direction < settings.directionCount; ++direction)
+            {
+                glm::vec2 step = GetDirection(map, direction);
+                for(int i = 0; i < sampleCount; ++i)
+                {
+                    sampleX[i] = center.x + step.x*distances[i];
+                    sampleZ[i] = center.y + step.y*distances[i];
+                }
+                Heightmap::SampleHeights(field, sampleX.data(), sampleZ.data(), heights.data(), sampleCount,
+                                         Heightmap::FILTER_BILINEAR);
+
+                float maxTan = 0.0f;
+                for(int i = 0; i < sampleCount; ++i)
+                {
+                    maxTan = glm::max(maxTan, (heights[i] - centerHeight)/(distances[i]*settings.texelSpacing));
+                }
+                ui32 layer = direction / HORIZON_DIRECTIONS_PER_LAYER;
+                ui64 index = (ui64(layer*settings.size + x)*settings.size + z)*HORIZON_DIRECTIONS_PER_LAYER +
+                        direction % HORIZON_DIRECTIONS_PER_LAYER;
+                map.texels[index] = encodeSine(maxTan);
+            }
+        }
+
+        //[minX, maxX] x [minZ, maxZ] wraps around the map, at most one map wide
+        void bakeRect(const Heightmap::Heightfield& field, Map& map, const TerrainBrush::TexelRect& rect)
+        {
+            std::vector<float> distances;
+            getSampleDistances(map.settings, distances);
+            ui32 mask = map.settings.size - 1;
+            i32 countZ = rect.maxZ - rect.minZ + 1;
+            Parallel::For(rect.minX, rect.maxX + 1, HORIZON_BLOCK_ROWS, [&](int xBegin, int xEnd)
+            {
+                std::vector<float> sampleX(distances.size());
+                std::vector<float> sampleZ(distances.size());
+                std::vector<float> heights(distances.size());
+                for(int x = xBegin; x < xEnd; ++x)
+                {
+                    for(i32 i = 0; i < countZ; ++i)
+                    {
+                        bakeTexel(field, map, distances, ui32(x) & mask, ui32(rect.minZ + i) & mask,
+                                  sampleX, sampleZ, heights);
+                    }
+                }
+            });
+        }
+    }
+
+    void Bake(const Heightmap::Heightfield& field, const Settings& settings, Map& map)
+    {
+        Debug::Assert(settings.size > 0 && (settings.size & (settings.size - 1)) == 0 &&
+                      settings.size <= field.size, "Horizon map size must be a power of two");
+        Debug::Assert(settings.directionCount > 0 && settings.directionCount % HORIZON_DIRECTIONS_PER_LAYER == 0,
+                      "Horizon directions must fill whole layers");
+
+        map.settings = settings;
+        map.texels.assign(getTexelBytes(settings), 0);
+        TerrainBrush::TexelRect rect = { 0, 0, i32(settings.size) - 1, i32(settings.size) - 1 };
+        bakeRect(field, map, rect);
+    }
+
+    TerrainBrush::TexelRect UpdateRegion(const Heightmap::Heightfield& field, Map& map,
+                                         const TerrainBrush::TexelRect& heightsRect)
+    {
+        //map texels whose samples can read the rect : within maxDistance, plus the bilinear footprint
+        const Settings& settings = map.settings;
+        float fieldPerMap = float(field.size)/float(settings.size);
+        float reach = settings.maxDistance + 1.0f;
+        TerrainBrush::TexelRect rect = {
+            i32(glm::floor((float(heightsRect.minX) - reach)/fieldPerMap - 0.5f)),
+            i32(glm::floor((float(heightsRect.minZ) - reach)/fieldPerMap - 0.5f)),
+            i32(glm::ceil((float(heightsRect.maxX + 1) + reach)/fieldPerMap - 0.5f)),
+            i32(glm::ceil((float(heightsRect.maxZ + 1) + reach)/fieldPerMap - 0.5f)) };
+        rect.maxX = glm::min(rect.maxX, rect.minX + i32(settings.size) - 1);
+        rect.maxZ = glm::min(rect.maxZ, rect.minZ + i32(settings.size) - 1);
+        bakeRect(field, map, rect);
+        return rect;
+    }
+
+    float GetHorizonSine(const Map& map, ui32 x, ui32 z, ui32 direction)
+    {
+        const Settings& settings = map.settings;
+        ui32 layer = direction / HORIZON_DIRECTIONS_PER_LAYER;
+        ui64 index = (ui64(layer*settings.size + x)*settings.size + z)*HORIZON_DIRECTIONS_PER_LAYER +
+                direction % HORIZON_DIRECTIONS_PER_LAYER;
+        return float(map.texels[index])/255.0f;
+    }
+
+    float SampleHorizonSine(const Map& map, ui32 fieldSize, float x, float z, const glm::vec2& direction_xz)
+    {
+        const Settings& settings = map.settings;
+        float mapPerField = float(settings.size)/float(fieldSize);
+        ui32 mask = settings.size - 1;
+        ui32 mapX = ui32(i32(glm::floor(x*mapPerField))) & mask;
+        ui32 mapZ = ui32(i32(glm::floor(z*mapPerField))) & mask;
+
+        float azimuth = glm::atan(direction_xz.y, direction_xz.x)/(2.0f*glm::pi<float>());
+        float direction = glm::fract(azimuth)*float(settings.directionCount);
+        ui32 first = ui32(direction) % settings.directionCount;
+        ui32 second = (first + 1) % settings.directionCount;
+        return glm::mix(GetHorizonSine(map, mapX, mapZ, first), GetHorizonSine(map, mapX, mapZ, second),
+                        glm::fract(direction));
+    }
+
+    glm::vec2 GetDirection(const Map& map, ui32 direction)
+    {
+        float azimuth = 2.0f*glm::pi<float>()*float(direction)/float(map.settings.directionCount);
+        return glm::vec2(glm::cos(azimuth), glm::sin(azimuth));
+    }
+
+    ui32 GetLayerCount(const Map& map)
+    {
+        return map.settings.directionCount / HORIZON_DIRECTIONS_PER_LAYER;
+    }
+
+    ui64 Hash(const Heightmap::Heightfield& field, const Settings& settings)
+    {
+        ui64 hash = 14695981039346656037ull;
+        ui32 version = HORIZON_MAP_VERSION;
+        hashBytes(hash, &version, sizeof(version));
+        hashBytes(hash, &settings.size, sizeof(settings.size));
+        hashBytes(hash, &settings.directionCount, sizeof(settings.directionCount));
+        hashBytes(hash, &settings.maxDistance, sizeof(settings.maxDistance));
+        hashBytes(hash, &settings.texelSpacing, sizeof(settings.texelSpacing));
+        hashBytes(hash, &field.size, sizeof(field.size));
+        hashBytes(hash, &field.heightScale, sizeof(field.heightScale));
+        ui64 texelCount = ui64(field.size)*ui64(field.size);
+        for(ui64 i = 0; i < texelCount; ++i)
+        {
+            hashBytes(hash, &field.texels[i].height, sizeof(ui16));
+        }
+        return hash;
+    }
+
+    bool Load(const std::string& filename, const Settings& settings, ui64 hash, Map& map)
+    {
+        std::ifstream file(filename.c_str(), std::ios::in | std::ios::binary);
+        if(!file.is_open())
+        {
+            return false;
+        }
+
+        FileHeader header;
+        file.read((char*)&header, sizeof(header));
+        if(!file || memcmp(header.magic, HORIZON_FILE_MAGIC, 4) != 0 || header.version != HORIZON_MAP_VERSION ||
+           header.hash != hash || header.size != settings.size || header.directionCount != settings.directionCount ||
+           header.dataBytes != getTexelBytes(settings))
+        {
+            SCE_LOG_DEBUG(Logger::CAT_TERRAIN, "Horizon map out of date : " + filename);
+            return false;
+        }
+
+        map.texels.resize(header.dataBytes);
+        file.read((char*)map.texels.data(), header.dataBytes);
+        if(!file)
+        {
+            SCE_LOG_DEBUG(Logger::CAT_TERRAIN, "Horizon map truncated : " + filename);
+            map.texels.clear();
+            return false;
+        }
+        map.settings = settings;
+        return true;
+    }
+
+    bool Save(const std::string& filename, ui64 hash, const Map& map)
+    {
+        FileHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, HORIZON_FILE_MAGIC, 4);
+        header.version = HORIZON_MAP_VERSION;
+        header.hash = hash;
+        header.size = map.settings.size;
+        header.directionCount = map.settings.directionCount;
+        header.dataBytes = map.texels.size();
+
+        if(!Tools::WriteFileAtomically(filename, { { &header, sizeof(header) },
+                                                   { map.texels.data(), header.dataBytes } }))
+        {
+            SCE_LOG_ERROR(Logger::CAT_TERRAIN, "Could not write horizon map : " + filename);
+            return false;
+        }
+        SCE_LOG_DEBUG(Logger::CAT_TERRAIN, "Horizon map written : " + filename);
+        return true;
+    }
+}
+
+}
@@ -0,0 +1,263 @@
+/******PROJECT:Sand Castle Engine******/
+/**************************************/
+/*********AUTHOR:Gwenn AUBERT**********/
+/******FILE:SCEImpostorCache.cpp*******/
+/**************************************/
+
+#include "../headers/SCEImpostorCache.hpp"
+#include "../headers/SCEInternal.hpp"
+#include "../headers/SCETools.hpp"
+#include "../headers/SCELogger.hpp"
+
+#include <fstream>
+#include <cstring>
+#include <algorithm>
+
+#define IMPOSTOR_FILE_MAGIC "SCEI"
+#define IMPOSTOR_FILE_EXTENSION ".cache"
+//files are hashed by blocks
+#define IMPOSTOR_HASH_BLOCK_BYTES (64*1024)
+
+namespace SCE
+{
+
+namespace ImpostorCache
+{
+
+    namespace
+    {
+        struct FileHeader
+        {
+            char    magic[4];
+            ui32    version;
+            ui64    hash;
+            //encoded sizes of the two atlases, stored one after the other
+            ui64    diffuseBytes;
+            ui64    normalBytes;
+            ui32    size;
+            ui32    nbAngles;
+            float   billboardSize[3];
+            char    padding[12];
+        };
+        static_assert(sizeof(FileHeader) == 64, "Impostor cache header must be 64 bytes");
+
+        //a run of empty texels, then texelCount texels stored as they are
+        struct Span
+        {
+            ui32    emptyCount;
+            ui32    texelCount;
+        };
+
+        void hashBytes(ui64& hash, const void* data, size_t byteCount)
+        {
+            const unsigned char* bytes = (const unsigned char*)data;
+            for(size_t i = 0; i < byteCount; ++i)
+            {
+                hash ^= bytes[i];
+                hash *= 1099511628211ull;
+            }
+        }
+
+        //the file length first, so that a missing file never hashes like an empty one
+        void hashFile(ui64& hash, const std::string& name)
+        {
+            std::ifstream file((RESSOURCE_PATH + name).c_str(), std::ios::in | std::ios::binary);
+            if(!file.is_open())
+            {
+                file.open((ENGINE_RESSOURCE_PATH + name).c_str(), std::ios::in | std::ios::binary);
+            }
+            hashBytes(hash, name.data(), name.size());
+            if(!file.is_open())
+            {
+                SCE_LOG_DEBUG(Logger::CAT_TREES, "Impostor source not found : " + name);
+                ui64 missing = ~0ull;
+                hashBytes(hash, &missing, sizeof(missing));
+                return;
+            }
+
+            file.seekg(0, std::ios::end);
+            ui64 fileBytes = ui64(file.tellg());
+            file.seekg(0, std::ios::beg);
+            hashBytes(hash, &fileBytes, sizeof(fileBytes));
+
+            std::vector<char> block(IMPOSTOR_HASH_BLOCK_BYTES);
+            while(file)
+            {
+                file.read(block.data(), block.size());
+                hashBytes(hash, block.data(), size_t(file.gcount()));
+            }
+        }
+
+        void encodeTexels(const std::vector<ui64>& texels, std::vector<char>& encoded)
+        {
+            encoded.clear();
+            size_t count = texels.size();
+            size_t i = 0;
+            while(i < count)
+            {
+                Span span = { 0, 0 };
+                while(i < count && texels[i] == 0 && span.emptyCount < 0xFFFFFFFFu)
+                {
+                    ++span.emptyCount;
+                    ++i;
+                }
+                size_t first = i;
+                while(i < count && texels[i] != 0 && span.texelCount < 0xFFFFFFFFu)
+                {
+                    ++span.texelCount;
+                    ++i;
+                }
+                size_t offset = encoded.size();
+                encoded.resize(offset + sizeof(Span) + span.texelCount*sizeof(ui64));
+                memcpy(&encoded[offset], &span, sizeof(Span));
+                if(span.texelCount > 0)
+                {
+                    memcpy(&encoded[offset + sizeof(Span)], &texels[first], span.texelCount*sizeof(ui64));
+                }
+            }
+        }
+
+        //false if the spans don't cover exactly the texels
+        bool decodeTexels(const std::vector<char>& encoded, std::vector<ui64>& texels)
+        {
+            size_t count = texels.size();
+            size_t offset = 0;
+            size_t i = 0;
+            while(offset < encoded.size())
+            {
+                Span span;
+                if(encoded.size() - offset < sizeof(Span))
+                {
+                    return false;
+                }
+                memcpy(&span, &encoded[offset], sizeof(Span));
+                offset += sizeof(Span);
+                if(ui64(span.emptyCount) + span.texelCount > count - i ||
+                   ui64(span.texelCount)*sizeof(ui64) > encoded.size() - offset)
+                {
+                    return false;
+                }
+                std::fill(texels.begin() + i, texels.begin() + i + span.emptyCount, 0);
+                i += span.emptyCount;
+                if(span.texelCount > 0)
+                {
+                    memcpy(&texels[i], &encoded[offset], span.texelCount*sizeof(ui64));
+                }
+                i += span.texelCount;
+                offset += span.texelCount*sizeof(ui64);
+            }
+            return i == count;
+        }
+    }
+
+    ui32 GetAtlasSize(const Settings& settings)
+    {
+        ui32 root = ui32(glm::sqrt(float(settings.nbAngles)));
+        return root*settings.texSize;
+    }
+
+    std::string GetCacheFilename(const std::string& name, const Settings& settings)
+    {
+        return ENGINE_RESSOURCE_PATH + name + "_" + std::to_string(settings.nbAngles) + "_" +
+                std::to_string(settings.texSize) + IMPOSTOR_FILE_EXTENSION;
+    }
+
+    ui64 Hash(const Settings& settings, const std::vector<std::string>& sourceFiles,
+              const std::vector<float>& values)
+    {
+        ui64 hash = 14695981039346656037ull;
+        ui32 version = IMPOSTOR_CACHE_VERSION;
+        hashBytes(hash, &version, sizeof(version));
+        hashBytes(hash, &settings.nbAngles, sizeof(settings.nbAngles));
+        hashBytes(hash, &settings.texSize, sizeof(settings.texSize));
+        hashBytes(hash, &settings.border, sizeof(settings.border));
+        for(const std::string& name : sourceFiles)
+        {
+            hashFile(hash, name);
+        }
+        if(!values.empty())
+        {
+            hashBytes(hash, values.data(), values.size()*sizeof(float));
+        }
+        return hash;
+    }
+
+    bool Load(const std::string& filename, const Settings& settings, ui64 hash, Atlas& atlas)
+    {
+        std::ifstream file(filename.c_str(), std::ios::in | std::ios::binary);
+        if(!file.is_open())
+        {
+            return false;
+        }
+
+        ui32 size = GetAtlasSize(settings);
+        ui64 texelCount = ui64(size)*ui64(size);
+        FileHeader header;
+        file.read((char*)&header, sizeof(header));
+        if(!file || memcmp(header.magic, IMPOSTOR_FILE_MAGIC, 4) != 0 || header.version != IMPOSTOR_CACHE_VERSION ||
+           header.hash != hash || header.size != size || header.nbAngles != settings.nbAngles ||
+           header.diffuseBytes > texelCount*(sizeof(ui64) + sizeof(Span)) ||
+           header.normalBytes > texelCount*(sizeof(ui64) + sizeof(Span)))
+        {
+            SCE_LOG_DEBUG(Logger::CAT_TREES, "Impostor cache out of date : " + filename);
+            return false;
+        }
+
+        std::vector<char> encoded;
+        std::vector<ui64>* atlases[2] = { &atlas.diffuse, &atlas.normal };
+        ui64 encodedBytes[2] = { header.diffuseBytes, header.normalBytes };
+        for(int i = 0; i < 2; ++i)
+        {
+            encoded.resize(encodedBytes[i]);
+            atlases[i]->resize(texelCount);
+            file.read(encoded.data(), encoded.size());
+            if(!file || !decodeTexels(encoded, *atlases[i]))
+            {
+                SCE_LOG_DEBUG(Logger::CAT_TREES, "Impostor cache truncated : " + filename);
+                atlas.diffuse.clear();
+                atlas.normal.clear();
+                return false;
+            }
+        }
+        atlas.size = size;
+        atlas.billboardSize = glm::vec3(header.billboardSize[0], header.billboardSize[1], header.billboardSize[2]);
+        return true;
+    }
+
+    bool Save(const std::string& filename, const Settings& settings, ui64 hash, const Atlas& atlas)
+    {
+        Debug::Assert(atlas.size == GetAtlasSize(settings) &&
+                      atlas.diffuse.size() == ui64(atlas.size)*ui64(atlas.size) &&
+                      atlas.normal.size() == atlas.diffuse.size(), "Impostor atlas doesn't match its settings");
+
+        std::vector<char> diffuse;
+        std::vector<char> normal;
+        encodeTexels(atlas.diffuse, diffuse);
+        encodeTexels(atlas.normal, normal);
+
+        FileHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, IMPOSTOR_FILE_MAGIC, 4);
+        header.version = IMPOSTOR_CACHE_VERSION;
+        header.hash = hash;
+        header.diffuseBytes = diffuse.size();
+        header.normalBytes = normal.size();
+        header.size = atlas.size;
+        header.nbAngles = settings.nbAngles;
+        header.billboardSize[0] = atlas.billboardSize.x;
+        header.billboardSize[1] = atlas.billboardSize.y;
+        header.billboardSize[2] = atlas.billboardSize.z;
+
+        if(!Tools::WriteFileAtomically(filename, { { &header, sizeof(header) }, { diffuse.data(), diffuse.size() },
+                                                   { normal.data(), normal.size() } }))
+        {
+            SCE_LOG_ERROR(Logger::CAT_TREES, "Could not write impostor cache : " + filename);
+            return false;
+        }
+        SCE_LOG_DEBUG(Logger::CAT_TREES, "Impostor cache written : " + filename + ", " +
+                      std::to_string((sizeof(header) + diffuse.size() + normal.size())/1024) + " KB");
+        return true;
+    }
+}
+
+}
@@ -18,14 +18,14 @@ namespace Input
         ui16 keyStates[KEY_COUNT] = { 0 }; //zero initialize whole array
     }
 
-    void UpdateKeyStates(GLFWwindow *window)
+    void UpdateKeyStates(KeyStateSource source)
     {
-        if(window)
+        if(source)
         {
             for(int i = 0; i < KEY_COUNT; ++i)
             {
                 keyPrevStates[i] = keyStates[i];
-                keyStates[i] = glfwGetKey(window, i);
+                keyStates[i] = source(i);
             }
         }
     }
@@ -5,7 +5,7 @@
 /**************************************/
 
 #include "../headers/SCEInternal.hpp"
-#include <iostream>
+#include "../headers/SCELogger.hpp"
 
 using namespace std;
 
@@ -16,7 +16,7 @@ namespace Internal {
     void Log(const string &message)
     {
 #ifdef SCE_DEBUG_ENGINE
-        cout << "(Internal) : " << message << endl;
+        SCE_LOG_DEBUG(Logger::CAT_ENGINE, message);
 #endif
     }
 
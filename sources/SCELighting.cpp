@@ -14,7 +14,10 @@
 #include "../headers/Camera.hpp"
 #include "../headers/SCESkyRenderer.hpp"
 #include "../headers/SCETerrain.hpp"
+#include "../headers/SCETerrainShadow.hpp"
 #include "../headers/SCEQuality.hpp"
+#include "../headers/SCERenderStats.hpp"
+#include "../headers/SCELogger.hpp"
 
 #ifdef SCE_DEBUG_ENGINE
 #include "../headers/SCEInput.hpp"
@@ -36,7 +39,8 @@ using namespace std;
 //when updating the cascade count, remember to update the lighting shader too
 #define CASCADE_COUNT 2
 
-#define CSM_TERRAIN_SHADOW 1
+//the horizon map shadows the terrain without rendering it in the cascades
+#define CSM_TERRAIN_SHADOW !TERRAIN_HORIZON_SHADOW
 #define TERRAIN_TREES_SHADOW 1
 #define RAYMACHED_TERRAIN_SHADOW 0
 
@@ -143,11 +147,11 @@ void SCELighting::RenderLightsToGBuffer(const CameraRenderData& renderData,
     //render lights needing a stencil pass (Point and Spot lights)
     for(SCEHandle<Light> light : s_instance->mStenciledLights)
     {
-        glUseProgram(s_instance->mEmptyShader);        
+        SCE::ShaderUtils::UseShader(s_instance->mEmptyShader);        
         gBuffer.BindForStencilPass();
         s_instance->renderLightStencilPass(renderData, light);
 
-        glUseProgram(s_instance->mLightShader);
+        SCE::ShaderUtils::UseShader(s_instance->mLightShader);
         gBuffer.BindForLightPass();
         gBuffer.SetupTexturesForLighting();
 
@@ -158,6 +162,7 @@ void SCELighting::RenderLightsToGBuffer(const CameraRenderData& renderData,
         glUniform1fv(s_instance->mShadowFarSplitUnifom, CASCADE_COUNT,
                      &(s_instance->mFarSplit_cameraspace[0]));
         glUniform1f(s_instance->mShadowCrossFadeUniform, c_shadowCrossFadeDist);
+        SCE::RenderStats::CountUniformCalls(3);
 
         s_instance->renderLightingPass(renderData, light);
     }
@@ -168,7 +173,7 @@ void SCELighting::RenderLightsToGBuffer(const CameraRenderData& renderData,
     //render directionnal lights
     for(SCEHandle<Light> light : s_instance->mDirectionalLights)
     {
-        glUseProgram(s_instance->mLightShader);
+        SCE::ShaderUtils::UseShader(s_instance->mLightShader);
         gBuffer.BindForLightPass();
         gBuffer.SetupTexturesForLighting();
 
@@ -184,18 +189,20 @@ void SCELighting::RenderLightsToGBuffer(const CameraRenderData& renderData,
                      &(s_instance->mFarSplit_cameraspace[0]));
 
         glUniform1f(s_instance->mShadowCrossFadeUniform, c_shadowCrossFadeDist);
+        SCE::RenderStats::CountUniformCalls(3);
 
         s_instance->renderLightingPass(renderData, light);
     }
 
     glDisable(GL_BLEND);
 
-#if RAYMACHED_TERRAIN_SHADOW
+#if RAYMACHED_TERRAIN_SHADOW || TERRAIN_HORIZON_SHADOW
     if(s_instance->mMainLight)
     {
+        //scene space, like the gbuffer positions
         glm::vec3 sunPosition =
-                s_instance->mMainLight->GetContainer()->GetComponent<Transform>()->GetWorldPosition();
-        SCE::Terrain::RenderShadow(renderData.projectionMatrix, renderData.projectionMatrix,
+                s_instance->mMainLight->GetContainer()->GetComponent<Transform>()->GetScenePosition();
+        SCE::Terrain::RenderShadow(renderData.projectionMatrix, renderData.viewMatrix,
                                    sunPosition, gBuffer);
     }
 #endif
@@ -216,7 +223,7 @@ void SCELighting::RenderSkyToGBuffer(const CameraRenderData& renderData, SCE_GBu
     }
     else
     {
-        Debug::LogError("No sun light set, skipping sky rendering");
+        SCE_LOG_ERROR(Logger::CAT_RENDER, "No sun light set, skipping sky rendering");
         //Render sky and sun
         SCE::SkyRenderer::Render(renderData, gBuffer, glm::vec3(0.0, 1000.0, 0.0),
                                  glm::vec4(1.0));
@@ -433,7 +440,7 @@ void SCELighting::renderShadowmapPass(const CameraRenderData& lightRenderData,
 
     glViewport(0, 0, SHADOW_MAP_WIDTH, SHADOW_MAP_HEIGHT);
 
-    glUseProgram(mEmptyShader);
+    SCE::ShaderUtils::UseShader(mEmptyShader);
     glEnable(GL_DEPTH_TEST);
     glCullFace(GL_FRONT);//render only back faces to avoid some shadow acnee
 
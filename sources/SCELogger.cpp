@@ -0,0 +1,476 @@
+/******PROJECT:Sand Castle Engine******/
+/**************************************/
+/*********AUTHOR:Gwenn AUBERT**********/
+/**********FILE:SCELogger.cpp**********/
+/**************************************/
+
+#include "../headers/SCELogger.hpp"
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <iostream>
+
+//must be a power of two
+#define LOG_RING_SIZE 4096
+//how long the writer sleeps when the ring is empty
+#define LOG_WRITER_WAIT_MS 10
+
+namespace SCE
+{
+
+namespace Logger
+{
+    namespace
+    {
+        typedef std::chrono::steady_clock Clock;
+
+        struct LogRecord
+        {
+            LogLevel        level;
+            LogCategory     category;
+            unsigned int    threadIndex;
+            double          time;
+            std::string     message;
+        };
+
+        //Bounded MPMC queue (Vyukov) : each slot's sequence tells whether it is
+        //free for the producer at that position or ready for the consumer
+        struct RingSlot
+        {
+            std::atomic<size_t>     sequence;
+            LogRecord               record;
+        };
+
+        struct LoggerData
+        {
+            LoggerData() : enqueuePos(0), dequeuePos(0),
+                pushedCount(0), writtenCount(0), droppedCount(0), reportedDropCount(0),
+                minLevel(LOG_TRACE), running(false), activeWriters(0), writerPaused(false),
+                consoleEnabled(true),
+                startTime(Clock::now())
+            {
+                for(size_t i = 0; i < LOG_RING_SIZE; ++i)
+                {
+                    slots[i].sequence.store(i, std::memory_order_relaxed);
+                }
+                for(int i = 0; i < LOG_CATEGORY_COUNT; ++i)
+                {
+                    categoryEnabled[i].store(true, std::memory_order_relaxed);
+                }
+            }
+
+            ~LoggerData()
+            {
+                Shutdown();
+            }
+
+            RingSlot                slots[LOG_RING_SIZE];
+            std::atomic<size_t>     enqueuePos;
+            std::atomic<size_t>     dequeuePos;
+
+            std::atomic<size_t>     pushedCount;
+            std::atomic<size_t>     writtenCount;
+            std::atomic<size_t>     droppedCount;
+            size_t                  reportedDropCount;
+
+            std::atomic<int>        minLevel;
+            std::atomic<bool>       categoryEnabled[LOG_CATEGORY_COUNT];
+
+            std::atomic<bool>       running;
+            //producers between their check of running and the end of their push
+            std::atomic<int>        activeWriters;
+            std::atomic<bool>       writerPaused;
+            std::thread             writerThread;
+            std::mutex              wakeLock;
+            std::condition_variable wakeCondition;
+
+            //held by whoever writes to the sinks : the writer thread, or the caller when synchronous
+            std::mutex              sinkLock;
+            bool                    consoleEnabled;
+            std::ofstream           fileSink;
+
+            Clock::time_point       startTime;
+        };
+
+        LoggerData loggerData;
+
+        const char* levelNames[LOG_LEVEL_COUNT] =
+        {
+            "TRACE",
+            "DEBUG",
+            "INFO",
+            "WARNING",
+            "ERROR"
+        };
+
+        const char* categoryNames[LOG_CATEGORY_COUNT] =
+        {
+            "General",
+            "Engine",
+            "Render",
+            "Terrain",
+            "Trees",
+            "Resources",
+            "Scene"
+        };
+
+        std::atomic<unsigned int> nextThreadIndex(0);
+
+        unsigned int getThreadIndex()
+        {
+            thread_local unsigned int threadIndex = nextThreadIndex++;
+            return threadIndex;
+        }
+
+        bool tryPush(LogRecord& record)
+        {
+            size_t pos = loggerData.enqueuePos.load(std::memory_order_relaxed);
+            RingSlot* slot;
+            for(;;)
+            {
+                slot = &loggerData.slots[pos & (LOG_RING_SIZE - 1)];
+                size_t sequence = slot->sequence.load(std::memory_order_acquire);
+                intptr_t diff = intptr_t(sequence) - intptr_t(pos);
+                if(diff == 0)
+                {
+                    if(loggerData.enqueuePos.compare_exchange_weak(pos, pos + 1,
+                                                                   std::memory_order_relaxed))
+                    {
+                        break;
+                    }
+                }
+                else if(diff < 0)
+                {
+                    //full
+                    return false;
+                }
+                else
+                {
+                    pos = loggerData.enqueuePos.load(std::memory_order_relaxed);
+                }
+            }
+
+            slot->record = std::move(record);
+            slot->sequence.store(pos + 1, std::memory_order_release);
+            return true;
+        }
+
+        bool tryPop(LogRecord& record)
+        {
+            size_t pos = loggerData.dequeuePos.load(std::memory_order_relaxed);
+            RingSlot* slot;
+            for(;;)
+            {
+                slot = &loggerData.slots[pos & (LOG_RING_SIZE - 1)];
+                size_t sequence = slot->sequence.load(std::memory_order_acquire);
+                intptr_t diff = intptr_t(sequence) - intptr_t(pos + 1);
+                if(diff == 0)
+                {
+                    if(loggerData.dequeuePos.compare_exchange_weak(pos, pos + 1,
+                                                                   std::memory_order_relaxed))
+                    {
+                        break;
+                    }
+                }
+                else if(diff < 0)
+                {
+                    //empty
+                    return false;
+                }
+                else
+                {
+                    pos = loggerData.dequeuePos.load(std::memory_order_relaxed);
+                }
+            }
+
+            record = std::move(slot->record);
+            slot->record.message.clear();
+            slot->sequence.store(pos + LOG_RING_SIZE, std::memory_order_release);
+            return true;
+        }
+
+        //sinkLock must be held
+        void writeRecord(const LogRecord& record)
+        {
+            std::ostringstream line;
+            line << std::fixed << std::setprecision(3) << record.time
+                 << " [" << levelNames[record.level] << "]"
+                 << " (" << categoryNames[record.category] << ")"
+                 << " T" << record.threadIndex
+                 << " : " << record.message << "\n";
+            std::string text = line.str();
+
+            if(loggerData.consoleEnabled)
+            {
+                if(record.level >= LOG_WARNING)
+                {
+                    std::cerr << text;
+                }
+                else
+                {
+                    std::cout << text;
+                }
+            }
+            if(loggerData.fileSink.is_open())
+            {
+                loggerData.fileSink << text;
+            }
+        }
+
+        //sinkLock must be held
+        void flushSinks()
+        {
+            size_t dropped = loggerData.droppedCount.load(std::memory_order_relaxed);
+            if(dropped != loggerData.reportedDropCount)
+            {
+                LogRecord record;
+                record.level = LOG_WARNING;
+                record.category = CAT_ENGINE;
+                record.threadIndex = getThreadIndex();
+                record.time = std::chrono::duration<double>(Clock::now() - loggerData.startTime).count();
+                record.message = std::to_string(dropped - loggerData.reportedDropCount) +
+                        " log records dropped, ring buffer was full";
+                loggerData.reportedDropCount = dropped;
+                writeRecord(record);
+            }
+
+            if(loggerData.consoleEnabled)
+            {
+                std::cout.flush();
+                std::cerr.flush();
+            }
+            if(loggerData.fileSink.is_open())
+            {
+                loggerData.fileSink.flush();
+            }
+        }
+
+        //write whatever is left in the ring from the calling thread
+        void drainRing()
+        {
+            std::lock_guard<std::mutex> lock(loggerData.sinkLock);
+            LogRecord record;
+            while(tryPop(record))
+            {
+                writeRecord(record);
+                loggerData.writtenCount.fetch_add(1, std::memory_order_release);
+            }
+            flushSinks();
+        }
+
+        void writerLoop()
+        {
+            LogRecord record;
+            for(;;)
+            {
+                bool wroteRecords = false;
+                if(!loggerData.writerPaused.load(std::memory_order_acquire))
+                {
+                    std::lock_guard<std::mutex> lock(loggerData.sinkLock);
+                    while(tryPop(record))
+                    {
+                        writeRecord(record);
+                        loggerData.writtenCount.fetch_add(1, std::memory_order_release);
+                        wroteRecords = true;
+                    }
+                    //once per batch, not once per record
+                    if(wroteRecords)
+                    {
+                        flushSinks();
+                    }
+                }
+
+                if(!wroteRecords)
+                {
+                    if(!loggerData.running.load(std::memory_order_acquire))
+                    {
+                        break;
+                    }
+                    std::unique_lock<std::mutex> lock(loggerData.wakeLock);
+                    loggerData.wakeCondition.wait_for(lock, std::chrono::milliseconds(LOG_WRITER_WAIT_MS));
+                }
+            }
+        }
+    }
+
+    void Init()
+    {
+        if(loggerData.running.load())
+        {
+            return;
+        }
+        loggerData.running.store(true, std::memory_order_release);
+        loggerData.writerThread = std::thread(writerLoop);
+    }
+
+    void Shutdown()
+    {
+        if(!loggerData.running.exchange(false))
+        {
+            return;
+        }
+        loggerData.wakeCondition.notify_one();
+        loggerData.writerThread.join();
+        //producers that saw running before the exchange may still be pushing, and errors among them
+        //wait for room : keep draining until they are done, then write what they pushed last
+        while(loggerData.activeWriters.load() > 0)
+        {
+            drainRing();
+            std::this_thread::yield();
+        }
+        drainRing();
+    }
+
+    void SetMinLevel(LogLevel level)
+    {
+        loggerData.minLevel.store(level, std::memory_order_relaxed);
+    }
+
+    LogLevel GetMinLevel()
+    {
+        return LogLevel(loggerData.minLevel.load(std::memory_order_relaxed));
+    }
+
+    void SetCategoryEnabled(LogCategory category, bool enabled)
+    {
+        loggerData.categoryEnabled[category].store(enabled, std::memory_order_relaxed);
+    }
+
+    bool IsEnabled(LogLevel level, LogCategory category)
+    {
+        return level >= loggerData.minLevel.load(std::memory_order_relaxed) &&
+                loggerData.categoryEnabled[category].load(std::memory_order_relaxed);
+    }
+
+    void Write(LogLevel level, LogCategory category, std::string message)
+    {
+        LogRecord record;
+        record.level = level;
+        record.category = category;
+        record.threadIndex = getThreadIndex();
+        record.time = std::chrono::duration<double>(Clock::now() - loggerData.startTime).count();
+        record.message = std::move(message);
+
+        //sequentially consistent with the exchange in Shutdown : either Shutdown sees this producer
+        //and waits for it, or this producer sees that the logger stopped and writes synchronously
+        loggerData.activeWriters.fetch_add(1);
+        if(!loggerData.running.load())
+        {
+            loggerData.activeWriters.fetch_sub(1, std::memory_order_release);
+            std::lock_guard<std::mutex> lock(loggerData.sinkLock);
+            //what this thread queued before Shutdown goes first
+            LogRecord queued;
+            while(tryPop(queued))
+            {
+                writeRecord(queued);
+                loggerData.writtenCount.fetch_add(1, std::memory_order_release);
+            }
+            writeRecord(record);
+            flushSinks();
+            return;
+        }
+
+        while(!tryPush(record))
+        {
+            if(level < LOG_ERROR)
+            {
+                loggerData.droppedCount.fetch_add(1, std::memory_order_relaxed);
+                loggerData.activeWriters.fetch_sub(1, std::memory_order_release);
+                return;
+            }
+            //errors are never lost, wait for the writer (or Shutdown) to make room
+            loggerData.wakeCondition.notify_one();
+            std::this_thread::yield();
+        }
+        loggerData.pushedCount.fetch_add(1, std::memory_order_release);
+        loggerData.activeWriters.fetch_sub(1, std::memory_order_release);
+
+        if(level >= LOG_ERROR)
+        {
+            loggerData.wakeCondition.notify_one();
+        }
+    }
+
+    void Flush()
+    {
+        if(!loggerData.running.load(std::memory_order_acquire))
+        {
+            drainRing();
+            return;
+        }
+
+        size_t target = loggerData.pushedCount.load(std::memory_order_acquire);
+        loggerData.wakeCondition.notify_one();
+        while(loggerData.writtenCount.load(std::memory_order_acquire) < target &&
+              loggerData.running.load(std::memory_order_acquire))
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    size_t GetPushedCount()
+    {
+        return loggerData.pushedCount.load(std::memory_order_acquire);
+    }
+
+    size_t GetWrittenCount()
+    {
+        return loggerData.writtenCount.load(std::memory_order_acquire);
+    }
+
+    size_t GetDroppedCount()
+    {
+        return loggerData.droppedCount.load(std::memory_order_relaxed);
+    }
+
+    void SetWriterPaused(bool paused)
+    {
+        loggerData.writerPaused.store(paused, std::memory_order_release);
+        loggerData.wakeCondition.notify_one();
+    }
+
+    void SetConsoleSinkEnabled(bool enabled)
+    {
+        std::lock_guard<std::mutex> lock(loggerData.sinkLock);
+        loggerData.consoleEnabled = enabled;
+    }
+
+    bool OpenFileSink(const std::string& filename)
+    {
+        std::lock_guard<std::mutex> lock(loggerData.sinkLock);
+        if(loggerData.fileSink.is_open())
+        {
+            loggerData.fileSink.close();
+        }
+        loggerData.fileSink.open(filename.c_str(), std::ios::out | std::ios::trunc);
+        return loggerData.fileSink.is_open();
+    }
+
+    void CloseFileSink()
+    {
+        std::lock_guard<std::mutex> lock(loggerData.sinkLock);
+        if(loggerData.fileSink.is_open())
+        {
+            loggerData.fileSink.flush();
+            loggerData.fileSink.close();
+        }
+    }
+
+    const char* GetLevelName(LogLevel level)
+    {
+        return levelNames[level];
+    }
+
+    const char* GetCategoryName(LogCategory category)
+    {
+        return categoryNames[category];
+    }
+}
+
+}
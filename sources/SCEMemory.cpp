@@ -0,0 +1,380 @@
+/******PROJECT:Sand Castle Engine******/
+/**************************************/
+/*********AUTHOR:Gwenn AUBERT**********/
+/**********FILE:SCEMemory.cpp**********/
+/**************************************/
+
+#include "../headers/SCEMemory.hpp"
+#include "../headers/SCETools.hpp"
+#include "../headers/SCELogger.hpp"
+
+#include <atomic>
+#include <mutex>
+#include <map>
+#include <sstream>
+#include <iomanip>
+
+namespace SCE
+{
+
+namespace Memory
+{
+    namespace
+    {
+        struct GLResourceEntry
+        {
+            MemoryTag   tag;
+            ui64        bytes;
+        };
+
+        struct MemoryData
+        {
+            MemoryData()
+            {
+                for(int tag = 0; tag < MEMORY_TAG_COUNT; ++tag)
+                {
+                    for(int kind = 0; kind < MEMORY_KIND_COUNT; ++kind)
+                    {
+                        current[tag][kind] = 0;
+                        peak[tag][kind] = 0;
+                        highWater[tag][kind] = 0;
+                    }
+                }
+            }
+
+            std::atomic<i64>                        current[MEMORY_TAG_COUNT][MEMORY_KIND_COUNT];
+            std::atomic<i64>                        peak[MEMORY_TAG_COUNT][MEMORY_KIND_COUNT];
+            std::atomic<i64>                        highWater[MEMORY_TAG_COUNT][MEMORY_KIND_COUNT];
+            //GL object names are only unique per object type
+            std::map<GLuint, GLResourceEntry>       glResources[MEMORY_KIND_COUNT];
+            std::mutex                              glResourcesLock;
+        };
+
+        MemoryData memoryData;
+
+        const char* tagNames[MEMORY_TAG_COUNT] =
+        {
+            "General",
+            "Perlin",
+            "Terrain",
+            "Trees",
+            "Meshes",
+            "Textures",
+            "RenderTargets",
+            "Text"
+        };
+
+        const char* kindNames[MEMORY_KIND_COUNT] =
+        {
+            "CPU heap",
+            "GPU textures",
+            "GPU buffers",
+            "GPU renderbuffers"
+        };
+
+        void raiseTo(std::atomic<i64>& mark, i64 value)
+        {
+            i64 prev = mark.load(std::memory_order_relaxed);
+            while(value > prev && !mark.compare_exchange_weak(prev, value, std::memory_order_relaxed))
+            {}
+        }
+
+        void addBytes(MemoryTag tag, MemoryKind kind, i64 delta)
+        {
+            Debug::Assert(tag < MEMORY_TAG_COUNT && kind < MEMORY_KIND_COUNT, "Invalid memory tag");
+            i64 value = memoryData.current[tag][kind].fetch_add(delta, std::memory_order_relaxed) + delta;
+            if(delta > 0)
+            {
+                raiseTo(memoryData.peak[tag][kind], value);
+                raiseTo(memoryData.highWater[tag][kind], value);
+            }
+        }
+
+        void trackGLResource(MemoryKind kind, MemoryTag tag, GLuint id, ui64 bytes)
+        {
+            std::lock_guard<std::mutex> lock(memoryData.glResourcesLock);
+            std::map<GLuint, GLResourceEntry>& resources = memoryData.glResources[kind];
+
+            auto it = resources.find(id);
+            if(it != resources.end())
+            {
+                addBytes(it->second.tag, kind, -i64(it->second.bytes));
+            }
+
+            GLResourceEntry& entry = resources[id];
+            entry.tag = tag;
+            entry.bytes = bytes;
+            addBytes(tag, kind, i64(bytes));
+        }
+
+        void untrackGLResource(MemoryKind kind, GLuint id)
+        {
+            std::lock_guard<std::mutex> lock(memoryData.glResourcesLock);
+            std::map<GLuint, GLResourceEntry>& resources = memoryData.glResources[kind];
+
+            auto it = resources.find(id);
+            if(it != resources.end())
+            {
+                addBytes(it->second.tag, kind, -i64(it->second.bytes));
+                resources.erase(it);
+            }
+        }
+
+        ui32 bytesPerTexel(GLenum internalFormat)
+        {
+            switch(internalFormat)
+            {
+            case GL_RGBA32F :
+                return 16;
+            case GL_RGB32F :
+                return 12;
+            case GL_RGBA16F :
+            case GL_RGBA16 :
+            case GL_RG32F :
+                return 8;
+            case GL_RGB16F :
+            case GL_RGB16 :
+                return 6;
+            case GL_R8 :
+            case GL_RED :
+                return 1;
+            case GL_RG8 :
+            case GL_R16 :
+            case GL_R16F :
+            case GL_DEPTH_COMPONENT16 :
+                return 2;
+            //RGB8 is padded to 4 bytes by most drivers
+            default :
+                return 4;
+            }
+        }
+
+        std::string formatBytes(i64 bytes)
+        {
+            std::ostringstream stream;
+            stream << std::fixed << std::setprecision(2);
+            if(bytes < 1024 * 1024 && bytes > -1024 * 1024)
+            {
+                stream << double(bytes) / 1024.0 << " KB";
+            }
+            else
+            {
+                stream << double(bytes) / (1024.0 * 1024.0) << " MB";
+            }
+            return stream.str();
+        }
+    }
+
+    Snapshot::Snapshot()
+        : liveGLResources(0)
+    {
+        for(int tag = 0; tag < MEMORY_TAG_COUNT; ++tag)
+        {
+            for(int kind = 0; kind < MEMORY_KIND_COUNT; ++kind)
+            {
+                bytes[tag][kind] = 0;
+            }
+        }
+    }
+
+    void TrackAllocation(MemoryTag tag, ui64 bytes)
+    {
+        addBytes(tag, CPU_HEAP, i64(bytes));
+    }
+
+    void TrackDeallocation(MemoryTag tag, ui64 bytes)
+    {
+        addBytes(tag, CPU_HEAP, -i64(bytes));
+    }
+
+    void TrackResize(MemoryTag tag, ui64 oldBytes, ui64 newBytes)
+    {
+        if(newBytes != oldBytes)
+        {
+            addBytes(tag, CPU_HEAP, i64(newBytes) - i64(oldBytes));
+        }
+    }
+
+    void TrackGLTexture(MemoryTag tag, GLuint textureId, ui64 bytes)
+    {
+        trackGLResource(GPU_TEXTURE, tag, textureId, bytes);
+    }
+
+    void UntrackGLTexture(GLuint textureId)
+    {
+        untrackGLResource(GPU_TEXTURE, textureId);
+    }
+
+    void TrackGLBuffer(MemoryTag tag, GLuint bufferId, ui64 bytes)
+    {
+        trackGLResource(GPU_BUFFER, tag, bufferId, bytes);
+    }
+
+    void UntrackGLBuffer(GLuint bufferId)
+    {
+        untrackGLResource(GPU_BUFFER, bufferId);
+    }
+
+    void TrackGLRenderbuffer(MemoryTag tag, GLuint renderbufferId, ui64 bytes)
+    {
+        trackGLResource(GPU_RENDERBUFFER, tag, renderbufferId, bytes);
+    }
+
+    void UntrackGLRenderbuffer(GLuint renderbufferId)
+    {
+        untrackGLResource(GPU_RENDERBUFFER, renderbufferId);
+    }
+
+    ui64 ComputeTextureSize(ui32 width, ui32 height, ui32 depth,
+                            GLenum internalFormat, bool hasMipmaps)
+    {
+        ui64 texelSize = bytesPerTexel(internalFormat);
+        ui64 size = ui64(width) * ui64(height) * ui64(depth) * texelSize;
+
+        while(hasMipmaps && (width > 1 || height > 1))
+        {
+            width = glm::max(width / 2u, 1u);
+            height = glm::max(height / 2u, 1u);
+            size += ui64(width) * ui64(height) * ui64(depth) * texelSize;
+        }
+
+        return size;
+    }
+
+    i64 GetCurrentBytes(MemoryTag tag, MemoryKind kind)
+    {
+        return memoryData.current[tag][kind].load(std::memory_order_relaxed);
+    }
+
+    i64 GetPeakBytes(MemoryTag tag, MemoryKind kind)
+    {
+        return memoryData.peak[tag][kind].load(std::memory_order_relaxed);
+    }
+
+    i64 GetHighWaterBytes(MemoryTag tag, MemoryKind kind)
+    {
+        return memoryData.highWater[tag][kind].load(std::memory_order_relaxed);
+    }
+
+    void ResetHighWaterMarks()
+    {
+        for(int tag = 0; tag < MEMORY_TAG_COUNT; ++tag)
+        {
+            for(int kind = 0; kind < MEMORY_KIND_COUNT; ++kind)
+            {
+                memoryData.highWater[tag][kind].store(memoryData.current[tag][kind].load());
+            }
+        }
+    }
+
+    std::string GetReport()
+    {
+        std::ostringstream report;
+        report << "Memory report (current / high water / peak)\n";
+
+        i64 totals[MEMORY_KIND_COUNT] = {0};
+
+        for(int tag = 0; tag < MEMORY_TAG_COUNT; ++tag)
+        {
+            bool tagPrinted = false;
+            for(int kind = 0; kind < MEMORY_KIND_COUNT; ++kind)
+            {
+                MemoryTag memTag = MemoryTag(tag);
+                MemoryKind memKind = MemoryKind(kind);
+                i64 peak = GetPeakBytes(memTag, memKind);
+                if(peak == 0)
+                {
+                    continue;
+                }
+
+                if(!tagPrinted)
+                {
+                    report << tagNames[tag] << "\n";
+                    tagPrinted = true;
+                }
+
+                i64 current = GetCurrentBytes(memTag, memKind);
+                totals[kind] += current;
+                report << "    " << std::left << std::setw(18) << kindNames[kind]
+                       << formatBytes(current) << " / "
+                       << formatBytes(GetHighWaterBytes(memTag, memKind)) << " / "
+                       << formatBytes(peak) << "\n";
+            }
+        }
+
+        report << "Total\n";
+        for(int kind = 0; kind < MEMORY_KIND_COUNT; ++kind)
+        {
+            report << "    " << std::left << std::setw(18) << kindNames[kind]
+                   << formatBytes(totals[kind]) << "\n";
+        }
+
+        return report.str();
+    }
+
+    void LogReport()
+    {
+        SCE_LOG_INFO(Logger::CAT_ENGINE, GetReport());
+    }
+
+    Snapshot TakeSnapshot()
+    {
+        Snapshot snapshot;
+        std::lock_guard<std::mutex> lock(memoryData.glResourcesLock);
+
+        for(int tag = 0; tag < MEMORY_TAG_COUNT; ++tag)
+        {
+            for(int kind = 0; kind < MEMORY_KIND_COUNT; ++kind)
+            {
+                snapshot.bytes[tag][kind] = memoryData.current[tag][kind].load();
+            }
+        }
+
+        for(int kind = 0; kind < MEMORY_KIND_COUNT; ++kind)
+        {
+            snapshot.liveGLResources += memoryData.glResources[kind].size();
+        }
+
+        return snapshot;
+    }
+
+    std::string DiffSnapshots(const Snapshot& before, const Snapshot& after)
+    {
+        std::ostringstream diff;
+
+        for(int tag = 0; tag < MEMORY_TAG_COUNT; ++tag)
+        {
+            for(int kind = 0; kind < MEMORY_KIND_COUNT; ++kind)
+            {
+                i64 delta = after.bytes[tag][kind] - before.bytes[tag][kind];
+                if(delta != 0)
+                {
+                    diff << tagNames[tag] << " - " << kindNames[kind] << " : "
+                         << (delta > 0 ? "+" : "") << delta << " bytes\n";
+                }
+            }
+        }
+
+        if(after.liveGLResources != before.liveGLResources)
+        {
+            diff << "Live GL objects : " << before.liveGLResources
+                 << " -> " << after.liveGLResources << "\n";
+        }
+
+        return diff.str();
+    }
+
+    const char* GetTagName(MemoryTag tag)
+    {
+        Debug::Assert(tag < MEMORY_TAG_COUNT, "Invalid memory tag");
+        return tagNames[tag];
+    }
+
+    const char* GetKindName(MemoryKind kind)
+    {
+        Debug::Assert(kind < MEMORY_KIND_COUNT, "Invalid memory kind");
+        return kindNames[kind];
+    }
+}
+
+}
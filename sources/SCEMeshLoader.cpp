@@ -9,6 +9,8 @@
 #include "../headers/SCETools.hpp"
 #include "../headers/SCEInternal.hpp"
 #include "../headers/SCERenderStructs.hpp"
+#include "../headers/SCEMemory.hpp"
+#include "../headers/SCELogger.hpp"
 
 
 #include <glm/gtc/matrix_transform.hpp>
@@ -263,6 +265,16 @@ namespace MeshLoader
 
     LoaderData loaderData;
 
+    ui64 meshDataBytes(const MeshData& data)
+    {
+        return SCE::Memory::VectorBytes(data.indices) +
+               SCE::Memory::VectorBytes(data.vertices) +
+               SCE::Memory::VectorBytes(data.normals) +
+               SCE::Memory::VectorBytes(data.uvs) +
+               SCE::Memory::VectorBytes(data.tangents) +
+               SCE::Memory::VectorBytes(data.bitangents);
+    }
+
 
     ui16 addMeshData(   const string& meshName,
                         const std::vector<ushort>& indices,
@@ -284,6 +296,8 @@ namespace MeshLoader
         SCE::Math::GetAABBForPoints(loaderData.meshData[id].vertices, loaderData.meshData[id].center,
                                     loaderData.meshData[id].dimensions);
 
+        SCE::Memory::TrackAllocation(SCE::Memory::TAG_MESHES, meshDataBytes(loaderData.meshData[id]));
+
         return id;
     }
 
@@ -773,9 +787,17 @@ namespace MeshLoader
 
         if(it != end(loaderData.meshIds))
         {
-            Internal::Log("Delete mesh : " + it->first);
+            SCE_LOG_DEBUG(Logger::CAT_RESOURCES, "Delete mesh : " + it->first);
             loaderData.meshIds.erase(it);
         }
+
+        //release the CPU copy of the mesh
+        auto itData = loaderData.meshData.find(meshId);
+        if(itData != end(loaderData.meshData))
+        {
+            SCE::Memory::TrackDeallocation(SCE::Memory::TAG_MESHES, meshDataBytes(itData->second));
+            loaderData.meshData.erase(itData);
+        }
     }
 
     const MeshData& GetMeshData(ui16 meshId)
@@ -11,6 +11,9 @@
 #include "../headers/SCETools.hpp"
 #include "../headers/SCEInternal.hpp"
 #include "../headers/SCERenderStructs.hpp"
+#include "../headers/SCERenderStats.hpp"
+#include "../headers/SCEMemory.hpp"
+#include "../headers/SCELogger.hpp"
 
 
 namespace SCE
@@ -50,11 +53,13 @@ namespace MeshRender
     {
         ShaderData()
             : instanceMatrixLocation(GL_INVALID_INDEX),
-              instanceCustomDataLocation(GL_INVALID_INDEX)
+              instanceCustomDataLocation(GL_INVALID_INDEX),
+              instanceDataLocation(GL_INVALID_INDEX)
         {}
         GLint attribLocations[VERTEX_ATTRIB_COUNT];
         GLint instanceMatrixLocation;
         GLint instanceCustomDataLocation;
+        GLint instanceDataLocation;
     };
 
     //Per mesh data
@@ -67,7 +72,9 @@ namespace MeshRender
               vaoID(GL_INVALID_INDEX),
               attributes(),
               instanceMatricesBuffer(GL_INVALID_INDEX),
-              instancesCount(0)
+              instancesCount(0),
+              instanceDataBuffer(GL_INVALID_INDEX),
+              instanceDataCapacity(0)
         {}
         std::map<GLuint,ShaderData>     shaderData;
         GLuint                          indiceBuffer;
@@ -77,6 +84,9 @@ namespace MeshRender
         GLuint                          instanceMatricesBuffer;
         uint                            instancesCount;
         AttributeData                   instanceCustomData;
+        //uvec4 per instance, used instead of the matrices by the shaders that read it
+        GLuint                          instanceDataBuffer;
+        uint                            instanceDataCapacity;
     };
 
 
@@ -99,7 +109,7 @@ namespace MeshRender
             RendererData() : meshRenderData() {}
             ~RendererData()
             {
-                Internal::Log("Cleaning up mesh render system, will delete Vaos and Vbos");
+                SCE_LOG_DEBUG(Logger::CAT_RENDER, "Cleaning up mesh render system, will delete Vaos and Vbos");
                 auto beginIt = begin(meshRenderData);
                 auto endIt = end(meshRenderData);
                 for(auto iterator = beginIt; iterator != endIt; iterator++) {
@@ -127,6 +137,8 @@ namespace MeshRender
             glBufferData(GL_ARRAY_BUFFER
                          , size
                          , buffer, GL_STATIC_DRAW);
+            SCE::RenderStats::CountBufferUpload(size);
+            SCE::Memory::TrackGLBuffer(SCE::Memory::TAG_MESHES, attribData.glBuffer, size);
 
             attribData.type = type;
             attribData.nbComponents = nbValues;
@@ -135,7 +147,7 @@ namespace MeshRender
 
         void initializeGLData(ui16 meshId)
         {
-            Internal::Log("Initializing mesh renderer data");
+            SCE_LOG_DEBUG(Logger::CAT_RENDER, "Initializing mesh renderer data");
 
             const MeshData& meshData = SCE::MeshLoader::GetMeshData(meshId);
 
@@ -197,6 +209,9 @@ namespace MeshRender
             glBufferData(GL_ELEMENT_ARRAY_BUFFER
                          , meshData.indices.size() * sizeof(unsigned short)
                          , meshData.indices.data(), GL_STATIC_DRAW);
+            SCE::RenderStats::CountBufferUpload(meshData.indices.size() * sizeof(unsigned short));
+            SCE::Memory::TrackGLBuffer(SCE::Memory::TAG_MESHES, indiceBuffer,
+                                       meshData.indices.size() * sizeof(unsigned short));
 
             renderData.indiceBuffer = indiceBuffer;
 
@@ -219,25 +234,36 @@ namespace MeshRender
             //preload instance data locations
             data.instanceMatrixLocation = glGetAttribLocation(programID, "instanceMatrix");
             data.instanceCustomDataLocation = glGetAttribLocation(programID, "instanceCustomData");
+            data.instanceDataLocation = glGetAttribLocation(programID, "instanceData");
         }
 
         void cleanupGLRenderData(MeshRenderData& renderData)
         {
             for(size_t i = 0; i < renderData.attributes.size(); ++i){
+                SCE::Memory::UntrackGLBuffer(renderData.attributes[i].glBuffer);
                 glDeleteBuffers(1, &(renderData.attributes[i].glBuffer));
             }
+            SCE::Memory::UntrackGLBuffer(renderData.indiceBuffer);
             glDeleteBuffers(1, &(renderData.indiceBuffer));
 
             if(renderData.instanceMatricesBuffer != GL_INVALID_INDEX )
             {
+                SCE::Memory::UntrackGLBuffer(renderData.instanceMatricesBuffer);
                 glDeleteBuffers(1, &(renderData.instanceMatricesBuffer));
             }
 
             if(renderData.instanceCustomData.glBuffer != GL_INVALID_INDEX )
             {
+                SCE::Memory::UntrackGLBuffer(renderData.instanceCustomData.glBuffer);
                 glDeleteBuffers(1, &(renderData.instanceCustomData.glBuffer));
             }
 
+            if(renderData.instanceDataBuffer != GL_INVALID_INDEX )
+            {
+                SCE::Memory::UntrackGLBuffer(renderData.instanceDataBuffer);
+                glDeleteBuffers(1, &(renderData.instanceDataBuffer));
+            }
+
             glDeleteVertexArrays(1, &(renderData.vaoID));
         }
 
@@ -306,6 +332,11 @@ namespace MeshRender
             {
                 glDisableVertexAttribArray(shaderData.instanceCustomDataLocation);
             }
+
+            if(shaderData.instanceDataLocation != (GLint)GL_INVALID_INDEX)
+            {
+                glDisableVertexAttribArray(shaderData.instanceDataLocation);
+            }
         }
     }
 
@@ -358,6 +389,7 @@ namespace MeshRender
                     GL_UNSIGNED_SHORT,  // type
                     (void*)0            // element array buffer offset
                     );
+        SCE::RenderStats::CountDraw(GL_TRIANGLES, indiceCount);
 
         cleanMeshAttributes(meshRenderData, shaderProgram);
 
@@ -380,6 +412,8 @@ namespace MeshRender
         glBindBuffer(GL_ARRAY_BUFFER, renderData.instanceMatricesBuffer);
         int size = sizeof(mat4) * instanceMatrices.size();
         glBufferData(GL_ARRAY_BUFFER, size, instanceMatrices.data(), drawType);
+        SCE::RenderStats::CountBufferUpload(size);
+        SCE::Memory::TrackGLBuffer(SCE::Memory::TAG_MESHES, renderData.instanceMatricesBuffer, size);
         glBindBuffer(GL_ARRAY_BUFFER, 0);
         renderData.instancesCount = instanceMatrices.size();
     }
@@ -402,9 +436,75 @@ namespace MeshRender
 
         glBindBuffer(GL_ARRAY_BUFFER, renderData.instanceCustomData.glBuffer);
         glBufferData(GL_ARRAY_BUFFER, size, data, drawType);
+        SCE::RenderStats::CountBufferUpload(size);
+        SCE::Memory::TrackGLBuffer(SCE::Memory::TAG_MESHES, renderData.instanceCustomData.glBuffer, size);
         glBindBuffer(GL_ARRAY_BUFFER, 0);
     }
 
+    void SetMeshInstanceData(ui16 meshId, const void* instanceData, uint instanceCount, GLenum drawType)
+    {
+        MeshRenderData &renderData = getMeshRenderData(meshId);
+        SCE::Debug::Assert(renderData.instanceMatricesBuffer != GL_INVALID_INDEX,
+                           std::string("Mesh was not set as instances,") +
+                           "use 'MakeMeshInstanced' to set mesh as instanced");
+
+        if(renderData.instanceDataBuffer == GL_INVALID_INDEX)
+        {
+            glGenBuffers(1, &(renderData.instanceDataBuffer));
+        }
+
+        glBindBuffer(GL_ARRAY_BUFFER, renderData.instanceDataBuffer);
+        int size = sizeof(glm::uvec4) * instanceCount;
+        glBufferData(GL_ARRAY_BUFFER, size, instanceData, drawType);
+        SCE::RenderStats::CountBufferUpload(size);
+        SCE::Memory::TrackGLBuffer(SCE::Memory::TAG_MESHES, renderData.instanceDataBuffer, size);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        renderData.instancesCount = instanceCount;
+        renderData.instanceDataCapacity = instanceCount;
+    }
+
+    void ReserveMeshInstanceData(ui16 meshId, uint instanceCapacity, GLenum drawType)
+    {
+        MeshRenderData &renderData = getMeshRenderData(meshId);
+        SCE::Debug::Assert(renderData.instanceMatricesBuffer != GL_INVALID_INDEX,
+                           std::string("Mesh was not set as instances,") +
+                           "use 'MakeMeshInstanced' to set mesh as instanced");
+
+        if(renderData.instanceDataBuffer == GL_INVALID_INDEX)
+        {
+            glGenBuffers(1, &(renderData.instanceDataBuffer));
+        }
+
+        glBindBuffer(GL_ARRAY_BUFFER, renderData.instanceDataBuffer);
+        int size = sizeof(glm::uvec4) * instanceCapacity;
+        glBufferData(GL_ARRAY_BUFFER, size, nullptr, drawType);
+        SCE::Memory::TrackGLBuffer(SCE::Memory::TAG_MESHES, renderData.instanceDataBuffer, size);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        renderData.instancesCount = 0;
+        renderData.instanceDataCapacity = instanceCapacity;
+    }
+
+    void UpdateMeshInstanceData(ui16 meshId, const void* instanceData, uint firstInstance, uint instanceCount)
+    {
+        MeshRenderData &renderData = getMeshRenderData(meshId);
+        SCE::Debug::Assert(firstInstance + instanceCount <= renderData.instanceDataCapacity,
+                           "Instances written past the instance data buffer");
+
+        glBindBuffer(GL_ARRAY_BUFFER, renderData.instanceDataBuffer);
+        int size = sizeof(glm::uvec4) * instanceCount;
+        glBufferSubData(GL_ARRAY_BUFFER, sizeof(glm::uvec4) * firstInstance, size, instanceData);
+        SCE::RenderStats::CountBufferUpload(size);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    void SetMeshInstanceCount(ui16 meshId, uint instanceCount)
+    {
+        MeshRenderData &renderData = getMeshRenderData(meshId);
+        SCE::Debug::Assert(instanceCount <= renderData.instanceDataCapacity,
+                           "More instances drawn than the instance data buffer holds");
+        renderData.instancesCount = instanceCount;
+    }
+
     void DrawInstances(ui16 meshId, const glm::mat4& projectionMatrix,
                        const glm::mat4& viewMatrix)
     {
@@ -428,7 +528,7 @@ namespace MeshRender
         GLint instanceAttribLoc = shaderData.instanceMatrixLocation;
 
         //we can't use a Matrix here, so mark it as 4 consecutive vectors instead
-        for (int i = 0; i < 4; i++)
+        for (int i = 0; i < 4 && instanceAttribLoc != (GLint)GL_INVALID_INDEX; i++)
         {
             // Set up the vertex attribute
             glVertexAttribPointer(instanceAttribLoc + i,             // Location
@@ -461,6 +561,16 @@ namespace MeshRender
             glVertexAttribDivisor(dataAttribLoc, 1);
         }
 
+        //bind the packed instances, as integers so that the shader gets the bits unchanged
+        GLint packedAttribLoc = shaderData.instanceDataLocation;
+        if(packedAttribLoc != (GLint)GL_INVALID_INDEX && meshRenderData.instanceDataBuffer != GL_INVALID_INDEX)
+        {
+            glBindBuffer(GL_ARRAY_BUFFER, meshRenderData.instanceDataBuffer);
+            glVertexAttribIPointer(packedAttribLoc, 4, GL_UNSIGNED_INT, sizeof(glm::uvec4), (void*)0);
+            glEnableVertexAttribArray(packedAttribLoc);
+            glVertexAttribDivisor(packedAttribLoc, 1);
+        }
+
 
         GLuint indiceCount = meshRenderData.indiceCount;
         GLuint indiceBuffer = meshRenderData.indiceBuffer;
@@ -475,9 +585,13 @@ namespace MeshRender
                     GL_UNSIGNED_SHORT,  // type
                     (void*)0,            // element array buffer offset
                     meshRenderData.instancesCount);
+        SCE::RenderStats::CountInstancedDraw(GL_TRIANGLES, indiceCount, meshRenderData.instancesCount);
 
         cleanMeshAttributes(meshRenderData, shaderProgram);
-        glDisableVertexAttribArray(instanceAttribLoc);
+        if(instanceAttribLoc != (GLint)GL_INVALID_INDEX)
+        {
+            glDisableVertexAttribArray(instanceAttribLoc);
+        }
         if(dataAttribLoc != (GLint)GL_INVALID_INDEX)
         {
             glDisableVertexAttribArray(dataAttribLoc);
@@ -0,0 +1,181 @@
+/******PROJECT:Sand Castle Engine******/
+/**************************************/
+/*********AUTHOR:Gwenn AUBERT**********/
+/*********FILE:SCEParallel.cpp*********/
+/**************************************/
+
+#include "../headers/SCEParallel.hpp"
+#include "../headers/SCETools.hpp"
+
+#include <chrono>
+
+namespace SCE
+{
+
+namespace Parallel
+{
+    namespace
+    {
+        ui32 requestedWorkerCount = 0;
+
+        double getSeconds()
+        {
+            return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+    }
+
+    void SetWorkerCount(ui32 workerCount)
+    {
+        requestedWorkerCount = workerCount;
+    }
+
+    ui32 GetWorkerCount()
+    {
+        if(requestedWorkerCount > 0)
+        {
+            return requestedWorkerCount;
+        }
+        //hardware_concurrency may return 0 when it can't tell
+        return glm::max(1u, ui32(std::thread::hardware_concurrency()));
+    }
+
+    void For(int begin, int end, int blockSize, const RangeBody& body)
+    {
+        Debug::Assert(blockSize > 0, "Parallel::For needs a positive block size");
+        if(end <= begin)
+        {
+            return;
+        }
+
+        int blockCount = (end - begin + blockSize - 1) / blockSize;
+        ui32 workerCount = glm::min(GetWorkerCount(), ui32(blockCount));
+
+        if(workerCount <= 1)
+        {
+            body(begin, end);
+            return;
+        }
+
+        //blocks are grabbed one at a time, so that uneven blocks don't leave workers idle
+        std::atomic<int> nextBlock(0);
+        auto work = [&]()
+        {
+            for(int block = nextBlock++; block < blockCount; block = nextBlock++)
+            {
+                int rangeBegin = begin + block*blockSize;
+                body(rangeBegin, glm::min(end, rangeBegin + blockSize));
+            }
+        };
+
+        std::vector<std::thread> workers;
+        workers.reserve(workerCount - 1);
+        for(ui32 i = 0; i + 1 < workerCount; ++i)
+        {
+            workers.push_back(std::thread(work));
+        }
+        work();
+
+        for(std::thread& worker : workers)
+        {
+            worker.join();
+        }
+    }
+
+    BackgroundWorker::BackgroundWorker()
+        : mCancel(false),
+          mHasPendingJob(false),
+          mIsRunning(false),
+          mIsStopping(false),
+          mPendingSubmitTime(0.0),
+          mLastLatency(0.0)
+    {
+        mThread = std::thread(&BackgroundWorker::run, this);
+    }
+
+    BackgroundWorker::~BackgroundWorker()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mLock);
+            mIsStopping = true;
+            mHasPendingJob = false;
+            mCancel = true;
+        }
+        mJobCondition.notify_one();
+        mThread.join();
+    }
+
+    void BackgroundWorker::Submit(const Job& job)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mLock);
+            mPendingJob = job;
+            mHasPendingJob = true;
+            mPendingSubmitTime = getSeconds();
+        }
+        mJobCondition.notify_one();
+    }
+
+    void BackgroundWorker::Cancel()
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        mHasPendingJob = false;
+        mPendingJob = Job();
+        mCancel = true;
+        if(!mIsRunning)
+        {
+            mIdleCondition.notify_all();
+        }
+    }
+
+    void BackgroundWorker::Wait()
+    {
+        std::unique_lock<std::mutex> lock(mLock);
+        mIdleCondition.wait(lock, [this]() { return !mHasPendingJob && !mIsRunning; });
+    }
+
+    bool BackgroundWorker::IsBusy()
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        return mHasPendingJob || mIsRunning;
+    }
+
+    double BackgroundWorker::GetLastLatency()
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        return mLastLatency;
+    }
+
+    void BackgroundWorker::run()
+    {
+        std::unique_lock<std::mutex> lock(mLock);
+        while(true)
+        {
+            mJobCondition.wait(lock, [this]() { return mHasPendingJob || mIsStopping; });
+            if(mIsStopping)
+            {
+                return;
+            }
+
+            Job job;
+            std::swap(job, mPendingJob);
+            double submitTime = mPendingSubmitTime;
+            mHasPendingJob = false;
+            mIsRunning = true;
+            //a Cancel before this point was meant for the previous job
+            mCancel = false;
+            lock.unlock();
+
+            job(mCancel);
+
+            lock.lock();
+            mIsRunning = false;
+            mLastLatency = getSeconds() - submitTime;
+            if(!mHasPendingJob)
+            {
+                mIdleCondition.notify_all();
+            }
+        }
+    }
+}
+
+}
@@ -6,50 +6,74 @@
 
 #include "../headers/SCEPerlin.hpp"
 #include "../headers/SCETools.hpp"
+#include "../headers/SCEMemory.hpp"
 #include <cstdlib>
 
+#include "../headers/SCESimd.hpp"
+#define USE_SSE_PERLIN SCE_USE_SSE2
+
 namespace SCE
 {
 namespace Perlin
 {
 
 #define EXP_ARRAY_SIZE 256
+//gradients are picked by hashing the grid corner through a seeded permutation,
+//instead of being stored for every cell of the grid
+#define PERLIN_TABLE_SIZE 256
+#define PERLIN_TABLE_MASK (PERLIN_TABLE_SIZE - 1)
 
 static int mSize = -1;
 static vec2* gradients;
 static int* permutations;
 static float* exponents;
 
-void randomizeNormalizedVectors(vec2* vectors, int count)
+//xorshift32, rand() sequences differ from one C library to the other
+static ui32 nextRandom(ui32& state)
 {
-    for(int i = 0; i < count; ++i)
-    {
-        vectors[i].x = SCE::Math::RandRange(-1.0, 1.0);
-        vectors[i].y = SCE::Math::RandRange(-1.0, 1.0);
-        glm::normalize(vectors[i]);
-    }
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
 }
 
-void MakePerlin(ui16 gridSize)
+//in [-1, 1[, exact conversion so that the gradients are the same on every platform
+static float nextSignedRandom(ui32& state)
+{
+    return float(i32(nextRandom(state) >> 8) - (1 << 23)) / float(1 << 23);
+}
+
+void MakePerlin(ui16 gridSize, ui32 seed)
 {
-    //initalize gradient grid
     mSize = gridSize;
-    int length = mSize*mSize;
-    gradients = (vec2*)malloc(sizeof(glm::vec2)*length);
-    randomizeNormalizedVectors(gradients, length);
+    ui32 state = seed ^ 0x9E3779B9u;
+    if(state == 0)
+    {
+        state = 0x9E3779B9u;
+    }
+
+    gradients = (vec2*)malloc(sizeof(glm::vec2)*PERLIN_TABLE_SIZE);
+    for(int i = 0; i < PERLIN_TABLE_SIZE; ++i)
+    {
+        gradients[i].x = nextSignedRandom(state);
+        gradients[i].y = nextSignedRandom(state);
+    }
 
-    permutations = (int*) malloc(sizeof(int)*EXP_ARRAY_SIZE);
+    permutations = (int*) malloc(sizeof(int)*PERLIN_TABLE_SIZE);
 
-    for(int i = 0; i < EXP_ARRAY_SIZE; ++i)
+    for(int i = 0; i < PERLIN_TABLE_SIZE; ++i)
     {
         permutations[i] = i;
     }
 
-    for(int i = EXP_ARRAY_SIZE - 1; i > 0; i--)
+    for(int i = PERLIN_TABLE_SIZE - 1; i > 0; i--)
     {
-        std::swap(permutations[i], permutations[rand()%(i + 1)]);
+        std::swap(permutations[i], permutations[nextRandom(state)%(i + 1)]);
     }
 
+    SCE::Memory::TrackAllocation(SCE::Memory::TAG_PERLIN, (sizeof(glm::vec2) + sizeof(int))*PERLIN_TABLE_SIZE
+                                 + sizeof(float)*EXP_ARRAY_SIZE);
+
     float mExpSrc = glm::pow(2.0f, -126.0f/float(EXP_ARRAY_SIZE - 1));
     mExpSrc = glm::mix(mExpSrc, 1.0f, 0.5f);
 
@@ -64,6 +88,12 @@ void MakePerlin(ui16 gridSize)
 
 void DestroyPerlin()
 {
+    if(gradients)
+    {
+        SCE::Memory::TrackDeallocation(SCE::Memory::TAG_PERLIN, (sizeof(glm::vec2) + sizeof(int))*PERLIN_TABLE_SIZE
+                                       + sizeof(float)*EXP_ARRAY_SIZE);
+    }
+
     free(gradients);
     gradients = NULL;
 
@@ -79,9 +109,14 @@ float GetPerlinAt(float x, float y)
     return GetPerlinAt(x, y, mSize);
 }
 
-int hash(int x, int y, int size)
+//x and y are grid coordinates, already wrapped in [0, mSize[. The high bits are
+//hashed too so that the pattern doesn't repeat every PERLIN_TABLE_SIZE cells
+static inline int gradientIndex(int x, int y)
 {
-    return permutations[(permutations[x] + y)%size];
+    int h = permutations[x & PERLIN_TABLE_MASK];
+    h = permutations[(h + (x >> 8)) & PERLIN_TABLE_MASK];
+    h = permutations[(h + y) & PERLIN_TABLE_MASK];
+    return permutations[(h + (y >> 8)) & PERLIN_TABLE_MASK];
 }
 
 //result in -0.5 .. 0.5
@@ -111,9 +146,8 @@ float GetPerlinAt(float x, float y, float period)
         int xg = int(glm::mod(corners[i].x, period))%mSize;
         int yg = int(glm::mod(corners[i].y, period))%mSize;
 
-        vec2 gradient = gradients[ xg  * mSize + yg ];
-//        vec2 gradient = gradients[hash(xg, yg, mSize)];
-        //expL = exponents[hash(xg%EXP_ARRAY_SIZE, yg%EXP_ARRAY_SIZE, EXP_ARRAY_SIZE)];
+        vec2 gradient = gradients[gradientIndex(xg, yg)];
+        //expL = exponents[gradientIndex(xg%EXP_ARRAY_SIZE, yg%EXP_ARRAY_SIZE)];
         gradientDotVector[i] = expL * glm::dot(gradient, vectorToPoint);
     }
 
@@ -146,6 +180,120 @@ float GetLayeredPerlinAt(float x, float y, int layers, float persistence)
     return perlinSum / maxValue;
 }
 
+#if USE_SSE_PERLIN
+//Lane by lane, these do the same float operations in the same order as the scalar
+//versions, results only differ if the compiler contracts the scalar code differently
+
+static inline __m128 fade4(__m128 t)
+{
+    //6t5-15t4+10t3
+    __m128 t3 = _mm_mul_ps(_mm_mul_ps(t, t), t);
+    __m128 poly = _mm_sub_ps(_mm_mul_ps(t, _mm_set1_ps(6.0f)), _mm_set1_ps(15.0f));
+    poly = _mm_add_ps(_mm_mul_ps(t, poly), _mm_set1_ps(10.0f));
+    return _mm_mul_ps(t3, poly);
+}
+
+//grid index of the given corner coordinates, int(mod(corner, period))%mSize
+static inline void gridIndex4(__m128 corner, __m128 period, int* indices)
+{
+    __m128 wrapped = _mm_sub_ps(corner, _mm_mul_ps(period, Simd::Floor4(_mm_div_ps(corner, period))));
+    _mm_storeu_si128((__m128i*)indices, _mm_cvttps_epi32(wrapped));
+    for(int i = 0; i < 4; ++i)
+    {
+        indices[i] %= mSize;
+    }
+}
+
+static inline __m128 gradientDot4(const int* xIndices, const int* yIndices, __m128 toPointX, __m128 toPointY)
+{
+    //random lookups, the only part that stays scalar
+    vec2 g0 = gradients[gradientIndex(xIndices[0], yIndices[0])];
+    vec2 g1 = gradients[gradientIndex(xIndices[1], yIndices[1])];
+    vec2 g2 = gradients[gradientIndex(xIndices[2], yIndices[2])];
+    vec2 g3 = gradients[gradientIndex(xIndices[3], yIndices[3])];
+    __m128 gradientX = _mm_setr_ps(g0.x, g1.x, g2.x, g3.x);
+    __m128 gradientY = _mm_setr_ps(g0.y, g1.y, g2.y, g3.y);
+    return _mm_add_ps(_mm_mul_ps(gradientX, toPointX), _mm_mul_ps(gradientY, toPointY));
+}
+
+static inline __m128 perlin4(__m128 x, __m128 y, float period)
+{
+    __m128 one = _mm_set1_ps(1.0f);
+    __m128 vPeriod = _mm_set1_ps(period);
+
+    __m128 x0 = Simd::Floor4(x);
+    __m128 y0 = Simd::Floor4(y);
+    __m128 x1 = _mm_add_ps(x0, one);
+    __m128 y1 = _mm_add_ps(y0, one);
+
+    int xi0[4], xi1[4], yi0[4], yi1[4];
+    gridIndex4(x0, vPeriod, xi0);
+    gridIndex4(x1, vPeriod, xi1);
+    gridIndex4(y0, vPeriod, yi0);
+    gridIndex4(y1, vPeriod, yi1);
+
+    __m128 dx0 = _mm_sub_ps(x, x0);
+    __m128 dx1 = _mm_sub_ps(x, x1);
+    __m128 dy0 = _mm_sub_ps(y, y0);
+    __m128 dy1 = _mm_sub_ps(y, y1);
+
+    __m128 dot00 = gradientDot4(xi0, yi0, dx0, dy0);
+    __m128 dot01 = gradientDot4(xi0, yi1, dx0, dy1);
+    __m128 dot10 = gradientDot4(xi1, yi0, dx1, dy0);
+    __m128 dot11 = gradientDot4(xi1, yi1, dx1, dy1);
+
+    __m128 u = fade4(dx0);
+    __m128 v = fade4(dy0);
+    return Simd::Mix4(Simd::Mix4(dot00, dot10, u), Simd::Mix4(dot01, dot11, u), v);
+}
+#endif
+
+void GetPerlinBatch(const float* x, const float* y, float period, float* results, int count)
+{
+    int i = 0;
+#if USE_SSE_PERLIN
+    for(; i + PERLIN_BATCH_WIDTH <= count; i += PERLIN_BATCH_WIDTH)
+    {
+        _mm_storeu_ps(results + i, perlin4(_mm_loadu_ps(x + i), _mm_loadu_ps(y + i), period));
+    }
+#endif
+    for(; i < count; ++i)
+    {
+        results[i] = GetPerlinAt(x[i], y[i], period);
+    }
+}
+
+void GetLayeredPerlinBatch(const float* x, const float* y, int layers, float persistence,
+                           float* results, int count)
+{
+    int i = 0;
+#if USE_SSE_PERLIN
+    for(; i + PERLIN_BATCH_WIDTH <= count; i += PERLIN_BATCH_WIDTH)
+    {
+        __m128 baseX = _mm_loadu_ps(x + i);
+        __m128 baseY = _mm_loadu_ps(y + i);
+        __m128 perlinSum = _mm_setzero_ps();
+        float frequency = 1.0;
+        float amplitude = 1.0;
+        float maxValue = 0.0;
+        for(int l = 0; l < layers; ++l)
+        {
+            __m128 vFrequency = _mm_set1_ps(frequency);
+            __m128 noise = perlin4(_mm_mul_ps(baseX, vFrequency), _mm_mul_ps(baseY, vFrequency), mSize);
+            perlinSum = _mm_add_ps(perlinSum, _mm_mul_ps(noise, _mm_set1_ps(amplitude)));
+            frequency *= 2;
+            maxValue += amplitude;
+            amplitude /= persistence;
+        }
+        _mm_storeu_ps(results + i, _mm_div_ps(perlinSum, _mm_set1_ps(maxValue)));
+    }
+#endif
+    for(; i < count; ++i)
+    {
+        results[i] = GetLayeredPerlinAt(x[i], y[i], layers, persistence);
+    }
+}
+
 }
 
 }
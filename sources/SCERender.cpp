@@ -15,6 +15,7 @@
 #include "../headers/SCEDebugText.hpp"
 #include "../headers/SCEFrustrumCulling.hpp"
 #include "../headers/SCEPostProcess.hpp"
+#include "../headers/SCERenderStats.hpp"
 
 
 using namespace std;
@@ -125,6 +126,8 @@ namespace Render
     void Render(const SCEHandle<Camera>& camera,
                            vector<Container*> objectsToRender)
     {
+        SCE::RenderStats::BeginFrame();
+
         vector<MeshRenderer*> shadowCasters;
 
         for(Container* obj : objectsToRender)
@@ -146,45 +149,53 @@ namespace Render
         SCE::Terrain::UpdateTerrain(renderData.projectionMatrix, renderData.viewMatrix);
 
         //render shadows to shadowmap
+        SCE::RenderStats::SetCurrentPass(SCE::RenderStats::SHADOW_PASS);
         SCEHandle<Transform> camTransform = camera->GetContainer()->GetComponent<Transform>();
         glm::mat4 camToWorld = camTransform->GetSceneTransform();
         SCELighting::RenderCascadedShadowMap(renderData, camera->GetFrustrumData(),
                                              camToWorld, shadowCasters);
 
         //render objects without lighting
+        SCE::RenderStats::SetCurrentPass(SCE::RenderStats::GEOMETRY_PASS);
         renderGeometryPass(renderData, objectsToRender);
 
         //lighting & sky
+        SCE::RenderStats::SetCurrentPass(SCE::RenderStats::LIGHTING_PASS);
         mGBuffer.ClearFinalBuffer();
         SCELighting::RenderLightsToGBuffer(renderData, mGBuffer);               
 
+        SCE::RenderStats::SetCurrentPass(SCE::RenderStats::POST_PROCESS_PASS);
         SCELighting::RenderSkyToGBuffer(renderData, mGBuffer);
 
         //luminance
         ToneMappingData& tonemap = mToneMapData;
         glDisable(GL_DEPTH_TEST);
-        glUseProgram(tonemap.luminanceShader);
+        SCE::ShaderUtils::UseShader(tonemap.luminanceShader);
         mGBuffer.BindForLuminancePass();
         RenderFullScreenPass(tonemap.luminanceShader, renderData.projectionMatrix, renderData.viewMatrix);
         mGBuffer.GenerateLuminanceMimap();        
 
         //Tonemapping & render to back buffer
-        glUseProgram(tonemap.toneMapShader);
+        SCE::ShaderUtils::UseShader(tonemap.toneMapShader);
         mGBuffer.BindForToneMapPass();
 
         glUniform1f(tonemap.exposureUniform, tonemap.exposure);
         glUniform1f(tonemap.maxBrightnessUniform, tonemap.maxBrightness);
 
         glUniform1f(tonemap.tonemapStrengthUniform, mDebugTonemapOff ? 0.0f : 1.0f);
+        SCE::RenderStats::CountUniformCalls(3);
 
         RenderFullScreenPass(tonemap.toneMapShader, renderData.projectionMatrix, renderData.viewMatrix);
 
         //reset to default framebufffer
         glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        SCE::RenderStats::CountFramebufferBind(0);
 
         //render debug text
         SCE::DebugText::RenderMessages(renderData.viewMatrix, renderData.projectionMatrix);
         glEnable(GL_DEPTH_TEST);
+
+        SCE::RenderStats::EndFrame();
     }
 
     void ResetClearColorToDefault()
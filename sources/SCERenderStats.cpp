@@ -0,0 +1,262 @@
+/******PROJECT:Sand Castle Engine******/
+/**************************************/
+/*********AUTHOR:Gwenn AUBERT**********/
+/*******FILE:SCERenderStats.cpp********/
+/**************************************/
+
+#include "../headers/SCERenderStats.hpp"
+#include "../headers/SCETime.hpp"
+#include "../headers/SCETools.hpp"
+#include "../headers/SCEInternal.hpp"
+#include "../headers/SCELogger.hpp"
+
+#include <fstream>
+
+namespace SCE
+{
+
+namespace RenderStats
+{
+    namespace
+    {
+        struct RenderStatsData
+        {
+            RenderStatsData()
+                : currentFrame(), lastFrame(), currentPass(UPDATE_PASS),
+                  frameStartTime(0.0), boundProgram(GL_INVALID_INDEX),
+                  boundFramebuffer(GL_INVALID_INDEX), csvFile()
+            {}
+
+            FrameStats      currentFrame;
+            FrameStats      lastFrame;
+            RenderPass      currentPass;
+            double          frameStartTime;
+            GLuint          boundProgram;
+            GLuint          boundFramebuffer;
+            std::ofstream   csvFile;
+        };
+
+        RenderStatsData statsData;
+
+        const char* passNames[RENDER_PASS_COUNT] =
+        {
+            "update",
+            "shadow",
+            "geometry",
+            "lighting",
+            "postprocess"
+        };
+
+        PassStats& currentPassStats()
+        {
+            return statsData.currentFrame.passes[statsData.currentPass];
+        }
+
+        ui64 primitiveCount(GLenum mode, ui32 indiceCount)
+        {
+            switch(mode)
+            {
+            case GL_TRIANGLES :
+                return indiceCount / 3;
+            case GL_TRIANGLE_STRIP :
+            case GL_TRIANGLE_FAN :
+                return indiceCount > 2 ? indiceCount - 2 : 0;
+            default :
+                //patches are counted separately, their triangles only exist on the GPU
+                return 0;
+            }
+        }
+
+        void accumulate(PassStats& total, const PassStats& pass)
+        {
+            total.drawCalls             += pass.drawCalls;
+            total.instancedDrawCalls    += pass.instancedDrawCalls;
+            total.instances             += pass.instances;
+            total.triangles             += pass.triangles;
+            total.patches               += pass.patches;
+            total.programSwitches       += pass.programSwitches;
+            total.textureBinds          += pass.textureBinds;
+            total.framebufferBinds      += pass.framebufferBinds;
+            total.bufferBytesUploaded   += pass.bufferBytesUploaded;
+            total.uniformCalls          += pass.uniformCalls;
+            total.visibleObjects        += pass.visibleObjects;
+            total.culledObjects         += pass.culledObjects;
+        }
+
+        void writeCSVLine(const FrameStats& frame, const char* passName, const PassStats& pass)
+        {
+            statsData.csvFile << frame.frameIndex << ","
+                              << frame.cpuTimeMs << ","
+                              << passName << ","
+                              << pass.drawCalls << ","
+                              << pass.instancedDrawCalls << ","
+                              << pass.instances << ","
+                              << pass.triangles << ","
+                              << pass.patches << ","
+                              << pass.programSwitches << ","
+                              << pass.textureBinds << ","
+                              << pass.framebufferBinds << ","
+                              << pass.bufferBytesUploaded << ","
+                              << pass.uniformCalls << ","
+                              << pass.visibleObjects << ","
+                              << pass.culledObjects << "\n";
+        }
+
+        void writeCSVFrame(const FrameStats& frame)
+        {
+            for(int i = 0; i < RENDER_PASS_COUNT; ++i)
+            {
+                writeCSVLine(frame, passNames[i], frame.passes[i]);
+            }
+            writeCSVLine(frame, "total", frame.total);
+        }
+    }
+
+    void BeginFrame()
+    {
+        ui64 frameIndex = statsData.lastFrame.frameIndex + 1;
+        statsData.currentFrame = FrameStats();
+        statsData.currentFrame.frameIndex = frameIndex;
+        statsData.currentPass = UPDATE_PASS;
+        //GL state may have been changed outside of the counted code, so start from a clean slate
+        statsData.boundProgram = GL_INVALID_INDEX;
+        statsData.boundFramebuffer = GL_INVALID_INDEX;
+        statsData.frameStartTime = SCE::Time::RealTimeInSeconds();
+    }
+
+    void EndFrame()
+    {
+        FrameStats& frame = statsData.currentFrame;
+        frame.cpuTimeMs = (SCE::Time::RealTimeInSeconds() - statsData.frameStartTime) * 1000.0;
+
+        frame.total = PassStats();
+        for(int i = 0; i < RENDER_PASS_COUNT; ++i)
+        {
+            accumulate(frame.total, frame.passes[i]);
+        }
+
+        statsData.lastFrame = frame;
+
+        if(statsData.csvFile.is_open())
+        {
+            writeCSVFrame(statsData.lastFrame);
+        }
+    }
+
+    void SetCurrentPass(RenderPass pass)
+    {
+        Debug::Assert(pass < RENDER_PASS_COUNT, "Invalid render pass");
+        statsData.currentPass = pass;
+    }
+
+    RenderPass GetCurrentPass()
+    {
+        return statsData.currentPass;
+    }
+
+    void CountDraw(GLenum mode, ui32 indiceCount)
+    {
+        PassStats& pass = currentPassStats();
+        ++pass.drawCalls;
+        pass.triangles += primitiveCount(mode, indiceCount);
+    }
+
+    void CountInstancedDraw(GLenum mode, ui32 indiceCount, ui32 instanceCount)
+    {
+        PassStats& pass = currentPassStats();
+        ++pass.drawCalls;
+        ++pass.instancedDrawCalls;
+        pass.instances += instanceCount;
+        pass.triangles += primitiveCount(mode, indiceCount) * instanceCount;
+    }
+
+    void CountPatches(ui32 patchCount)
+    {
+        currentPassStats().patches += patchCount;
+    }
+
+    void CountProgramBind(GLuint program)
+    {
+        if(program != statsData.boundProgram)
+        {
+            ++currentPassStats().programSwitches;
+            statsData.boundProgram = program;
+        }
+    }
+
+    void CountTextureBind(ui32 bindCount)
+    {
+        currentPassStats().textureBinds += bindCount;
+    }
+
+    void CountFramebufferBind(GLuint fboId)
+    {
+        if(fboId != statsData.boundFramebuffer)
+        {
+            ++currentPassStats().framebufferBinds;
+            statsData.boundFramebuffer = fboId;
+        }
+    }
+
+    void CountBufferUpload(ui64 bytes)
+    {
+        currentPassStats().bufferBytesUploaded += bytes;
+    }
+
+    void CountUniformCalls(ui32 callCount)
+    {
+        currentPassStats().uniformCalls += callCount;
+    }
+
+    void CountVisibility(ui32 visibleCount, ui32 culledCount)
+    {
+        PassStats& pass = currentPassStats();
+        pass.visibleObjects += visibleCount;
+        pass.culledObjects += culledCount;
+    }
+
+    const FrameStats& GetLastFrameStats()
+    {
+        return statsData.lastFrame;
+    }
+
+    const char* GetPassName(RenderPass pass)
+    {
+        Debug::Assert(pass < RENDER_PASS_COUNT, "Invalid render pass");
+        return passNames[pass];
+    }
+
+    bool StartCSVExport(const std::string& filename)
+    {
+        StopCSVExport();
+
+        statsData.csvFile.open(filename.c_str(), std::ios::out | std::ios::trunc);
+        if(!statsData.csvFile.is_open())
+        {
+            SCE_LOG_ERROR(Logger::CAT_RENDER, "Could not open render stats file : " + filename);
+            return false;
+        }
+
+        statsData.csvFile << "frame,cpu_ms,pass,draws,instanced_draws,instances,triangles,"
+                          << "patches,program_switches,texture_binds,fbo_binds,"
+                          << "buffer_bytes,uniform_calls,visible,culled\n";
+
+        SCE_LOG_DEBUG(Logger::CAT_RENDER, "Exporting render stats to : " + filename);
+        return true;
+    }
+
+    void StopCSVExport()
+    {
+        if(statsData.csvFile.is_open())
+        {
+            statsData.csvFile.close();
+        }
+    }
+
+    bool IsExportingCSV()
+    {
+        return statsData.csvFile.is_open();
+    }
+}
+
+}
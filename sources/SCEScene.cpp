@@ -10,6 +10,8 @@
 #include "../headers/SCEInternal.hpp"
 #include "../headers/SCERender.hpp"
 #include "../headers/SCETerrain.hpp"
+#include "../headers/SCEMemory.hpp"
+#include "../headers/SCELogger.hpp"
 
 #include "../headers/SCECore.hpp"
 
@@ -19,6 +21,9 @@ using namespace std;
 
 SCEScene* SCEScene::s_scene = nullptr;
 
+//memory state before the scene was created, used to find what a scene leaked once destroyed
+static SCE::Memory::Snapshot s_preSceneMemory;
+
 SCE::SCEScene::SCEScene()
     : mContainers(), mGameObjects(), mLastId(0)
 {    
@@ -27,8 +32,8 @@ SCE::SCEScene::SCEScene()
 SCE::SCEScene::~SCEScene()
 {
     SCE::Terrain::Cleanup();
-    Internal::Log("Delete scene");
-    Internal::Log("Clear stuff");
+    SCE_LOG_DEBUG(Logger::CAT_SCENE, "Delete scene");
+    SCE_LOG_DEBUG(Logger::CAT_SCENE, "Clear stuff");
     for(Container* cont : mContainers)
     {
         delete(cont);
@@ -41,6 +46,8 @@ void SCE::SCEScene::CreateEmptyScene()
 {
     Debug::Assert(s_scene == nullptr
                   , "A scene is already loaded, destroy it befor loading a new one");
+    s_preSceneMemory = SCE::Memory::TakeSnapshot();
+    SCE::Memory::ResetHighWaterMarks();
     s_scene = new SCEScene();
 }
 
@@ -108,14 +115,25 @@ void SCEScene::UpdateScene()
 
 void SCE::SCEScene::DestroyScene()
 {
+    if(s_scene)
+    {
+        SCE_LOG_DEBUG(Logger::CAT_SCENE, SCE::Memory::GetReport());
+    }
+
     SECURE_DELETE(s_scene);
+
+    std::string leaks = SCE::Memory::DiffSnapshots(s_preSceneMemory, SCE::Memory::TakeSnapshot());
+    if(!leaks.empty())
+    {
+        SCE_LOG_DEBUG(Logger::CAT_SCENE, "Memory still allocated after scene destruction :\n" + leaks);
+    }
 }
 
 SCEHandle<Container> SCEScene::CreateContainer(const string &name)
 {
     if(!s_scene)
     {
-        Debug::LogError("No scene to add the container to, create a scene first");
+        SCE_LOG_ERROR(Logger::CAT_SCENE, "No scene to add the container to, create a scene first");
     }
     Container* cont = new Container(name, ++s_scene->mLastId);
     s_scene->mContainers.push_back(cont);
@@ -130,7 +148,7 @@ void SCEScene::DestroyContainer(const SCEHandle<Container> &container)
 
 void SCEScene::RemoveContainer(int objId)
 {
-    Internal::Log("Removing container from scene");
+    SCE_LOG_DEBUG(Logger::CAT_SCENE, "Removing container from scene");
     if(!s_scene) return;
     auto objIt = find_if(
                      begin(s_scene->mContainers)
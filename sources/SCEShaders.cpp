@@ -8,6 +8,8 @@
 #include "../headers/SCETools.hpp"
 #include "../headers/SCEInternal.hpp"
 #include "../headers/SCECore.hpp"
+#include "../headers/SCERenderStats.hpp"
+#include "../headers/SCELogger.hpp"
 
 #include <map>
 #include <algorithm>
@@ -64,11 +66,12 @@ namespace ShaderUtils
 
             ~ShadersData()
             {
-                Internal::Log("Cleaning up shader system, will delete compiled shader promgrams");
+                SCE_LOG_DEBUG(Logger::CAT_RESOURCES,
+                              "Cleaning up shader system, will delete compiled shader promgrams");
                 auto beginIt = begin(compiledPrograms);
                 auto endIt = end(compiledPrograms);
                 for(auto iterator = beginIt; iterator != endIt; iterator++) {
-                    Internal::Log("Deleting shader : " + iterator->first);
+                    SCE_LOG_DEBUG(Logger::CAT_RESOURCES, "Deleting shader : " + iterator->first);
                     glDeleteProgram(iterator->second);
                 }
             }
@@ -198,7 +201,7 @@ namespace ShaderUtils
             GLint result = GL_FALSE;
             int infoLogLength;
 
-            Internal::Log("Compiling shader at " + fullPath);
+            SCE_LOG_DEBUG(Logger::CAT_RESOURCES, "Compiling shader at " + fullPath);
 
             for(int i = 0; i < SHADER_TYPE_COUNT; ++i)
             {
@@ -216,16 +219,16 @@ namespace ShaderUtils
                     if (!result && infoLogLength > 0 ){
                         std::vector<char> shaderErrorMessage(infoLogLength+1);
                         glGetShaderInfoLog(shaderIds[i], infoLogLength, NULL, &shaderErrorMessage[0]);
-                        Internal::Log("Compilation Error on " + shaderTypeToString(i) + " !!!");
-                        Internal::Log(std::to_string(shadersTypeStartLine[i]) + "+ " +
-                                    string(&shaderErrorMessage[0]) + "\n");
+                        SCE_LOG_DEBUG(Logger::CAT_RESOURCES, "Compilation Error on " + shaderTypeToString(i) + " !!!");
+                        SCE_LOG_DEBUG(Logger::CAT_RESOURCES, std::to_string(shadersTypeStartLine[i]) + "+ " +
+                                      string(&shaderErrorMessage[0]) + "\n");
                     }
                 }
             }
 
 
             // Link the program
-            Internal::Log("Linking shader program\n");
+            SCE_LOG_DEBUG(Logger::CAT_RESOURCES, "Linking shader program\n");
 
             for(int i = 0; i < SHADER_TYPE_COUNT; ++i)
             {
@@ -244,8 +247,8 @@ namespace ShaderUtils
             if (!result && infoLogLength > 0 ){
                 std::vector<char> ProgramErrorMessage(infoLogLength+1);
                 glGetProgramInfoLog(programID, infoLogLength, NULL, &ProgramErrorMessage[0]);
-                Internal::Log("Linking error !!!");
-                Internal::Log(string(&ProgramErrorMessage[0]) + "\n");
+                SCE_LOG_DEBUG(Logger::CAT_RESOURCES, "Linking error !!!");
+                SCE_LOG_DEBUG(Logger::CAT_RESOURCES, string(&ProgramErrorMessage[0]) + "\n");
             }
 
             //Now that the program is linked, we can delete the individual shaders
@@ -306,7 +309,7 @@ namespace ShaderUtils
 
         if(it != end(shaderData.compiledPrograms))
         {
-            Internal::Log("Delete program : " + it->first);
+            SCE_LOG_DEBUG(Logger::CAT_RESOURCES, "Delete program : " + it->first);
             glDeleteProgram(it->second);
             shaderData.compiledPrograms.erase(it);
         }
@@ -341,12 +344,14 @@ namespace ShaderUtils
         glUniformMatrix4fv(uniforms.ModelMatrixUniform, 1, GL_FALSE, &(modelMatrix[0][0]));
         glUniformMatrix4fv(uniforms.ViewMatrixUniform, 1, GL_FALSE, &(viewMatrix[0][0]));
         glUniformMatrix4fv(uniforms.ProjectionMatrixUniform, 1, GL_FALSE, &(projectionMatrix[0][0]));
+        SCE::RenderStats::CountUniformCalls(8);
     }
 
     void BindRootPosition(GLuint shaderId, glm::vec3 const& rootPosition)
     {
         DefaultUniforms& uniforms = shaderData.defaultUniforms[shaderId];
         glUniform3f(uniforms.rootPositionUniform, rootPosition.x, rootPosition.y, rootPosition.z);
+        SCE::RenderStats::CountUniformCalls();
     }
 
     void UseShader(GLuint shaderProgram)
@@ -358,6 +363,7 @@ namespace ShaderUtils
 //        else
         {
             glUseProgram(shaderProgram);
+            SCE::RenderStats::CountProgramBind(shaderProgram);
         }
     }
 
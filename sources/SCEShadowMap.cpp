@@ -7,6 +7,8 @@
 #include "../headers/SCEShadowMap.hpp"
 #include "../headers/SCELighting.hpp"
 #include "../headers/SCETools.hpp"
+#include "../headers/SCERenderStats.hpp"
+#include "../headers/SCEMemory.hpp"
 
 using namespace SCE;
 using namespace std;
@@ -24,6 +26,7 @@ SCEShadowMap::~SCEShadowMap()
 {
     if(mDepthTexture != GL_INVALID_INDEX)
     {
+        SCE::Memory::UntrackGLTexture(mDepthTexture);
         glDeleteTextures(1, &mDepthTexture);
     }
 
@@ -46,6 +49,9 @@ bool SCEShadowMap::Init(GLuint shadowmapWidth, GLuint shadowmapHeight, GLuint ca
     //texture array creation
     glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT16,
                  shadowmapWidth, shadowmapHeight, cascadeCount, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+    SCE::Memory::TrackGLTexture(SCE::Memory::TAG_RENDER_TARGETS, mDepthTexture,
+                                SCE::Memory::ComputeTextureSize(shadowmapWidth, shadowmapHeight,
+                                                                cascadeCount, GL_DEPTH_COMPONENT16, false));
 
 #ifdef USE_PCF
     //to allow PCF shadows
@@ -79,6 +85,7 @@ bool SCEShadowMap::Init(GLuint shadowmapWidth, GLuint shadowmapHeight, GLuint ca
 void SCEShadowMap::BindForShadowPass(GLuint cascadeId)
 {
     glBindFramebuffer(GL_FRAMEBUFFER, mFBOId);
+    SCE::RenderStats::CountFramebufferBind(mFBOId);
     //bind the right level of the texture array
     glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, mDepthTexture, 0, cascadeId);
 }
@@ -89,6 +96,8 @@ void SCEShadowMap::BindTextureToLightShader(GLuint textureUnit)
     glBindTexture(GL_TEXTURE_2D_ARRAY, mDepthTexture);
     // Set the sampler uniform to the texture unit
     glUniform1i(SCELighting::GetShadowmapSamplerUniform(), textureUnit);
+    SCE::RenderStats::CountTextureBind();
+    SCE::RenderStats::CountUniformCalls();
 }
 
 
@@ -11,6 +11,7 @@
 #include "../headers/SCE_GBuffer.hpp"
 #include "../headers/SCEQuality.hpp"
 #include "../headers/SCEPostProcess.hpp"
+#include "../headers/SCEMemory.hpp"
 
 namespace SCE
 {
@@ -93,6 +94,10 @@ namespace SkyRenderer
         glBindTexture(GL_TEXTURE_2D, sunData.sunAndFlareTexture);
         glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16F, commonSkyData.renderWidth, commonSkyData.renderHeight,
                      0, GL_RG, GL_FLOAT, NULL);
+        SCE::Memory::TrackGLTexture(SCE::Memory::TAG_RENDER_TARGETS, sunData.sunAndFlareTexture,
+                                    SCE::Memory::ComputeTextureSize(commonSkyData.renderWidth,
+                                                                    commonSkyData.renderHeight, 1,
+                                                                    GL_RG16F, false));
         glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
         glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
@@ -106,6 +111,10 @@ namespace SkyRenderer
         glTexImage2D(GL_TEXTURE_2D, 0, SUN_SHAFT_TEXTURE_FORMAT,
                      commonSkyData.renderWidth, commonSkyData.renderHeight,
                      0, GL_RED, GL_FLOAT, NULL);
+        SCE::Memory::TrackGLTexture(SCE::Memory::TAG_RENDER_TARGETS, sunData.sunShaftTexture,
+                                    SCE::Memory::ComputeTextureSize(commonSkyData.renderWidth,
+                                                                    commonSkyData.renderHeight, 1,
+                                                                    SUN_SHAFT_TEXTURE_FORMAT, false));
         glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
         glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
@@ -212,9 +221,16 @@ namespace SkyRenderer
     {
         if(sunData.sunShaftTexture != GL_INVALID_INDEX)
         {
+            SCE::Memory::UntrackGLTexture(sunData.sunShaftTexture);
             glDeleteTextures(1, &(sunData.sunShaftTexture));
         }
 
+        if(sunData.sunAndFlareTexture != GL_INVALID_INDEX)
+        {
+            SCE::Memory::UntrackGLTexture(sunData.sunAndFlareTexture);
+            glDeleteTextures(1, &(sunData.sunAndFlareTexture));
+        }
+
         if(commonSkyData.fboId != GL_INVALID_INDEX)
         {
             glDeleteFramebuffers(1, &(commonSkyData.fboId));
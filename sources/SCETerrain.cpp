@@ -18,15 +18,23 @@
 #include "../headers/SCETerrainTrees.hpp"
 #include "../headers/SCEQuality.hpp"
 #include "../headers/SCEScene.hpp"
+#include "../headers/SCERenderStats.hpp"
+#include "../headers/SCEMemory.hpp"
+#include "../headers/SCEHeightmap.hpp"
+#include "../headers/SCEHeightmapCache.hpp"
+#include "../headers/SCEHeightPyramid.hpp"
+#include "../headers/SCETerrainQuadtree.hpp"
+#include "../headers/SCETerrainClipmap.hpp"
+#include "../headers/SCEHorizonMap.hpp"
+#include "../headers/SCEInternal.hpp"
+#include "../headers/SCELogger.hpp"
 
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/random.hpp>
+#include <algorithm>
 
 #define USE_STB_PERLIN 0
-#if USE_STB_PERLIN
-#define STB_PERLIN_IMPLEMENTATION
-#include <stb_perlin.h>
-#else
+#if !USE_STB_PERLIN
 #include "../headers/SCEPerlin.hpp"
 #endif
 
@@ -60,11 +68,22 @@
 //#define TERRAIN_TEXTURE_SIZE 2048
 //#define TERRAIN_TEXTURE_SIZE 512
 #define TEX_TILE_SIZE 2.0f
+//batched terrain queries are converted to texel space this many at a time, on the stack
+#define TERRAIN_QUERY_BATCH 256
 
 #define DISPLAY_TREES 1
+//reuse the heightmap generated by a previous run when its parameters didn't change
+#define USE_HEIGHTMAP_CACHE 1
 #define TERRAIN_FOLLOW_CAMERA 0
-
-//#define ISLAND_MODE
+//stream the terrain from a tiled heightfield, see sce_terrain_bake --import-dem
+#define TERRAIN_CLIPMAP 0
+#define TERRAIN_CLIPMAP_FILE ENGINE_RESSOURCE_PATH "Terrain/terrain.tiles"
+//horizon map for TERRAIN_HORIZON_SHADOW : quarter resolution, 8 azimuths, horizons up to 256 texels away
+#define HORIZON_MAP_DOWNSCALE 4
+#define HORIZON_DIRECTION_COUNT 8
+#define HORIZON_MAX_DISTANCE 256.0f
+#define HORIZON_MAP_FILE_PREFIX ENGINE_RESSOURCE_PATH "Terrain/horizon_"
+#define HORIZON_MAP_FILE_EXTENSION ".cache"
 
 namespace SCE
 {
@@ -86,6 +105,8 @@ namespace Terrain
             GLuint  dirtTexture;
             GLuint  snowTexture;
             GLuint  rockTexture;
+            //one RGBA8 layer per 4 horizon directions
+            GLuint  horizonTexture;
 
             GLint   terrainTextureUniform;
             GLint   maxTesselationDistanceUniform;
@@ -113,13 +134,15 @@ namespace Terrain
                 quadVertices[2] = glm::vec3(1.0f, 0.0f, 1.0f);
                 quadVertices[3] = glm::vec3(0.0f, 0.0f, 1.0f);
 
-                normalAndHeight = nullptr;
+                heightfield = nullptr;
             }
 
             //Terrain quad render data
             GLuint  quadVao;
             GLuint  quadVerticesVbo;
             GLuint  quadIndicesVbo;
+            //one vec4 per patch to draw : corner in xyz and size in w
+            GLuint  patchInstancesVbo;
 
             float terrainSize;
             float maxTesselationDist;
@@ -135,12 +158,20 @@ namespace Terrain
 
             TerrainGLData   glData;
 
-            glm::vec4 *normalAndHeight;
-            std::vector<glm::mat4> patchModelMatrices;
-            std::vector<glm::vec4> patchBoundingBoxCenters;
+            //Morton ordered, see Heightmap::CompactTexel
+            SCE::Heightmap::CompactTexel *heightfield;
+            //min/max heights over blocks of heightfield cells, for the ray casts
+            SCE::HeightPyramid::Pyramid heightPyramid;
+            //empty unless TERRAIN_HORIZON_SHADOW is on
+            SCE::HorizonMap::Map horizonMap;
+            SCE::TerrainQuadtree::Quadtree patchQuadtree;
+            //filled every frame by the quadtree selection
+            std::vector<glm::vec4> patchInstances;
 
             TerrainShadow terrainShadow;
             TerrainTrees terrainTrees;
+            //inactive unless a tiled heightfield was opened
+            TerrainClipmap terrainClipmap;
         };
 
  /*      File scope variables    */
@@ -150,13 +181,26 @@ namespace Terrain
         {
             if(terrainData->glData.terrainTexture != GL_INVALID_INDEX)
             {
+                SCE::Memory::UntrackGLTexture(terrainData->glData.terrainTexture);
                 glDeleteTextures(1, &(terrainData->glData.terrainTexture));
             }
 
+            if(terrainData->glData.horizonTexture != GL_INVALID_INDEX)
+            {
+                SCE::Memory::UntrackGLTexture(terrainData->glData.horizonTexture);
+                glDeleteTextures(1, &(terrainData->glData.horizonTexture));
+            }
+
+            SCE::Memory::UntrackGLBuffer(terrainData->quadIndicesVbo);
+            SCE::Memory::UntrackGLBuffer(terrainData->quadVerticesVbo);
+            SCE::Memory::UntrackGLBuffer(terrainData->patchInstancesVbo);
             glDeleteBuffers(1, &(terrainData->quadIndicesVbo));
             glDeleteBuffers(1, &(terrainData->quadVerticesVbo));
+            glDeleteBuffers(1, &(terrainData->patchInstancesVbo));
             glDeleteVertexArrays(1, &(terrainData->quadVao));
 
+            terrainData->terrainClipmap.Close();
+
             if(terrainData->glData.terrainProgram != GL_INVALID_INDEX)
             {
                 SCE::ShaderUtils::DeleteShaderProgram(terrainData->glData.terrainProgram);
@@ -183,194 +227,113 @@ namespace Terrain
             }
         }
 
-        void computeNormalsForQuad(int xCount, int zCount, glm::vec3 *normals, float* heightmap)
+        SCE::Heightmap::Heightfield getHeightfield()
         {
-            float terrainSize = terrainData->terrainSize;
-            float x, z;
-            float y1, y2, y3, y4;
-            float stepSize = terrainSize / float(TERRAIN_TEXTURE_SIZE);
-
-            x = float(xCount)*stepSize;
-            z = float(zCount)*stepSize;
-
-            int x0 = xCount;
-            int x1 = (xCount + 1)%TERRAIN_TEXTURE_SIZE;
-            int z0 = zCount;
-            int z1 = (zCount + 1)%TERRAIN_TEXTURE_SIZE;
-
-            y1 = heightmap[x0*TERRAIN_TEXTURE_SIZE + z0];
-            y2 = heightmap[x1*TERRAIN_TEXTURE_SIZE + z0];
-            y3 = heightmap[x0*TERRAIN_TEXTURE_SIZE + z1];
-            y4 = heightmap[x1*TERRAIN_TEXTURE_SIZE + z1];
-
-            glm::vec3 p1(x           , y1, z);
-            glm::vec3 p2(x + stepSize, y2, z);
-            glm::vec3 p3(x           , y3, z + stepSize);
-            glm::vec3 p4(x + stepSize, y4, z + stepSize);
-
-            glm::vec3 normal1 = cross(p3 - p1, p2 - p1);
-            glm::vec3 normal2 = cross(p2 - p4, p3 - p4);
-
-            //first is lower left corner
-            normals[(xCount*TERRAIN_TEXTURE_SIZE + zCount)*2] = normal1;
-            //second is upper right corner
-            normals[(xCount*TERRAIN_TEXTURE_SIZE + zCount)*2 + 1] = normal2;
-
-            /* following this pattern (le badass ascii art)
-            *     |\--|1
-            *     | \ |
-            *    0|__\|
-            */
-        }
-
-
-        //generate perlin noise texture
-        void initializeTerrain(float yPos, float startScale, float heightScale, int nbRepeat)
-        {
-            //8MB array, does not fit on stack so heap allocate it
-            float *heightmap = new float[TERRAIN_TEXTURE_SIZE*TERRAIN_TEXTURE_SIZE];
-            glm::vec3 *normals = new glm::vec3[TERRAIN_TEXTURE_SIZE*TERRAIN_TEXTURE_SIZE*2];
-            glm::vec4 *packedNormalAndHeight = new glm::vec4[TERRAIN_TEXTURE_SIZE*TERRAIN_TEXTURE_SIZE];
-
-            int nbLayers = 16;
-            float maxValue = 0.0f;
-            float amplitude = 1.0f;
-            float scale = 0.0f;
-            float exponentScaleFactor = 1.0f;
-            float noise = 0.0f;
-            float persistence = 0.3f;
-
-            float x, z;
-            float y = 0.0f;
-
-            float edgeChange = 1.0f;
-            float exponent = 1.0f;
-#ifdef ISLAND_MODE
-            float xDist, zDist;
-#endif            
-
-            //Fill terrain heightmap
-            for(int xCount = 0; xCount < TERRAIN_TEXTURE_SIZE; ++xCount)
-            {
-                x = float(xCount) / float(TERRAIN_TEXTURE_SIZE);
-                x += yPos;
-
-                for(int zCount = 0; zCount < TERRAIN_TEXTURE_SIZE; ++zCount)
-                {
-                     z = float(zCount) / float(TERRAIN_TEXTURE_SIZE);
-                     z += yPos;
-#ifdef ISLAND_MODE
-                    xDist = (0.5f - x);
-                    zDist = (0.5f - z);
-                    float distToCenter = sqrt(xDist*xDist + zDist*zDist);//min(xDist, zDist);
-                    edgeChange = SCE::Math::mapToRange(0.15f, 0.495f, 1.0f, 0.0f, distToCenter);
-                    //ease in-out
-                    edgeChange = 1.0f / (1.0f + exp(-(edgeChange - 0.5f)*8.0f));
-#endif
-                    noise = 0.0f;
-                    amplitude = 1.0f;
-                    scale = startScale;
-                    maxValue = 0.0f;
+            SCE::Heightmap::Heightfield heightfield;
+            heightfield.texels = terrainData->heightfield;
+            heightfield.size = TERRAIN_TEXTURE_SIZE;
+            heightfield.heightScale = terrainData->heightScale;
+            return heightfield;
+        }
 
-                    for(int l = 0; l < nbLayers; ++l)
-                    {
-                        //stb_perlin returns values between -0.6 & 0.6
-#if USE_STB_PERLIN
-                        float tmpNoise = stb_perlin_noise3(x*scale, y*scale, z*scale);
-                        tmpNoise = SCE::Math::MapToRange(-0.7f, 0.7f, 0.0f, 1.0f, tmpNoise);
-#else
-                        float tmpNoise = Perlin::GetPerlinAt(x*scale, z*scale,
-                                                             (scale));
-                        tmpNoise = SCE::Math::MapToRange(-0.5f, 0.5f, 0.0f, 1.0f, tmpNoise);
-
-                        float expScale = scale * exponentScaleFactor;
-                        exponent = Perlin::GetPerlinAt((x + 0.5f)*expScale, (z + 0.5f)*expScale,
-                                                       int(expScale));
-                        exponent = SCE::Math::MapToRange(-0.5f, 0.5f, 0.0f, 1.0f, exponent);
-#endif
-                        exponent = SCE::Math::MapToRange(0.5f, 1.0f, 0.0f, 1.0f, exponent);
-                        float k = 1.5f;
-                        exponent = glm::exp(k*exponent - k);
-                        exponent = glm::mix(exponent, 1.0f, 1.0f - pow(1.0f - (float)l/(float)nbLayers, 8.0f));
-                        tmpNoise *= exponent;
-//                        if(l == 0)
-//                        {
-//                            tmpNoise = glm::pow(tmpNoise, 5.0f);
-//                        }
-//                        else if(l == 1)
-//                        {
-//                            tmpNoise = glm::pow(tmpNoise, 3.5f);
-//                        }
-//                        tmpNoise = glm::pow(tmpNoise, 1.0f + 2.0f*(1.0f - float(l)/float(nbLayers)));
-                        noise += tmpNoise*amplitude;
-                        maxValue += amplitude;
-                        amplitude *= persistence*(0.75f + tmpNoise);
-                        scale *= 2.0f;
-                    }
+        //worldToTerrainCoord maps the terrain to [-1, 1], same texel space as the shaders' uvs
+        glm::vec2 worldToTexel(float x_worldspace, float z_worldspace)
+        {
+            const glm::mat4& toTerrain = terrainData->worldToTerrainCoord;
+            float x = toTerrain[0][0]*x_worldspace + toTerrain[2][0]*z_worldspace + toTerrain[3][0];
+            float z = toTerrain[0][2]*x_worldspace + toTerrain[2][2]*z_worldspace + toTerrain[3][2];
+            return (glm::vec2(x, z)*0.5f + 0.5f)*float(TERRAIN_TEXTURE_SIZE);
+        }
 
-                    float res = noise / maxValue;
-#ifdef ISLAND_MODE
-                    res = SCE::Math::mapToRange(0.4f, 1.0f, 0.0f, 1.0f, res);
-#else
-                    res = SCE::Math::MapToRange(0.0f, 1.0f, 0.0f, 1.0f, res);
-#endif
-                    heightmap[xCount*TERRAIN_TEXTURE_SIZE + zCount] = res*heightScale*edgeChange;
-                }
+        void worldToTexel(const float* x_worldspace, const float* z_worldspace,
+                          float* x_texelspace, float* z_texelspace, int count)
+        {
+            for(int i = 0; i < count; ++i)
+            {
+                glm::vec2 texelPos = worldToTexel(x_worldspace[i], z_worldspace[i]);
+                x_texelspace[i] = texelPos.x;
+                z_texelspace[i] = texelPos.y;
             }
+        }
 
-            //compute per face normal
-            for(int xCount = 0; xCount < TERRAIN_TEXTURE_SIZE ; ++xCount)
+        //heightfield space of the ray casts : x, z in texels, y above the terrain base
+        glm::vec3 worldToHeightfield(const glm::vec3& pos_worldspace)
+        {
+            glm::vec2 texelPos = worldToTexel(pos_worldspace.x, pos_worldspace.z);
+            return glm::vec3(texelPos.x, pos_worldspace.y - terrainData->baseHeight, texelPos.y);
+        }
+
+        glm::vec3 heightfieldToWorld(const glm::vec3& pos_heightfield)
+        {
+            float worldPerTexel = terrainData->terrainSize / float(TERRAIN_TEXTURE_SIZE);
+            return glm::vec3((pos_heightfield.x - 0.5f*TERRAIN_TEXTURE_SIZE)*worldPerTexel,
+                             pos_heightfield.y + terrainData->baseHeight,
+                             (pos_heightfield.z - 0.5f*TERRAIN_TEXTURE_SIZE)*worldPerTexel);
+        }
+
+        //read the streamed terrain, or load the perlin noise heightmap from the cache, or generate it
+        void initializeTerrain(const SCE::Heightmap::Params& params)
+        {
+            ui64 texelCount = TERRAIN_TEXTURE_SIZE*TERRAIN_TEXTURE_SIZE;
+            SCE::Heightmap::GPUTexel *texels = nullptr;
+            SCE::HeightmapCache::CachedHeightmap cachedHeightmap;
+            if(terrainData->terrainClipmap.IsActive())
             {
-                for(int zCount = 0; zCount < TERRAIN_TEXTURE_SIZE; ++zCount)
+                //the mip of the file with the size of the global texture, the clipmap adds the details
+                const SCE::TiledHeightfield::File& file = terrainData->terrainClipmap.GetFile();
+                ui32 level = 0;
+                while((file.size >> level) > TERRAIN_TEXTURE_SIZE)
                 {
-                    computeNormalsForQuad(xCount, zCount, normals, heightmap);
+                    ++level;
                 }
+                texels = new SCE::Heightmap::GPUTexel[TERRAIN_TEXTURE_SIZE*TERRAIN_TEXTURE_SIZE];
+                SCE::Memory::TrackAllocation(SCE::Memory::TAG_TERRAIN,
+                                             texelCount*sizeof(SCE::Heightmap::GPUTexel));
+                SCE::TiledHeightfield::ReadLevel(file, level, texels);
             }
-
-            int lookX, lookZ;
-            //compute smooth normals per vertex
-            for(int xCount = 0; xCount < TERRAIN_TEXTURE_SIZE ; ++xCount)
+#if USE_HEIGHTMAP_CACHE
+            std::string cacheFilename = SCE::HeightmapCache::GetCacheFilename(params.size);
+            ui64 paramsHash = SCE::Heightmap::HashParams(params);
+            if(!texels && SCE::HeightmapCache::Load(cacheFilename, paramsHash, params.size, cachedHeightmap))
             {
-                for(int zCount = 0; zCount < TERRAIN_TEXTURE_SIZE; ++zCount)
-                {
-                    glm::vec3 normalSum(0.0f);//normals[xCount*TERRAIN_TEXTURE_SIZE + zCount];
-
-                    //lower left tri
-                    if(xCount > 0 && zCount >0)
-                    {
-                        lookX = xCount - 1;
-                        lookZ = zCount - 1;
-                        normalSum += normals[(lookX*TERRAIN_TEXTURE_SIZE + lookZ)*2 + 1];
-                    }
-                    //upper right tri
-                    normalSum += normals[(xCount*TERRAIN_TEXTURE_SIZE + zCount)*2];
-                    //lower right tri
-                    if(zCount >0)
-                    {
-                        lookX = xCount;
-                        lookZ = zCount - 1;
-                        normalSum += normals[(lookX*TERRAIN_TEXTURE_SIZE + lookZ)*2];
-                        normalSum += normals[(lookX*TERRAIN_TEXTURE_SIZE + lookZ)*2 + 1];
-                    }
-                    //upper left tri
-                    if(xCount > 0)
-                    {
-                        lookX = xCount - 1;
-                        lookZ = zCount;
-                        normalSum += normals[(lookX*TERRAIN_TEXTURE_SIZE + lookZ)*2];
-                        normalSum += normals[(lookX*TERRAIN_TEXTURE_SIZE + lookZ)*2 + 1];
-                    }
-
-                    y = heightmap[xCount*TERRAIN_TEXTURE_SIZE + zCount];
-                    packedNormalAndHeight[xCount*TERRAIN_TEXTURE_SIZE + zCount] =
-                            glm::vec4(normalize(normalSum), y);
-                }
+                SCE_LOG_DEBUG(Logger::CAT_TERRAIN, "Terrain heightmap loaded from " + cacheFilename);
+                texels = cachedHeightmap.texels;
+            }
+#endif
+            if(!texels)
+            {
+                //8MB array, does not fit on stack so heap allocate it
+                float *heightmap = new float[TERRAIN_TEXTURE_SIZE*TERRAIN_TEXTURE_SIZE];
+                glm::vec4 *normalAndHeight = new glm::vec4[TERRAIN_TEXTURE_SIZE*TERRAIN_TEXTURE_SIZE];
+                texels = new SCE::Heightmap::GPUTexel[TERRAIN_TEXTURE_SIZE*TERRAIN_TEXTURE_SIZE];
+                ui64 generationBytes = texelCount*(sizeof(float) + sizeof(glm::vec4));
+                SCE::Memory::TrackAllocation(SCE::Memory::TAG_TERRAIN,
+                                             generationBytes + texelCount*sizeof(SCE::Heightmap::GPUTexel));
+
+                SCE::Heightmap::GenerateHeights(heightmap, TERRAIN_TEXTURE_SIZE, params.offset,
+                                                params.startScale, params.heightScale);
+                SCE::Heightmap::ComputeNormalsAndHeight(heightmap, TERRAIN_TEXTURE_SIZE, params.terrainSize,
+                                                        normalAndHeight);
+                SCE::Heightmap::PackGPUTexels(normalAndHeight, TERRAIN_TEXTURE_SIZE, params.heightScale,
+                                              texels);
+
+                delete[] heightmap;
+                delete[] normalAndHeight;
+                SCE::Memory::TrackDeallocation(SCE::Memory::TAG_TERRAIN, generationBytes);
+#if USE_HEIGHTMAP_CACHE
+                SCE::HeightmapCache::Save(cacheFilename, paramsHash, params.size, texels);
+#endif
             }
 
+            //normal and height, half the size of the RGBA32F version
             glGenTextures(1, &(terrainData->glData.terrainTexture));
             glBindTexture(GL_TEXTURE_2D, terrainData->glData.terrainTexture);
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, TERRAIN_TEXTURE_SIZE, TERRAIN_TEXTURE_SIZE, 0,
-                         GL_RGBA, GL_FLOAT, packedNormalAndHeight);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16, TERRAIN_TEXTURE_SIZE, TERRAIN_TEXTURE_SIZE, 0,
+                         GL_RGBA, GL_UNSIGNED_SHORT, texels);
+            SCE::Memory::TrackGLTexture(SCE::Memory::TAG_TERRAIN, terrainData->glData.terrainTexture,
+                                        SCE::Memory::ComputeTextureSize(TERRAIN_TEXTURE_SIZE,
+                                                                        TERRAIN_TEXTURE_SIZE, 1,
+                                                                        GL_RGBA16, false));
 
             glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
             glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
@@ -378,11 +341,25 @@ namespace Terrain
             glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
             glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 
-            //delete textures, except for the heightmap which is used at runtime
-            //and will be deleted in the cleanup function
-            delete[] normals;
-            delete[] heightmap;
-            terrainData->normalAndHeight = packedNormalAndHeight;
+            //keep a quarter size copy for the CPU queries, it is deleted in the cleanup function
+            terrainData->heightfield = new SCE::Heightmap::CompactTexel[TERRAIN_TEXTURE_SIZE*TERRAIN_TEXTURE_SIZE];
+            SCE::Memory::TrackAllocation(SCE::Memory::TAG_TERRAIN,
+                                         texelCount*sizeof(SCE::Heightmap::CompactTexel));
+            SCE::Heightmap::PackCompactTexels(texels, TERRAIN_TEXTURE_SIZE, terrainData->heightfield);
+            SCE::HeightPyramid::Build(getHeightfield(), terrainData->heightPyramid);
+            SCE::Memory::TrackAllocation(SCE::Memory::TAG_TERRAIN,
+                                         SCE::HeightPyramid::GetByteSize(terrainData->heightPyramid));
+
+            if(cachedHeightmap.mapping)
+            {
+                SCE::HeightmapCache::Release(cachedHeightmap);
+            }
+            else
+            {
+                delete[] texels;
+                SCE::Memory::TrackDeallocation(SCE::Memory::TAG_TERRAIN,
+                                               texelCount*sizeof(SCE::Heightmap::GPUTexel));
+            }
         }
 
         void initializeRenderData()
@@ -392,6 +369,7 @@ namespace Terrain
             GLuint terrainProgram = SCE::ShaderUtils::CreateShaderProgram(TERRAIN_SHADER_NAME);
 
              glData.terrainProgram = terrainProgram;
+            glData.horizonTexture = GL_INVALID_INDEX;
 
             glData.terrainTextureUniform = glGetUniformLocation(terrainProgram, TERRAIN_TEXTURE_UNIFORM);
             glData.grassTextureUniform = glGetUniformLocation(terrainProgram, GRASS_TEXTURE_UNIFORM);
@@ -410,6 +388,8 @@ namespace Terrain
             glData.patchSizeUniform =
                     glGetUniformLocation(terrainProgram, PATCH_SIZE_UNIFORM);
 
+            terrainData->terrainClipmap.InitRenderData(terrainProgram);
+
             glData.grassTexture = SCE::TextureUtils::LoadTexture(GRASS_TEX_FILE);
             glData.dirtTexture = SCE::TextureUtils::LoadTexture(DIRT_TEX_FILE);
             glData.snowTexture = SCE::TextureUtils::LoadTexture(SNOW_TEX_FILE);
@@ -420,13 +400,19 @@ namespace Terrain
             glBindBuffer(GL_ARRAY_BUFFER, terrainData->quadVerticesVbo);
             glBufferData(GL_ARRAY_BUFFER, sizeof(terrainData->quadVertices),
                          terrainData->quadVertices, GL_STATIC_DRAW);
+            SCE::Memory::TrackGLBuffer(SCE::Memory::TAG_TERRAIN, terrainData->quadVerticesVbo,
+                                       sizeof(terrainData->quadVertices));
             glBindBuffer(GL_ARRAY_BUFFER, 0);
             //indices buffer
             glGenBuffers(1, &(terrainData->quadIndicesVbo));
             glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, terrainData->quadIndicesVbo);
             glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(terrainData->quadPatchIndices),
                          terrainData->quadPatchIndices, GL_STATIC_DRAW);
+            SCE::Memory::TrackGLBuffer(SCE::Memory::TAG_TERRAIN, terrainData->quadIndicesVbo,
+                                       sizeof(terrainData->quadPatchIndices));
             glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+            //per patch buffer, filled before each draw
+            glGenBuffers(1, &(terrainData->patchInstancesVbo));
             //quad VAO creation
             glGenVertexArrays(1, &(terrainData->quadVao));
             glBindVertexArray(terrainData->quadVao);
@@ -438,26 +424,21 @@ namespace Terrain
             glEnableVertexAttribArray(vertexAttribLocation);
             glVertexAttribPointer(vertexAttribLocation, 3, GL_FLOAT, GL_FALSE, 0, 0);
 
+            glBindBuffer(GL_ARRAY_BUFFER, terrainData->patchInstancesVbo);
+            GLuint patchAttribLocation = glGetAttribLocation(terrainProgram,
+                                                             "patchPosition_worldspace");
+            glEnableVertexAttribArray(patchAttribLocation);
+            glVertexAttribPointer(patchAttribLocation, 4, GL_FLOAT, GL_FALSE, 0, 0);
+            glVertexAttribDivisor(patchAttribLocation, 1);
+
             glBindVertexArray(0);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
 
             // We work with 4 points per patch.
             glPatchParameteri(GL_PATCH_VERTICES, 4);
 
         }
 
-        void renderPatch(const glm::mat4& projectionMatrix,
-                         const glm::mat4& viewMatrix,
-                         const glm::mat4& modelMatrix)
-        {
-            //do the rendering
-            SCE::ShaderUtils::BindDefaultUniforms(terrainData->glData.terrainProgram, modelMatrix,
-                                                  viewMatrix, projectionMatrix);
-            glDrawElements(GL_PATCHES,
-                           4,//indices count
-                           GL_UNSIGNED_SHORT,
-                           0);
-        }
-
         void computeTerrainMatrices(glm::vec3 const& cameraPosition)
         {
             SCE::DebugText::LogMessage("Cam : " + std::to_string(cameraPosition.x)
@@ -476,39 +457,221 @@ namespace Terrain
             //                * glm::translate(mat4(1.0f), -terrainPosition_worldspace);
         }
 
-        //pre-compute model matrices for all patches
-        void initializePatchMatrices(int nbRepeat)
+#if TERRAIN_CLIPMAP
+        //the file replaces the generated heightmap, the terrain takes its size and heights
+        void openClipmap(const std::string& filename)
         {
-            float halfTerrainSize = terrainData->terrainSize*0.5f*float(nbRepeat);
+            TerrainClipmap& clipmap = terrainData->terrainClipmap;
+            if(!clipmap.Open(filename))
+            {
+                SCE_LOG_ERROR(Logger::CAT_TERRAIN, "Could not open the streamed terrain " + filename +
+                              ", generating it instead");
+                return;
+            }
+
+            const SCE::TiledHeightfield::File& file = clipmap.GetFile();
+            if(file.size < TERRAIN_TEXTURE_SIZE || file.tileSize > TERRAIN_TEXTURE_SIZE)
+            {
+                SCE_LOG_ERROR(Logger::CAT_TERRAIN, "The streamed terrain " + filename + " needs at least " +
+                              std::to_string(TERRAIN_TEXTURE_SIZE) + " texels and tiles of at most as many, "
+                              "generating it instead");
+                clipmap.Close();
+                return;
+            }
+
+            terrainData->terrainSize = float(file.size)*file.texelSpacing;
+            terrainData->heightScale = file.heightScale;
+            //the streamed levels do not wrap around
+            terrainData->nbRepeat = 1;
+            SCE_LOG_DEBUG(Logger::CAT_TERRAIN, "Terrain streamed from " + filename + ", " +
+                          std::to_string(file.size) + " texels");
+        }
+#endif
+
+#if TERRAIN_HORIZON_SHADOW
+        //the bake takes a few seconds at full quality, it is cached next to the heightmap
+        void initializeHorizonMap()
+        {
+            SCE::HorizonMap::Settings settings;
+            settings.size = glm::max(TERRAIN_TEXTURE_SIZE / HORIZON_MAP_DOWNSCALE, 1);
+            settings.directionCount = HORIZON_DIRECTION_COUNT;
+            settings.maxDistance = HORIZON_MAX_DISTANCE;
+            settings.texelSpacing = terrainData->terrainSize / float(TERRAIN_TEXTURE_SIZE);
+
+            SCE::HorizonMap::Map& map = terrainData->horizonMap;
+            std::string filename = HORIZON_MAP_FILE_PREFIX + std::to_string(settings.size) + HORIZON_MAP_FILE_EXTENSION;
+            ui64 hash = SCE::HorizonMap::Hash(getHeightfield(), settings);
+            if(SCE::HorizonMap::Load(filename, settings, hash, map))
+            {
+                SCE_LOG_DEBUG(Logger::CAT_TERRAIN, "Terrain horizon map loaded from " + filename);
+            }
+            else
+            {
+                SCE::HorizonMap::Bake(getHeightfield(), settings, map);
+                SCE::HorizonMap::Save(filename, hash, map);
+            }
+            SCE::Memory::TrackAllocation(SCE::Memory::TAG_TERRAIN, SCE::Memory::VectorBytes(map.texels));
+
+            GLsizei layerCount = GLsizei(SCE::HorizonMap::GetLayerCount(map));
+            glGenTextures(1, &(terrainData->glData.horizonTexture));
+            glBindTexture(GL_TEXTURE_2D_ARRAY, terrainData->glData.horizonTexture);
+            glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, settings.size, settings.size, layerCount, 0,
+                         GL_RGBA, GL_UNSIGNED_BYTE, map.texels.data());
+            SCE::Memory::TrackGLTexture(SCE::Memory::TAG_TERRAIN, terrainData->glData.horizonTexture,
+                                        SCE::Memory::ComputeTextureSize(settings.size, settings.size, layerCount,
+                                                                        GL_RGBA8, false));
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+        }
+
+        //uploads the horizons of rect, in map texels, every layer at once
+        void uploadHorizonRect(const SCE::TerrainBrush::TexelRect& rect)
+        {
+            const SCE::HorizonMap::Map& map = terrainData->horizonMap;
+            ui32 size = map.settings.size;
+            GLsizei layerCount = GLsizei(SCE::HorizonMap::GetLayerCount(map));
+            SCE::TerrainBrush::TexelRect parts[4];
+            ui32 partCount = SCE::TerrainBrush::SplitWrapped(rect, size, parts);
+
+            //straight from the map : x major rows of size texels, layers of size rows
+            glBindTexture(GL_TEXTURE_2D_ARRAY, terrainData->glData.horizonTexture);
+            glPixelStorei(GL_UNPACK_ROW_LENGTH, GLint(size));
+            glPixelStorei(GL_UNPACK_IMAGE_HEIGHT, GLint(size));
+            for(ui32 i = 0; i < partCount; ++i)
+            {
+                const SCE::TerrainBrush::TexelRect& part = parts[i];
+                const ui8* first = &map.texels[(ui64(part.minX)*size + ui64(part.minZ))*HORIZON_DIRECTIONS_PER_LAYER];
+                glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, part.minZ, part.minX, 0,
+                                part.maxZ - part.minZ + 1, part.maxX - part.minX + 1, layerCount,
+                                GL_RGBA, GL_UNSIGNED_BYTE, first);
+                SCE::RenderStats::CountBufferUpload(ui64(SCE::TerrainBrush::GetTexelCount(part))*
+                                                    HORIZON_DIRECTIONS_PER_LAYER*ui64(layerCount));
+            }
+            glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+            glPixelStorei(GL_UNPACK_IMAGE_HEIGHT, 0);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+        }
+#endif
+
+        //min and max worldspace heights of the patch with this corner, skirt included
+        glm::vec2 computePatchHeightRange(const glm::vec3& corner_worldspace)
+        {
+            //heights of all the texels under the patch, the pyramid handles the inner blocks
             float patchSize = terrainData->patchSize;
+            const TerrainClipmap& clipmap = terrainData->terrainClipmap;
+            SCE::HeightPyramid::HeightRange range;
+            if(clipmap.IsActive())
+            {
+                //the streamed levels are finer than the global heightmap
+                glm::vec2 minTexel = clipmap.WorldToTexel(corner_worldspace.x, corner_worldspace.z);
+                glm::vec2 maxTexel = clipmap.WorldToTexel(corner_worldspace.x + patchSize,
+                                                          corner_worldspace.z + patchSize);
+                range = SCE::TiledHeightfield::GetRange(clipmap.GetFile(), minTexel.x, minTexel.y,
+                                                        maxTexel.x, maxTexel.y);
+            }
+            else
+            {
+                glm::vec2 minTexel = worldToTexel(corner_worldspace.x, corner_worldspace.z);
+                glm::vec2 maxTexel = worldToTexel(corner_worldspace.x + patchSize,
+                                                  corner_worldspace.z + patchSize);
+                range = SCE::HeightPyramid::GetRange(getHeightfield(), terrainData->heightPyramid,
+                                                     minTexel.x, minTexel.y, maxTexel.x, maxTexel.y);
+            }
+            float toHeight = terrainData->heightScale / 65535.0f;
+            return glm::vec2(float(range.min)*toHeight, float(range.max)*toHeight) +
+                    glm::vec2(terrainData->baseHeight - TERRAIN_BOUNDS_SKIRT,
+                              terrainData->baseHeight + TERRAIN_BOUNDS_SKIRT);
+        }
 
-            terrainData->patchModelMatrices.reserve(int(terrainData->terrainSize/terrainData->patchSize));
+        //build the quadtree over the patch grid, covering nbRepeat x nbRepeat terrains
+        void initializePatchQuadtree(int nbRepeat)
+        {
+            float halfTerrainSize = terrainData->terrainSize*0.5f*float(nbRepeat);
+            float patchSize = terrainData->patchSize;
+            ui32 patchesPerSide = ui32(glm::round(2.0f*halfTerrainSize/patchSize));
+            glm::vec3 origin_worldspace(-halfTerrainSize, terrainData->baseHeight, -halfTerrainSize);
 
-            for(float x = -halfTerrainSize;
-                x < halfTerrainSize - terrainData->patchSize;
-                x += terrainData->patchSize)
+            std::vector<glm::vec2> patchHeightRanges(patchesPerSide*patchesPerSide);
+            for(ui32 x = 0; x < patchesPerSide; ++x)
             {
-                for(float z = -halfTerrainSize;
-                    z < halfTerrainSize - terrainData->patchSize;
-                    z += terrainData->patchSize)
+                for(ui32 z = 0; z < patchesPerSide; ++z)
                 {
-                    glm::vec3 pos_worldspace(x, terrainData->baseHeight, z);
+                    glm::vec3 corner_worldspace = origin_worldspace + glm::vec3(float(x), 0.0f, float(z))*patchSize;
+                    patchHeightRanges[x*patchesPerSide + z] = computePatchHeightRange(corner_worldspace);
+                }
+            }
 
-                    //Model to world matrix is concatenation of quad and terrain matrices
-                    glm::mat4 modelMatrix = glm::translate(mat4(1.0f), pos_worldspace) *
-                                            glm::scale(mat4(1.0f), glm::vec3(terrainData->patchSize));
+            SCE::TerrainQuadtree::Build(patchesPerSide, patchSize, origin_worldspace,
+                                        patchHeightRanges, terrainData->patchQuadtree);
+            SCE::Memory::TrackAllocation(SCE::Memory::TAG_TERRAIN,
+                                         SCE::Memory::VectorBytes(terrainData->patchQuadtree.nodes));
+        }
 
-                    pos_worldspace += glm::vec3(patchSize, patchSize, patchSize)*0.5f;
-                    float height = GetTerrainHeight(pos_worldspace);
-                    pos_worldspace.y = height;
+        //uploads the normals and heights of rect, which may wrap around the heightfield edges
+        void uploadTexelRect(const SCE::TerrainBrush::TexelRect& rect)
+        {
+            SCE::TerrainBrush::TexelRect parts[4];
+            ui32 partCount = SCE::TerrainBrush::SplitWrapped(rect, TERRAIN_TEXTURE_SIZE, parts);
+            std::vector<SCE::Heightmap::GPUTexel> texels;
+            glBindTexture(GL_TEXTURE_2D, terrainData->glData.terrainTexture);
+            for(ui32 i = 0; i < partCount; ++i)
+            {
+                const SCE::TerrainBrush::TexelRect& part = parts[i];
+                texels.resize(SCE::TerrainBrush::GetTexelCount(part));
+                SCE::TerrainBrush::UpdateNormals(terrainData->heightfield, TERRAIN_TEXTURE_SIZE,
+                                                 terrainData->terrainSize, terrainData->heightScale,
+                                                 part, texels.data());
+                //x major like the whole texture : x is the row, z the column
+                glTexSubImage2D(GL_TEXTURE_2D, 0, part.minZ, part.minX,
+                                part.maxZ - part.minZ + 1, part.maxX - part.minX + 1,
+                                GL_RGBA, GL_UNSIGNED_SHORT, texels.data());
+                SCE::RenderStats::CountBufferUpload(texels.size()*sizeof(SCE::Heightmap::GPUTexel));
+            }
+            glBindTexture(GL_TEXTURE_2D, 0);
+        }
+
+        //refits the patches and places the trees again over [min, max], in every repeat of the heightfield
+        void invalidateTerrainRegion(const glm::vec2& min_worldspace, const glm::vec2& max_worldspace)
+        {
+            SCE::TerrainQuadtree::Quadtree& tree = terrainData->patchQuadtree;
+            float terrainSize = terrainData->terrainSize;
+            float halfTerrainSize = terrainSize*0.5f*float(terrainData->nbRepeat);
+            glm::vec2 origin(tree.origin_worldspace.x, tree.origin_worldspace.z);
+            i32 lastPatch = i32(tree.patchesPerSide) - 1;
+            SCE::TerrainQuadtree::PatchHeightQuery getHeightRange = [&tree](ui32 x, ui32 z)
+            {
+                return computePatchHeightRange(tree.origin_worldspace +
+                                               glm::vec3(float(x), 0.0f, float(z))*tree.patchSize);
+            };
 
-                    terrainData->patchModelMatrices.push_back(modelMatrix);
-                    terrainData->patchBoundingBoxCenters.push_back(glm::vec4(pos_worldspace, 1.0));
+            for(int repeatX = -terrainData->nbRepeat; repeatX <= terrainData->nbRepeat; ++repeatX)
+            {
+                for(int repeatZ = -terrainData->nbRepeat; repeatZ <= terrainData->nbRepeat; ++repeatZ)
+                {
+                    glm::vec2 offset = glm::vec2(float(repeatX), float(repeatZ))*terrainSize;
+                    glm::vec2 min = glm::max(min_worldspace + offset, glm::vec2(-halfTerrainSize));
+                    glm::vec2 max = glm::min(max_worldspace + offset, glm::vec2(halfTerrainSize));
+                    if(min.x > max.x || min.y > max.y)
+                    {
+                        continue;
+                    }
+
+                    glm::ivec2 minPatch = glm::clamp(glm::ivec2(glm::floor((min - origin)/tree.patchSize)),
+                                                     glm::ivec2(0), glm::ivec2(lastPatch));
+                    glm::ivec2 maxPatch = glm::clamp(glm::ivec2(glm::floor((max - origin)/tree.patchSize)),
+                                                     glm::ivec2(0), glm::ivec2(lastPatch));
+                    SCE::TerrainQuadtree::UpdateHeightRanges(tree, ui32(minPatch.x), ui32(minPatch.y),
+                                                             ui32(maxPatch.x), ui32(maxPatch.y), getHeightRange);
+#if DISPLAY_TREES
+                    terrainData->terrainTrees.InvalidateRegion(min, max);
+#endif
                 }
             }
         }
 
-
     //end of anonymous namespace
     }
 
@@ -531,6 +694,9 @@ namespace Terrain
 
         computeTerrainMatrices(cameraPosition);
 
+        //the view works in scene space, the clipmap in worldspace
+        terrainData->terrainClipmap.Update(cameraPosition + SCEScene::GetFrameRootPosition());
+
 #if DISPLAY_TREES
 
         float maxDistFromCenter = halfTerrainSize*(float)terrainData->nbRepeat - patchSize * 0.5f;
@@ -561,7 +727,7 @@ namespace Terrain
         TerrainGLData& glData = terrainData->glData;        
 
         //setup gl state that is common for all patches
-        glUseProgram(glData.terrainProgram);
+        SCE::ShaderUtils::UseShader(glData.terrainProgram);
 
         //bind terrain textures
         SCE::TextureUtils::BindSafeTexture(glData.terrainTexture, 0, 0);//terrain height map is sampler 0
@@ -571,6 +737,7 @@ namespace Terrain
         SCE::TextureUtils::BindTexture(glData.rockTexture, 3, glData.rockTextureUniform);
 
         SCE::ShaderUtils::BindRootPosition(glData.terrainProgram, SCEScene::GetFrameRootPosition());
+        terrainData->terrainClipmap.BindUniforms(SCEScene::GetFrameRootPosition());
 
         //uniforms        
         glUniform1f(glData.maxTesselationDistanceUniform, terrainData->terrainSize);
@@ -581,53 +748,72 @@ namespace Terrain
 
         glUniformMatrix4fv(glData.worldToTerrainMatUniform, 1, GL_FALSE,
                            &(terrainData->worldToTerrainCoord[0][0]));
+        SCE::RenderStats::CountUniformCalls(6);
 
-        glBindVertexArray(terrainData->quadVao);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, terrainData->quadIndicesVbo);
-
-        float patchSize = terrainData->patchSize;
-
-        glm::vec4 R_cameraspace = viewMatrix*glm::vec4(patchSize, 0.0, 0.0, 0.0);
-        glm::vec4 S_cameraspace = viewMatrix*glm::vec4(0.0, patchSize, 0.0, 0.0);
-        glm::vec4 T_cameraspace = viewMatrix*glm::vec4(0.0, 0.0, patchSize, 0.0);
+        //patches are positionned by their instance data, the view works in scene space
+        SCE::ShaderUtils::BindDefaultUniforms(glData.terrainProgram, glm::mat4(1.0f),
+                                              viewMatrix, projectionMatrix);
 
-        uint patchCount = 0;
-        uint offscreenCount = 0;
-        glm::vec4 center_cameraspace;
-        glm::vec4 root_worldspace = glm::vec4(SCEScene::GetFrameRootPosition(), 0.0f);
-
-        for(uint i = 0; i < terrainData->patchModelMatrices.size(); ++i)
-        {
-            center_cameraspace = viewMatrix*
+        glm::vec3 root_worldspace = SCEScene::GetFrameRootPosition();
+        glm::mat4 worldToCamera = viewMatrix*glm::translate(mat4(1.0f), -root_worldspace);
+        glm::vec3 cameraPosition_worldspace =
+                glm::vec3(glm::inverse(worldToCamera)*glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
 #if TERRAIN_FOLLOW_CAMERA
-                    terrainData->terrainToWorldSpace*
-#endif
-                    (terrainData->patchBoundingBoxCenters[i] - root_worldspace);
-#if !TERRAIN_FOLLOW_CAMERA
-            // this can't work because the BB are initialize with a specific height
-            if(SCE::FrustrumCulling::IsBoxInFrustrum(center_cameraspace,
-                                                     R_cameraspace, S_cameraspace, T_cameraspace))
+        //the quadtree is built around the terrain origin, select in terrain space
+        worldToCamera = worldToCamera*terrainData->terrainToWorldSpace;
+        cameraPosition_worldspace -= glm::vec3(terrainData->terrainToWorldSpace[3]);
 #endif
-            {
-                renderPatch(projectionMatrix,
-                            viewMatrix,
+
+        //the TCS computes the tessellation from these same uniforms
+        SCE::TerrainQuadtree::LodSettings lod;
+        lod.maxTessDistance = terrainData->terrainSize;
+        lod.lodMultiplier = isShadowPass ? 32.0f : SCE::Quality::TerrainLodMultiplier;
+
+        std::vector<glm::vec4>& instances = terrainData->patchInstances;
+        instances.clear();
+        SCE::TerrainQuadtree::SelectionStats selectionStats;
+        SCE::TerrainQuadtree::SelectPatches(terrainData->patchQuadtree, worldToCamera,
+                                            cameraPosition_worldspace, lod, instances, selectionStats);
 #if TERRAIN_FOLLOW_CAMERA
-                            terrainData->terrainToWorldSpace *
-#endif
-                            terrainData->patchModelMatrices[i]);
-            }
-#if !TERRAIN_FOLLOW_CAMERA
-            else
+        for(glm::vec4& instance : instances)
+        {
+            instance += glm::vec4(glm::vec3(terrainData->terrainToWorldSpace[3]), 0.0f);
+        }
 #endif
-            {
-                ++offscreenCount;
-            }
-            ++patchCount;
+
+        if(!instances.empty())
+        {
+            ui64 instancesBytes = instances.size()*sizeof(glm::vec4);
+            glBindBuffer(GL_ARRAY_BUFFER, terrainData->patchInstancesVbo);
+            glBufferData(GL_ARRAY_BUFFER, instancesBytes, instances.data(), GL_STREAM_DRAW);
+            SCE::RenderStats::CountBufferUpload(instancesBytes);
+            SCE::Memory::TrackGLBuffer(SCE::Memory::TAG_TERRAIN, terrainData->patchInstancesVbo,
+                                       instancesBytes);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+            glBindVertexArray(terrainData->quadVao);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, terrainData->quadIndicesVbo);
+            glDrawElementsInstanced(GL_PATCHES,
+                                    4,//indices count
+                                    GL_UNSIGNED_SHORT,
+                                    0,
+                                    GLsizei(selectionStats.instanceCount));
+            SCE::RenderStats::CountInstancedDraw(GL_PATCHES, 4, selectionStats.instanceCount);
+            SCE::RenderStats::CountPatches(selectionStats.instanceCount);
         }
 
+        SCE::RenderStats::CountVisibility(selectionStats.drawnPatches, selectionStats.culledPatches);
+
         SCE::DebugText::LogMessage("Rendering terrain");
-        SCE::DebugText::LogMessage("Patches rendered : " + std::to_string(patchCount));
-        SCE::DebugText::LogMessage("Patches offscreen : " + std::to_string(offscreenCount));
+        SCE::DebugText::LogMessage("Patches rendered : " + std::to_string(selectionStats.drawnPatches) +
+                                   " in " + std::to_string(selectionStats.instanceCount) + " instances");
+        SCE::DebugText::LogMessage("Patches offscreen : " + std::to_string(selectionStats.culledPatches));
+        SCE::DebugText::LogMessage("Quadtree nodes visited : " + std::to_string(selectionStats.visitedNodes));
+        if(terrainData->terrainClipmap.IsActive())
+        {
+            SCE::DebugText::LogMessage("Clipmap pages pending : " +
+                                       std::to_string(terrainData->terrainClipmap.GetPendingPageCount()));
+        }
 
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
         glBindVertexArray(0);
@@ -666,7 +852,10 @@ namespace Terrain
         terrainData->terrainShadow.RenderShadow(projectionMatrix, viewMatrix,
                                                 sunPosition, gbuffer, terrainData->worldToTerrainCoord,
                                                 terrainData->glData.terrainTexture,
-                                                terrainData->heightScale);
+                                                terrainData->heightScale,
+                                                terrainData->glData.horizonTexture,
+                                                terrainData->horizonMap.texels.empty() ? 0 :
+                                                GLint(terrainData->horizonMap.settings.directionCount));
 
         glEnable(GL_DEPTH_TEST);
         glDepthMask(GL_TRUE);
@@ -676,30 +865,38 @@ namespace Terrain
     {
         if(!terrainData)
         {
+            //compute the actual terrain size we will cover with patches
+            SCE::Heightmap::Params heightmapParams =
+                    SCE::Heightmap::GetTerrainParams(terrainSize, patchSize, TERRAIN_TEXTURE_SIZE);
+            terrainSize = heightmapParams.terrainSize;
+
 #if !USE_STB_PERLIN
-            Perlin::MakePerlin(TERRAIN_TEXTURE_SIZE);
+            Perlin::MakePerlin(TERRAIN_TEXTURE_SIZE, heightmapParams.seed);
 #endif
 
-            //compute the actual terrain size we will cover with patches
-            terrainSize = floor(terrainSize/patchSize)*patchSize;
-
             terrainData = new TerrainData();
             terrainData->terrainSize = terrainSize;
             terrainData->patchSize = patchSize;
             terrainData->baseHeight = terrainBaseHeight;
-            terrainData->heightScale = 10000.0f;//max height in meter
+            terrainData->heightScale = heightmapParams.heightScale;
             terrainData->maxTesselationDist = maxTessDist;
             terrainData->nbRepeat = nbRepeat;
 
+#if TERRAIN_CLIPMAP
+            openClipmap(TERRAIN_CLIPMAP_FILE);
+            nbRepeat = terrainData->nbRepeat;
+#endif
             initializeRenderData();
-            float yPos = 0.0;//SCE::Math::RandRange(0.0f, 1.0f);
-            float scale = 1.0f*(terrainSize/9000.0f);
-            scale = glm::pow(2.0f, glm::ceil(glm::log2(scale)));
-            initializeTerrain(yPos, scale, terrainData->heightScale, nbRepeat);
+            float yPos = heightmapParams.offset;
+            float scale = heightmapParams.startScale;
+            initializeTerrain(heightmapParams);
 
             computeTerrainMatrices(vec3(0.0f));
 
-            initializePatchMatrices(nbRepeat);
+            initializePatchQuadtree(nbRepeat);
+#if TERRAIN_HORIZON_SHADOW
+            initializeHorizonMap();
+#endif
 
 #if DISPLAY_TREES
             terrainData->terrainTrees.InitializeTreeLayout(yPos, yPos,
@@ -717,46 +914,186 @@ namespace Terrain
             Perlin::DestroyPerlin();
 #endif
             cleanupGLData();
-            if(terrainData->normalAndHeight != nullptr)
+            if(terrainData->heightfield != nullptr)
             {
-                delete[] terrainData->normalAndHeight;
+                delete[] terrainData->heightfield;
+                SCE::Memory::TrackDeallocation(SCE::Memory::TAG_TERRAIN, TERRAIN_TEXTURE_SIZE*TERRAIN_TEXTURE_SIZE*
+                                               sizeof(SCE::Heightmap::CompactTexel));
             }
+            SCE::Memory::TrackDeallocation(SCE::Memory::TAG_TERRAIN,
+                                           SCE::HeightPyramid::GetByteSize(terrainData->heightPyramid));
+            SCE::Memory::TrackDeallocation(SCE::Memory::TAG_TERRAIN,
+                                           SCE::Memory::VectorBytes(terrainData->patchQuadtree.nodes));
+            SCE::Memory::TrackDeallocation(SCE::Memory::TAG_TERRAIN,
+                                           SCE::Memory::VectorBytes(terrainData->horizonMap.texels));
             delete terrainData;
             terrainData = nullptr;
         }
     }
 
     float GetTerrainHeight(const vec3& pos_worldspace)
+    {
+        return SampleTerrainHeight(pos_worldspace, SCE::Heightmap::FILTER_BILINEAR);
+    }
+
+    glm::vec3 GetTerrainNormal(const vec3& pos_worldspace)
+    {
+        return SampleTerrainNormal(pos_worldspace, SCE::Heightmap::FILTER_BILINEAR);
+    }
+
+    float SampleTerrainHeight(const vec3& pos_worldspace, SCE::Heightmap::Filter filter)
     {
         if(terrainData)
         {
-            glm::vec4 pos_terrainSpace = terrainData->worldToTerrainCoord*glm::vec4(pos_worldspace, 1.0);
-            int x = int((pos_terrainSpace.x*0.5f + 0.5f)*TERRAIN_TEXTURE_SIZE);
-            int z = int((pos_terrainSpace.z*0.5f + 0.5f)*TERRAIN_TEXTURE_SIZE);
-            while(x < 0) { x += TERRAIN_TEXTURE_SIZE; }
-            while(z < 0) { z += TERRAIN_TEXTURE_SIZE; }
-            x = x%TERRAIN_TEXTURE_SIZE;
-            z = z%TERRAIN_TEXTURE_SIZE;
-            return terrainData->normalAndHeight[x*TERRAIN_TEXTURE_SIZE + z].a + terrainData->baseHeight;
+            glm::vec2 texelPos = worldToTexel(pos_worldspace.x, pos_worldspace.z);
+            return SCE::Heightmap::SampleHeight(getHeightfield(), texelPos.x, texelPos.y, filter)
+                    + terrainData->baseHeight;
         }
         return 0.0f;
     }
 
-    glm::vec3 GetTerrainNormal(const vec3& pos_worldspace)
+    glm::vec3 SampleTerrainNormal(const vec3& pos_worldspace, SCE::Heightmap::Filter filter)
     {
         if(terrainData)
         {
-            glm::vec4 pos_terrainSpace = terrainData->worldToTerrainCoord*glm::vec4(pos_worldspace, 1.0);
-            int x = int((pos_terrainSpace.x*0.5f + 0.5f)*TERRAIN_TEXTURE_SIZE);
-            int z = int((pos_terrainSpace.z*0.5f + 0.5f)*TERRAIN_TEXTURE_SIZE);
-            while(x < 0) { x += TERRAIN_TEXTURE_SIZE; }
-            while(z < 0) { z += TERRAIN_TEXTURE_SIZE; }
-            x = x%TERRAIN_TEXTURE_SIZE;
-            z = z%TERRAIN_TEXTURE_SIZE;
-            return glm::vec3( terrainData->normalAndHeight[x*TERRAIN_TEXTURE_SIZE + z] );
+            glm::vec2 texelPos = worldToTexel(pos_worldspace.x, pos_worldspace.z);
+            return SCE::Heightmap::SampleNormal(getHeightfield(), texelPos.x, texelPos.y, filter);
         }
         return glm::vec3(0.0f, 1.0f, 0.0f);
     }
+
+    void GetTerrainHeights(const float* x_worldspace, const float* z_worldspace, float* heights,
+                           int count, SCE::Heightmap::Filter filter)
+    {
+        if(!terrainData)
+        {
+            std::fill(heights, heights + count, 0.0f);
+            return;
+        }
+
+        SCE::Heightmap::Heightfield heightfield = getHeightfield();
+        float x_texelspace[TERRAIN_QUERY_BATCH];
+        float z_texelspace[TERRAIN_QUERY_BATCH];
+        for(int start = 0; start < count; start += TERRAIN_QUERY_BATCH)
+        {
+            int batchCount = glm::min(count - start, TERRAIN_QUERY_BATCH);
+            worldToTexel(x_worldspace + start, z_worldspace + start, x_texelspace, z_texelspace, batchCount);
+            SCE::Heightmap::SampleHeights(heightfield, x_texelspace, z_texelspace,
+                                          heights + start, batchCount, filter);
+            for(int i = start; i < start + batchCount; ++i)
+            {
+                heights[i] += terrainData->baseHeight;
+            }
+        }
+    }
+
+    bool RaycastTerrain(const vec3& origin_worldspace, const vec3& direction_worldspace,
+                        float maxDistance, SCE::HeightPyramid::RayHit& hit)
+    {
+        hit = SCE::HeightPyramid::RayHit();
+        if(!terrainData)
+        {
+            return false;
+        }
+
+        //with a unit direction, distances along the ray are the same in both spaces
+        glm::vec3 origin = worldToHeightfield(origin_worldspace);
+        glm::vec3 direction = worldToHeightfield(origin_worldspace + glm::normalize(direction_worldspace)) - origin;
+        if(SCE::HeightPyramid::RayCast(getHeightfield(), terrainData->heightPyramid,
+                                       origin, direction, maxDistance, hit))
+        {
+            hit.position = heightfieldToWorld(hit.position);
+        }
+        return hit.hasHit;
+    }
+
+    void IntersectTerrainSegments(const vec3* starts_worldspace, const vec3* ends_worldspace,
+                                  SCE::HeightPyramid::RayHit* hits, int count)
+    {
+        if(!terrainData)
+        {
+            std::fill(hits, hits + count, SCE::HeightPyramid::RayHit());
+            return;
+        }
+
+        std::vector<glm::vec3> starts(count);
+        std::vector<glm::vec3> ends(count);
+        for(int i = 0; i < count; ++i)
+        {
+            starts[i] = worldToHeightfield(starts_worldspace[i]);
+            ends[i] = worldToHeightfield(ends_worldspace[i]);
+        }
+        SCE::HeightPyramid::IntersectSegments(getHeightfield(), terrainData->heightPyramid,
+                                              starts.data(), ends.data(), hits, count);
+        for(int i = 0; i < count; ++i)
+        {
+            if(hits[i].hasHit)
+            {
+                hits[i].position = heightfieldToWorld(hits[i].position);
+                hits[i].distance *= glm::length(ends_worldspace[i] - starts_worldspace[i]);
+            }
+        }
+    }
+
+    void DeformTerrain(const SCE::TerrainBrush::Brush& brush_worldspace)
+    {
+        if(!terrainData)
+        {
+            return;
+        }
+        if(terrainData->terrainClipmap.IsActive())
+        {
+            SCE_LOG_ERROR(Logger::CAT_TERRAIN, "Streamed terrains can't be deformed");
+            return;
+        }
+
+        //the tree worker samples the heights we are about to change
+        terrainData->terrainTrees.WaitForUpdate();
+
+        float worldPerTexel = terrainData->terrainSize / float(TERRAIN_TEXTURE_SIZE);
+        SCE::TerrainBrush::Brush brush = brush_worldspace;
+        brush.start = worldToHeightfield(brush_worldspace.start);
+        brush.end = worldToHeightfield(brush_worldspace.end);
+        brush.radius = brush_worldspace.radius / worldPerTexel;
+
+        SCE::TerrainBrush::ApplyBrush(terrainData->heightfield, TERRAIN_TEXTURE_SIZE,
+                                      terrainData->heightScale, brush);
+        SCE::TerrainBrush::TexelRect heightsRect = SCE::TerrainBrush::GetBrushRect(brush, TERRAIN_TEXTURE_SIZE);
+        SCE::TerrainBrush::TexelRect normalsRect = SCE::TerrainBrush::GetNormalsRect(heightsRect,
+                                                                                     TERRAIN_TEXTURE_SIZE);
+        uploadTexelRect(normalsRect);
+        SCE::HeightPyramid::UpdateRegion(getHeightfield(), terrainData->heightPyramid,
+                                         heightsRect.minX, heightsRect.minZ, heightsRect.maxX, heightsRect.maxZ);
+#if TERRAIN_HORIZON_SHADOW
+        uploadHorizonRect(SCE::HorizonMap::UpdateRegion(getHeightfield(), terrainData->horizonMap, heightsRect));
+#endif
+
+        //a texel of margin : the bilinear surface and the patch ranges also read the neighbour texels
+        glm::vec3 min = heightfieldToWorld(glm::vec3(float(normalsRect.minX - 1), 0.0f, float(normalsRect.minZ - 1)));
+        glm::vec3 max = heightfieldToWorld(glm::vec3(float(normalsRect.maxX + 2), 0.0f, float(normalsRect.maxZ + 2)));
+        invalidateTerrainRegion(glm::vec2(min.x, min.z), glm::vec2(max.x, max.z));
+    }
+
+    void GetTerrainNormals(const float* x_worldspace, const float* z_worldspace, glm::vec3* normals,
+                           int count, SCE::Heightmap::Filter filter)
+    {
+        if(!terrainData)
+        {
+            std::fill(normals, normals + count, glm::vec3(0.0f, 1.0f, 0.0f));
+            return;
+        }
+
+        SCE::Heightmap::Heightfield heightfield = getHeightfield();
+        float x_texelspace[TERRAIN_QUERY_BATCH];
+        float z_texelspace[TERRAIN_QUERY_BATCH];
+        for(int start = 0; start < count; start += TERRAIN_QUERY_BATCH)
+        {
+            int batchCount = glm::min(count - start, TERRAIN_QUERY_BATCH);
+            worldToTexel(x_worldspace + start, z_worldspace + start, x_texelspace, z_texelspace, batchCount);
+            SCE::Heightmap::SampleNormals(heightfield, x_texelspace, z_texelspace,
+                                          normals + start, batchCount, filter);
+        }
+    }
 }
 
 }
@@ -0,0 +1,251 @@
+/******PROJECT:Sand Castle Engine******/
+/**************************************/
+/*********AUTHOR:Gwenn AUBERT**********/
+/*******FILE:SCETerrainBrush.cpp*******/
+/**************************************/
+
+#include "../headers/SCETerrainBrush.hpp"
+#include "../headers/SCETools.hpp"
+
+#include <glm/gtc/constants.hpp>
+
+//crater profile : bowl up to this fraction of the radius, rim after it
+#define CRATER_BOWL_RATIO 0.7f
+//rim height, relative to the crater depth
+#define CRATER_RIM_HEIGHT 0.2f
+
+namespace SCE
+{
+
+namespace TerrainBrush
+{
+
+    namespace
+    {
+        inline Heightmap::CompactTexel& texelAt(Heightmap::CompactTexel* texels, ui32 size, i32 x, i32 z)
+        {
+            ui32 mask = size - 1;
+            return texels[Heightmap::MortonIndex(ui32(x) & mask, ui32(z) & mask)];
+        }
+
+        inline float heightAt(const Heightmap::CompactTexel* texels, ui32 size, float toHeight, i32 x, i32 z)
+        {
+            ui32 mask = size - 1;
+            return float(texels[Heightmap::MortonIndex(ui32(x) & mask, ui32(z) & mask)].height)*toHeight;
+        }
+
+        //1 inside, smooth fade to 0 over the falloff
+        float brushWeight(const Brush& brush, float distance)
+        {
+            float inner = brush.radius*(1.0f - glm::clamp(brush.falloff, 0.0f, 1.0f));
+            if(distance >= brush.radius)
+            {
+                return 0.0f;
+            }
+            if(distance <= inner)
+            {
+                return 1.0f;
+            }
+            float t = (brush.radius - distance)/(brush.radius - inner);
+            return t*t*(3.0f - 2.0f*t);
+        }
+
+        float craterOffset(const Brush& brush, float distance)
+        {
+            float t = distance/brush.radius;
+            if(t >= 1.0f)
+            {
+                return 0.0f;
+            }
+            if(t < CRATER_BOWL_RATIO)
+            {
+                float bowl = t/CRATER_BOWL_RATIO;
+                return -brush.strength*(1.0f - bowl*bowl);
+            }
+            float rim = (t - CRATER_BOWL_RATIO)/(1.0f - CRATER_BOWL_RATIO);
+            return brush.strength*CRATER_RIM_HEIGHT*glm::sin(rim*glm::pi<float>());
+        }
+
+        //new height of a texel centered on position
+        float brushHeight(const Brush& brush, const glm::vec2& position, float height)
+        {
+            glm::vec2 start(brush.start.x, brush.start.z);
+            switch(brush.type)
+            {
+            case BRUSH_RAISE :
+                return height + brush.strength*brushWeight(brush, glm::length(position - start));
+            case BRUSH_CRATER :
+                return height + craterOffset(brush, glm::length(position - start));
+            case BRUSH_FLATTEN :
+                return glm::mix(height, brush.start.y,
+                                glm::clamp(brush.strength, 0.0f, 1.0f)*brushWeight(brush, glm::length(position - start)));
+            case BRUSH_ROAD :
+            {
+                glm::vec2 segment = glm::vec2(brush.end.x, brush.end.z) - start;
+                float lengthSquared = glm::dot(segment, segment);
+                float along = lengthSquared > 0.0f ?
+                            glm::clamp(glm::dot(position - start, segment)/lengthSquared, 0.0f, 1.0f) : 0.0f;
+                float distance = glm::length(position - (start + segment*along));
+                float target = glm::mix(brush.start.y, brush.end.y, along);
+                return glm::mix(height, target, glm::clamp(brush.strength, 0.0f, 1.0f)*brushWeight(brush, distance));
+            }
+            default :
+                return height;
+            }
+        }
+
+        //same faces as computeNormalsForQuad in SCEHeightmap.cpp, of the quad between texels
+        //(x, z) and (x + 1, z + 1) : lower left triangle in first, upper right one in second
+        void quadNormals(const Heightmap::CompactTexel* texels, ui32 size, float toHeight, float stepSize,
+                         i32 x, i32 z, glm::vec3& lowerLeft, glm::vec3& upperRight)
+        {
+            glm::vec3 p1(0.0f, heightAt(texels, size, toHeight, x, z), 0.0f);
+            glm::vec3 p2(stepSize, heightAt(texels, size, toHeight, x + 1, z), 0.0f);
+            glm::vec3 p3(0.0f, heightAt(texels, size, toHeight, x, z + 1), stepSize);
+            glm::vec3 p4(stepSize, heightAt(texels, size, toHeight, x + 1, z + 1), stepSize);
+            lowerLeft = glm::cross(p3 - p1, p2 - p1);
+            upperRight = glm::cross(p2 - p4, p3 - p4);
+        }
+
+        //x and z in [0, size[ : the smoothing doesn't wrap on the first row and column, like smoothNormalRows
+        glm::vec3 smoothNormal(const Heightmap::CompactTexel* texels, ui32 size, float toHeight, float stepSize,
+                               i32 x, i32 z)
+        {
+            glm::vec3 lowerLeft, upperRight;
+            quadNormals(texels, size, toHeight, stepSize, x, z, lowerLeft, upperRight);
+            glm::vec3 normalSum = lowerLeft;
+            if(x > 0 && z > 0)
+            {
+                quadNormals(texels, size, toHeight, stepSize, x - 1, z - 1, lowerLeft, upperRight);
+                normalSum += upperRight;
+            }
+            if(z > 0)
+            {
+                quadNormals(texels, size, toHeight, stepSize, x, z - 1, lowerLeft, upperRight);
+                normalSum += lowerLeft + upperRight;
+            }
+            if(x > 0)
+            {
+                quadNormals(texels, size, toHeight, stepSize, x - 1, z, lowerLeft, upperRight);
+                normalSum += lowerLeft + upperRight;
+            }
+            return glm::normalize(normalSum);
+        }
+
+        //splits [min, max] along one axis, returns the number of spans
+        ui32 splitAxis(i32 min, i32 max, ui32 size, i32 spanMin[2], i32 spanMax[2])
+        {
+            i32 begin = i32(((i64(min) % i64(size)) + i64(size)) % i64(size));
+            i32 end = begin + (max - min);
+            if(end < i32(size))
+            {
+                spanMin[0] = begin;
+                spanMax[0] = end;
+                return 1;
+            }
+            spanMin[0] = begin;
+            spanMax[0] = i32(size) - 1;
+            spanMin[1] = 0;
+            spanMax[1] = end - i32(size);
+            return 2;
+        }
+
+        //keeps the rect at most one heightfield wide, so no texel is edited twice
+        TexelRect clampToSize(const TexelRect& rect, ui32 size)
+        {
+            TexelRect clamped = rect;
+            clamped.maxX = glm::min(clamped.maxX, clamped.minX + i32(size) - 1);
+            clamped.maxZ = glm::min(clamped.maxZ, clamped.minZ + i32(size) - 1);
+            return clamped;
+        }
+    }
+
+    TexelRect GetBrushRect(const Brush& brush, ui32 size)
+    {
+        glm::vec2 min = glm::vec2(brush.start.x, brush.start.z);
+        glm::vec2 max = min;
+        if(brush.type == BRUSH_ROAD)
+        {
+            min = glm::min(min, glm::vec2(brush.end.x, brush.end.z));
+            max = glm::max(max, glm::vec2(brush.end.x, brush.end.z));
+        }
+        //texel centers are at + 0.5
+        min -= brush.radius + 0.5f;
+        max += brush.radius - 0.5f;
+        TexelRect rect = { i32(glm::floor(min.x)), i32(glm::floor(min.y)),
+                           i32(glm::ceil(max.x)), i32(glm::ceil(max.y)) };
+        return clampToSize(rect, size);
+    }
+
+    TexelRect GetNormalsRect(const TexelRect& heightsRect, ui32 size)
+    {
+        TexelRect rect = { heightsRect.minX - 1, heightsRect.minZ - 1, heightsRect.maxX + 1, heightsRect.maxZ + 1 };
+        return clampToSize(rect, size);
+    }
+
+    void ApplyBrush(Heightmap::CompactTexel* texels, ui32 size, float heightScale, const Brush& brush)
+    {
+        Debug::Assert(size > 0 && (size & (size - 1)) == 0, "Brushes need a power of two heightfield");
+        if(brush.radius <= 0.0f)
+        {
+            return;
+        }
+
+        TexelRect rect = GetBrushRect(brush, size);
+        float toHeight = heightScale/65535.0f;
+        for(i32 x = rect.minX; x <= rect.maxX; ++x)
+        {
+            for(i32 z = rect.minZ; z <= rect.maxZ; ++z)
+            {
+                Heightmap::CompactTexel& texel = texelAt(texels, size, x, z);
+                float height = brushHeight(brush, glm::vec2(float(x) + 0.5f, float(z) + 0.5f),
+                                           float(texel.height)*toHeight);
+                texel.height = ui16(glm::clamp(height/heightScale, 0.0f, 1.0f)*65535.0f + 0.5f);
+            }
+        }
+    }
+
+    void UpdateNormals(Heightmap::CompactTexel* texels, ui32 size, float terrainSize, float heightScale,
+                       const TexelRect& rect, Heightmap::GPUTexel* gpuTexels)
+    {
+        float toHeight = heightScale/65535.0f;
+        float stepSize = terrainSize/float(size);
+        ui32 mask = size - 1;
+        i32 rowSize = rect.maxZ - rect.minZ + 1;
+        for(i32 x = rect.minX; x <= rect.maxX; ++x)
+        {
+            for(i32 z = rect.minZ; z <= rect.maxZ; ++z)
+            {
+                i32 wrappedX = i32(ui32(x) & mask);
+                i32 wrappedZ = i32(ui32(z) & mask);
+                Heightmap::CompactTexel& texel = texelAt(texels, size, x, z);
+                glm::vec3 normal = smoothNormal(texels, size, toHeight, stepSize, wrappedX, wrappedZ);
+
+                //keep the exact raw height, the packing would round it through a float
+                Heightmap::GPUTexel gpuTexel = Heightmap::PackGPUTexel(normal, 0.0f, heightScale);
+                gpuTexel.height = texel.height;
+                texel = Heightmap::PackCompactTexel(gpuTexel);
+                gpuTexels[(x - rect.minX)*rowSize + z - rect.minZ] = gpuTexel;
+            }
+        }
+    }
+
+    ui32 SplitWrapped(const TexelRect& rect, ui32 size, TexelRect wrapped[4])
+    {
+        i32 minX[2], maxX[2], minZ[2], maxZ[2];
+        ui32 xCount = splitAxis(rect.minX, rect.maxX, size, minX, maxX);
+        ui32 zCount = splitAxis(rect.minZ, rect.maxZ, size, minZ, maxZ);
+        ui32 count = 0;
+        for(ui32 i = 0; i < xCount; ++i)
+        {
+            for(ui32 j = 0; j < zCount; ++j)
+            {
+                TexelRect part = { minX[i], minZ[j], maxX[i], maxZ[j] };
+                wrapped[count++] = part;
+            }
+        }
+        return count;
+    }
+}
+
+}
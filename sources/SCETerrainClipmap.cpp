@@ -0,0 +1,184 @@
+/******PROJECT:Sand Castle Engine******/
+/**************************************/
+/*********AUTHOR:Gwenn AUBERT**********/
+/******FILE:SCETerrainClipmap.cpp******/
+/**************************************/
+
+#include "../headers/SCETerrainClipmap.hpp"
+#include "../headers/SCEMemory.hpp"
+#include "../headers/SCERenderStats.hpp"
+#include "../headers/SCETools.hpp"
+
+#define CLIPMAP_LEVEL_COUNT 6
+#define CLIPMAP_TILES_PER_LEVEL 4
+//uploads per frame, a 256x256 tile is 512KB
+#define CLIPMAP_PAGES_PER_FRAME 4
+
+SCE::TerrainClipmap::TerrainClipmap()
+    : mTexture(GL_INVALID_INDEX), mTexturesUniform(-1), mLevelCountUniform(-1),
+      mLevelUvUniform(-1), mLevelBoundsUniform(-1)
+{
+}
+
+SCE::TerrainClipmap::~TerrainClipmap()
+{
+    Close();
+}
+
+bool SCE::TerrainClipmap::Open(const std::string& filename)
+{
+    if(!SCE::TiledHeightfield::Open(filename, mFile))
+    {
+        return false;
+    }
+
+    Clipmap::Settings settings;
+    settings.levelCount = glm::min(ui32(CLIPMAP_LEVEL_COUNT), mFile.levelCount);
+    settings.tilesPerLevel = CLIPMAP_TILES_PER_LEVEL;
+    settings.tileSize = mFile.tileSize;
+    settings.size = mFile.size;
+    Clipmap::Init(settings, mState);
+    return true;
+}
+
+void SCE::TerrainClipmap::Close()
+{
+    if(mTexture != GL_INVALID_INDEX)
+    {
+        SCE::Memory::UntrackGLTexture(mTexture);
+        glDeleteTextures(1, &mTexture);
+        mTexture = GL_INVALID_INDEX;
+    }
+    SCE::TiledHeightfield::Close(mFile);
+    mState = Clipmap::State();
+    mPages.clear();
+}
+
+void SCE::TerrainClipmap::InitRenderData(GLuint terrainProgram)
+{
+    mTexturesUniform = glGetUniformLocation(terrainProgram, "ClipmapTextures");
+    mLevelCountUniform = glGetUniformLocation(terrainProgram, "ClipmapLevelCount");
+    mLevelUvUniform = glGetUniformLocation(terrainProgram, "ClipmapLevelUv");
+    mLevelBoundsUniform = glGetUniformLocation(terrainProgram, "ClipmapLevelBounds");
+
+    if(!IsActive())
+    {
+        return;
+    }
+
+    //toroidal levels : repeating makes the uvs wrap like the slots do
+    const Clipmap::Settings& settings = mState.settings;
+    ui32 levelTexels = settings.tilesPerLevel*settings.tileSize;
+    glGenTextures(1, &mTexture);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, mTexture);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA16, levelTexels, levelTexels, settings.levelCount, 0,
+                 GL_RGBA, GL_UNSIGNED_SHORT, nullptr);
+    SCE::Memory::TrackGLTexture(SCE::Memory::TAG_TERRAIN, mTexture,
+                                SCE::Memory::ComputeTextureSize(levelTexels, levelTexels, settings.levelCount,
+                                                                GL_RGBA16, false));
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
+bool SCE::TerrainClipmap::IsActive() const
+{
+    return mFile.mapping != nullptr;
+}
+
+const SCE::TiledHeightfield::File& SCE::TerrainClipmap::GetFile() const
+{
+    return mFile;
+}
+
+glm::vec2 SCE::TerrainClipmap::WorldToTexel(float x_worldspace, float z_worldspace) const
+{
+    return glm::vec2(x_worldspace, z_worldspace)/mFile.texelSpacing + float(mFile.size)*0.5f;
+}
+
+void SCE::TerrainClipmap::Update(const glm::vec3& cameraPosition_worldspace)
+{
+    if(!IsActive())
+    {
+        return;
+    }
+
+    glm::vec2 camera_texelspace = WorldToTexel(cameraPosition_worldspace.x, cameraPosition_worldspace.z);
+    Clipmap::Update(mState, camera_texelspace.x, camera_texelspace.y);
+    Clipmap::TakePages(mState, CLIPMAP_PAGES_PER_FRAME, mPages);
+    if(mPages.empty())
+    {
+        return;
+    }
+
+    //straight from the mapping, x major tiles are rows of the texture
+    ui32 tileSize = mFile.tileSize;
+    ui64 tileBytes = ui64(tileSize)*ui64(tileSize)*sizeof(Heightmap::GPUTexel);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, mTexture);
+    for(const Clipmap::Page& page : mPages)
+    {
+        const Heightmap::GPUTexel* tile =
+                SCE::TiledHeightfield::GetTile(mFile, page.level, page.tileX, page.tileZ);
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, page.slotZ*tileSize, page.slotX*tileSize, page.level,
+                        tileSize, tileSize, 1, GL_RGBA, GL_UNSIGNED_SHORT, tile);
+        SCE::RenderStats::CountBufferUpload(tileBytes);
+    }
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
+void SCE::TerrainClipmap::BindUniforms(const glm::vec3& rootPosition_worldspace)
+{
+    glActiveTexture(GL_TEXTURE0 + CLIPMAP_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, IsActive() ? mTexture : 0);
+    glUniform1i(mTexturesUniform, CLIPMAP_TEXTURE_UNIT);
+    SCE::RenderStats::CountTextureBind();
+
+    ui32 levelCount = IsActive() ? mState.settings.levelCount : 0;
+    glUniform1i(mLevelCountUniform, GLint(levelCount));
+    SCE::RenderStats::CountUniformCalls(2);
+    if(levelCount == 0)
+    {
+        return;
+    }
+
+    const Clipmap::Settings& settings = mState.settings;
+    double levelTexels = double(settings.tilesPerLevel*settings.tileSize);
+    glm::dvec3 root_filespace = glm::dvec3(rootPosition_worldspace) +
+            glm::dvec3(double(mFile.size)*0.5*double(mFile.texelSpacing));
+    glm::vec4 levelUvs[CLIPMAP_MAX_LEVELS];
+    glm::vec4 levelBounds[CLIPMAP_MAX_LEVELS];
+    for(ui32 level = 0; level < levelCount; ++level)
+    {
+        //uv = scenespace*scale + offset, the offset only keeps the fractional part of the root
+        double texelSize = double(mFile.texelSpacing)*double(1u << level);
+        double levelExtent = texelSize*levelTexels;
+        double offsetX = root_filespace.x/levelExtent;
+        double offsetZ = root_filespace.z/levelExtent;
+        levelUvs[level] = glm::vec4(float(offsetZ - glm::floor(offsetZ)), float(offsetX - glm::floor(offsetX)),
+                                    float(1.0/levelExtent), 0.0f);
+
+        //a texel of margin : the filtering reads the neighbour texels
+        const Clipmap::TileRect& valid = mState.levels[level].valid;
+        if(Clipmap::IsEmpty(valid))
+        {
+            levelBounds[level] = glm::vec4(1.0f, 1.0f, 0.0f, 0.0f);
+            continue;
+        }
+        glm::dvec4 bounds_texelspace(double(valid.minX*i32(settings.tileSize)) + 1.0,
+                                     double(valid.minZ*i32(settings.tileSize)) + 1.0,
+                                     double(valid.maxX*i32(settings.tileSize)) - 1.0,
+                                     double(valid.maxZ*i32(settings.tileSize)) - 1.0);
+        glm::dvec4 root_xz(root_filespace.x, root_filespace.z, root_filespace.x, root_filespace.z);
+        levelBounds[level] = glm::vec4(bounds_texelspace*texelSize - root_xz);
+    }
+    glUniform4fv(mLevelUvUniform, GLsizei(levelCount), &(levelUvs[0][0]));
+    glUniform4fv(mLevelBoundsUniform, GLsizei(levelCount), &(levelBounds[0][0]));
+    SCE::RenderStats::CountUniformCalls(2);
+}
+
+ui32 SCE::TerrainClipmap::GetPendingPageCount() const
+{
+    return ui32(mState.pending.size());
+}
@@ -0,0 +1,240 @@
+/******PROJECT:Sand Castle Engine******/
+/**************************************/
+/*********AUTHOR:Gwenn AUBERT**********/
+/******FILE:SCETerrainQuadtree.cpp*****/
+/**************************************/
+
+#include "../headers/SCETerrainQuadtree.hpp"
+#include "../headers/SCEFrustrumCulling.hpp"
+#include "../headers/SCETools.hpp"
+
+#include <cfloat>
+
+//a node pushes at most 4 children for each one it pops, enough for 2^16 patches per side
+#define SELECTION_STACK_SIZE (3*16 + 1)
+
+namespace SCE
+{
+
+namespace TerrainQuadtree
+{
+
+    namespace
+    {
+        struct StackEntry
+        {
+            i32     node;
+            //the parent was entirely inside the frustrum, no need to test again
+            bool    inside;
+        };
+
+        i32 buildNode(Quadtree& tree, const std::vector<glm::vec2>& patchHeightRanges,
+                      ui32 x, ui32 z, ui32 size)
+        {
+            i32 index = i32(tree.nodes.size());
+            tree.nodes.push_back(Node());
+            Node node;
+            node.x = ui16(x);
+            node.z = ui16(z);
+            node.size = ui16(size);
+            for(int i = 0; i < 4; ++i)
+            {
+                node.children[i] = -1;
+            }
+
+            if(size == 1)
+            {
+                const glm::vec2& heightRange = patchHeightRanges[x*tree.patchesPerSide + z];
+                glm::vec3 corner = tree.origin_worldspace + glm::vec3(float(x), 0.0f, float(z))*tree.patchSize;
+                node.boundsMin = glm::vec3(corner.x, heightRange.x, corner.z);
+                node.boundsMax = glm::vec3(corner.x + tree.patchSize, heightRange.y, corner.z + tree.patchSize);
+            }
+            else
+            {
+                node.boundsMin = glm::vec3(FLT_MAX);
+                node.boundsMax = glm::vec3(-FLT_MAX);
+                ui32 childSize = size/2;
+                for(ui32 i = 0; i < 4; ++i)
+                {
+                    ui32 childX = x + (i >> 1)*childSize;
+                    ui32 childZ = z + (i & 1)*childSize;
+                    if(childX < tree.patchesPerSide && childZ < tree.patchesPerSide)
+                    {
+                        i32 child = buildNode(tree, patchHeightRanges, childX, childZ, childSize);
+                        node.children[i] = child;
+                        node.boundsMin = glm::min(node.boundsMin, tree.nodes[child].boundsMin);
+                        node.boundsMax = glm::max(node.boundsMax, tree.nodes[child].boundsMax);
+                    }
+                }
+            }
+
+            tree.nodes[index] = node;
+            return index;
+        }
+
+        //only the heights change, the footprints stay the same
+        void refitNode(Quadtree& tree, i32 index, ui32 minX, ui32 minZ, ui32 maxX, ui32 maxZ,
+                       const PatchHeightQuery& getHeightRange)
+        {
+            Node& node = tree.nodes[index];
+            if(node.x > maxX || node.z > maxZ || ui32(node.x) + node.size <= minX || ui32(node.z) + node.size <= minZ)
+            {
+                return;
+            }
+
+            if(node.size == 1)
+            {
+                glm::vec2 heightRange = getHeightRange(node.x, node.z);
+                node.boundsMin.y = heightRange.x;
+                node.boundsMax.y = heightRange.y;
+                return;
+            }
+
+            float minHeight = FLT_MAX;
+            float maxHeight = -FLT_MAX;
+            for(ui32 i = 0; i < 4; ++i)
+            {
+                i32 child = node.children[i];
+                if(child >= 0)
+                {
+                    refitNode(tree, child, minX, minZ, maxX, maxZ, getHeightRange);
+                    minHeight = glm::min(minHeight, tree.nodes[child].boundsMin.y);
+                    maxHeight = glm::max(maxHeight, tree.nodes[child].boundsMax.y);
+                }
+            }
+            node.boundsMin.y = minHeight;
+            node.boundsMax.y = maxHeight;
+        }
+
+        //patches of the node that are in the grid
+        ui32 coveredPatches(const Quadtree& tree, const Node& node)
+        {
+            ui32 sizeX = glm::min(ui32(node.size), tree.patchesPerSide - node.x);
+            ui32 sizeZ = glm::min(ui32(node.size), tree.patchesPerSide - node.z);
+            return sizeX*sizeZ;
+        }
+
+        //horizontal only : the TCS measures from displaced edge centers, which may be out of the
+        //height range of the bounds, but they are never closer than the node footprint
+        float distanceToFootprint(const glm::vec3& position, const Node& node)
+        {
+            glm::vec2 horizontal(position.x, position.z);
+            glm::vec2 closest = glm::clamp(horizontal, glm::vec2(node.boundsMin.x, node.boundsMin.z),
+                                           glm::vec2(node.boundsMax.x, node.boundsMax.z));
+            return glm::length(horizontal - closest);
+        }
+
+        void addInstance(const Quadtree& tree, const Node& node,
+                         std::vector<glm::vec4>& instances, SelectionStats& stats)
+        {
+            glm::vec3 corner = tree.origin_worldspace +
+                    glm::vec3(float(node.x), 0.0f, float(node.z))*tree.patchSize;
+            instances.push_back(glm::vec4(corner, float(node.size)*tree.patchSize));
+            stats.drawnPatches += ui32(node.size)*ui32(node.size);
+            ++stats.instanceCount;
+        }
+    }
+
+    void Build(ui32 patchesPerSide, float patchSize, const glm::vec3& origin_worldspace,
+               const std::vector<glm::vec2>& patchHeightRanges, Quadtree& tree)
+    {
+        Debug::Assert(patchesPerSide > 0 && patchesPerSide <= 0x8000, "Invalid terrain patch count");
+        Debug::Assert(patchHeightRanges.size() == patchesPerSide*patchesPerSide,
+                      "One height range per patch expected");
+
+        tree.patchesPerSide = patchesPerSide;
+        tree.patchSize = patchSize;
+        tree.origin_worldspace = origin_worldspace;
+        tree.nodes.clear();
+
+        ui32 rootSize = 1;
+        while(rootSize < patchesPerSide)
+        {
+            rootSize *= 2;
+        }
+        //a full tree has 4/3 nodes per leaf
+        tree.nodes.reserve(patchesPerSide*patchesPerSide*4/3 + 1);
+        buildNode(tree, patchHeightRanges, 0, 0, rootSize);
+    }
+
+    void UpdateHeightRanges(Quadtree& tree, ui32 minX, ui32 minZ, ui32 maxX, ui32 maxZ,
+                            const PatchHeightQuery& getHeightRange)
+    {
+        if(!tree.nodes.empty())
+        {
+            refitNode(tree, 0, minX, minZ, maxX, maxZ, getHeightRange);
+        }
+    }
+
+    float GetTessellationLevel(float distance, float patchSize, const LodSettings& lod)
+    {
+        float farDist = lod.maxTessDistance + 10.0f;
+        float tess = 1.0f - glm::clamp((distance - patchSize) / farDist, 0.0f, 1.0f);
+        tess = glm::pow(tess, 12.0f) / lod.lodMultiplier;
+        return glm::clamp(tess*TERRAIN_MAX_TESS_LEVEL, TERRAIN_MIN_TESS_LEVEL, TERRAIN_MAX_TESS_LEVEL);
+    }
+
+    void SelectPatches(const Quadtree& tree, const glm::mat4& worldToCamera,
+                       const glm::vec3& cameraPosition_worldspace, const LodSettings& lod,
+                       std::vector<glm::vec4>& instances, SelectionStats& stats)
+    {
+        if(tree.nodes.empty())
+        {
+            return;
+        }
+
+        StackEntry stack[SELECTION_STACK_SIZE];
+        int stackSize = 0;
+        stack[stackSize++] = { 0, false };
+
+        while(stackSize > 0)
+        {
+            StackEntry entry = stack[--stackSize];
+            const Node& node = tree.nodes[entry.node];
+            ++stats.visitedNodes;
+
+            if(!entry.inside)
+            {
+                glm::vec3 extent = node.boundsMax - node.boundsMin;
+                glm::vec4 center_cameraspace = worldToCamera*glm::vec4((node.boundsMin + node.boundsMax)*0.5f, 1.0f);
+                FrustrumCulling::BoxCulling culling =
+                        FrustrumCulling::ClassifyBox(center_cameraspace,
+                                                     worldToCamera*glm::vec4(extent.x, 0.0f, 0.0f, 0.0f),
+                                                     worldToCamera*glm::vec4(0.0f, extent.y, 0.0f, 0.0f),
+                                                     worldToCamera*glm::vec4(0.0f, 0.0f, extent.z, 0.0f));
+                if(culling == FrustrumCulling::BOX_OUTSIDE)
+                {
+                    stats.culledPatches += coveredPatches(tree, node);
+                    continue;
+                }
+                entry.inside = culling == FrustrumCulling::BOX_INSIDE;
+            }
+
+            if(node.size == 1)
+            {
+                addInstance(tree, node, instances, stats);
+                continue;
+            }
+
+            //every edge in the node is at least this far, so at most this tessellated
+            bool fullyInGrid = coveredPatches(tree, node) == ui32(node.size)*ui32(node.size);
+            if(fullyInGrid && node.size <= TERRAIN_MAX_MERGED_PATCHES &&
+               GetTessellationLevel(distanceToFootprint(cameraPosition_worldspace, node),
+                                    tree.patchSize, lod) <= TERRAIN_MIN_TESS_LEVEL)
+            {
+                addInstance(tree, node, instances, stats);
+                continue;
+            }
+
+            for(int i = 0; i < 4; ++i)
+            {
+                if(node.children[i] >= 0)
+                {
+                    stack[stackSize++] = { node.children[i], entry.inside };
+                }
+            }
+        }
+    }
+}
+
+}
@@ -8,6 +8,7 @@
 #include "../headers/SCEShaders.hpp"
 #include "../headers/SCE_GBuffer.hpp"
 #include "../headers/SCERender.hpp"
+#include "../headers/SCEScene.hpp"
 
 SCE::TerrainShadow::TerrainShadow()
 {
@@ -25,12 +26,16 @@ SCE::TerrainShadow::TerrainShadow()
             glGetUniformLocation(mShader, "FinalTex");
     mHeightScaleUniform =
             glGetUniformLocation(mShader, "HeightScale");
+    mHorizonMapUniform =
+            glGetUniformLocation(mShader, "HorizonMap");
+    mHorizonDirectionCountUniform =
+            glGetUniformLocation(mShader, "HorizonDirectionCount");
 }
 
 void SCE::TerrainShadow::RenderShadow(const mat4 &projectionMatrix, const mat4 &viewMatrix,
                                       const vec3 &sunPosition, SCE_GBuffer &gbuffer,
                                       const mat4 &worldToTerrainspace, uint terrainTexture,
-                                      float heightScale)
+                                      float heightScale, uint horizonTexture, int horizonDirectionCount)
 {
     glUseProgram(mShader);
 
@@ -45,6 +50,13 @@ void SCE::TerrainShadow::RenderShadow(const mat4 &projectionMatrix, const mat4 &
     glBindTexture(GL_TEXTURE_2D, terrainTexture);
     glUniform1i(mTerrainTexUniform, 2);
 
+    //no horizon map : the shader ray marches the heightmap instead
+    glActiveTexture(GL_TEXTURE3);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, horizonDirectionCount > 0 ? horizonTexture : 0);
+    glUniform1i(mHorizonMapUniform, 3);
+    glUniform1i(mHorizonDirectionCountUniform, horizonDirectionCount);
+
+    SCE::ShaderUtils::BindRootPosition(mShader, SCEScene::GetFrameRootPosition());
     glUniform1f(mHeightScaleUniform, heightScale);
     glUniform3fv(mSunPositionUniform, 1, &sunPosition[0]);
     glUniformMatrix4fv(mWorldToTerrainMatUniform, 1, GL_FALSE,
@@ -19,29 +19,19 @@
 #include "../headers/SCERender.hpp"
 #include "../headers/SCEBillboardRender.hpp"
 #include "../headers/SCEScene.hpp"
+#include "../headers/SCERenderStats.hpp"
+#include "../headers/SCEMemory.hpp"
+#include "../headers/SCEImpostorCache.hpp"
+#include "../headers/SCEInternal.hpp"
+#include "../headers/SCELogger.hpp"
 
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/random.hpp>
 
-#define USE_STB_PERLIN 1
-#if USE_STB_PERLIN
-    #ifndef STB_PERLIN_IMPLEMENTATION
-    #define STB_PERLIN_IMPLEMENTATION
-    #include <stb_perlin.h>
-    #endif
-#else
-#include "../headers/SCEPerlin.hpp"
-#endif
-
-#define USE_IMPOSTORS 1
 #define DOUBLE_SIDED_TREES 1
-#define NB_IMPOSTOR_ANGLES (6*6)
 
 #define USE_THREADED_UPDATE 1
 
-#define IMPOSTOR_FLIP_X 0
-#define IMPOSTOR_FACE_Z 0
-
 #define TREE_TRUNK_SHADER_NAME "Terrain/TreePack/TreeInstanced_trunk"
 #define TREE_LEAVES_SHADER_NAME "Terrain/TreePack/TreeInstanced_leaves"
 #define TREE_MODEL_NAME "Terrain/TreePack/tree_5/1/lod"
@@ -61,281 +51,110 @@
 #define BILLBOARD_GEN_MAIN_TEX "MainTex"
 #define BILLBOARD_GEN_NORMAL_TEX "NormalMap"
 #define BILLBOARD_GEN_TRANSLUCENCY "Translucency"
-#define BILLBOARD_BORDER 0.05f
 
 #define IMPOSTOR_SHADER_NAME "Terrain/TreeImpostor"
 #define IMPOSTOR_TEXTURE_UNIFORM "ImpostorTex"
 #define IMPOSTOR_NORMAL_UNIFORM "ImpostorNormalTex"
-
-void SCE::TerrainTrees::UpdateVisibilityAndLOD(mat4 viewMatrix,
-                                               mat4 worldToTerrainspaceMatrix,
-                                               vec3 cameraPosition_scenespace,
-                                               float maxDistFromCenter,
-                                               glm::mat4 impostorScaleMat)
+#define IMPOSTOR_SCALE_MATRIX_UNIFORM "ImpostorScaleMatrix"
+#define IMPOSTOR_ATLAS_SIZE_UNIFORM "ImpostorAtlasSize"
+#define IMPOSTOR_ATLAS_BORDER_UNIFORM "ImpostorAtlasBorder"
+#define IMPOSTOR_TEXTURE_SIZE 512
+#define IMPOSTOR_CACHE_NAME "Terrain/TreePack/tree_5/impostors"
+//mesh files written by the mesh loader conversion, all read by the capture
+#define IMPOSTOR_MESH_FILES {"vertices", "indices", "normals", "uvs", "tangents", "bitangents"}
+#define IMPOSTOR_TRUNK_TRANSLUCENCY 0.0f
+
+namespace
 {
-#if USE_THREADED_UPDATE
-
-#define DO_SLEEP 0
-#define DO_DURATION 1
-
-#else
-
-#define DO_SLEEP 0
-#define DO_DURATION 0
-
-#endif
-
-#if DO_SLEEP
-    std::chrono::milliseconds waitInterval(8);
-#endif
-
-#if DO_DURATION
-    double startTime = SCE::Time::RealTimeInSeconds();
-#endif
-
-    float perlinScale = 0.05f;
-    float positionNoiseScale = 5.0f;
-    float noiseX, noiseZ;
-
-    int discardedGroups = 0;
-    int prevSize = 0;
-
-    for(int i = 0; i < TREE_LOD_COUNT; ++i)
+    SCE::ImpostorCache::Settings getImpostorCacheSettings()
     {
-        prevSize = mTreeMatrices[i].size();
-        mTreeMatrices[i].clear();
-        mTreeMatrices[i].reserve(prevSize);
-    }
-
-    prevSize = mTreeImpostorMatrices.size();
-    mTreeImpostorMatrices.clear();
-    mTreeImpostorMatrices.reserve(prevSize);
-    mTreeImpostorTexMapping.clear();
-    mTreeImpostorTexMapping.reserve(prevSize);
-
-    //perform frustum culling on the tree groups
-    std::vector<TreeGroup*> activeGroups;
-    for(TreeGroup& group : mTreeGroups)
-    {
-        //make a bigger radius to account for possible displacement
-        float totalRadius = group.radius + group.spacing*positionNoiseScale;
-        glm::vec3 groupPos = glm::vec3(group.position.x, 0.0f,
-                                       group.position.y);        
-        groupPos.y = SCE::Terrain::GetTerrainHeight(groupPos);
-        //convert to scenespace
-        groupPos -= SCEScene::GetFrameRootPosition();
-
-        glm::vec4 groupPos_cameraspace = viewMatrix*glm::vec4(groupPos, 1.0);
-
-        if(SCE::FrustrumCulling::IsSphereInFrustrum(groupPos_cameraspace, totalRadius))
-        {
-            activeGroups.push_back(&group);
-        }
-        else
-        {
-            ++discardedGroups;
-        }       
+        SCE::ImpostorCache::Settings settings;
+        settings.nbAngles = NB_IMPOSTOR_ANGLES;
+        settings.texSize = IMPOSTOR_TEXTURE_SIZE;
+        settings.border = BILLBOARD_BORDER;
+        return settings;
     }
 
-#if DO_SLEEP
-    std::this_thread::sleep_for(waitInterval);
-#endif
-
-    glm::vec3 camPosition_worldspace = SCEScene::GetFrameRootPosition() + cameraPosition_scenespace;
-    glm::vec2 camPos2 = glm::vec2(camPosition_worldspace.x, camPosition_worldspace.z);
-
-    //sort the visible tree groups
-    std::sort(begin(activeGroups), end(activeGroups),
-              [&camPos2](TreeGroup const* a, TreeGroup const* b) -> bool
+    //everything the capture reads, the impostors are made from the first LOD
+    ui64 getImpostorCacheHash(const SCE::ImpostorCache::Settings& settings)
     {
-        return glm::length(camPos2 - a->position) < glm::length(camPos2 - b->position);
-    });
-
-#if DO_SLEEP
-    std::this_thread::sleep_for(waitInterval);
-#endif
-
-    glm::vec3 leveledCamPos = camPosition_worldspace;
-    leveledCamPos.y = 0.0f;
-    //Spawn trees from tree groups
-    int lodGroup = 0;
-
-    for(TreeGroup* group : activeGroups)
-    {
-        for(float x = -group->radius; x < group->radius; x += group->spacing)
+        std::vector<std::string> sourceFiles;
+        for(const char* part : {"0_trunk", "0_leaves"})
         {
-            for(float z = -group->radius; z < group->radius; z += group->spacing)
+            for(const char* meshFile : IMPOSTOR_MESH_FILES)
             {
-                //compute tree position from group and non-random noise
-                glm::vec3 treePos(x + group->position.x, 0.0f, z + group->position.y);
-
-#if USE_STB_PERLIN
-                noiseX = stb_perlin_noise3(treePos.x*perlinScale, 25.0f,
-                                           treePos.z*perlinScale);
-                noiseZ = stb_perlin_noise3(treePos.z*perlinScale, 25.0f,
-                                           treePos.x*perlinScale);
-                //scale to apply to the tree
-                float scale = SCE::Math::MapToRange(-0.6f, 0.6f, 1.0f, 1.8f, noiseZ);
-#else
-                noiseX = Perlin::GetPerlinAt(treePos.x*perlinScale, treePos.z*perlinScale);
-                noiseZ = Perlin::GetPerlinAt(treePos.z*perlinScale, treePos.x*perlinScale);
-                //scale to apply to the tree
-                float scale = SCE::Math::MapToRange(-0.5f, 0.5f, 0.8f, 1.4f, noiseZ);
-#endif
-
-                treePos.x += noiseX*group->spacing*positionNoiseScale;
-                treePos.z += noiseZ*group->spacing*positionNoiseScale;
-
-                float distToCam = glm::max(0.0f, length(treePos - leveledCamPos));
-                for(lodGroup = 0; lodGroup < TREE_LOD_COUNT; ++lodGroup)
-                {
-                    if(distToCam < SCE::Quality::Trees::LodDistances[lodGroup])
-                    {
-                        break;
-                    }
-                }
-
-                //tree could have spawn outside of terrain, only keep if inside
-                if( abs(treePos.x) < maxDistFromCenter
-                    && abs(treePos.z) < maxDistFromCenter
-                    && distToCam < SCE::Quality::Trees::MaxDrawDistance)
-                {
-                    //put tree at the surface of terrain
-                    float height = SCE::Terrain::GetTerrainHeight(treePos);
-                    //go slightly down to avoid sticking out of the ground
-                    treePos.y = height - 2.0f*scale;
-
-                    glm::mat4 instanceMatrix;
-
-                    //make a tree model
-                    if(lodGroup < TREE_LOD_COUNT)
-                    {
-                        lodGroup = clamp(lodGroup, 0, TREE_LOD_COUNT - 1);
-                        instanceMatrix = glm::translate(mat4(1.0f), treePos)*
-                                glm::rotate(mat4(1.0), noiseX*10.0f, glm::vec3(0, 1, 0))*
-                                glm::scale(mat4(1.0), glm::vec3(scale));
-                        mTreeMatrices[lodGroup].push_back(instanceMatrix);
-                    }
-#if USE_IMPOSTORS
-                    //make an impostor
-                    else
-                    {
-                        //rotate plane to face camera
-                        glm::vec3 dirToCam = glm::normalize(camPosition_worldspace - treePos);
-#if IMPOSTOR_FACE_Z
-                        float angleYAxis = glm::atan(1.0f, 0.0f) -
-                                glm::atan(dirToCam.z, dirToCam.x);
-
-                        instanceMatrix = glm::translate(mat4(1.0f), treePos)*
-                                glm::rotate(mat4(1.0), angleYAxis, glm::vec3(0.0, 1.0, 0.0))*
-                                glm::scale(mat4(1.0), glm::vec3(scale))*
-                                impostorScaleMat;
-                        mTreeImpostorMatrices.push_back(instanceMatrix);
-
-                        mTreeImpostorTexMapping.push_back(
-                                    SCE::BillboardRender::GetMappingForAgnle(noiseX*10.0f-angleYAxis,
-                                                                             NB_IMPOSTOR_ANGLES,
-                                                                             IMPOSTOR_FLIP_X));
-#else
-                        float angleYAxis = glm::atan(-1.0f, 0.0f) -
-                                glm::atan(dirToCam.z, dirToCam.x);
-
-                        instanceMatrix = glm::translate(mat4(1.0f), treePos)*
-                                glm::rotate(mat4(1.0), angleYAxis, glm::vec3(0.0, 1.0, 0.0))*
-                                glm::scale(mat4(1.0), glm::vec3(scale))*
-                                impostorScaleMat;
-                        mTreeImpostorMatrices.push_back(instanceMatrix);
-
-                        mTreeImpostorTexMapping.push_back(
-                                    SCE::BillboardRender::GetMappingForAgnle(noiseX*-10.0f+angleYAxis,
-                                                                             NB_IMPOSTOR_ANGLES,
-                                                                             IMPOSTOR_FLIP_X, BILLBOARD_BORDER));
-#endif
-                    }
-#endif
-                }
+                sourceFiles.push_back(std::string(TREE_MODEL_NAME) + part + TREE_MODEL_EXTENSION +
+                                      "_convert." + meshFile);
             }
         }
-    }
+        sourceFiles.push_back(TREE_BARK_TEX_NAME);
+        sourceFiles.push_back(TREE_BARK_NORMAL_NAME);
+        sourceFiles.push_back(TREE_LEAVES_TEX_NAME);
+        sourceFiles.push_back(std::string(BILLBOARD_GEN_SHADER_NAME) + SHADER_SUFIX);
 
-#if DO_SLEEP
-    std::this_thread::sleep_for(waitInterval);
-#endif
-
-#if DO_DURATION
-    double ellapsedTime = SCE::Time::RealTimeInSeconds() - startTime;
-    double remainingTime = SCE::Quality::Trees::VisibilityUpdateDuration - ellapsedTime;
-    if(remainingTime > 0)
-    {
-        std::this_thread::sleep_for(std::chrono::milliseconds(int(remainingTime*1000.0f)));
+        std::vector<float> values = { IMPOSTOR_TRUNK_TRANSLUCENCY, TREE_LEAVES_TRANSLUCENCY };
+        return SCE::ImpostorCache::Hash(settings, sourceFiles, values);
     }
-#endif
+}
 
-    //sort non-impostors trees individually
-    for(int i = 0; i < TREE_LOD_COUNT; ++i)
+void SCE::TerrainTrees::UpdateVisibilityAndLOD(VisibilitySnapshot snapshot,
+                                               const SCE::Parallel::CancelToken& cancel)
+{
+    SCE::TreeLayout::ComputeVisibilityAndLOD(mTreeGroups, mGroupGrid, snapshot.viewMatrix,
+                                             snapshot.rootPosition_worldspace,
+                                             snapshot.cameraPosition_scenespace, snapshot.maxDistFromCenter,
+                                             [](const float* x, const float* z, float* heights, int count)
+                                             {
+                                                 SCE::Terrain::GetTerrainHeights(x, z, heights, count);
+                                             },
+                                             cancel,
+                                             mPlacementCache,
+                                             mTreeInstances.GetWriteBuffer());
+
+    //report instance lists and placements memory, only this thread resizes them
+    ui64 instanceBytes = SCE::TreeLayout::GetPlacementCacheBytes(mPlacementCache);
+    for(ui32 buffer = 0; buffer < mTreeInstances.GetBufferCount(); ++buffer)
     {
-        //sort the visible trees
-        std::sort(begin(mTreeMatrices[i]), end(mTreeMatrices[i]),
-                  [&leveledCamPos](glm::mat4 const& a, glm::mat4 const& b) -> bool
+        const SCE::TreeLayout::TreeInstances& instances = mTreeInstances.GetBuffer(buffer);
+        for(ui32 list = 0; list < TREE_LIST_COUNT; ++list)
         {
-            glm::vec3 aPos(a[3].x, 0.0f, a[3].z);
-            glm::vec3 bPos(b[3].x, 0.0f, b[3].z);
-            return length(leveledCamPos - aPos) < length(leveledCamPos - bPos);
-        });
-
+            instanceBytes += SCE::Memory::VectorBytes(SCE::TreeLayout::GetInstanceList(instances, list)) +
+                    SCE::Memory::VectorBytes(instances.pageUpdates[list]);
+        }
     }
+    SCE::Memory::TrackResize(SCE::Memory::TAG_TREES, mTrackedInstanceBytes, instanceBytes);
+    mTrackedInstanceBytes = instanceBytes;
 
+    //the terrain changed under the groups, these instances are stale : the next update replaces them
+    if(cancel)
     {
-        mTreeInstanceLock.lock();
-        mInstancesUpToDate = false;
-        mTreeInstanceLock.unlock();
+        return;
     }
+
+    mTreeInstances.Publish();
 }
 
-//Spread tree groups over the terrain
-SCE::TerrainTrees::TerrainTrees()
-    : mInstancesUpToDate(false)
+#if USE_IMPOSTORS
+std::string SCE::TerrainTrees::GetImpostorCacheFilename()
 {
-    //Load tree models
-    mTreeGlData.trunkShaderProgram = SCE::ShaderUtils::CreateShaderProgram(TREE_TRUNK_SHADER_NAME);
-    mTreeGlData.leavesShaderProgram = SCE::ShaderUtils::CreateShaderProgram(TREE_LEAVES_SHADER_NAME);
+    return SCE::ImpostorCache::GetCacheFilename(IMPOSTOR_CACHE_NAME, getImpostorCacheSettings());
+}
 
-    for(int lod = 0; lod < TREE_LOD_COUNT; ++lod)
+//Loads the impostor atlases from their cache, or renders every view of the tree and caches them
+glm::vec3 SCE::TerrainTrees::InitializeImpostorAtlases()
+{
+    SCE::ImpostorCache::Settings settings = getImpostorCacheSettings();
+    ui64 hash = getImpostorCacheHash(settings);
+    std::string filename = GetImpostorCacheFilename();
+    SCE::ImpostorCache::Atlas atlas;
+    if(SCE::ImpostorCache::Load(filename, settings, hash, atlas))
     {
-        std::string lodStr = std::to_string(lod);
-        ui16 trunkMeshId = SCE::MeshLoader::CreateMeshFromFile(TREE_MODEL_NAME +
-                                                          lodStr + "_trunk" +
-                                                          TREE_MODEL_EXTENSION);
-        SCE::MeshRender::InitializeMeshRenderData(trunkMeshId);
-        SCE::MeshRender::MakeMeshInstanced(trunkMeshId);
-
-        ui16 leavesMeshId = SCE::MeshLoader::CreateMeshFromFile(TREE_MODEL_NAME +
-                                                          lodStr + "_leaves" +
-                                                          TREE_MODEL_EXTENSION);
-        SCE::MeshRender::InitializeMeshRenderData(leavesMeshId);
-        SCE::MeshRender::MakeMeshInstanced(leavesMeshId);
-
-        mTreeGlData.trunkMeshIds[lod] = trunkMeshId;
-        mTreeGlData.leavesMeshIds[lod] = leavesMeshId;
+        mTreeGlData.impostorData.texture = SCE::BillboardRender::CreateTexture(atlas.size, atlas.diffuse.data());
+        mTreeGlData.impostorData.normalTexture = SCE::BillboardRender::CreateTexture(atlas.size, atlas.normal.data());
+        SCE_LOG_DEBUG(Logger::CAT_TREES, "Tree impostors loaded from " + filename);
+        return atlas.billboardSize;
     }
 
-    mTreeGlData.barkTexture = SCE::TextureUtils::LoadTexture(TREE_BARK_TEX_NAME);
-    mTreeGlData.barkTexUniform =
-            glGetUniformLocation(mTreeGlData.trunkShaderProgram, TREE_BARK_TEX_UNIFORM);
-
-    mTreeGlData.barkNormalTexture = SCE::TextureUtils::LoadTexture(TREE_BARK_NORMAL_NAME);
-    mTreeGlData.barkNormalTexUniform =
-            glGetUniformLocation(mTreeGlData.trunkShaderProgram, TREE_BARK_NORMAL_TEX_UNIFORM);
-
-    mTreeGlData.leafTexture = SCE::TextureUtils::LoadTexture(TREE_LEAVES_TEX_NAME);
-    mTreeGlData.leafTexUniform =
-            glGetUniformLocation(mTreeGlData.leavesShaderProgram, TREE_LEAVES_TEX_UNIFORM);
-    mTreeGlData.leavesTranslucencyUniform =
-            glGetUniformLocation(mTreeGlData.leavesShaderProgram, TREE_LEAVES_TRANSLUCENCY_UNIFORM);
-
-
-#if USE_IMPOSTORS
-
     //generate textures for different angles
 //    ui16 impostorSrcLeavesMesh = mTreeGlData.leavesMeshIds[TREE_LOD_COUNT - 1];
 //    ui16 impostorSrcTrunkMesh = mTreeGlData.trunkMeshIds[TREE_LOD_COUNT - 1];
@@ -349,8 +168,6 @@ SCE::TerrainTrees::TerrainTrees()
     GLint billboardNormalUniform = glGetUniformLocation(billboardCaptureShader, BILLBOARD_GEN_NORMAL_TEX);
     GLint billboardTranslucencyUniform = glGetUniformLocation(billboardCaptureShader, BILLBOARD_GEN_TRANSLUCENCY);
 
-    float trunkTransluceny = 0.0f;//put some translu on the trunk to avoid it going to dark
-
     //callback that will be call to render each angle
     SCE::BillboardRender::RenderCallback renderCallback = [&](glm::mat4 const& modelMatrix,
             glm::mat4 const& viewMatrix, glm::mat4 const& projectionMatrix)
@@ -359,7 +176,7 @@ SCE::TerrainTrees::TerrainTrees()
         SCE::ShaderUtils::UseShader(billboardCaptureShader);
         SCE::TextureUtils::BindTexture(mTreeGlData.barkTexture, 0, billboardDiffuseUniform);
         SCE::TextureUtils::BindTexture(mTreeGlData.barkNormalTexture, 1, billboardNormalUniform);
-        glUniform1f(billboardTranslucencyUniform, trunkTransluceny);
+        glUniform1f(billboardTranslucencyUniform, IMPOSTOR_TRUNK_TRANSLUCENCY);
         SCE::MeshRender::RenderMesh(impostorSrcTrunkMesh, projectionMatrix, viewMatrix, modelMatrix);
 
         //render trees leaves
@@ -381,14 +198,83 @@ SCE::TerrainTrees::TerrainTrees()
 
     //Start generating the billboards
     glm::vec3 billboardSize = SCE::BillboardRender::GenerateTexturesFromMesh(
-                                                   NB_IMPOSTOR_ANGLES, 512, BILLBOARD_BORDER,
+                                                   settings.nbAngles, settings.texSize, settings.border,
                                                    treeCenter, treeDimensions,
                                                    &mTreeGlData.impostorData.texture,
                                                    &mTreeGlData.impostorData.normalTexture,
                                                    renderCallback);
     //we're done with this shader so delete it
     SCE::ShaderUtils::DeleteShaderProgram(billboardCaptureShader);
-    billboardCaptureShader = GL_INVALID_INDEX;  
+    billboardCaptureShader = GL_INVALID_INDEX;
+    SCE::TextureUtils::DeleteTexture(defaultNormalTex);
+
+    //keep them for the next launches
+    atlas.size = SCE::ImpostorCache::GetAtlasSize(settings);
+    atlas.billboardSize = billboardSize;
+    atlas.diffuse.resize(ui64(atlas.size)*ui64(atlas.size));
+    atlas.normal.resize(atlas.diffuse.size());
+    SCE::BillboardRender::ReadTexture(mTreeGlData.impostorData.texture, atlas.size, atlas.diffuse.data());
+    SCE::BillboardRender::ReadTexture(mTreeGlData.impostorData.normalTexture, atlas.size, atlas.normal.data());
+    SCE::ImpostorCache::Save(filename, settings, hash, atlas);
+
+    return billboardSize;
+}
+#endif
+
+//Spread tree groups over the terrain
+SCE::TerrainTrees::TerrainTrees()
+    : mLayoutParams(),
+      mUploadedUpdate(0),
+      mLastUpdateTime(0.0),
+      mTrackedInstanceBytes(0),
+      mMaxConsumeTime(0.0)
+{
+    for(ui32 list = 0; list < TREE_LIST_COUNT; ++list)
+    {
+        mInstanceCapacities[list] = 0;
+    }
+
+    //Load tree models
+    mTreeGlData.trunkShaderProgram = SCE::ShaderUtils::CreateShaderProgram(TREE_TRUNK_SHADER_NAME);
+    mTreeGlData.leavesShaderProgram = SCE::ShaderUtils::CreateShaderProgram(TREE_LEAVES_SHADER_NAME);
+
+    for(int lod = 0; lod < TREE_LOD_COUNT; ++lod)
+    {
+        std::string lodStr = std::to_string(lod);
+        ui16 trunkMeshId = SCE::MeshLoader::CreateMeshFromFile(TREE_MODEL_NAME +
+                                                          lodStr + "_trunk" +
+                                                          TREE_MODEL_EXTENSION);
+        SCE::MeshRender::InitializeMeshRenderData(trunkMeshId);
+        SCE::MeshRender::MakeMeshInstanced(trunkMeshId);
+
+        ui16 leavesMeshId = SCE::MeshLoader::CreateMeshFromFile(TREE_MODEL_NAME +
+                                                          lodStr + "_leaves" +
+                                                          TREE_MODEL_EXTENSION);
+        SCE::MeshRender::InitializeMeshRenderData(leavesMeshId);
+        SCE::MeshRender::MakeMeshInstanced(leavesMeshId);
+
+        mTreeGlData.trunkMeshIds[lod] = trunkMeshId;
+        mTreeGlData.leavesMeshIds[lod] = leavesMeshId;
+    }
+
+    mTreeGlData.barkTexture = SCE::TextureUtils::LoadTexture(TREE_BARK_TEX_NAME);
+    mTreeGlData.barkTexUniform =
+            glGetUniformLocation(mTreeGlData.trunkShaderProgram, TREE_BARK_TEX_UNIFORM);
+
+    mTreeGlData.barkNormalTexture = SCE::TextureUtils::LoadTexture(TREE_BARK_NORMAL_NAME);
+    mTreeGlData.barkNormalTexUniform =
+            glGetUniformLocation(mTreeGlData.trunkShaderProgram, TREE_BARK_NORMAL_TEX_UNIFORM);
+
+    mTreeGlData.leafTexture = SCE::TextureUtils::LoadTexture(TREE_LEAVES_TEX_NAME);
+    mTreeGlData.leafTexUniform =
+            glGetUniformLocation(mTreeGlData.leavesShaderProgram, TREE_LEAVES_TEX_UNIFORM);
+    mTreeGlData.leavesTranslucencyUniform =
+            glGetUniformLocation(mTreeGlData.leavesShaderProgram, TREE_LEAVES_TRANSLUCENCY_UNIFORM);
+
+
+#if USE_IMPOSTORS
+
+    glm::vec3 billboardSize = InitializeImpostorAtlases();
 
     //Set up impostor render data
     mTreeGlData.impostorData.meshId = SCE::MeshLoader::CreateQuadMesh("BillboardQuad", IMPOSTOR_FACE_Z);
@@ -400,6 +286,12 @@ SCE::TerrainTrees::TerrainTrees()
             glGetUniformLocation(mTreeGlData.impostorData.shaderProgram, IMPOSTOR_TEXTURE_UNIFORM);
     mTreeGlData.impostorData.normalUniform =
             glGetUniformLocation(mTreeGlData.impostorData.shaderProgram, IMPOSTOR_NORMAL_UNIFORM);
+    mTreeGlData.impostorData.scaleMatrixUniform =
+            glGetUniformLocation(mTreeGlData.impostorData.shaderProgram, IMPOSTOR_SCALE_MATRIX_UNIFORM);
+    mTreeGlData.impostorData.atlasSizeUniform =
+            glGetUniformLocation(mTreeGlData.impostorData.shaderProgram, IMPOSTOR_ATLAS_SIZE_UNIFORM);
+    mTreeGlData.impostorData.atlasBorderUniform =
+            glGetUniformLocation(mTreeGlData.impostorData.shaderProgram, IMPOSTOR_ATLAS_BORDER_UNIFORM);
 
 
     //scale impostor quad so that it looks like a regular tree
@@ -413,11 +305,12 @@ SCE::TerrainTrees::TerrainTrees()
 
 SCE::TerrainTrees::~TerrainTrees()
 {
-    if(mUpdateThread)
-    {
-        mUpdateThread->join();
-        mUpdateThread.release();
-    }
+    mUpdateWorker.Cancel();
+    mUpdateWorker.Wait();
+
+    SCE::Memory::TrackDeallocation(SCE::Memory::TAG_TREES, mTrackedInstanceBytes +
+                                   SCE::Memory::VectorBytes(mTreeGroups) +
+                                   SCE::TreeLayout::GetGroupGridBytes(mGroupGrid));
 
     if(mTreeGlData.trunkShaderProgram != GL_INVALID_INDEX)
     {
@@ -460,14 +353,17 @@ SCE::TerrainTrees::~TerrainTrees()
         SCE::TextureUtils::DeleteTexture(mTreeGlData.leafTexture);
     }
 
+    //impostor textures are created by the billboard renderer, not the texture system
     if(mTreeGlData.impostorData.texture != GL_INVALID_INDEX)
     {
-        SCE::TextureUtils::DeleteTexture(mTreeGlData.impostorData.texture);
+        SCE::Memory::UntrackGLTexture(mTreeGlData.impostorData.texture);
+        glDeleteTextures(1, &mTreeGlData.impostorData.texture);
     }
 
     if(mTreeGlData.impostorData.normalTexture != GL_INVALID_INDEX)
     {
-        SCE::TextureUtils::DeleteTexture(mTreeGlData.impostorData.normalTexture);
+        SCE::Memory::UntrackGLTexture(mTreeGlData.impostorData.normalTexture);
+        glDeleteTextures(1, &mTreeGlData.impostorData.normalTexture);
     }
 }
 
@@ -475,49 +371,45 @@ void SCE::TerrainTrees::InitializeTreeLayout(float xOffset, float zOffset,
                                              float startScale, float heightScale,
                                              float halfTerrainSize)
 {
-    //number of time the map is divided to form tree groups
-    float divPerKm = SCE::Quality::Trees::NbGroupPerKm;
-    int treeGroupIter = int(divPerKm*halfTerrainSize/1000.0f);
-    float scale = startScale;
-    float baseGroupRadius = (1000.0f/divPerKm);
-    float maxRadiusScale = 1.3f;
-    float minRadiusScale = 0.7f;
-    float baseSpacing = SCE::Quality::Trees::BaseSpacing;
-
-    for(int xCount = 0; xCount < treeGroupIter; ++xCount)
-    {
-        float x = float(xCount) / float(treeGroupIter);
-
-        for(int zCount = 0; zCount < treeGroupIter; ++zCount)
-        {
-            float z = float(zCount) / float(treeGroupIter);
-
-#if USE_STB_PERLIN
-            float y = 115.0f; //any value will do, just need to be something other than the terrain height
-            float noise = stb_perlin_noise3((x + xOffset)*scale, y*scale, (z + zOffset)*scale);
-            noise = SCE::Math::MapToRange(-0.7f, 0.7f, minRadiusScale, maxRadiusScale, noise);
-#else
-            float noise = Perlin::GetPerlinAt((x + xOffset)*scale, (z + zOffset)*scale);
-            noise = SCE::Math::MapToRange(-0.5f, 0.5f, minRadiusScale, maxRadiusScale, noise);
-#endif
-            glm::vec2 pos = (glm::vec2(x, z)*2.0f - vec2(1.0, 1.0))*halfTerrainSize;
+    ui64 prevGroupBytes = SCE::Memory::VectorBytes(mTreeGroups) + SCE::TreeLayout::GetGroupGridBytes(mGroupGrid);
+
+    SCE::TreeLayout::GenerateTreeGroups(xOffset, zOffset, startScale, heightScale, halfTerrainSize,
+                                        SCE::Terrain::GetTerrainHeight, SCE::Terrain::GetTerrainNormal,
+                                        mTreeGroups);
+    mLayoutParams.xOffset = xOffset;
+    mLayoutParams.zOffset = zOffset;
+    mLayoutParams.startScale = startScale;
+    mLayoutParams.heightScale = heightScale;
+    mLayoutParams.halfTerrainSize = halfTerrainSize;
+
+    SCE::TreeLayout::BuildGroupGrid(mTreeGroups, TREE_GROUP_GRID_CELL_SIZE, mGroupGrid);
+    SCE::Memory::TrackResize(SCE::Memory::TAG_TREES, prevGroupBytes, SCE::Memory::VectorBytes(mTreeGroups) +
+                             SCE::TreeLayout::GetGroupGridBytes(mGroupGrid));
+}
 
-            glm::vec3 normal = SCE::Terrain::GetTerrainNormal(glm::vec3(pos.x, 0.0f, pos.y));
-            float height = SCE::Terrain::GetTerrainHeight(glm::vec3(pos.x, 0.0f, pos.y))/heightScale;
+void SCE::TerrainTrees::WaitForUpdate()
+{
+    mUpdateWorker.Wait();
+}
 
-            float flatness = pow(dot(normal, vec3(0.0f, 1.0f, 0.0f)), 8.0f);
-            //Spawn tree at low height on flat terrain
-            if(height < 0.3f && flatness > 0.6f
-               && (noise - minRadiusScale) > (0.2f*(maxRadiusScale-minRadiusScale)))
-            {
-                TreeGroup group;
-                group.position = pos;
-                group.radius = noise*baseGroupRadius;
-                group.spacing = baseSpacing;
-                mTreeGroups.push_back(group);
-            }
-        }
-    }
+void SCE::TerrainTrees::InvalidateRegion(const glm::vec2& min_worldspace, const glm::vec2& max_worldspace)
+{
+    //the worker reads the groups too, the next SpawnTreeInstances starts it again
+    mUpdateWorker.Cancel();
+    mUpdateWorker.Wait();
+    ui64 prevGroupBytes = SCE::Memory::VectorBytes(mTreeGroups) + SCE::TreeLayout::GetGroupGridBytes(mGroupGrid);
+
+    SCE::TreeLayout::UpdateTreeGroups(mLayoutParams.xOffset, mLayoutParams.zOffset, mLayoutParams.startScale,
+                                      mLayoutParams.heightScale, mLayoutParams.halfTerrainSize,
+                                      SCE::Terrain::GetTerrainHeight, SCE::Terrain::GetTerrainNormal,
+                                      min_worldspace, max_worldspace, mTreeGroups);
+    SCE::TreeLayout::InvalidatePlacements(min_worldspace, max_worldspace, mPlacementCache);
+
+    SCE::TreeLayout::BuildGroupGrid(mTreeGroups, TREE_GROUP_GRID_CELL_SIZE, mGroupGrid);
+    SCE::Memory::TrackResize(SCE::Memory::TAG_TREES, prevGroupBytes, SCE::Memory::VectorBytes(mTreeGroups) +
+                             SCE::TreeLayout::GetGroupGridBytes(mGroupGrid));
+    //don't wait for the next update period to show the trees at their new place
+    mLastUpdateTime = 0.0;
 }
 
 void SCE::TerrainTrees::SpawnTreeInstances(const glm::mat4& viewMatrix,
@@ -525,77 +417,132 @@ void SCE::TerrainTrees::SpawnTreeInstances(const glm::mat4& viewMatrix,
                                            const glm::vec3& cameraPosition,
                                            float maxDistFromCenter)
 {
-    bool isUpToDate = false;
-#if USE_THREADED_UPDATE
-    mTreeInstanceLock.lock();
-    isUpToDate = mInstancesUpToDate;
-    mTreeInstanceLock.unlock();
+    VisibilitySnapshot snapshot;
+    snapshot.viewMatrix = viewMatrix;
+    snapshot.cameraPosition_scenespace = cameraPosition;
+    snapshot.rootPosition_worldspace = SCEScene::GetFrameRootPosition();
+    snapshot.maxDistFromCenter = maxDistFromCenter;
 
-    if(!isUpToDate && mUpdateThread)
-    {
-        mUpdateThread->join();
-        mUpdateThread.release();
-    }
+#if USE_THREADED_UPDATE
+    bool isIdle = !mUpdateWorker.IsBusy();
 #else
-    SCE::TerrainTrees::UpdateVisibilityAndLOD(
-                            viewMatrix,
-                            worldToTerrainspaceMatrix,
-                            cameraPosition,
-                            maxDistFromCenter,
-                            mImpostorScaleMat);
+    SCE::Parallel::CancelToken notCancelled(false);
+    SCE::TerrainTrees::UpdateVisibilityAndLOD(snapshot, notCancelled);
 #endif
 
-    if(!isUpToDate)
+    //takes the last instances the update published, never waits for a running one
+    double consumeStart = SCE::Time::RealTimeInSeconds();
+    bool hasNewInstances = mTreeInstances.Consume();
+    mMaxConsumeTime = glm::max(mMaxConsumeTime, SCE::Time::RealTimeInSeconds() - consumeStart);
+    SCE::DebugText::LogMessage("Trees instances : " + std::to_string(mTreeInstances.GetPublishedCount()) +
+                               " published, " + std::to_string(mTreeInstances.GetDroppedCount()) +
+                               " dropped, longest handoff " + std::to_string(mMaxConsumeTime*1e6) + " us");
+
+    if(hasNewInstances)
     {
-        mTreeInstanceLock.lock();
+        const SCE::TreeLayout::TreeInstances& instances = mTreeInstances.GetReadBuffer();
         SCE::DebugText::LogMessage("Tree groups : " + std::to_string(mTreeGroups.size()));
+        SCE::DebugText::LogMessage("Trees LOD updates : " + std::to_string(instances.relodGroupCount) +
+                                   " of " + std::to_string(instances.visibleGroupCount) + " groups");
+
+        for(ui32 list = 0; list < TREE_LIST_COUNT; ++list)
+        {
+            UploadInstanceList(instances, list);
+        }
+        mUploadedUpdate = instances.update;
 
         for(uint lod = 0; lod < TREE_LOD_COUNT; ++lod)
         {
-            SCE::MeshRender::SetMeshInstanceMatrices(mTreeGlData.trunkMeshIds[lod],
-                                              mTreeMatrices[lod], GL_DYNAMIC_DRAW);
-            SCE::MeshRender::SetMeshInstanceMatrices(mTreeGlData.leavesMeshIds[lod],
-                                              mTreeMatrices[lod], GL_DYNAMIC_DRAW);
             SCE::DebugText::LogMessage("Trees lod " + std::to_string(lod) + " : " +
-                                  std::to_string(mTreeMatrices[lod].size()));
+                                  std::to_string(instances.trees[lod].size()));
         }
-
 #if USE_IMPOSTORS
         SCE::DebugText::LogMessage("Trees impostors " +
-                              std::to_string(mTreeImpostorMatrices.size()));
-
-        SCE::MeshRender::SetMeshInstanceMatrices(mTreeGlData.impostorData.meshId,
-                                          mTreeImpostorMatrices, GL_DYNAMIC_DRAW);
-        SCE::MeshRender::SetInstanceCustomData(
-                    mTreeGlData.impostorData.meshId,
-                    mTreeImpostorTexMapping.data(),
-                    mTreeImpostorTexMapping.size()*sizeof(mTreeImpostorTexMapping[0]),
-                    GL_DYNAMIC_DRAW,
-                    4,
-                    GL_FLOAT);
+                              std::to_string(instances.impostors.size()));
 #endif
-        mInstancesUpToDate = true;
-
-        mTreeInstanceLock.unlock();
+    }
 
 #if USE_THREADED_UPDATE
-        mUpdateThread.reset(new std::thread(&SCE::TerrainTrees::UpdateVisibilityAndLOD,
-                                            this,
-                                            viewMatrix,
-                                            worldToTerrainspaceMatrix,
-                                            cameraPosition,
-                                            maxDistFromCenter,
-                                            mImpostorScaleMat));
+    SCE::DebugText::LogMessage("Trees update latency : " +
+                               std::to_string(mUpdateWorker.GetLastLatency()*1000.0) + " ms");
+
+    //Updates start at most once per VisibilityUpdateDuration, with the camera of that frame
+    double time = SCE::Time::RealTimeInSeconds();
+    if(isIdle && time - mLastUpdateTime >= SCE::Quality::Trees::VisibilityUpdateDuration)
+    {
+        mLastUpdateTime = time;
+        mUpdateWorker.Submit([this, snapshot](const SCE::Parallel::CancelToken& cancel)
+        {
+            UpdateVisibilityAndLOD(snapshot, cancel);
+        });
+    }
+#endif
+}
+
+void SCE::TerrainTrees::UploadInstanceList(const SCE::TreeLayout::TreeInstances& instances, ui32 list)
+{
+    //the LODs are drawn by the trunk and leaves meshes, each with its own buffer
+    ui16 meshIds[2];
+    ui32 meshCount = 0;
+    if(list == TREE_IMPOSTOR_LIST)
+    {
+#if USE_IMPOSTORS
+        meshIds[meshCount++] = mTreeGlData.impostorData.meshId;
 #endif
     }
+    else
+    {
+        meshIds[meshCount++] = mTreeGlData.trunkMeshIds[list];
+        meshIds[meshCount++] = mTreeGlData.leavesMeshIds[list];
+    }
+
+    const std::vector<SCE::TreeLayout::CompactInstance>& trees = SCE::TreeLayout::GetInstanceList(instances, list);
+    const std::vector<ui32>& pageUpdates = instances.pageUpdates[list];
+    ui32 count = ui32(trees.size());
+    if(count > mInstanceCapacities[list])
+    {
+        //room for the list to grow a bit before the buffers are made again
+        mInstanceCapacities[list] = count + count/2;
+        for(ui32 i = 0; i < meshCount; ++i)
+        {
+            SCE::MeshRender::ReserveMeshInstanceData(meshIds[i], mInstanceCapacities[list], GL_DYNAMIC_DRAW);
+            SCE::MeshRender::UpdateMeshInstanceData(meshIds[i], trees.data(), 0, count);
+        }
+    }
+    else
+    {
+        //one upload per run of pages written since the last upload
+        ui32 pageCount = (count + TREE_INSTANCE_PAGE_SIZE - 1)/TREE_INSTANCE_PAGE_SIZE;
+        ui32 page = 0;
+        while(page < pageCount)
+        {
+            if(pageUpdates[page] <= mUploadedUpdate)
+            {
+                ++page;
+                continue;
+            }
+            ui32 first = page*TREE_INSTANCE_PAGE_SIZE;
+            while(page < pageCount && pageUpdates[page] > mUploadedUpdate)
+            {
+                ++page;
+            }
+            ui32 end = glm::min(page*TREE_INSTANCE_PAGE_SIZE, count);
+            for(ui32 i = 0; i < meshCount; ++i)
+            {
+                SCE::MeshRender::UpdateMeshInstanceData(meshIds[i], trees.data() + first, first, end - first);
+            }
+        }
+    }
+    for(ui32 i = 0; i < meshCount; ++i)
+    {
+        SCE::MeshRender::SetMeshInstanceCount(meshIds[i], count);
+    }
 }
 
 void SCE::TerrainTrees::RenderTrees(const mat4 &projectionMatrix, const mat4 &viewMatrix,
                                     bool isShadowPass)
 {
     {
-        mTreeInstanceLock.lock();
-
     #if !DOUBLE_SIDED_TREES
         glDisable(GL_CULL_FACE);
     #endif
@@ -617,6 +564,7 @@ void SCE::TerrainTrees::RenderTrees(const mat4 &projectionMatrix, const mat4 &vi
 
         SCE::TextureUtils::BindTexture(mTreeGlData.leafTexture, 0, mTreeGlData.leafTexUniform);
         glUniform1f(mTreeGlData.leavesTranslucencyUniform, TREE_LEAVES_TRANSLUCENCY);
+        SCE::RenderStats::CountUniformCalls();
 
         for(uint lod = 0; lod < TREE_LOD_COUNT; ++lod)
         {
@@ -631,7 +579,13 @@ void SCE::TerrainTrees::RenderTrees(const mat4 &projectionMatrix, const mat4 &vi
             glDisable(GL_CULL_FACE);
             //render tree impostors
             SCE::ShaderUtils::UseShader(mTreeGlData.impostorData.shaderProgram);
-            SCE::ShaderUtils::BindRootPosition(mTreeGlData.trunkShaderProgram, SCEScene::GetFrameRootPosition());
+            SCE::ShaderUtils::BindRootPosition(mTreeGlData.impostorData.shaderProgram,
+                                               SCEScene::GetFrameRootPosition());
+            //the instances only have the atlas cell, the shader finds its uvs
+            glUniformMatrix4fv(mTreeGlData.impostorData.scaleMatrixUniform, 1, GL_FALSE, &mImpostorScaleMat[0][0]);
+            glUniform1f(mTreeGlData.impostorData.atlasSizeUniform, glm::floor(glm::sqrt(float(NB_IMPOSTOR_ANGLES))));
+            glUniform1f(mTreeGlData.impostorData.atlasBorderUniform, IMPOSTOR_ATLAS_BORDER);
+            SCE::RenderStats::CountUniformCalls(3);
 
             SCE::TextureUtils::BindTexture(mTreeGlData.impostorData.texture, 0,
                                            mTreeGlData.impostorData.textureUniform);
@@ -647,6 +601,11 @@ void SCE::TerrainTrees::RenderTrees(const mat4 &projectionMatrix, const mat4 &vi
         glEnable(GL_CULL_FACE);
     #endif
 
-        mTreeInstanceLock.unlock();
+        //groups are culled against the main camera only
+        if(!isShadowPass)
+        {
+            const SCE::TreeLayout::TreeInstances& instances = mTreeInstances.GetReadBuffer();
+            SCE::RenderStats::CountVisibility(instances.visibleGroupCount, instances.culledGroupCount);
+        }
     }
 }
@@ -6,6 +6,7 @@
 
 #include "../headers/SCETextRenderer.hpp"
 #include "../headers/SCETools.hpp"
+#include "../headers/SCEMemory.hpp"
 
 #define STB_RECT_PACK_IMPLEMENTATION
 #include "stb_rect_pack.h"
@@ -146,6 +147,9 @@ namespace TextRenderer
             glBindTexture(GL_TEXTURE_2D, loadedRenderData.texture);
             glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, atlasWidth, atlasHeight, 0, GL_RED,
                          GL_UNSIGNED_BYTE, fontAtlasData.data());
+            SCE::Memory::TrackGLTexture(SCE::Memory::TAG_TEXT, loadedRenderData.texture,
+                                        SCE::Memory::ComputeTextureSize(atlasWidth, atlasHeight, 1,
+                                                                        GL_R8, false));
 
             glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
             glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
@@ -171,6 +175,9 @@ namespace TextRenderer
 
     void UnloadFont(ui16 fontId)
     {
+        SCE::Memory::UntrackGLTexture(fontsRenderData[fontId].texture);
+        SCE::Memory::UntrackGLBuffer(fontsRenderData[fontId].verticesBuffer);
+        SCE::Memory::UntrackGLBuffer(fontsRenderData[fontId].uvBuffer);
         glDeleteTextures(1, &fontsRenderData[fontId].texture);
         glDeleteBuffers(1, &fontsRenderData[fontId].verticesBuffer);
         glDeleteBuffers(1, &fontsRenderData[fontId].uvBuffer);
@@ -227,10 +234,14 @@ namespace TextRenderer
         //Render text
         glBindBuffer(GL_ARRAY_BUFFER, fontsRenderData[fontId].verticesBuffer);
         glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec3), &vertices[0], GL_DYNAMIC_DRAW);
+        SCE::Memory::TrackGLBuffer(SCE::Memory::TAG_TEXT, fontsRenderData[fontId].verticesBuffer,
+                                   vertices.size() * sizeof(glm::vec3));
 
 
         glBindBuffer(GL_ARRAY_BUFFER, fontsRenderData[fontId].uvBuffer);
         glBufferData(GL_ARRAY_BUFFER, uvs.size() * sizeof(glm::vec2), &uvs[0], GL_DYNAMIC_DRAW);
+        SCE::Memory::TrackGLBuffer(SCE::Memory::TAG_TEXT, fontsRenderData[fontId].uvBuffer,
+                                   uvs.size() * sizeof(glm::vec2));
 
 
 
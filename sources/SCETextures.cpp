@@ -8,6 +8,9 @@
 #include "../headers/SCETools.hpp"
 #include "../headers/SCEMetadataParser.hpp"
 #include "../headers/SCEInternal.hpp"
+#include "../headers/SCERenderStats.hpp"
+#include "../headers/SCEMemory.hpp"
+#include "../headers/SCELogger.hpp"
 
 //disable unneeded image formats
 #define STBI_NO_TGA
@@ -55,16 +58,18 @@ namespace TextureUtils
 
         ~TexturesData()
         {
-            Internal::Log("Cleaning up texture system, will delete loaded textures");
+            SCE_LOG_DEBUG(Logger::CAT_RESOURCES, "Cleaning up texture system, will delete loaded textures");
             auto beginIt = begin(loadedTextures);
             auto endIt = end(loadedTextures);
             for(auto iterator = beginIt; iterator != endIt; iterator++) {
-                Internal::Log("Deleting texture : " + iterator->first);
+                SCE_LOG_DEBUG(Logger::CAT_RESOURCES, "Deleting texture : " + iterator->first);
+                SCE::Memory::UntrackGLTexture(iterator->second);
                 glDeleteTextures(1, &(iterator->second));
             }
 
             for(GLuint texId : createdTextures)
             {
+                SCE::Memory::UntrackGLTexture(texId);
                 glDeleteTextures(1, &texId);
             }
         }
@@ -117,6 +122,9 @@ namespace TextureUtils
         glBindTexture(GL_TEXTURE_2D, textureID);
         glTexImage2D(GL_TEXTURE_2D, 0, internalGPUFormat, width, height, 0, textureFormat,
                      componentType, textureData);
+        SCE::Memory::TrackGLTexture(SCE::Memory::TAG_TEXTURES, textureID,
+                                    SCE::Memory::ComputeTextureSize(width, height, 1,
+                                                                    internalGPUFormat, mipmapsOn));
 
         if(mipmapsOn)
         {
@@ -153,7 +161,8 @@ namespace TextureUtils
             fullTexturePath = ENGINE_RESSOURCE_PATH + filename;
         }
 
-        Internal::Log(std::string("TODO : Compression format not yet used : ") + std::to_string(compressionFormat));
+        SCE_LOG_DEBUG(Logger::CAT_RESOURCES, std::string("TODO : Compression format not yet used : ") +
+                      std::to_string(compressionFormat));
 
         int width, height, nbComponent;
         unsigned char* textureData = stbi_load(fullTexturePath.c_str(),
@@ -280,7 +289,8 @@ namespace TextureUtils
                                       SCETextureFormat compressionFormat, SCETextureWrap wrapMode,
                                       bool mipmapsOn)
     {
-        Internal::Log(std::string("TODO : Compression format not yet used : ") + std::to_string(compressionFormat));
+        SCE_LOG_DEBUG(Logger::CAT_RESOURCES, std::string("TODO : Compression format not yet used : ") +
+                      std::to_string(compressionFormat));
 
         uint channelCount = 4;
         unsigned char *textureData = new unsigned char [width * height * channelCount];
@@ -311,7 +321,7 @@ namespace TextureUtils
         //texture has already been loaded
         if(texturesData.loadedTextures.count(textureName) > 0)
         {
-            Internal::Log("Texture " + textureName + " already loaded, using it directly");
+            SCE_LOG_DEBUG(Logger::CAT_RESOURCES, "Texture " + textureName + " already loaded, using it directly");
             return texturesData.loadedTextures[textureName];
         }
 
@@ -331,7 +341,8 @@ namespace TextureUtils
         //texture id was found in loaded textures
         if(itLoaded != end(texturesData.loadedTextures))
         {
-            Internal::Log("Delete texture : " + itLoaded->first);
+            SCE_LOG_DEBUG(Logger::CAT_RESOURCES, "Delete texture : " + itLoaded->first);
+            SCE::Memory::UntrackGLTexture(itLoaded->second);
             glDeleteTextures(1, &(itLoaded->second));
             texturesData.loadedTextures.erase(itLoaded);
         }
@@ -343,6 +354,7 @@ namespace TextureUtils
         //texture id was found in created textures
         if(itCreated != end(texturesData.createdTextures))
         {
+            SCE::Memory::UntrackGLTexture(textureId);
             glDeleteTextures(1, &textureId);
             texturesData.createdTextures.erase(itCreated);
         }
@@ -364,6 +376,8 @@ namespace TextureUtils
 
         // Set the sampler uniform to the texture unit
         glUniform1i(samplerUniformId, textureUnit);
+        SCE::RenderStats::CountTextureBind();
+        SCE::RenderStats::CountUniformCalls();
     }
 
     void BindSafeTexture(GLuint textureId, GLuint textureUnit, GLuint samplerUniformId)
@@ -373,6 +387,8 @@ namespace TextureUtils
         glBindTexture(GL_TEXTURE_2D, textureId);
         // Set the sampler uniform to the texture unit
         glUniform1i(samplerUniformId, textureUnit);
+        SCE::RenderStats::CountTextureBind();
+        SCE::RenderStats::CountUniformCalls();
     }
 
 #ifdef SCE_DEBUG_ENGINE
@@ -0,0 +1,423 @@
+/******PROJECT:Sand Castle Engine******/
+/**************************************/
+/*********AUTHOR:Gwenn AUBERT**********/
+/*****FILE:SCETiledHeightfield.cpp*****/
+/**************************************/
+
+#include "../headers/SCETiledHeightfield.hpp"
+#include "../headers/SCEInternal.hpp"
+#include "../headers/SCETools.hpp"
+#include "../headers/SCEParallel.hpp"
+#include "../headers/SCELogger.hpp"
+
+#include <cstring>
+#include <cstdio>
+
+#ifdef _WIN32
+#define USE_MMAP 0
+#else
+#define USE_MMAP 1
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#define TILED_FILE_MAGIC "SCET"
+//the tile data starts on a page boundary. The tiles are packed after it, so they all stay page aligned
+//only when a tile is a multiple of 4 KB (tiles of 32x32 texels and more)
+#define TILE_DATA_ALIGNMENT 4096
+//texel coordinates of every level must fit in an i32
+#define TILED_MAX_SIZE 0x10000
+//keeps the tile count of all the levels in a ui32
+#define TILED_MAX_TILES_PER_SIDE 0x8000
+
+namespace SCE
+{
+
+namespace TiledHeightfield
+{
+    namespace
+    {
+        struct FileHeader
+        {
+            char    magic[4];
+            ui32    version;
+            ui32    size;
+            ui32    tileSize;
+            ui32    levelCount;
+            ui32    tileCount;
+            float   heightScale;
+            float   texelSpacing;
+            ui64    dataOffset;
+            char    padding[24];
+        };
+        static_assert(sizeof(FileHeader) == 64, "Tiled heightfield header must be 64 bytes");
+        static_assert(sizeof(TileInfo) == 16, "Tiled heightfield tile entries must be 16 bytes");
+
+        bool isPowerOfTwo(ui32 val)
+        {
+            return val > 0 && (val & (val - 1)) == 0;
+        }
+
+        bool isValidSize(ui32 size, ui32 tileSize)
+        {
+            return isPowerOfTwo(size) && isPowerOfTwo(tileSize) && size >= tileSize && size <= TILED_MAX_SIZE &&
+                    size/tileSize <= TILED_MAX_TILES_PER_SIDE;
+        }
+
+        //levels go down to a single tile
+        ui32 computeLevelCount(ui32 size, ui32 tileSize)
+        {
+            ui32 levelCount = 1;
+            while((size >> (levelCount - 1)) > tileSize)
+            {
+                ++levelCount;
+            }
+            return levelCount;
+        }
+
+        void computeLevelFirstTiles(File& file)
+        {
+            file.levelFirstTile.resize(file.levelCount);
+            ui32 tileCount = 0;
+            for(ui32 level = 0; level < file.levelCount; ++level)
+            {
+                file.levelFirstTile[level] = tileCount;
+                ui32 tilesPerSide = GetTilesPerSide(file, level);
+                tileCount += tilesPerSide*tilesPerSide;
+            }
+        }
+
+        ui32 getTileIndex(const File& file, ui32 level, ui32 tileX, ui32 tileZ)
+        {
+            return file.levelFirstTile[level] + tileX*GetTilesPerSide(file, level) + tileZ;
+        }
+
+        //clamped to the level edges
+        const Heightmap::GPUTexel& texelAt(const File& file, ui32 level, i32 x, i32 z)
+        {
+            i32 maxCoord = i32(file.size >> level) - 1;
+            ui32 clampedX = ui32(glm::clamp(x, 0, maxCoord));
+            ui32 clampedZ = ui32(glm::clamp(z, 0, maxCoord));
+            const Heightmap::GPUTexel* tile = GetTile(file, level, clampedX / file.tileSize,
+                                                      clampedZ / file.tileSize);
+            return tile[(clampedX % file.tileSize)*file.tileSize + clampedZ % file.tileSize];
+        }
+
+        //2x2 average of the level above
+        float mipHeight(const File& file, ui32 level, i32 x, i32 z)
+        {
+            i32 maxCoord = i32(file.size >> level) - 1;
+            x = glm::clamp(x, 0, maxCoord);
+            z = glm::clamp(z, 0, maxCoord);
+            float sum = 0.0f;
+            for(i32 i = 0; i < 4; ++i)
+            {
+                sum += float(texelAt(file, level - 1, x*2 + (i >> 1), z*2 + (i & 1)).height);
+            }
+            return sum*0.25f*(file.heightScale / 65535.0f);
+        }
+
+        //heights of the tile texels and of a one texel border, for the normals
+        void fillTile(const File& file, TileInfo& info, ui32 level, ui32 tileX, ui32 tileZ,
+                      const std::function<float(i32, i32)>& getHeight, std::vector<float>& heights)
+        {
+            ui32 tileSize = file.tileSize;
+            ui32 borderSize = tileSize + 2;
+            heights.resize(borderSize*borderSize);
+            i32 firstX = i32(tileX*tileSize) - 1;
+            i32 firstZ = i32(tileZ*tileSize) - 1;
+            for(ui32 x = 0; x < borderSize; ++x)
+            {
+                for(ui32 z = 0; z < borderSize; ++z)
+                {
+                    heights[x*borderSize + z] = getHeight(firstX + i32(x), firstZ + i32(z));
+                }
+            }
+
+            Heightmap::GPUTexel* texels = (Heightmap::GPUTexel*)((char*)file.mapping + info.offset);
+            float spacing = file.texelSpacing*float(1u << level);
+            info.minHeight = 0xFFFF;
+            info.maxHeight = 0;
+            for(ui32 x = 0; x < tileSize; ++x)
+            {
+                for(ui32 z = 0; z < tileSize; ++z)
+                {
+                    ui32 center = (x + 1)*borderSize + z + 1;
+                    glm::vec3 normal(heights[center - borderSize] - heights[center + borderSize],
+                                     2.0f*spacing,
+                                     heights[center - 1] - heights[center + 1]);
+                    Heightmap::GPUTexel& texel = texels[x*tileSize + z];
+                    texel = Heightmap::PackGPUTexel(glm::normalize(normal), heights[center], file.heightScale);
+                    info.minHeight = glm::min(info.minHeight, texel.height);
+                    info.maxHeight = glm::max(info.maxHeight, texel.height);
+                }
+            }
+        }
+    }
+
+    bool Write(const std::string& filename, ui32 size, ui32 tileSize, float heightScale,
+               float texelSpacing, const HeightSource& getHeight)
+    {
+        if(!isValidSize(size, tileSize))
+        {
+            SCE_LOG_ERROR(Logger::CAT_TERRAIN, "Invalid tiled heightfield size : " + std::to_string(size) +
+                          ", tiles of " + std::to_string(tileSize));
+            return false;
+        }
+
+#if USE_MMAP
+        File file;
+        file.size = size;
+        file.tileSize = tileSize;
+        file.levelCount = computeLevelCount(size, tileSize);
+        file.heightScale = heightScale;
+        file.texelSpacing = texelSpacing;
+        computeLevelFirstTiles(file);
+        ui32 lastLevelTiles = GetTilesPerSide(file, file.levelCount - 1);
+        ui32 tileCount = file.levelFirstTile.back() + lastLevelTiles*lastLevelTiles;
+        ui64 tileBytes = ui64(tileSize)*ui64(tileSize)*sizeof(Heightmap::GPUTexel);
+        ui64 dataOffset = sizeof(FileHeader) + ui64(tileCount)*sizeof(TileInfo);
+        dataOffset = (dataOffset + TILE_DATA_ALIGNMENT - 1)/TILE_DATA_ALIGNMENT*TILE_DATA_ALIGNMENT;
+        ui64 fileBytes = dataOffset + ui64(tileCount)*tileBytes;
+
+        //mapped like Tools::WriteFileAtomically writes : to the temporary file, then renamed
+        std::string tmpFilename = Tools::GetTemporaryFilename(filename);
+        int fd = open(tmpFilename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if(fd < 0 || ftruncate(fd, off_t(fileBytes)) != 0)
+        {
+            SCE_LOG_ERROR(Logger::CAT_TERRAIN, "Could not write tiled heightfield : " + filename);
+            if(fd >= 0)
+            {
+                close(fd);
+                remove(tmpFilename.c_str());
+            }
+            return false;
+        }
+        //shared : the tiles are written straight to the file, no copy of the whole map in memory
+        void* mapping = mmap(nullptr, fileBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if(mapping == MAP_FAILED)
+        {
+            SCE_LOG_ERROR(Logger::CAT_TERRAIN, "Could not map tiled heightfield : " + filename);
+            remove(tmpFilename.c_str());
+            return false;
+        }
+        file.mapping = mapping;
+        file.mappingSize = fileBytes;
+
+        FileHeader* header = (FileHeader*)mapping;
+        memset(header, 0, sizeof(FileHeader));
+        memcpy(header->magic, TILED_FILE_MAGIC, 4);
+        header->version = TILED_HEIGHTFIELD_VERSION;
+        header->size = size;
+        header->tileSize = tileSize;
+        header->levelCount = file.levelCount;
+        header->tileCount = tileCount;
+        header->heightScale = heightScale;
+        header->texelSpacing = texelSpacing;
+        header->dataOffset = dataOffset;
+
+        TileInfo* tiles = (TileInfo*)((char*)mapping + sizeof(FileHeader));
+        for(ui32 i = 0; i < tileCount; ++i)
+        {
+            tiles[i].offset = dataOffset + ui64(i)*tileBytes;
+            tiles[i].minHeight = 0;
+            tiles[i].maxHeight = 0;
+            tiles[i].padding = 0;
+        }
+        file.tiles = tiles;
+
+        //each level only reads the one above it, its tiles are independent
+        i32 maxCoord = i32(size) - 1;
+        for(ui32 level = 0; level < file.levelCount; ++level)
+        {
+            ui32 tilesPerSide = GetTilesPerSide(file, level);
+            std::function<float(i32, i32)> levelHeight;
+            if(level == 0)
+            {
+                levelHeight = [&getHeight, maxCoord](i32 x, i32 z)
+                {
+                    return getHeight(ui32(glm::clamp(x, 0, maxCoord)), ui32(glm::clamp(z, 0, maxCoord)));
+                };
+            }
+            else
+            {
+                levelHeight = [&file, level](i32 x, i32 z) { return mipHeight(file, level, x, z); };
+            }
+
+            Parallel::For(0, int(tilesPerSide*tilesPerSide), 1, [&](int begin, int end)
+            {
+                std::vector<float> heights;
+                for(int tile = begin; tile < end; ++tile)
+                {
+                    ui32 tileX = ui32(tile) / tilesPerSide;
+                    ui32 tileZ = ui32(tile) % tilesPerSide;
+                    fillTile(file, tiles[getTileIndex(file, level, tileX, tileZ)], level, tileX, tileZ,
+                             levelHeight, heights);
+                }
+            });
+        }
+
+        bool synced = msync(mapping, fileBytes, MS_SYNC) == 0;
+        munmap(mapping, fileBytes);
+        if(!synced)
+        {
+            remove(tmpFilename.c_str());
+        }
+        if(!synced || !Tools::ReplaceWithTemporaryFile(filename))
+        {
+            SCE_LOG_ERROR(Logger::CAT_TERRAIN, "Could not write tiled heightfield : " + filename);
+            return false;
+        }
+        SCE_LOG_DEBUG(Logger::CAT_TERRAIN, "Tiled heightfield written : " + filename);
+        return true;
+#else
+        (void)heightScale;
+        (void)texelSpacing;
+        (void)getHeight;
+        SCE_LOG_ERROR(Logger::CAT_TERRAIN, "Tiled heightfields need mmap, not written : " + filename);
+        return false;
+#endif
+    }
+
+    bool Open(const std::string& filename, File& file)
+    {
+        Debug::Assert(file.mapping == nullptr, "Tiled heightfield already open");
+
+#if USE_MMAP
+        int fd = open(filename.c_str(), O_RDONLY);
+        if(fd < 0)
+        {
+            return false;
+        }
+        struct stat fileStat;
+        if(fstat(fd, &fileStat) != 0 || ui64(fileStat.st_size) < sizeof(FileHeader))
+        {
+            close(fd);
+            return false;
+        }
+        ui64 fileBytes = ui64(fileStat.st_size);
+        void* mapping = mmap(nullptr, fileBytes, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if(mapping == MAP_FAILED)
+        {
+            return false;
+        }
+
+        const FileHeader* header = (const FileHeader*)mapping;
+        File opened;
+        opened.size = header->size;
+        opened.tileSize = header->tileSize;
+        opened.levelCount = header->levelCount;
+        opened.heightScale = header->heightScale;
+        opened.texelSpacing = header->texelSpacing;
+        opened.mapping = mapping;
+        opened.mappingSize = fileBytes;
+        bool isValid = memcmp(header->magic, TILED_FILE_MAGIC, 4) == 0 &&
+                header->version == TILED_HEIGHTFIELD_VERSION &&
+                isValidSize(header->size, header->tileSize) &&
+                header->levelCount == computeLevelCount(header->size, header->tileSize);
+        if(isValid)
+        {
+            computeLevelFirstTiles(opened);
+            ui32 lastLevelTiles = GetTilesPerSide(opened, opened.levelCount - 1);
+            ui64 tileBytes = ui64(opened.tileSize)*ui64(opened.tileSize)*sizeof(Heightmap::GPUTexel);
+            //the tile table sits between the header and the tiles
+            ui64 tableEnd = sizeof(FileHeader) + ui64(header->tileCount)*sizeof(TileInfo);
+            isValid = header->tileCount == opened.levelFirstTile.back() + lastLevelTiles*lastLevelTiles &&
+                    tableEnd <= header->dataOffset && header->dataOffset <= fileBytes &&
+                    fileBytes - header->dataOffset >= ui64(header->tileCount)*tileBytes;
+            //GetTile trusts the offsets, every tile must be inside the data
+            const TileInfo* tiles = (const TileInfo*)((const char*)mapping + sizeof(FileHeader));
+            for(ui32 i = 0; isValid && i < header->tileCount; ++i)
+            {
+                isValid = tiles[i].offset >= header->dataOffset && tiles[i].offset <= fileBytes &&
+                        fileBytes - tiles[i].offset >= tileBytes;
+            }
+        }
+        if(!isValid)
+        {
+            SCE_LOG_ERROR(Logger::CAT_TERRAIN, "Invalid or out of date tiled heightfield : " + filename);
+            munmap(mapping, fileBytes);
+            return false;
+        }
+
+        opened.tiles = (const TileInfo*)((const char*)mapping + sizeof(FileHeader));
+        file = opened;
+        SCE_LOG_DEBUG(Logger::CAT_TERRAIN, "Tiled heightfield opened : " + filename + ", " +
+                      std::to_string(file.size) + " texels, " + std::to_string(file.levelCount) + " levels");
+        return true;
+#else
+        SCE_LOG_ERROR(Logger::CAT_TERRAIN, "Tiled heightfields need mmap, not opened : " + filename);
+        return false;
+#endif
+    }
+
+    void Close(File& file)
+    {
+        if(file.mapping == nullptr)
+        {
+            return;
+        }
+#if USE_MMAP
+        munmap(file.mapping, file.mappingSize);
+#endif
+        file = File();
+    }
+
+    const TileInfo& GetTileInfo(const File& file, ui32 level, ui32 tileX, ui32 tileZ)
+    {
+        return file.tiles[getTileIndex(file, level, tileX, tileZ)];
+    }
+
+    const Heightmap::GPUTexel* GetTile(const File& file, ui32 level, ui32 tileX, ui32 tileZ)
+    {
+        return (const Heightmap::GPUTexel*)((const char*)file.mapping +
+                                            GetTileInfo(file, level, tileX, tileZ).offset);
+    }
+
+    void ReadLevel(const File& file, ui32 level, Heightmap::GPUTexel* texels)
+    {
+        ui32 tileSize = file.tileSize;
+        ui32 levelSize = file.size >> level;
+        ui32 tilesPerSide = GetTilesPerSide(file, level);
+        for(ui32 tileX = 0; tileX < tilesPerSide; ++tileX)
+        {
+            for(ui32 tileZ = 0; tileZ < tilesPerSide; ++tileZ)
+            {
+                const Heightmap::GPUTexel* tile = GetTile(file, level, tileX, tileZ);
+                for(ui32 x = 0; x < tileSize; ++x)
+                {
+                    memcpy(texels + (tileX*tileSize + x)*levelSize + tileZ*tileSize,
+                           tile + x*tileSize, tileSize*sizeof(Heightmap::GPUTexel));
+                }
+            }
+        }
+    }
+
+    HeightPyramid::HeightRange GetRange(const File& file, float minX, float minZ, float maxX, float maxZ)
+    {
+        //texels joined by the cells under the region, see HeightPyramid::GetRange
+        i32 maxCoord = i32(file.size) - 1;
+        i32 firstX = glm::clamp(i32(glm::floor(minX - 0.5f)), 0, maxCoord);
+        i32 firstZ = glm::clamp(i32(glm::floor(minZ - 0.5f)), 0, maxCoord);
+        i32 lastX = glm::clamp(i32(glm::floor(maxX - 0.5f)) + 1, 0, maxCoord);
+        i32 lastZ = glm::clamp(i32(glm::floor(maxZ - 0.5f)) + 1, 0, maxCoord);
+
+        HeightPyramid::HeightRange range = { 0xFFFF, 0 };
+        for(ui32 tileX = ui32(firstX) / file.tileSize; tileX <= ui32(lastX) / file.tileSize; ++tileX)
+        {
+            for(ui32 tileZ = ui32(firstZ) / file.tileSize; tileZ <= ui32(lastZ) / file.tileSize; ++tileZ)
+            {
+                const TileInfo& info = GetTileInfo(file, 0, tileX, tileZ);
+                range.min = glm::min(range.min, info.minHeight);
+                range.max = glm::max(range.max, info.maxHeight);
+            }
+        }
+        return range;
+    }
+}
+
+}
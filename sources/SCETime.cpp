@@ -5,7 +5,7 @@
 /**************************************/
 
 #include "../headers/SCETime.hpp"
-#include <glfw3.h>
+#include <chrono>
 
 namespace SCE
 {
@@ -27,9 +27,19 @@ namespace Time
 
     static TimeData globalTimeData;
 
+    //used until a clock source is given, the core sets the glfw timer as source
+    double steadyClock()
+    {
+        typedef std::chrono::steady_clock Clock;
+        static const Clock::time_point origin = Clock::now();
+        return std::chrono::duration<double>(Clock::now() - origin).count();
+    }
+
+    static ClockSource clockSource = steadyClock;
+
     void updateTimeData(TimeData* timeData)
     {
-        double currentTime = glfwGetTime();
+        double currentTime = clockSource();
         timeData->mDeltaTime = currentTime - timeData->mLastTime;
         timeData->mDeltaTime *= timeData->mTimeSpeed;
         timeData->mDeltaTime = timeData->mDeltaTime > 1.0 ? 1.0 : timeData->mDeltaTime;
@@ -39,8 +49,8 @@ namespace Time
 
     void Init()
     {
-        globalTimeData.mStartTime = glfwGetTime();
-        globalTimeData.mLastTime = glfwGetTime();
+        globalTimeData.mStartTime = clockSource();
+        globalTimeData.mLastTime = globalTimeData.mStartTime;
     }
 
     void Update()
@@ -60,7 +70,7 @@ namespace Time
 
     double RealTimeInSeconds()
     {
-        return glfwGetTime() - globalTimeData.mStartTime;
+        return clockSource() - globalTimeData.mStartTime;
     }
 
     float GetTimeSpeed()
@@ -72,6 +82,11 @@ namespace Time
     {
         globalTimeData.mTimeSpeed = value;
     }
+
+    void SetClockSource(ClockSource source)
+    {
+        clockSource = source ? source : steadyClock;
+    }
 }
 
 }
@@ -5,7 +5,15 @@
 /**************************************/
 
 #include "../headers/SCETools.hpp"
+#include "../headers/SCELogger.hpp"
 #include <stdlib.h>
+#include <fstream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#endif
 
 using namespace std;
 
@@ -26,6 +34,8 @@ namespace Debug
     {
     #ifdef SCE_DEBUG
         LogError(errorMsg);
+        //make sure the error reaches the sinks before dying
+        Logger::Flush();
         abort();
     #else
         LogError(errorMsg);
@@ -34,12 +44,12 @@ namespace Debug
 
     void Log(const string &message)
     {
-        cout << message << endl;
+        SCE_LOG_INFO(Logger::CAT_GENERAL, message);
     }
 
     void LogError(const string &message)
     {
-        cerr << "[ERROR] " << message << endl;
+        SCE_LOG_ERROR(Logger::CAT_GENERAL, message);
     }
 }
 
@@ -58,6 +68,50 @@ namespace Tools
         return res;
     }
 
+    bool WriteFileAtomically(const string& filename, const std::vector<FileChunk>& chunks)
+    {
+        string tmpFilename = GetTemporaryFilename(filename);
+        std::ofstream file(tmpFilename.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+        if(!file.is_open())
+        {
+            return false;
+        }
+        for(const FileChunk& chunk : chunks)
+        {
+            file.write((const char*)chunk.data, std::streamsize(chunk.bytes));
+        }
+        file.close();
+        if(!file)
+        {
+            remove(tmpFilename.c_str());
+            return false;
+        }
+        return ReplaceWithTemporaryFile(filename);
+    }
+
+    string GetTemporaryFilename(const string& filename)
+    {
+        return filename + ".tmp";
+    }
+
+    bool ReplaceWithTemporaryFile(const string& filename)
+    {
+        string tmpFilename = GetTemporaryFilename(filename);
+#ifdef _WIN32
+        //rename fails on an existing file there
+        bool renamed = MoveFileExA(tmpFilename.c_str(), filename.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+        //replaces filename atomically, a crash leaves either the old file or the new one
+        bool renamed = rename(tmpFilename.c_str(), filename.c_str()) == 0;
+#endif
+        if(!renamed)
+        {
+            remove(tmpFilename.c_str());
+            return false;
+        }
+        return true;
+    }
+
     uint FloatToColorRange(float val)
     {
         return (int)(val * 255.0f);
@@ -185,12 +239,3 @@ namespace Math
 }
 
 }
-
-
-
-
-
-
-
-
-
@@ -0,0 +1,914 @@
+/******PROJECT:Sand Castle Engine******/
+/**************************************/
+/*********AUTHOR:Gwenn AUBERT**********/
+/********FILE:SCETreeLayout.cpp********/
+/**************************************/
+
+#include "../headers/SCETreeLayout.hpp"
+#include "../headers/SCETools.hpp"
+#include "../headers/SCEFrustrumCulling.hpp"
+#include "../headers/SCEQuality.hpp"
+#include "../headers/SCEMemory.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/constants.hpp>
+#include <algorithm>
+#include <cfloat>
+#include <atomic>
+
+#define USE_STB_PERLIN 1
+#if USE_STB_PERLIN
+    #ifndef STB_PERLIN_IMPLEMENTATION
+    #define STB_PERLIN_IMPLEMENTATION
+    #include <stb_perlin.h>
+    #endif
+#else
+#include "../headers/SCEPerlin.hpp"
+#endif
+
+#define TREE_PERLIN_SCALE 0.05f
+//how far trees move from their grid point, in multiples of the group spacing
+#define TREE_POSITION_NOISE_SCALE 5.0f
+//cached groups are kept a bit past the draw distance, so that going back and forth doesn't place them again
+#define TREE_CACHE_EVICT_DISTANCE_RATIO 1.25f
+//the LODs are computed again a bit before a tree reaches a LOD distance, for rounding errors
+#define TREE_LOD_MARGIN_EPSILON 0.01f
+
+namespace SCE
+{
+
+namespace TreeLayout
+{
+
+    namespace
+    {
+        //grid of candidate group positions over the terrain
+        int getTreeGroupIter(float halfTerrainSize)
+        {
+            //number of time the map is divided to form tree groups
+            float divPerKm = SCE::Quality::Trees::NbGroupPerKm;
+            return int(divPerKm*halfTerrainSize/1000.0f);
+        }
+
+        //appends the group of grid point (xCount, zCount) when the terrain there allows it
+        void addTreeGroup(int xCount, int zCount, int treeGroupIter, float xOffset, float zOffset,
+                          float startScale, float heightScale, float halfTerrainSize,
+                          const HeightQuery& getHeight, const NormalQuery& getNormal,
+                          std::vector<TreeGroup>& groups)
+        {
+            float divPerKm = SCE::Quality::Trees::NbGroupPerKm;
+            float scale = startScale;
+            float baseGroupRadius = (1000.0f/divPerKm);
+            float maxRadiusScale = 1.3f;
+            float minRadiusScale = 0.7f;
+            float baseSpacing = SCE::Quality::Trees::BaseSpacing;
+
+            float x = float(xCount) / float(treeGroupIter);
+            float z = float(zCount) / float(treeGroupIter);
+
+#if USE_STB_PERLIN
+            float y = 115.0f; //any value will do, just need to be something other than the terrain height
+            float noise = stb_perlin_noise3((x + xOffset)*scale, y*scale, (z + zOffset)*scale);
+            noise = SCE::Math::MapToRange(-0.7f, 0.7f, minRadiusScale, maxRadiusScale, noise);
+#else
+            float noise = Perlin::GetPerlinAt((x + xOffset)*scale, (z + zOffset)*scale);
+            noise = SCE::Math::MapToRange(-0.5f, 0.5f, minRadiusScale, maxRadiusScale, noise);
+#endif
+            glm::vec2 pos = (glm::vec2(x, z)*2.0f - vec2(1.0, 1.0))*halfTerrainSize;
+
+            glm::vec3 normal = getNormal(glm::vec3(pos.x, 0.0f, pos.y));
+            float height = getHeight(glm::vec3(pos.x, 0.0f, pos.y))/heightScale;
+
+            float flatness = pow(dot(normal, vec3(0.0f, 1.0f, 0.0f)), 8.0f);
+            //Spawn tree at low height on flat terrain
+            if(height < 0.3f && flatness > 0.6f
+               && (noise - minRadiusScale) > (0.2f*(maxRadiusScale-minRadiusScale)))
+            {
+                TreeGroup group;
+                group.position = pos;
+                group.radius = noise*baseGroupRadius;
+                group.spacing = baseSpacing;
+                group.height = height*heightScale;
+                group.gridIndex = ui32(xCount*treeGroupIter + zCount);
+                groups.push_back(group);
+            }
+        }
+
+        //trees per side of a group, the same loop as placeGroupTrees
+        ui32 getTreesPerSide(const TreeGroup& group)
+        {
+            ui32 count = 0;
+            for(float x = -group.radius; x < group.radius; x += group.spacing)
+            {
+                ++count;
+            }
+            return count;
+        }
+
+        //farthest a tree of the group can be from its center
+        float getGroupReach(const TreeGroup& group)
+        {
+            return group.radius*glm::root_two<float>() + group.spacing*TREE_POSITION_NOISE_SCALE;
+        }
+
+        //deterministic trees of the group : position from its grid and non-random noise, scale and rotation
+        void placeGroupTrees(const TreeGroup& group, PlacementCache& cache, ui32 first,
+                             const HeightBatchQuery& getHeights)
+        {
+            float noiseX, noiseZ;
+            ui32 index = first;
+            for(float x = -group.radius; x < group.radius; x += group.spacing)
+            {
+                for(float z = -group.radius; z < group.radius; z += group.spacing)
+                {
+                    glm::vec3 treePos(x + group.position.x, 0.0f, z + group.position.y);
+
+#if USE_STB_PERLIN
+                    noiseX = stb_perlin_noise3(treePos.x*TREE_PERLIN_SCALE, 25.0f,
+                                               treePos.z*TREE_PERLIN_SCALE);
+                    noiseZ = stb_perlin_noise3(treePos.z*TREE_PERLIN_SCALE, 25.0f,
+                                               treePos.x*TREE_PERLIN_SCALE);
+                    //scale to apply to the tree
+                    float scale = SCE::Math::MapToRange(-0.6f, 0.6f, 1.0f, 1.8f, noiseZ);
+#else
+                    noiseX = Perlin::GetPerlinAt(treePos.x*TREE_PERLIN_SCALE, treePos.z*TREE_PERLIN_SCALE);
+                    noiseZ = Perlin::GetPerlinAt(treePos.z*TREE_PERLIN_SCALE, treePos.x*TREE_PERLIN_SCALE);
+                    //scale to apply to the tree
+                    float scale = SCE::Math::MapToRange(-0.5f, 0.5f, 0.8f, 1.4f, noiseZ);
+#endif
+
+                    cache.treeX[index] = treePos.x + noiseX*group.spacing*TREE_POSITION_NOISE_SCALE;
+                    cache.treeZ[index] = treePos.z + noiseZ*group.spacing*TREE_POSITION_NOISE_SCALE;
+                    cache.treeScales[index] = scale;
+                    cache.treeNoises[index] = noiseX;
+                    ++index;
+                }
+            }
+
+            ui32 count = index - first;
+            getHeights(&cache.treeX[first], &cache.treeZ[first], &cache.treeY[first], int(count));
+            for(ui32 i = first; i < index; ++i)
+            {
+                //go slightly down to avoid sticking out of the ground
+                cache.treeY[i] -= 2.0f*cache.treeScales[i];
+            }
+        }
+
+        //drops every cached group, slots grow to hold the biggest group seen
+        //ids start at 1, 0 is the cache of the instances nothing wrote yet
+        std::atomic<ui32> nextPlacementCacheId(1);
+
+        void resetPlacementCache(PlacementCache& cache, ui32 slotCapacity)
+        {
+            ui32 update = cache.update;
+            ui32 id = cache.id;
+            cache = PlacementCache();
+            cache.slotCapacity = slotCapacity;
+            cache.update = update;
+            cache.id = id;
+        }
+
+        void markPage(PlacementCache& cache, ui32 list, ui32 place)
+        {
+            std::vector<ui32>& pageUpdates = cache.drawnPageUpdates[list];
+            ui32 page = place / TREE_INSTANCE_PAGE_SIZE;
+            if(page >= pageUpdates.size())
+            {
+                pageUpdates.resize(page + 1);
+            }
+            pageUpdates[page] = cache.update;
+        }
+
+        //the last instance of the list takes the place of the tree
+        void hideTree(PlacementCache& cache, ui32 tree)
+        {
+            ui32 list = cache.treeLists[tree];
+            if(list == TREE_LOD_HIDDEN)
+            {
+                return;
+            }
+            std::vector<CompactInstance>& instances = cache.drawnInstances[list];
+            std::vector<ui32>& trees = cache.drawnTrees[list];
+            ui32 place = cache.treePlaces[tree];
+            ui32 last = ui32(trees.size()) - 1;
+            if(place != last)
+            {
+                instances[place] = instances[last];
+                trees[place] = trees[last];
+                cache.treePlaces[trees[place]] = place;
+                markPage(cache, list, place);
+            }
+            instances.pop_back();
+            trees.pop_back();
+            cache.treeLists[tree] = TREE_LOD_HIDDEN;
+        }
+
+        void showTree(PlacementCache& cache, ui32 tree, ui32 list, const CompactInstance& instance)
+        {
+            ui32 place = ui32(cache.drawnTrees[list].size());
+            cache.drawnInstances[list].push_back(instance);
+            cache.drawnTrees[list].push_back(tree);
+            cache.treeLists[tree] = ui8(list);
+            cache.treePlaces[tree] = place;
+            markPage(cache, list, place);
+        }
+
+        //moves the trees of the slot to the lists of their LOD. The model instances only depend on the
+        //tree and its LOD, the impostors are written again when their LODs were computed again
+        void drawSlot(PlacementCache& cache, ui32 slot, bool isRelod)
+        {
+            if(cache.slotDrawnUpdates[slot] == 0)
+            {
+                cache.drawnSlots.push_back(slot);
+            }
+            cache.slotDrawnUpdates[slot] = cache.update;
+
+            ui32 first = slot*cache.slotCapacity;
+            for(ui32 i = first; i < first + cache.slotTreeCounts[slot]; ++i)
+            {
+                ui32 list = cache.treeLods[i];
+                if(cache.treeLists[i] == list)
+                {
+                    if(list == TREE_IMPOSTOR_LIST && isRelod)
+                    {
+                        cache.drawnInstances[list][cache.treePlaces[i]] = cache.treeImpostors[i];
+                        markPage(cache, list, cache.treePlaces[i]);
+                    }
+                    continue;
+                }
+                hideTree(cache, i);
+                if(list == TREE_IMPOSTOR_LIST)
+                {
+                    showTree(cache, i, list, cache.treeImpostors[i]);
+                }
+                else if(list != TREE_LOD_HIDDEN)
+                {
+                    glm::vec3 treePos(cache.treeX[i], cache.treeY[i], cache.treeZ[i]);
+                    showTree(cache, i, list, EncodeInstance(treePos, cache.treeScales[i],
+                                                            cache.treeNoises[i]*10.0f, list));
+                }
+            }
+        }
+
+        void hideSlot(PlacementCache& cache, ui32 slot)
+        {
+            ui32 first = slot*cache.slotCapacity;
+            for(ui32 i = first; i < first + cache.slotTreeCounts[slot]; ++i)
+            {
+                hideTree(cache, i);
+            }
+            cache.slotDrawnUpdates[slot] = 0;
+        }
+
+        //copies the pages written since instances were, the page updates and the list sizes
+        void copyDrawnLists(const PlacementCache& cache, TreeInstances& instances)
+        {
+            if(instances.cacheId != cache.id)
+            {
+                instances.update = 0;
+            }
+            for(ui32 list = 0; list < TREE_LIST_COUNT; ++list)
+            {
+                const std::vector<CompactInstance>& drawn = cache.drawnInstances[list];
+                std::vector<CompactInstance>& copy = list == TREE_IMPOSTOR_LIST ? instances.impostors :
+                                                                                  instances.trees[list];
+                copy.resize(drawn.size());
+                instances.pageUpdates[list] = cache.drawnPageUpdates[list];
+                for(ui32 start = 0; start < drawn.size(); start += TREE_INSTANCE_PAGE_SIZE)
+                {
+                    if(cache.drawnPageUpdates[list][start / TREE_INSTANCE_PAGE_SIZE] > instances.update)
+                    {
+                        ui32 end = glm::min(start + TREE_INSTANCE_PAGE_SIZE, ui32(drawn.size()));
+                        std::copy(drawn.begin() + start, drawn.begin() + end, copy.begin() + start);
+                    }
+                }
+            }
+            instances.update = cache.update;
+            instances.cacheId = cache.id;
+        }
+
+        //what a cancelled update leaves, the next one writes the lists whole
+        void clearInstances(TreeInstances& instances)
+        {
+            for(int lod = 0; lod < TREE_LOD_COUNT; ++lod)
+            {
+                instances.trees[lod].clear();
+            }
+            instances.impostors.clear();
+            instances.update = 0;
+        }
+
+        void releaseSlot(PlacementCache& cache, ui32 slot)
+        {
+            if(cache.slotDrawnUpdates[slot] != 0)
+            {
+                hideSlot(cache, slot);
+                cache.drawnSlots.erase(std::find(cache.drawnSlots.begin(), cache.drawnSlots.end(), slot));
+            }
+            cache.groupSlots.erase(cache.slotGroups[slot]);
+            cache.slotTreeCounts[slot] = 0;
+            cache.slotLodStates[slot].z = -1.0f;
+            cache.freeSlots.push_back(slot);
+        }
+
+        //slot of the group trees, placed now if they aren't cached
+        ui32 getGroupSlot(const TreeGroup& group, const HeightBatchQuery& getHeights, PlacementCache& cache)
+        {
+            std::unordered_map<ui32, ui32>::const_iterator found = cache.groupSlots.find(group.gridIndex);
+            if(found != cache.groupSlots.end())
+            {
+                return found->second;
+            }
+
+            ui32 slot;
+            if(!cache.freeSlots.empty())
+            {
+                slot = cache.freeSlots.back();
+                cache.freeSlots.pop_back();
+            }
+            else
+            {
+                slot = ui32(cache.slotTreeCounts.size());
+                cache.slotTreeCounts.push_back(0);
+                cache.slotBounds.push_back(glm::vec3(0.0f));
+                cache.slotGroups.push_back(0);
+                cache.slotLodStates.push_back(glm::vec3(0.0f));
+                cache.slotDrawnUpdates.push_back(0);
+                ui64 treeCount = ui64(slot + 1)*cache.slotCapacity;
+                cache.treeX.resize(treeCount);
+                cache.treeY.resize(treeCount);
+                cache.treeZ.resize(treeCount);
+                cache.treeScales.resize(treeCount);
+                cache.treeNoises.resize(treeCount);
+                cache.treeLods.resize(treeCount, TREE_LOD_HIDDEN);
+                cache.treeImpostors.resize(treeCount);
+                cache.treeLists.resize(treeCount, TREE_LOD_HIDDEN);
+                cache.treePlaces.resize(treeCount);
+            }
+
+            ui32 perSide = getTreesPerSide(group);
+            cache.slotTreeCounts[slot] = perSide*perSide;
+            cache.slotBounds[slot] = glm::vec3(group.position.x, group.position.y, getGroupReach(group));
+            cache.slotGroups[slot] = group.gridIndex;
+            cache.groupSlots[group.gridIndex] = slot;
+            cache.slotLodStates[slot].z = -1.0f;
+            placeGroupTrees(group, cache, slot*cache.slotCapacity, getHeights);
+            return slot;
+        }
+
+        //forgets the LODs if they were computed with other settings
+        void checkLodSettings(PlacementCache& cache, float maxDrawDistance, float maxDistFromCenter)
+        {
+            bool isSame = cache.lodMaxDrawDistance == maxDrawDistance &&
+                    cache.lodMaxDistFromCenter == maxDistFromCenter;
+            for(int lod = 0; lod < TREE_LOD_COUNT; ++lod)
+            {
+                isSame = isSame && cache.lodDistances[lod] == SCE::Quality::Trees::LodDistances[lod];
+                cache.lodDistances[lod] = SCE::Quality::Trees::LodDistances[lod];
+            }
+            cache.lodMaxDrawDistance = maxDrawDistance;
+            cache.lodMaxDistFromCenter = maxDistFromCenter;
+            if(!isSame)
+            {
+                InvalidateLods(cache);
+            }
+        }
+
+        bool isLodStale(const PlacementCache& cache, ui32 slot, const glm::vec2& camPos2)
+        {
+            const glm::vec3& state = cache.slotLodStates[slot];
+            return state.z < 0.0f ||
+                    glm::length(camPos2 - glm::vec2(state.x, state.y)) >= state.z - TREE_LOD_MARGIN_EPSILON;
+        }
+
+        //LOD of each tree of the slot, impostors turned to the camera. Also finds how far the camera
+        //can go before that changes : the closest any tree is to a LOD distance or to the draw distance,
+        //and the distance after which an impostor faces more than TREE_IMPOSTOR_REFACE_ANGLE away
+        void computeSlotLods(PlacementCache& cache, ui32 slot, const glm::vec3& camPosition_worldspace,
+                             float maxDrawDistance, float maxDistFromCenter)
+        {
+            glm::vec2 camPos2 = glm::vec2(camPosition_worldspace.x, camPosition_worldspace.z);
+            ui32 first = slot*cache.slotCapacity;
+            ui32 count = cache.slotTreeCounts[slot];
+            float margin = FLT_MAX;
+
+            int lodGroup = 0;
+            for(ui32 i = first; i < first + count; ++i)
+            {
+                ui8& treeLod = cache.treeLods[i];
+                treeLod = TREE_LOD_HIDDEN;
+                float treeX = cache.treeX[i];
+                float treeZ = cache.treeZ[i];
+                float distToCam = glm::length(glm::vec2(treeX, treeZ) - camPos2);
+
+                //tree could have spawn outside of terrain, only keep if inside
+                if(abs(treeX) >= maxDistFromCenter || abs(treeZ) >= maxDistFromCenter)
+                {
+                    continue;
+                }
+                margin = glm::min(margin, glm::abs(distToCam - maxDrawDistance));
+                if(distToCam >= maxDrawDistance)
+                {
+                    continue;
+                }
+
+                for(lodGroup = 0; lodGroup < TREE_LOD_COUNT; ++lodGroup)
+                {
+                    if(SCE::Quality::Trees::LodDistances[lodGroup] > 0.0f)
+                    {
+                        margin = glm::min(margin, glm::abs(distToCam - SCE::Quality::Trees::LodDistances[lodGroup]));
+                    }
+                }
+                for(lodGroup = 0; lodGroup < TREE_LOD_COUNT; ++lodGroup)
+                {
+                    if(distToCam < SCE::Quality::Trees::LodDistances[lodGroup])
+                    {
+                        break;
+                    }
+                }
+
+                if(lodGroup < TREE_LOD_COUNT)
+                {
+                    treeLod = ui8(lodGroup);
+                }
+#if USE_IMPOSTORS
+                //make an impostor
+                else
+                {
+                    //put tree at the surface of terrain
+                    glm::vec3 treePos(treeX, cache.treeY[i], treeZ);
+                    float noiseX = cache.treeNoises[i];
+
+                    //rotate plane to face camera
+                    glm::vec3 dirToCam = glm::normalize(camPosition_worldspace - treePos);
+#if IMPOSTOR_FACE_Z
+                    float angleYAxis = glm::atan(1.0f, 0.0f) -
+                            glm::atan(dirToCam.z, dirToCam.x);
+                    ui32 view = GetImpostorView(noiseX*10.0f-angleYAxis, NB_IMPOSTOR_ANGLES);
+#else
+                    float angleYAxis = glm::atan(-1.0f, 0.0f) -
+                            glm::atan(dirToCam.z, dirToCam.x);
+                    ui32 view = GetImpostorView(noiseX*-10.0f+angleYAxis, NB_IMPOSTOR_ANGLES);
+#endif
+                    treeLod = TREE_IMPOSTOR_LIST;
+                    cache.treeImpostors[i] = EncodeInstance(treePos, cache.treeScales[i], angleYAxis, view);
+                    //moving the camera sideways by d turns the direction to the tree by at most d/distance
+                    margin = glm::min(margin, distToCam*TREE_IMPOSTOR_REFACE_ANGLE);
+                }
+#endif
+            }
+
+            cache.slotLodStates[slot] = glm::vec3(camPos2, margin);
+        }
+
+        //inverse of the grid position computation of addTreeGroup
+        inline float toGridCoord(float pos, float halfTerrainSize, int treeGroupIter)
+        {
+            return (pos/halfTerrainSize + 1.0f)*0.5f*float(treeGroupIter);
+        }
+    }
+
+    PlacementCache::PlacementCache()
+        : slotCapacity(0), lodMaxDrawDistance(0.0f), lodMaxDistFromCenter(0.0f), update(0),
+          id(nextPlacementCacheId++)
+    {
+        for(int i = 0; i < TREE_LOD_COUNT; ++i)
+        {
+            lodDistances[i] = 0.0f;
+        }
+    }
+
+    void GenerateTreeGroups(float xOffset, float zOffset, float startScale,
+                            float heightScale, float halfTerrainSize,
+                            const HeightQuery& getHeight, const NormalQuery& getNormal,
+                            std::vector<TreeGroup>& groups)
+    {
+        int treeGroupIter = getTreeGroupIter(halfTerrainSize);
+        for(int xCount = 0; xCount < treeGroupIter; ++xCount)
+        {
+            for(int zCount = 0; zCount < treeGroupIter; ++zCount)
+            {
+                addTreeGroup(xCount, zCount, treeGroupIter, xOffset, zOffset, startScale, heightScale,
+                             halfTerrainSize, getHeight, getNormal, groups);
+            }
+        }
+    }
+
+    void UpdateTreeGroups(float xOffset, float zOffset, float startScale,
+                          float heightScale, float halfTerrainSize,
+                          const HeightQuery& getHeight, const NormalQuery& getNormal,
+                          const glm::vec2& min_worldspace, const glm::vec2& max_worldspace,
+                          std::vector<TreeGroup>& groups)
+    {
+        int treeGroupIter = getTreeGroupIter(halfTerrainSize);
+        //grid points inside [min, max]
+        int firstX = glm::max(0, int(glm::ceil(toGridCoord(min_worldspace.x, halfTerrainSize, treeGroupIter))));
+        int firstZ = glm::max(0, int(glm::ceil(toGridCoord(min_worldspace.y, halfTerrainSize, treeGroupIter))));
+        int lastX = glm::min(treeGroupIter - 1,
+                             int(glm::floor(toGridCoord(max_worldspace.x, halfTerrainSize, treeGroupIter))));
+        int lastZ = glm::min(treeGroupIter - 1,
+                             int(glm::floor(toGridCoord(max_worldspace.y, halfTerrainSize, treeGroupIter))));
+        if(firstX > lastX || firstZ > lastZ)
+        {
+            return;
+        }
+
+        //groups sit on their grid point, find it back from the position
+        groups.erase(std::remove_if(groups.begin(), groups.end(), [=](const TreeGroup& group)
+        {
+            int x = int(glm::round(toGridCoord(group.position.x, halfTerrainSize, treeGroupIter)));
+            int z = int(glm::round(toGridCoord(group.position.y, halfTerrainSize, treeGroupIter)));
+            return x >= firstX && x <= lastX && z >= firstZ && z <= lastZ;
+        }), groups.end());
+
+        for(int xCount = firstX; xCount <= lastX; ++xCount)
+        {
+            for(int zCount = firstZ; zCount <= lastZ; ++zCount)
+            {
+                addTreeGroup(xCount, zCount, treeGroupIter, xOffset, zOffset, startScale, heightScale,
+                             halfTerrainSize, getHeight, getNormal, groups);
+            }
+        }
+    }
+
+    void BuildGroupGrid(const std::vector<TreeGroup>& groups, float cellSize, GroupGrid& grid)
+    {
+        grid = GroupGrid();
+        grid.cellSize = cellSize;
+        if(groups.empty())
+        {
+            return;
+        }
+
+        glm::vec2 minPosition = groups[0].position;
+        glm::vec2 maxPosition = groups[0].position;
+        for(const TreeGroup& group : groups)
+        {
+            minPosition = glm::min(minPosition, group.position);
+            maxPosition = glm::max(maxPosition, group.position);
+            grid.maxReach = glm::max(grid.maxReach, getGroupReach(group));
+        }
+        glm::vec2 extent = maxPosition - minPosition;
+        grid.origin = minPosition;
+        grid.cellsPerSide = ui32(glm::floor(glm::max(extent.x, extent.y)/cellSize)) + 1;
+
+        //counting sort of the groups by cell
+        ui32 cellCount = grid.cellsPerSide*grid.cellsPerSide;
+        std::vector<ui32> groupCells(groups.size());
+        grid.cellStarts.assign(cellCount + 1, 0);
+        grid.cellMin.assign(cellCount, glm::vec3(FLT_MAX));
+        grid.cellMax.assign(cellCount, glm::vec3(-FLT_MAX));
+        for(size_t i = 0; i < groups.size(); ++i)
+        {
+            const TreeGroup& group = groups[i];
+            glm::uvec2 cell = glm::min(glm::uvec2((group.position - grid.origin)/cellSize),
+                                       glm::uvec2(grid.cellsPerSide - 1));
+            ui32 cellIndex = cell.x*grid.cellsPerSide + cell.y;
+            groupCells[i] = cellIndex;
+            ++grid.cellStarts[cellIndex + 1];
+
+            //same sphere as the per group culling
+            float totalRadius = group.radius + group.spacing*TREE_POSITION_NOISE_SCALE;
+            glm::vec3 center(group.position.x, group.height, group.position.y);
+            grid.cellMin[cellIndex] = glm::min(grid.cellMin[cellIndex], center - totalRadius);
+            grid.cellMax[cellIndex] = glm::max(grid.cellMax[cellIndex], center + totalRadius);
+        }
+        for(ui32 i = 0; i < cellCount; ++i)
+        {
+            grid.cellStarts[i + 1] += grid.cellStarts[i];
+        }
+
+        std::vector<ui32> cellEnds(grid.cellStarts.begin(), grid.cellStarts.end() - 1);
+        grid.cellGroups.resize(groups.size());
+        for(size_t i = 0; i < groups.size(); ++i)
+        {
+            grid.cellGroups[cellEnds[groupCells[i]]++] = ui32(i);
+        }
+    }
+
+    void ComputeVisibilityAndLOD(const std::vector<TreeGroup>& groups,
+                                 const GroupGrid& grid,
+                                 const glm::mat4& viewMatrix,
+                                 const glm::vec3& rootPosition_worldspace,
+                                 const glm::vec3& cameraPosition_scenespace,
+                                 float maxDistFromCenter,
+                                 const HeightBatchQuery& getHeights,
+                                 const Parallel::CancelToken& cancel,
+                                 PlacementCache& cache,
+                                 TreeInstances& instances)
+    {
+        ++cache.update;
+
+        glm::vec3 camPosition_worldspace = rootPosition_worldspace + cameraPosition_scenespace;
+        glm::vec2 camPos2 = glm::vec2(camPosition_worldspace.x, camPosition_worldspace.z);
+        float maxDrawDistance = SCE::Quality::Trees::MaxDrawDistance;
+
+        //cells that may hold a group in range : around the camera, as far as a tree can be drawn
+        std::vector<TreeGroup const*> activeGroups;
+        if(grid.cellsPerSide > 0)
+        {
+            float cellRange = maxDrawDistance + grid.maxReach;
+            glm::vec2 rangeMin = glm::floor((camPos2 - cellRange - grid.origin)/grid.cellSize);
+            glm::vec2 rangeMax = glm::floor((camPos2 + cellRange - grid.origin)/grid.cellSize);
+            float lastCell = float(grid.cellsPerSide - 1);
+            glm::ivec2 firstCell = glm::ivec2(glm::clamp(rangeMin, glm::vec2(0.0f), glm::vec2(lastCell)));
+            glm::ivec2 endCell = glm::ivec2(glm::clamp(rangeMax, glm::vec2(-1.0f), glm::vec2(lastCell))) + 1;
+            glm::mat4 worldToCamera = viewMatrix*glm::translate(glm::mat4(1.0f), -rootPosition_worldspace);
+
+            for(int x = firstCell.x; x < endCell.x; ++x)
+            {
+                if(cancel)
+                {
+                    clearInstances(instances);
+                    return;
+                }
+                for(int z = firstCell.y; z < endCell.y; ++z)
+                {
+                    ui32 cellIndex = ui32(x)*grid.cellsPerSide + ui32(z);
+                    ui32 groupBegin = grid.cellStarts[cellIndex];
+                    ui32 groupEnd = grid.cellStarts[cellIndex + 1];
+                    if(groupBegin == groupEnd)
+                    {
+                        continue;
+                    }
+
+                    //group centers are inside the cell
+                    glm::vec2 cellStart = grid.origin + glm::vec2(float(x), float(z))*grid.cellSize;
+                    glm::vec2 closest = glm::clamp(camPos2, cellStart, cellStart + grid.cellSize);
+                    if(glm::length(camPos2 - closest) - grid.maxReach >= maxDrawDistance)
+                    {
+                        continue;
+                    }
+
+                    const glm::vec3& boundsMin = grid.cellMin[cellIndex];
+                    glm::vec3 extent = grid.cellMax[cellIndex] - boundsMin;
+                    glm::vec4 center_cameraspace = worldToCamera*glm::vec4(boundsMin + extent*0.5f, 1.0f);
+                    FrustrumCulling::BoxCulling culling =
+                            FrustrumCulling::ClassifyBox(center_cameraspace,
+                                                         worldToCamera*glm::vec4(extent.x, 0.0f, 0.0f, 0.0f),
+                                                         worldToCamera*glm::vec4(0.0f, extent.y, 0.0f, 0.0f),
+                                                         worldToCamera*glm::vec4(0.0f, 0.0f, extent.z, 0.0f));
+                    if(culling == FrustrumCulling::BOX_OUTSIDE)
+                    {
+                        continue;
+                    }
+
+                    for(ui32 i = groupBegin; i < groupEnd; ++i)
+                    {
+                        TreeGroup const& group = groups[grid.cellGroups[i]];
+                        //none of its trees can be drawn
+                        if(glm::length(camPos2 - group.position) - getGroupReach(group) >= maxDrawDistance)
+                        {
+                            continue;
+                        }
+
+                        if(culling == FrustrumCulling::BOX_INSIDE)
+                        {
+                            activeGroups.push_back(&group);
+                            continue;
+                        }
+
+                        //make a bigger radius to account for possible displacement
+                        float totalRadius = group.radius + group.spacing*TREE_POSITION_NOISE_SCALE;
+                        glm::vec3 groupPos = glm::vec3(group.position.x, group.height, group.position.y);
+                        //convert to scenespace
+                        groupPos -= rootPosition_worldspace;
+
+                        glm::vec4 groupPos_cameraspace = viewMatrix*glm::vec4(groupPos, 1.0);
+
+                        if(SCE::FrustrumCulling::IsSphereInFrustrum(groupPos_cameraspace, totalRadius))
+                        {
+                            activeGroups.push_back(&group);
+                        }
+                    }
+                }
+            }
+        }
+
+        if(cancel)
+        {
+            clearInstances(instances);
+            return;
+        }
+
+        //sort the visible tree groups, groups on the same circle by grid index so that the instances
+        //don't depend on the order the groups were visited in
+        std::sort(begin(activeGroups), end(activeGroups),
+                  [&camPos2](TreeGroup const* a, TreeGroup const* b) -> bool
+        {
+            float aDistance = glm::length(camPos2 - a->position);
+            float bDistance = glm::length(camPos2 - b->position);
+            return aDistance < bDistance || (aDistance == bDistance && a->gridIndex < b->gridIndex);
+        });
+
+        //forget the groups far behind, then place the trees of the groups coming in range
+        for(ui32 slot = 0; slot < cache.slotTreeCounts.size(); ++slot)
+        {
+            const glm::vec3& bounds = cache.slotBounds[slot];
+            if(cache.slotTreeCounts[slot] > 0 &&
+               glm::length(camPos2 - glm::vec2(bounds.x, bounds.y)) - bounds.z >
+               maxDrawDistance*TREE_CACHE_EVICT_DISTANCE_RATIO)
+            {
+                releaseSlot(cache, slot);
+            }
+        }
+
+        ui32 slotCapacity = cache.slotCapacity;
+        for(TreeGroup const* group : activeGroups)
+        {
+            ui32 perSide = getTreesPerSide(*group);
+            slotCapacity = glm::max(slotCapacity, perSide*perSide);
+        }
+        if(slotCapacity > cache.slotCapacity)
+        {
+            resetPlacementCache(cache, slotCapacity);
+        }
+
+        //Draw the trees of the groups with the LODs of the last update, unless the camera moved enough
+        //to change them. Only the groups coming in view or with new LODs change the lists
+        checkLodSettings(cache, maxDrawDistance, maxDistFromCenter);
+        instances.relodGroupCount = 0;
+        for(TreeGroup const* group : activeGroups)
+        {
+            //the placements, LODs and lists already done stay in the cache for the next update
+            if(cancel)
+            {
+                clearInstances(instances);
+                return;
+            }
+            ui32 slot = getGroupSlot(*group, getHeights, cache);
+            bool isRelod = isLodStale(cache, slot, camPos2);
+            if(isRelod)
+            {
+                computeSlotLods(cache, slot, camPosition_worldspace, maxDrawDistance, maxDistFromCenter);
+                ++instances.relodGroupCount;
+            }
+            if(isRelod || cache.slotDrawnUpdates[slot] == 0)
+            {
+                drawSlot(cache, slot, isRelod);
+            }
+            cache.slotDrawnUpdates[slot] = cache.update;
+        }
+
+        //the groups out of view since the last update leave the lists
+        ui32 keptCount = 0;
+        for(ui32 slot : cache.drawnSlots)
+        {
+            if(cache.slotDrawnUpdates[slot] == cache.update)
+            {
+                cache.drawnSlots[keptCount++] = slot;
+            }
+            else
+            {
+                hideSlot(cache, slot);
+            }
+        }
+        cache.drawnSlots.resize(keptCount);
+        copyDrawnLists(cache, instances);
+
+        instances.visibleGroupCount = activeGroups.size();
+        instances.culledGroupCount = groups.size() - activeGroups.size();
+    }
+
+    void InvalidatePlacements(const glm::vec2& min_worldspace, const glm::vec2& max_worldspace,
+                              PlacementCache& cache)
+    {
+        for(ui32 slot = 0; slot < cache.slotTreeCounts.size(); ++slot)
+        {
+            const glm::vec3& bounds = cache.slotBounds[slot];
+            glm::vec2 center(bounds.x, bounds.y);
+            glm::vec2 closest = glm::clamp(center, min_worldspace, max_worldspace);
+            if(cache.slotTreeCounts[slot] > 0 && glm::length(center - closest) <= bounds.z)
+            {
+                releaseSlot(cache, slot);
+            }
+        }
+    }
+
+    void InvalidateLods(PlacementCache& cache)
+    {
+        for(glm::vec3& state : cache.slotLodStates)
+        {
+            state.z = -1.0f;
+        }
+    }
+
+    ui64 GetGroupGridBytes(const GroupGrid& grid)
+    {
+        return Memory::VectorBytes(grid.cellStarts) + Memory::VectorBytes(grid.cellGroups) +
+                Memory::VectorBytes(grid.cellMin) + Memory::VectorBytes(grid.cellMax);
+    }
+
+    ui64 GetPlacementCacheBytes(const PlacementCache& cache)
+    {
+        //the map nodes are a guess : key, value and a next pointer each, plus the buckets
+        ui64 mapBytes = ui64(cache.groupSlots.size())*(sizeof(ui32)*2 + sizeof(void*)) +
+                ui64(cache.groupSlots.bucket_count())*sizeof(void*);
+        ui64 listBytes = 0;
+        for(ui32 list = 0; list < TREE_LIST_COUNT; ++list)
+        {
+            listBytes += Memory::VectorBytes(cache.drawnInstances[list]) + Memory::VectorBytes(cache.drawnTrees[list]) +
+                    Memory::VectorBytes(cache.drawnPageUpdates[list]);
+        }
+        return Memory::VectorBytes(cache.treeX) + Memory::VectorBytes(cache.treeY) +
+                Memory::VectorBytes(cache.treeZ) + Memory::VectorBytes(cache.treeScales) +
+                Memory::VectorBytes(cache.treeNoises) + Memory::VectorBytes(cache.slotTreeCounts) +
+                Memory::VectorBytes(cache.slotBounds) + Memory::VectorBytes(cache.slotGroups) +
+                Memory::VectorBytes(cache.freeSlots) + Memory::VectorBytes(cache.treeLods) +
+                Memory::VectorBytes(cache.treeImpostors) + Memory::VectorBytes(cache.slotLodStates) +
+                Memory::VectorBytes(cache.treeLists) + Memory::VectorBytes(cache.treePlaces) +
+                Memory::VectorBytes(cache.drawnSlots) + Memory::VectorBytes(cache.slotDrawnUpdates) +
+                listBytes + mapBytes;
+    }
+
+    CompactInstance EncodeInstance(const glm::vec3& position_worldspace, float scale, float yawRad,
+                                   ui32 index)
+    {
+        Debug::Assert(index < (1u << TREE_INSTANCE_INDEX_BITS), "Tree instance index out of range");
+        const ui32 yawSteps = 1u << TREE_INSTANCE_YAW_BITS;
+        const ui32 scaleMax = (1u << TREE_INSTANCE_SCALE_BITS) - 1u;
+
+        float PI2 = 2.0f*glm::pi<float>();
+        float turns = yawRad/PI2;
+        ui32 yaw = ui32(glm::floor((turns - glm::floor(turns))*float(yawSteps) + 0.5f)) % yawSteps;
+        ui32 quantizedScale = ui32(glm::clamp(scale/TREE_INSTANCE_MAX_SCALE, 0.0f, 1.0f)*float(scaleMax) + 0.5f);
+
+        CompactInstance instance;
+        instance.x = position_worldspace.x;
+        instance.y = position_worldspace.y;
+        instance.z = position_worldspace.z;
+        instance.packed = yaw | quantizedScale << TREE_INSTANCE_YAW_BITS |
+                index << (TREE_INSTANCE_YAW_BITS + TREE_INSTANCE_SCALE_BITS);
+        return instance;
+    }
+
+    void DecodeInstance(const CompactInstance& instance, glm::vec3& position_worldspace,
+                        float& scale, float& yawRad, ui32& index)
+    {
+        const ui32 yawSteps = 1u << TREE_INSTANCE_YAW_BITS;
+        const ui32 scaleMax = (1u << TREE_INSTANCE_SCALE_BITS) - 1u;
+
+        position_worldspace = glm::vec3(instance.x, instance.y, instance.z);
+        yawRad = float(instance.packed & (yawSteps - 1u))*(2.0f*glm::pi<float>()/float(yawSteps));
+        scale = float((instance.packed >> TREE_INSTANCE_YAW_BITS) & scaleMax)*(TREE_INSTANCE_MAX_SCALE/float(scaleMax));
+        index = instance.packed >> (TREE_INSTANCE_YAW_BITS + TREE_INSTANCE_SCALE_BITS);
+    }
+
+    glm::mat4 GetInstanceMatrix(const CompactInstance& instance)
+    {
+        glm::vec3 position;
+        float scale, yaw;
+        ui32 index;
+        DecodeInstance(instance, position, scale, yaw, index);
+
+        //translate*rotate(yaw, y axis)*scale, written out like in the shaders
+        float c = glm::cos(yaw)*scale;
+        float s = glm::sin(yaw)*scale;
+        return glm::mat4(glm::vec4(c, 0.0f, -s, 0.0f),
+                         glm::vec4(0.0f, scale, 0.0f, 0.0f),
+                         glm::vec4(s, 0.0f, c, 0.0f),
+                         glm::vec4(position, 1.0f));
+    }
+
+    ui32 GetImpostorView(float angleInRad, ui16 nbAngles)
+    {
+        ui16 root = (ui16)glm::sqrt(nbAngles);
+        nbAngles = root*root;
+
+        float PI2 = 2.0f*glm::pi<float>();
+        angleInRad = glm::mod(angleInRad + PI2, PI2);
+        return glm::min(ui32(angleInRad/PI2*float(nbAngles)), ui32(nbAngles) - 1u);
+    }
+
+    glm::vec4 GetImpostorViewMapping(ui32 view, ui16 nbAngles, bool flipX, float borderRatio)
+    {
+        ui16 root = (ui16)glm::sqrt(nbAngles);
+
+        ui16 xInd = view/root;
+        ui16 yInd = view%root;
+
+        float fRoot = (float)root;
+        float scaledHalfBorder = borderRatio/fRoot * 0.5f;
+        float width = 1.0f/fRoot - scaledHalfBorder;
+        float height = 1.0f/fRoot - scaledHalfBorder;
+
+        float xStart = (float)xInd/fRoot + scaledHalfBorder;
+        float yStart = (float)yInd/fRoot + scaledHalfBorder;
+
+        if(flipX)
+        {
+            return vec4(xStart + width, yStart, -width, height);
+        }
+        else
+        {
+            return vec4(xStart, yStart, width, height);
+        }
+    }
+
+    glm::vec4 GetImpostorMapping(float angleInRad, ui16 nbAngles, bool flipX, float borderRatio)
+    {
+        return GetImpostorViewMapping(GetImpostorView(angleInRad, nbAngles), nbAngles, flipX, borderRatio);
+    }
+}
+
+}
@@ -8,6 +8,8 @@
 #include "../headers/SCETools.hpp"
 #include "../headers/SCELighting.hpp"
 #include "../headers/SCEPostProcess.hpp"
+#include "../headers/SCERenderStats.hpp"
+#include "../headers/SCEMemory.hpp"
 
 using namespace SCE;
 using namespace std;
@@ -28,21 +30,28 @@ SCE_GBuffer::~SCE_GBuffer()
 {
     if (mTextures[0] != GL_INVALID_INDEX)
     {
+        for (uint i = 0 ; i < GBUFFER_TEXTURE_COUNT ; i++)
+        {
+            SCE::Memory::UntrackGLTexture(mTextures[i]);
+        }
         glDeleteTextures(GBUFFER_TEXTURE_COUNT, mTextures);
     }
 
     if (mDepthTexture != GL_INVALID_INDEX)
     {
+        SCE::Memory::UntrackGLTexture(mDepthTexture);
         glDeleteTextures(1, &mDepthTexture);
     }
 
     if (mFinalTexture != GL_INVALID_INDEX)
     {
+        SCE::Memory::UntrackGLTexture(mFinalTexture);
         glDeleteTextures(1, &mFinalTexture);
     }
 
     if (mLuminanceTexture != GL_INVALID_INDEX)
     {
+        SCE::Memory::UntrackGLTexture(mLuminanceTexture);
         glDeleteTextures(1, &mLuminanceTexture);
     }
 
@@ -70,10 +79,16 @@ bool SCE_GBuffer::Init(uint windowWidth, uint windowHeight)
         if(i == GBUFFER_TEXTURE_TYPE_NORMAL_SPEC || i == GBUFFER_TEXTURE_TYPE_DIFFUSE)
         {
             glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, windowWidth, windowHeight, 0, GL_RGBA, GL_FLOAT, NULL);
+            SCE::Memory::TrackGLTexture(SCE::Memory::TAG_RENDER_TARGETS, mTextures[i],
+                                        SCE::Memory::ComputeTextureSize(windowWidth, windowHeight, 1,
+                                                                        GL_RGBA32F, false));
         }
         else //use only 3 channels for position
         {
             glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB32F, windowWidth, windowHeight, 0, GL_RGB, GL_FLOAT, NULL);
+            SCE::Memory::TrackGLTexture(SCE::Memory::TAG_RENDER_TARGETS, mTextures[i],
+                                        SCE::Memory::ComputeTextureSize(windowWidth, windowHeight, 1,
+                                                                        GL_RGB32F, false));
         }
         glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
         glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
@@ -86,6 +101,9 @@ bool SCE_GBuffer::Init(uint windowWidth, uint windowHeight)
     glBindTexture(GL_TEXTURE_2D, mDepthTexture);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH24_STENCIL8, windowWidth, windowHeight, 0,
                  GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+    SCE::Memory::TrackGLTexture(SCE::Memory::TAG_RENDER_TARGETS, mDepthTexture,
+                                SCE::Memory::ComputeTextureSize(windowWidth, windowHeight, 1,
+                                                                GL_DEPTH24_STENCIL8, false));
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_NONE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
@@ -97,6 +115,9 @@ bool SCE_GBuffer::Init(uint windowWidth, uint windowHeight)
     // with the stencil test into the Framebuffer where the stencil buffer was filled (this GBuffer)
     glBindTexture(GL_TEXTURE_2D, mFinalTexture);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB32F, windowWidth, windowHeight, 0, GL_RGB, GL_FLOAT, NULL);
+    SCE::Memory::TrackGLTexture(SCE::Memory::TAG_RENDER_TARGETS, mFinalTexture,
+                                SCE::Memory::ComputeTextureSize(windowWidth, windowHeight, 1,
+                                                                GL_RGB32F, false));
     glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
@@ -106,6 +127,9 @@ bool SCE_GBuffer::Init(uint windowWidth, uint windowHeight)
 
     glBindTexture(GL_TEXTURE_2D, mLuminanceTexture);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_R16, windowWidth, windowHeight, 0, GL_RED, GL_FLOAT, NULL);
+    SCE::Memory::TrackGLTexture(SCE::Memory::TAG_RENDER_TARGETS, mLuminanceTexture,
+                                SCE::Memory::ComputeTextureSize(windowWidth, windowHeight, 1,
+                                                                GL_R16, true));
     glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
     glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glGenerateMipmap(GL_TEXTURE_2D);
@@ -129,6 +153,7 @@ bool SCE_GBuffer::Init(uint windowWidth, uint windowHeight)
 void SCE_GBuffer::ClearFinalBuffer()
 {
     glBindFramebuffer(GL_DRAW_FRAMEBUFFER, mFBOId);
+    SCE::RenderStats::CountFramebufferBind(mFBOId);
     glDrawBuffer(GL_COLOR_ATTACHMENT0 + FINAL_TEXT_ATTACHMENT);
     glClear(GL_COLOR_BUFFER_BIT);
 }
@@ -136,6 +161,7 @@ void SCE_GBuffer::ClearFinalBuffer()
 void SCE_GBuffer::BindForGeometryPass()
 {
     glBindFramebuffer(GL_FRAMEBUFFER, mFBOId);
+    SCE::RenderStats::CountFramebufferBind(mFBOId);
     //reset the color attachment buffers that have been removed for stencil pass
     GLenum drawBuffers[GBUFFER_TEXTURE_COUNT];
     for (uint i = 0 ; i < GBUFFER_TEXTURE_COUNT ; i++) {
@@ -150,6 +176,7 @@ void SCE_GBuffer::BindForStencilPass()
 {
     //write stencil to GBuffer
     glBindFramebuffer(GL_FRAMEBUFFER, mFBOId);
+    SCE::RenderStats::CountFramebufferBind(mFBOId);
 }
 
 void SCE_GBuffer::BindForLightPass()
@@ -157,12 +184,14 @@ void SCE_GBuffer::BindForLightPass()
     //bind FBO for reading and drawing (because the stencil buffer used for stencil test is the one
     // from the draw framebuffer
     glBindFramebuffer(GL_FRAMEBUFFER, mFBOId);
+    SCE::RenderStats::CountFramebufferBind(mFBOId);
     glDrawBuffer(GL_COLOR_ATTACHMENT0 + FINAL_TEXT_ATTACHMENT);
 }
 
 void SCE_GBuffer::BindForSkyPass()
 {
     glBindFramebuffer(GL_FRAMEBUFFER, mFBOId);
+    SCE::RenderStats::CountFramebufferBind(mFBOId);
 
     glActiveTexture(GL_TEXTURE0);
     glBindTexture(GL_TEXTURE_2D, mFinalTexture);
@@ -171,6 +200,8 @@ void SCE_GBuffer::BindForSkyPass()
     glActiveTexture(GL_TEXTURE1);
     glBindTexture(GL_TEXTURE_2D, mTextures[GBUFFER_TEXTURE_TYPE_POSITION]);
     glUniform1i(1, 1);//PositionTex is sampler1
+    SCE::RenderStats::CountTextureBind(2);
+    SCE::RenderStats::CountUniformCalls(2);
 
     glDrawBuffer(GL_COLOR_ATTACHMENT0 + FINAL_TEXT_ATTACHMENT);
 }
@@ -178,6 +209,7 @@ void SCE_GBuffer::BindForSkyPass()
 void SCE_GBuffer::BindForLuminancePass()
 {
     glBindFramebuffer(GL_FRAMEBUFFER, mFBOId);
+    SCE::RenderStats::CountFramebufferBind(mFBOId);
 
     glActiveTexture(GL_TEXTURE0);
     glBindTexture(GL_TEXTURE_2D, mFinalTexture);
@@ -186,6 +218,8 @@ void SCE_GBuffer::BindForLuminancePass()
     glActiveTexture(GL_TEXTURE1);
     glBindTexture(GL_TEXTURE_2D, mLuminanceTexture);
     glUniform1i(1, 1);//LuminanceTex is sampler1
+    SCE::RenderStats::CountTextureBind(2);
+    SCE::RenderStats::CountUniformCalls(2);
 
     glDrawBuffer(GL_COLOR_ATTACHMENT0 + LUM_TEXT_ATTACHMENT);
 }
@@ -200,6 +234,7 @@ void SCE_GBuffer::BindForToneMapPass()
 {
     glBindFramebuffer(GL_READ_FRAMEBUFFER, mFBOId);
     glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    SCE::RenderStats::CountFramebufferBind(0);
     glDrawBuffer(GL_BACK);
     glActiveTexture(GL_TEXTURE0);
     glBindTexture(GL_TEXTURE_2D, mFinalTexture);
@@ -208,6 +243,8 @@ void SCE_GBuffer::BindForToneMapPass()
     glActiveTexture(GL_TEXTURE1);
     glBindTexture(GL_TEXTURE_2D, mLuminanceTexture);
     glUniform1i(1, 1);//LuminanceTex is sampler1
+    SCE::RenderStats::CountTextureBind(2);
+    SCE::RenderStats::CountUniformCalls(2);
 }
 
 void SCE_GBuffer::SetupTexturesForLighting()
@@ -219,6 +256,8 @@ void SCE_GBuffer::SetupTexturesForLighting()
         // Set the sampler uniform to the texture unit
         glUniform1i(SCELighting::GetTextureSamplerUniform(GBUFFER_TEXTURE_TYPE(i)), i);
     }
+    SCE::RenderStats::CountTextureBind(GBUFFER_TEXTURE_COUNT);
+    SCE::RenderStats::CountUniformCalls(GBUFFER_TEXTURE_COUNT);
 }
 
 void SCE_GBuffer::SetupFinalTexture(uint uniform, uint sampler)
@@ -226,6 +265,8 @@ void SCE_GBuffer::SetupFinalTexture(uint uniform, uint sampler)
     glActiveTexture(GL_TEXTURE0 + sampler);
     glBindTexture(GL_TEXTURE_2D, mFinalTexture);
     glUniform1i(uniform, sampler);
+    SCE::RenderStats::CountTextureBind();
+    SCE::RenderStats::CountUniformCalls();
 }
 
 void SCE_GBuffer::BindTexture(SCE_GBuffer::GBUFFER_TEXTURE_TYPE type, uint uniform, uint texUnit)
@@ -234,6 +275,8 @@ void SCE_GBuffer::BindTexture(SCE_GBuffer::GBUFFER_TEXTURE_TYPE type, uint unifo
     glBindTexture(GL_TEXTURE_2D, mTextures[type]);
     // Set the sampler uniform to the texture unit
     glUniform1i(uniform, texUnit);
+    SCE::RenderStats::CountTextureBind();
+    SCE::RenderStats::CountUniformCalls();
 }
 
 void SCE_GBuffer::SetReadBuffer(GBUFFER_TEXTURE_TYPE TextureType)
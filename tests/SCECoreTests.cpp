@@ -0,0 +1,671 @@
+/******PROJECT:Sand Castle Engine******/
+/**************************************/
+/*********AUTHOR:Gwenn AUBERT**********/
+/********FILE:SCECoreTests.cpp*********/
+/**************************************/
+
+#include "SCETest.hpp"
+#include "../bench/SCEBenchScenes.hpp"
+#include "../headless/SCEFakeSources.hpp"
+#include "../headers/SCETools.hpp"
+#include "../headers/SCEScene.hpp"
+#include "../headers/Transform.hpp"
+#include "../headers/SCEMetadataParser.hpp"
+#include "../headers/SCEFrustrumCulling.hpp"
+#include "../headers/SCEMeshLoader.hpp"
+#include "../headers/SCETime.hpp"
+#include "../headers/SCEInput.hpp"
+#include "../headers/SCEPerlin.hpp"
+#include "../headers/SCEParallel.hpp"
+#include "../headers/SCELogger.hpp"
+
+#include <fstream>
+#include <algorithm>
+#include <thread>
+#include <chrono>
+#include <map>
+#include <sstream>
+
+#define PERLIN_BATCH_TOLERANCE 1e-5f
+#define TEST_MESH_NAME "Terrain/TreePack/tree_5/1/lod0_leaves.obj"
+//how long the cancelled job waits for its token before giving up
+#define WORKER_CANCEL_TIMEOUT 5.0
+#define HANDOFF_PUBLISH_COUNT 200
+#define HANDOFF_INSTANCE_COUNT 10000
+#define ATOMIC_FILE "test_atomic.bin"
+#define LOGGER_FILE "test_logger.log"
+#define LOGGER_PRODUCER_COUNT 4
+//each producer queues more than the ring holds while the writer is paused
+#define LOGGER_RECORD_COUNT 5000
+#define LOGGER_ERROR_COUNT 100
+
+using namespace SCE;
+
+namespace
+{
+    template<int N>
+    class TestComponent : public Component
+    {
+    public :
+        int value = N;
+    protected :
+        TestComponent(SCEHandle<Container>& container)
+            : Component(container, "TestComponent" + std::to_string(N)) {}
+    };
+
+    struct Listener
+    {
+        Listener() : sum(0), callCount(0) {}
+        void OnValue(int value)
+        {
+            sum += value;
+            ++callCount;
+        }
+        int sum;
+        int callCount;
+    };
+
+    bool isNear(const glm::vec3& a, const glm::vec3& b, float tolerance = 1e-4f)
+    {
+        return glm::length(a - b) <= tolerance;
+    }
+
+    void testContainer()
+    {
+        SCEHandle<Container> container = SCEScene::CreateContainer("TestContainer");
+        SCEHandle<Container> other = SCEScene::CreateContainer("Other");
+        Test::Check(container->GetContainerId() != other->GetContainerId(), "two containers share an id");
+        Test::Check(container->GetName() == "TestContainer", "name not kept");
+
+        container->SetTag("Tag");
+        container->SetLayer("Layer");
+        container->SetName("Renamed");
+        Test::Check(container->GetTag() == "Tag" && container->GetLayer() == "Layer" &&
+                    container->GetName() == "Renamed", "tag, layer or name not set");
+
+        Test::Check(!container->HasComponent<TestComponent<0>>(), "empty container has a component");
+        SCEHandle<TestComponent<0>> first = container->AddComponent<TestComponent<0>>();
+        SCEHandle<TestComponent<1>> second = container->AddComponent<TestComponent<1>>();
+        SCEHandle<Transform> transform = container->AddComponent<Transform>();
+        Test::Check(container->HasComponent<TestComponent<0>>() && container->HasComponent<TestComponent<1>>() &&
+                    container->HasComponent<Transform>(), "added components not found");
+        Test::Check(container->GetComponent<TestComponent<1>>() == second &&
+                    container->GetComponent<TestComponent<1>>()->value == 1, "GetComponent returns another component");
+        Test::Check(!other->HasComponent<Transform>(), "component found on another container");
+
+        container->RemoveComponent<TestComponent<0>>();
+        Test::Check(!container->HasComponent<TestComponent<0>>(), "removed component still found");
+        Test::Check(!first, "handle to a removed component still valid");
+        container->RemoveComponent(second);
+        Test::Check(!container->HasComponent<TestComponent<1>>() && !second, "component removed by handle still found");
+        Test::Check(transform && container->GetComponent<Transform>() == transform,
+                    "removing components changed the others");
+
+        SCEScene::DestroyContainer(container);
+        SCEScene::DestroyContainer(other);
+    }
+
+    void testHandle()
+    {
+        SCEHandle<Container> empty;
+        Test::Check(!empty, "default handle is valid");
+
+        SCEHandle<Container> container = SCEScene::CreateContainer("HandleContainer");
+        SCEHandle<Container> copy = container;
+        SCEHandle<Container> moved = SCEHandle<Container>(container);
+        SCEHandle<Transform> transform = container->AddComponent<Transform>();
+        SCEHandle<Transform> transformCopy = transform;
+        Test::Check(copy && moved && copy == container && !(copy != container), "copies don't compare equal");
+        Test::Check(copy == container.getRaw(), "handle doesn't compare equal to its target");
+
+        //every handle is cleared when its target goes away, copies included
+        SCEScene::DestroyContainer(container);
+        Test::Check(!container && !copy && !moved, "container handles still valid after destruction");
+        Test::Check(!transform && !transformCopy, "component handles still valid after their container is destroyed");
+    }
+
+    void testEvent()
+    {
+        Event<int> event;
+        Listener first;
+        Listener second;
+        {
+            Delegate delegate;
+            delegate.connect(&first, &Listener::OnValue, event);
+            delegate.connect(&second, &Listener::OnValue, event);
+            event(3);
+            event(4);
+            Test::Check(first.sum == 7 && second.sum == 7 && first.callCount == 2, "listeners not called");
+
+            delegate.disconnectAll();
+            event(5);
+            Test::Check(first.callCount == 2 && second.callCount == 2, "listener called after disconnectAll");
+
+            delegate.connect(&first, &Listener::OnValue, event);
+            event(1);
+            Test::Check(first.sum == 8 && second.sum == 7, "reconnected listener not called alone");
+        }
+        //the delegate went out of scope, the event must not call it anymore
+        event(10);
+        Test::Check(first.sum == 8, "listener called after its delegate was destroyed");
+
+        Listener late;
+        Delegate lateDelegate;
+        {
+            Event<int> shortEvent;
+            lateDelegate.connect(&late, &Listener::OnValue, shortEvent);
+            shortEvent(2);
+        }
+        lateDelegate.disconnectAll();
+        Test::Check(late.sum == 2, "listener of a destroyed event not called while it existed");
+    }
+
+    void testTransform()
+    {
+        SCEHandle<Container> parentContainer = SCEScene::CreateContainer("Parent");
+        SCEHandle<Container> childContainer = SCEScene::CreateContainer("Child");
+        SCEHandle<Transform> parent = parentContainer->AddComponent<Transform>();
+        SCEHandle<Transform> child = childContainer->AddComponent<Transform>();
+
+        parent->SetLocalPosition(glm::vec3(1.0f, 0.0f, 0.0f));
+        child->SetLocalPosition(glm::vec3(5.0f, 0.0f, 0.0f));
+        Test::Check(!child->HasParent() && isNear(child->GetScenePosition(), glm::vec3(5.0f, 0.0f, 0.0f)),
+                    "position without a parent is not the local one");
+
+        //parenting keeps the scene position, then the child follows its parent
+        child->SetLocalPosition(glm::vec3(0.0f));
+        parent->AddChild(child);
+        Test::Check(child->HasParent(), "child has no parent");
+        Test::Check(isNear(child->GetScenePosition(), glm::vec3(0.0f)), "parenting moved the child");
+        Test::Check(isNear(child->GetLocalPosition(), glm::vec3(-1.0f, 0.0f, 0.0f)),
+                    "local position not relative to the parent");
+        child->SetLocalPosition(glm::vec3(4.0f, 0.0f, 0.0f));
+        Test::Check(isNear(child->GetScenePosition(), glm::vec3(5.0f, 0.0f, 0.0f)),
+                    "local position not relative to the parent");
+        parent->SetLocalPosition(glm::vec3(2.0f, 1.0f, 0.0f));
+        Test::Check(isNear(child->GetScenePosition(), glm::vec3(6.0f, 1.0f, 0.0f)), "child didn't follow its parent");
+
+        //a quarter turn around y sends +x to -z
+        parent->SetLocalOrientation(glm::vec3(0.0f, 90.0f, 0.0f));
+        Test::Check(isNear(child->GetScenePosition(), glm::vec3(2.0f, 1.0f, -4.0f)),
+                    "child didn't turn with its parent");
+        Test::Check(isNear(child->LocalToSceneDir(glm::vec3(1.0f, 0.0f, 0.0f)), glm::vec3(0.0f, 0.0f, -1.0f)),
+                    "directions don't turn with the parent");
+        parent->SetLocalScale(glm::vec3(2.0f));
+        Test::Check(isNear(child->GetScenePosition(), glm::vec3(2.0f, 1.0f, -8.0f)),
+                    "child isn't scaled by its parent");
+        glm::vec4 sceneOrigin = child->GetSceneTransform()*glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+        Test::Check(isNear(glm::vec3(sceneOrigin), child->GetScenePosition()),
+                    "scene transform doesn't match the scene position");
+
+        parent->RemoveChild(child);
+        Test::Check(!child->HasParent() && isNear(child->GetScenePosition(), glm::vec3(2.0f, 1.0f, -8.0f)),
+                    "unparenting moved the child");
+
+        child->SetLocalPosition(glm::vec3(0.0f));
+        child->SetLocalOrientation(glm::vec3(0.0f));
+        child->SetLocalScale(glm::vec3(1.0f));
+        child->LookAt(glm::vec3(10.0f, 0.0f, 10.0f));
+        Test::Check(isNear(child->Forward(), glm::normalize(glm::vec3(1.0f, 0.0f, 1.0f)), 1e-3f),
+                    "LookAt doesn't face the target");
+
+        SCEScene::DestroyContainer(childContainer);
+        SCEScene::DestroyContainer(parentContainer);
+    }
+
+    void testMetadataParser()
+    {
+        Test::Check(isNear(MetadataParser::StringToVec3("(1.5, -2, 3.25)"), glm::vec3(1.5f, -2.0f, 3.25f)),
+                    "vec3 parsed wrong");
+        glm::vec4 vec4 = MetadataParser::StringToVec4("(0.5,1,2,-4)");
+        Test::Check(vec4 == glm::vec4(0.5f, 1.0f, 2.0f, -4.0f), "vec4 parsed wrong");
+        Test::Check(MetadataParser::StringToFloat("0.25") == 0.25f && MetadataParser::StringToDouble("-8.5") == -8.5 &&
+                    MetadataParser::StringToInt("42") == 42, "numbers parsed wrong");
+
+        std::map<std::string, std::string> data = MetadataParser::GetLineData("name:Bark;size:12;tint:(1,0,0)");
+        Test::Check(data.size() == 3 && data["name"] == "Bark" && data["size"] == "12" &&
+                    data["tint"] == "(1,0,0)", "line data parsed wrong");
+        std::map<std::string, std::string> custom = MetadataParser::GetLineData("a=1,b=2", '=', ',');
+        Test::Check(custom.size() == 2 && custom["a"] == "1" && custom["b"] == "2", "custom separators ignored");
+    }
+
+    void testFrustrumCulling()
+    {
+        FrustrumCulling::UpdateCulling(BenchScenes::Projection());
+
+        //the camera looks down -z
+        Test::Check(FrustrumCulling::IsSphereInFrustrum(glm::vec4(0.0f, 0.0f, -100.0f, 1.0f), 1.0f),
+                    "sphere in front of the camera culled");
+        Test::Check(!FrustrumCulling::IsSphereInFrustrum(glm::vec4(0.0f, 0.0f, 100.0f, 1.0f), 1.0f),
+                    "sphere behind the camera kept");
+        Test::Check(!FrustrumCulling::IsSphereInFrustrum(glm::vec4(1000.0f, 0.0f, -100.0f, 1.0f), 1.0f),
+                    "sphere on the side kept");
+        Test::Check(FrustrumCulling::IsSphereInFrustrum(glm::vec4(0.0f, 0.0f, 5.0f, 1.0f), 10.0f),
+                    "sphere across the near plane culled");
+
+        glm::vec4 R(10.0f, 0.0f, 0.0f, 0.0f);
+        glm::vec4 S(0.0f, 10.0f, 0.0f, 0.0f);
+        glm::vec4 T(0.0f, 0.0f, 10.0f, 0.0f);
+        Test::Check(FrustrumCulling::ClassifyBox(glm::vec4(0.0f, 0.0f, -100.0f, 1.0f), R, S, T) ==
+                    FrustrumCulling::BOX_INSIDE, "small box in front not inside");
+        Test::Check(FrustrumCulling::ClassifyBox(glm::vec4(0.0f, 0.0f, -100.0f, 1.0f), R*100.0f, S, T) ==
+                    FrustrumCulling::BOX_INTERSECTING, "wide box in front not intersecting");
+        Test::Check(FrustrumCulling::ClassifyBox(glm::vec4(0.0f, 0.0f, 100.0f, 1.0f), R, S, T) ==
+                    FrustrumCulling::BOX_OUTSIDE, "box behind not outside");
+
+        //the classification agrees with the boolean test everywhere
+        ui32 disagreements = 0;
+        Math::SeedRandomGenerator(7);
+        for(int i = 0; i < 10000; ++i)
+        {
+            glm::vec4 position(Math::RandRange(-500.0f, 500.0f), Math::RandRange(-500.0f, 500.0f),
+                               Math::RandRange(-1000.0f, 100.0f), 1.0f);
+            float size = Math::RandRange(1.0f, 200.0f);
+            bool isVisible = FrustrumCulling::IsBoxInFrustrum(position, R*size, S*size, T*size);
+            FrustrumCulling::BoxCulling culling = FrustrumCulling::ClassifyBox(position, R*size, S*size, T*size);
+            bool isInside = FrustrumCulling::IsSphereInFrustrum(position, 0.0f);
+            disagreements += isVisible != (culling != FrustrumCulling::BOX_OUTSIDE) ? 1 : 0;
+            //a box whose center is in view is never culled
+            disagreements += isInside && !isVisible ? 1 : 0;
+        }
+        Test::Check(disagreements == 0, std::to_string(disagreements) + " boxes classified differently");
+    }
+
+    void testMeshLoader()
+    {
+        ui16 quad = MeshLoader::CreateQuadMesh("TestQuad");
+        Test::Check(MeshLoader::CreateQuadMesh("TestQuad") == quad, "same quad loaded twice");
+        const MeshData& quadData = MeshLoader::GetMeshData(quad);
+        Test::Check(quadData.vertices.size() == 4 && quadData.indices.size() == 6 &&
+                    quadData.normals.size() == quadData.vertices.size() &&
+                    quadData.uvs.size() == quadData.vertices.size(), "quad has the wrong layout");
+
+        ui16 cube = MeshLoader::CreateCubeMesh("TestCube");
+        const MeshData& cubeData = MeshLoader::GetMeshData(cube);
+        Test::Check(cube != quad && cubeData.indices.size() == 36, "cube has the wrong layout");
+        Test::Check(isNear(cubeData.center, glm::vec3(0.0f)), "cube not centered");
+        for(ushort index : cubeData.indices)
+        {
+            Test::Check(index < cubeData.vertices.size(), "cube index out of its vertices");
+        }
+
+        std::vector<ushort> indices = { 0, 1, 2 };
+        std::vector<vec3> vertices = { vec3(0.0f), vec3(2.0f, 0.0f, 0.0f), vec3(0.0f, 4.0f, 0.0f) };
+        std::vector<vec3> normals(3, vec3(0.0f, 0.0f, 1.0f));
+        std::vector<vec2> uvs(3, vec2(0.0f));
+        ui16 custom = MeshLoader::CreateCustomMesh(indices, vertices, normals, uvs, std::vector<vec3>(),
+                                                   std::vector<vec3>());
+        const MeshData& customData = MeshLoader::GetMeshData(custom);
+        Test::Check(customData.indices == indices && customData.vertices == vertices, "custom mesh not kept");
+        //dimensions are half extents
+        Test::Check(isNear(customData.dimensions, glm::vec3(1.0f, 2.0f, 0.0f)) &&
+                    isNear(customData.center, glm::vec3(1.0f, 2.0f, 0.0f)), "custom mesh bounds wrong");
+
+        //a deleted mesh is created again under a new id
+        MeshLoader::DeleteMesh(quad);
+        ui16 newQuad = MeshLoader::CreateQuadMesh("TestQuad");
+        Test::Check(newQuad != quad && MeshLoader::GetMeshData(newQuad).vertices.size() == 4,
+                    "deleted quad not created again");
+        MeshLoader::DeleteMesh(newQuad);
+        MeshLoader::DeleteMesh(cube);
+        MeshLoader::DeleteMesh(custom);
+
+        std::string indicesFile = std::string(ENGINE_RESSOURCE_PATH) + TEST_MESH_NAME + "_convert.indices";
+        if(!std::ifstream(indicesFile.c_str()))
+        {
+            Debug::Log("mesh file : skipped, run from a directory containing " ENGINE_RESSOURCE_PATH);
+            return;
+        }
+        ui16 mesh = MeshLoader::CreateMeshFromFile(TEST_MESH_NAME);
+        const MeshData& meshData = MeshLoader::GetMeshData(mesh);
+        Test::Check(!meshData.indices.empty() && meshData.indices.size() % 3 == 0 &&
+                    meshData.normals.size() == meshData.vertices.size() &&
+                    meshData.uvs.size() == meshData.vertices.size(), "mesh file has the wrong layout");
+        ushort maxIndex = meshData.indices.empty() ? 0 :
+                                                     *std::max_element(meshData.indices.begin(), meshData.indices.end());
+        Test::Check(maxIndex < meshData.vertices.size(), "mesh file index out of its vertices");
+        Test::Check(MeshLoader::CreateMeshFromFile(TEST_MESH_NAME) == mesh, "same mesh file loaded twice");
+        MeshLoader::DeleteMesh(mesh);
+    }
+
+    void testFakeSources()
+    {
+        FakeTime::Install(10.0);
+        FakeTime::Step(0.25);
+        Test::Check(Time::DeltaTime() == 0.25 && Time::RealTimeInSeconds() == 0.25, "fake frame not seen by Time");
+        Time::SetTimeSpeed(0.5f);
+        FakeTime::Step(0.5);
+        Test::Check(Time::DeltaTime() == 0.25, "time speed not applied");
+        Time::SetTimeSpeed(1.0f);
+        FakeTime::Step(3.0);
+        Test::Check(Time::DeltaTime() == 1.0, "long frames not clamped");
+        FakeTime::Uninstall();
+
+        FakeInput::ReleaseAllKeys();
+        FakeInput::Update();
+        FakeInput::SetKeyDown(GLFW_KEY_W, true);
+        FakeInput::Update();
+        Test::Check(Input::GetKeyAction(GLFW_KEY_W) == Input::Press, "key not pressed");
+        FakeInput::Update();
+        Test::Check(Input::GetKeyAction(GLFW_KEY_W) == Input::Hold, "key not held");
+        FakeInput::SetKeyDown(GLFW_KEY_W, false);
+        FakeInput::Update();
+        Test::Check(Input::GetKeyAction(GLFW_KEY_W) == Input::Release, "key not released");
+        FakeInput::Update();
+        Test::Check(Input::GetKeyAction(GLFW_KEY_W) == Input::None, "released key still active");
+    }
+
+    void testPerlinBatch()
+    {
+        Perlin::MakePerlin(256, 42);
+        std::vector<float> xs, zs, layeredXs, layeredZs;
+        for(int x = 0; x < 64; ++x)
+        {
+            //odd counts go through the scalar tail of the batches
+            for(int z = 0; z < 63; ++z)
+            {
+                xs.push_back(float(x)*0.37f);
+                zs.push_back(float(z)*0.37f);
+                layeredXs.push_back(float(x)*0.01f);
+                layeredZs.push_back(float(z)*0.01f);
+            }
+        }
+        int sampleCount = int(xs.size());
+        std::vector<float> batchResults(sampleCount), layeredResults(sampleCount);
+        Perlin::GetPerlinBatch(xs.data(), zs.data(), 64.0f, batchResults.data(), sampleCount);
+        Perlin::GetLayeredPerlinBatch(layeredXs.data(), layeredZs.data(), 8, 2.0f, layeredResults.data(), sampleCount);
+        float maxError = 0.0f;
+        for(int i = 0; i < sampleCount; ++i)
+        {
+            float scalar = Perlin::GetPerlinAt(xs[i], zs[i], 64.0f);
+            float layeredScalar = Perlin::GetLayeredPerlinAt(layeredXs[i], layeredZs[i], 8, 2.0f);
+            maxError = glm::max(maxError, glm::abs(batchResults[i] - scalar));
+            maxError = glm::max(maxError, glm::abs(layeredResults[i] - layeredScalar));
+        }
+        Perlin::DestroyPerlin();
+        Test::Check(maxError <= PERLIN_BATCH_TOLERANCE, "batch differs from scalar by " + std::to_string(maxError));
+    }
+
+    void testBackgroundWorker()
+    {
+        Parallel::BackgroundWorker worker;
+
+        //jobs submitted while the worker is busy replace each other, only the last one runs
+        std::atomic<bool> isStarted(false);
+        std::atomic<bool> isReleased(false);
+        worker.Submit([&isStarted, &isReleased](const Parallel::CancelToken&)
+        {
+            isStarted = true;
+            while(!isReleased)
+            {
+                std::this_thread::yield();
+            }
+        });
+        while(!isStarted)
+        {
+            std::this_thread::yield();
+        }
+        std::atomic<ui32> jobCount(0);
+        ui32 lastJob = 0;
+        for(ui32 i = 1; i <= 3; ++i)
+        {
+            worker.Submit([&lastJob, &jobCount, i](const Parallel::CancelToken&)
+            {
+                lastJob = i;
+                ++jobCount;
+            });
+        }
+        isReleased = true;
+        worker.Wait();
+        Test::Check(jobCount == 1 && lastJob == 3, std::to_string(jobCount) + " waiting jobs ran, the last was " +
+                    std::to_string(lastJob));
+        Test::Check(worker.GetLastLatency() > 0.0, "no latency measured");
+
+        //a running job sees its token once cancelled
+        isStarted = false;
+        bool isCancelled = false;
+        worker.Submit([&isStarted, &isCancelled](const Parallel::CancelToken& cancel)
+        {
+            isStarted = true;
+            auto start = std::chrono::steady_clock::now();
+            while(!cancel && std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() <
+                  WORKER_CANCEL_TIMEOUT)
+            {
+                std::this_thread::yield();
+            }
+            isCancelled = cancel;
+        });
+        while(!isStarted)
+        {
+            std::this_thread::yield();
+        }
+        worker.Cancel();
+        worker.Wait();
+        Test::Check(isCancelled, "the running job was not cancelled");
+    }
+
+    //each list is filled with its publish number, a list with two numbers was read while written
+    void testTripleBuffer()
+    {
+        Parallel::TripleBuffer<std::vector<ui64>> lists;
+        std::atomic<bool> isDone(false);
+        std::thread producer([&]()
+        {
+            for(ui64 value = 1; value <= HANDOFF_PUBLISH_COUNT; ++value)
+            {
+                lists.GetWriteBuffer().assign(HANDOFF_INSTANCE_COUNT, value);
+                lists.Publish();
+            }
+            isDone = true;
+        });
+        ui64 tornCount = 0;
+        ui64 lastValue = 0;
+        bool isInOrder = true;
+        bool isLast = false;
+        while(!isLast)
+        {
+            isLast = isDone;
+            if(lists.Consume())
+            {
+                const std::vector<ui64>& list = lists.GetReadBuffer();
+                tornCount += std::count(list.begin(), list.end(), list[0]) == i64(list.size()) ? 0 : 1;
+                isInOrder = isInOrder && list[0] > lastValue;
+                lastValue = list[0];
+            }
+            std::this_thread::yield();
+        }
+        producer.join();
+
+        Test::Check(tornCount == 0, std::to_string(tornCount) + " lists read while written");
+        Test::Check(isInOrder && lastValue == HANDOFF_PUBLISH_COUNT, "lists read out of order, the last one read is " +
+                    std::to_string(lastValue));
+        //every list was either consumed or replaced by a newer one
+        Test::Check(lists.GetPublishedCount() == HANDOFF_PUBLISH_COUNT &&
+                    lists.GetConsumedCount() + lists.GetDroppedCount() == HANDOFF_PUBLISH_COUNT,
+                    "lists lost between the threads");
+    }
+
+    //records of the logger test file, the message split in producer tag and index.
+    //Lines that don't come from the test (dropped record reports) are skipped
+    struct LoggedRecord
+    {
+        std::string level;
+        std::string tag;
+        ui32        index;
+    };
+
+    std::vector<LoggedRecord> readLoggedRecords(const std::string& filename)
+    {
+        std::vector<LoggedRecord> records;
+        std::ifstream file(filename.c_str());
+        std::string line;
+        while(std::getline(file, line))
+        {
+            size_t levelStart = line.find('[');
+            size_t levelEnd = line.find(']');
+            size_t messageStart = line.find(" : ");
+            if(levelStart == std::string::npos || levelEnd == std::string::npos ||
+               messageStart == std::string::npos)
+            {
+                continue;
+            }
+            std::istringstream message(line.substr(messageStart + 3));
+            LoggedRecord record;
+            if(message >> record.tag >> record.index && !record.tag.empty() && isalpha(record.tag[0]))
+            {
+                record.level = line.substr(levelStart + 1, levelEnd - levelStart - 1);
+                records.push_back(record);
+            }
+        }
+        return records;
+    }
+
+    //producers racing each other and Shutdown on the ring : every record kept is written once,
+    //in the order of its producer, records are dropped only when the ring is full and never errors
+    void testLogger()
+    {
+        Logger::SetConsoleSinkEnabled(false);
+        bool isFileOpen = Logger::OpenFileSink(LOGGER_FILE);
+        Logger::Init();
+        size_t startPushed = Logger::GetPushedCount();
+        size_t startWritten = Logger::GetWrittenCount();
+        size_t startDropped = Logger::GetDroppedCount();
+
+        auto produce = [](const std::string& tag, Logger::LogLevel level, ui32 count)
+        {
+            for(ui32 i = 0; i < count; ++i)
+            {
+                Logger::Write(level, Logger::CAT_GENERAL, tag + " " + std::to_string(i));
+            }
+        };
+        auto runProducers = [&produce](const std::string& prefix)
+        {
+            std::vector<std::thread> producers;
+            for(int p = 0; p < LOGGER_PRODUCER_COUNT; ++p)
+            {
+                producers.emplace_back(produce, prefix + std::to_string(p), Logger::LOG_INFO, LOGGER_RECORD_COUNT);
+            }
+            for(std::thread& producer : producers)
+            {
+                producer.join();
+            }
+        };
+
+        //fill the ring with the writer paused
+        Logger::SetWriterPaused(true);
+        runProducers("p");
+        size_t fullPushed = Logger::GetPushedCount() - startPushed;
+        size_t fullDropped = Logger::GetDroppedCount() - startDropped;
+
+        //errors pushed to the full ring wait for room
+        std::thread errorProducer(produce, "e", Logger::LOG_ERROR, LOGGER_ERROR_COUNT);
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        Logger::SetWriterPaused(false);
+        errorProducer.join();
+        size_t errorDropped = Logger::GetDroppedCount() - startDropped - fullDropped;
+
+        Logger::Flush();
+        bool isFlushed = Logger::GetWrittenCount() - startWritten == Logger::GetPushedCount() - startPushed;
+
+        //Shutdown while the producers push, what they queued before it must still be written
+        size_t shutdownDropped = Logger::GetDroppedCount();
+        std::thread shutdownThread([]()
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            Logger::Shutdown();
+        });
+        runProducers("s");
+        shutdownThread.join();
+        shutdownDropped = Logger::GetDroppedCount() - shutdownDropped;
+        bool isDrained = Logger::GetWrittenCount() == Logger::GetPushedCount();
+
+        Logger::CloseFileSink();
+        Logger::SetConsoleSinkEnabled(true);
+
+        Test::Check(isFileOpen, "could not open " LOGGER_FILE);
+        Test::Check(fullDropped > 0 && fullPushed + fullDropped == LOGGER_PRODUCER_COUNT*LOGGER_RECORD_COUNT,
+                    std::to_string(fullPushed) + " records queued and " + std::to_string(fullDropped) +
+                    " dropped by the full ring");
+        Test::Check(errorDropped == 0, std::to_string(errorDropped) + " errors dropped");
+        Test::Check(isFlushed, "Flush returned before the queued records were written");
+        Test::Check(isDrained, "records left in the ring after Shutdown");
+
+        std::vector<LoggedRecord> records = readLoggedRecords(LOGGER_FILE);
+        std::map<std::string, ui32> nextIndices;
+        size_t countsByPrefix[3] = {};
+        bool isInOrder = true;
+        bool isErrorLevel = true;
+        for(const LoggedRecord& record : records)
+        {
+            auto next = nextIndices.find(record.tag);
+            isInOrder = isInOrder && (next == nextIndices.end() || record.index >= next->second);
+            nextIndices[record.tag] = record.index + 1;
+            int prefix = record.tag[0] == 'p' ? 0 : record.tag[0] == 'e' ? 1 : 2;
+            ++countsByPrefix[prefix];
+            isErrorLevel = isErrorLevel && (prefix != 1 || record.level == "ERROR");
+        }
+        Test::Check(isInOrder, "records of a producer written out of order");
+        Test::Check(isErrorLevel, "errors written with another level");
+        Test::Check(countsByPrefix[0] == fullPushed, std::to_string(countsByPrefix[0]) + " of the " +
+                    std::to_string(fullPushed) + " records queued in the full ring written");
+        Test::Check(countsByPrefix[1] == LOGGER_ERROR_COUNT, std::to_string(countsByPrefix[1]) + " of the " +
+                    std::to_string(LOGGER_ERROR_COUNT) + " errors written");
+        Test::Check(countsByPrefix[2] + shutdownDropped == LOGGER_PRODUCER_COUNT*LOGGER_RECORD_COUNT,
+                    std::to_string(countsByPrefix[2]) + " records written and " + std::to_string(shutdownDropped) +
+                    " dropped around Shutdown");
+        std::remove(LOGGER_FILE);
+    }
+
+    void testAtomicFile()
+    {
+        ui32 header = 0xCAFE;
+        std::vector<ui16> payload(1000, 7);
+        Test::Check(Tools::WriteFileAtomically(ATOMIC_FILE, { { &header, sizeof(header) },
+                                                              { payload.data(), payload.size()*sizeof(ui16) } }),
+                    "write failed");
+        //replaces the previous file
+        payload[999] = 9;
+        Test::Check(Tools::WriteFileAtomically(ATOMIC_FILE, { { &header, sizeof(header) },
+                                                              { payload.data(), payload.size()*sizeof(ui16) } }),
+                    "second write failed");
+
+        ui32 readHeader = 0;
+        std::vector<ui16> readPayload(payload.size());
+        std::ifstream file(ATOMIC_FILE, std::ios::in | std::ios::binary);
+        file.read((char*)&readHeader, sizeof(readHeader));
+        file.read((char*)readPayload.data(), readPayload.size()*sizeof(ui16));
+        Test::Check(file && file.peek() == EOF && readHeader == header && readPayload == payload,
+                    "file content differs from the chunks");
+        file.close();
+        Test::Check(!std::ifstream(Tools::GetTemporaryFilename(ATOMIC_FILE).c_str()), "temporary file left");
+        std::remove(ATOMIC_FILE);
+
+        Test::Check(!Tools::WriteFileAtomically("missing_directory/" ATOMIC_FILE, { { &header, sizeof(header) } }),
+                    "write to a missing directory succeeded");
+    }
+}
+
+namespace SCE
+{
+
+namespace Test
+{
+    void AddCoreTests()
+    {
+        Add("container", testContainer);
+        Add("handle", testHandle);
+        Add("event", testEvent);
+        Add("transform", testTransform);
+        Add("metadata_parser", testMetadataParser);
+        Add("frustrum_culling", testFrustrumCulling);
+        Add("mesh_loader", testMeshLoader);
+        Add("fake_sources", testFakeSources);
+        Add("perlin_batch", testPerlinBatch);
+        Add("background_worker", testBackgroundWorker);
+        Add("triple_buffer", testTripleBuffer);
+        Add("logger", testLogger);
+        Add("atomic_file", testAtomicFile);
+    }
+}
+
+}
@@ -0,0 +1,1142 @@
+/******PROJECT:Sand Castle Engine******/
+/**************************************/
+/*********AUTHOR:Gwenn AUBERT**********/
+/*******FILE:SCETerrainTests.cpp*******/
+/**************************************/
+
+#include "SCETest.hpp"
+#include "../bench/SCEBenchScenes.hpp"
+#include "../headers/SCETools.hpp"
+#include "../headers/SCEPerlin.hpp"
+#include "../headers/SCEHeightmap.hpp"
+#include "../headers/SCEHeightmapCache.hpp"
+#include "../headers/SCEHeightPyramid.hpp"
+#include "../headers/SCEParallel.hpp"
+#include "../headers/SCEFrustrumCulling.hpp"
+#include "../headers/SCETerrainQuadtree.hpp"
+#include "../headers/SCETerrainBrush.hpp"
+#include "../headers/SCEHorizonMap.hpp"
+#include "../headers/SCEClipmap.hpp"
+#include "../headers/SCETiledHeightfield.hpp"
+#include "../headers/SCETreeLayout.hpp"
+#include "../headers/SCEQuality.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <fstream>
+
+#define FIELD_SIZE 512
+#define FIELD_HEIGHT_SCALE 10000.0f
+#define FIELD_TERRAIN_SIZE 9000.0f
+#define PARALLEL_HEIGHTMAP_SIZE 256
+//octahedral normals on 8 bits, worst case is a bit under 1 degree
+#define COMPACT_NORMAL_MIN_DOT 0.9995f
+#define SAMPLE_COUNT 4096
+//relative to the height scale
+#define SAMPLE_BATCH_TOLERANCE 1e-6f
+#define RAYCAST_COUNT 1024
+//ray length, in heightfield sizes
+#define RAYCAST_PERIODS 3.0f
+#define RANGE_QUERY_COUNT 1024
+#define BOUNDS_PATCH_TEXELS 16
+//surface points tested per patch side to find the patches really in view
+#define BOUNDS_SAMPLES 9
+#define BRUSH_PATCH_TEXELS 16
+#define HEIGHTMAP_CACHE_SIZE 64
+#define HEIGHTMAP_CACHE_FILE "test_heightmap.cache"
+#define CORRUPT_HEIGHTMAP_CACHE_FILE "test_corrupt_heightmap.cache"
+//version in the 64 bytes header of the heightmap cache, after the magic
+#define HEIGHTMAP_CACHE_VERSION_POSITION 4
+#define HORIZON_MAP_SIZE 64
+#define HORIZON_DIRECTION_COUNT 8
+#define HORIZON_MAX_DISTANCE 128.0f
+#define HORIZON_RAYCAST_COUNT 512
+#define HORIZON_BISECTION_STEPS 20
+#define HORIZON_MAX_ANGLE_ERROR 2.0f
+#define HORIZON_MEAN_ANGLE_ERROR 0.25f
+#define HORIZON_FILE "test_horizon.cache"
+#define QUADTREE_PATCHES_PER_SIDE 64
+#define QUADTREE_PATCH_SIZE 125.0f
+#define CLIPMAP_SIZE 16384
+#define CLIPMAP_TILE_SIZE 256
+#define CLIPMAP_LEVEL_COUNT 5
+#define CLIPMAP_TILES_PER_LEVEL 4
+#define CLIPMAP_PAGES_PER_FRAME 4
+#define CLIPMAP_FRAME_COUNT 1000
+#define TILED_HEIGHTFIELD_SIZE 512
+#define TILED_HEIGHTFIELD_TILE_SIZE 128
+#define TILED_HEIGHTFIELD_FILE "test_heightfield.tiles"
+#define CORRUPT_HEIGHTFIELD_FILE "test_corrupt.tiles"
+//file layout the corruption test patches : dataOffset in the 64 bytes header, then 16 bytes tile entries
+#define TILED_DATA_OFFSET_POSITION 32
+#define TILED_FIRST_TILE_POSITION 64
+
+using namespace SCE;
+
+namespace
+{
+    //the generated terrain the heightfield tests share, made on first use
+    struct TerrainFixture
+    {
+        std::vector<glm::vec4>                  normalAndHeight;
+        std::vector<Heightmap::CompactTexel>    compact;
+        Heightmap::Heightfield                  field;
+        HeightPyramid::Pyramid                  pyramid;
+    };
+
+    const TerrainFixture& getTerrain()
+    {
+        static TerrainFixture fixture;
+        if(fixture.compact.empty())
+        {
+            std::vector<float> heights(FIELD_SIZE*FIELD_SIZE);
+            Perlin::MakePerlin(FIELD_SIZE, 42);
+            Heightmap::GenerateHeights(heights.data(), FIELD_SIZE, 0.0f, 1.0f, FIELD_HEIGHT_SCALE);
+            Perlin::DestroyPerlin();
+            fixture.normalAndHeight.resize(heights.size());
+            Heightmap::ComputeNormalsAndHeight(heights.data(), FIELD_SIZE, FIELD_TERRAIN_SIZE,
+                                               fixture.normalAndHeight.data());
+            std::vector<Heightmap::GPUTexel> texels(heights.size());
+            fixture.compact.resize(heights.size());
+            Heightmap::PackGPUTexels(fixture.normalAndHeight.data(), FIELD_SIZE, FIELD_HEIGHT_SCALE, texels.data());
+            Heightmap::PackCompactTexels(texels.data(), FIELD_SIZE, fixture.compact.data());
+            fixture.field.texels = fixture.compact.data();
+            fixture.field.size = FIELD_SIZE;
+            fixture.field.heightScale = FIELD_HEIGHT_SCALE;
+            HeightPyramid::Build(fixture.field, fixture.pyramid);
+        }
+        return fixture;
+    }
+
+    bool isInRect(const TerrainBrush::TexelRect& rect, ui32 size, ui32 x, ui32 z)
+    {
+        ui32 mask = size - 1;
+        return ((x - ui32(rect.minX)) & mask) <= ui32(rect.maxX - rect.minX) &&
+                ((z - ui32(rect.minZ)) & mask) <= ui32(rect.maxZ - rect.minZ);
+    }
+
+    //worldspace copies of a texel rect over a terrain centered on the origin, clamped to it
+    std::vector<glm::vec4> brushWorldRegions(const TerrainBrush::TexelRect& normalsRect, ui32 size, float terrainSize)
+    {
+        //a texel of margin, the bilinear surface reads the neighbour texels
+        float worldPerTexel = terrainSize/float(size);
+        glm::vec2 min = (glm::vec2(float(normalsRect.minX - 1), float(normalsRect.minZ - 1)) - 0.5f*float(size))*
+                worldPerTexel;
+        glm::vec2 max = (glm::vec2(float(normalsRect.maxX + 2), float(normalsRect.maxZ + 2)) - 0.5f*float(size))*
+                worldPerTexel;
+        std::vector<glm::vec4> regions;
+        for(int repeatX = -1; repeatX <= 1; ++repeatX)
+        {
+            for(int repeatZ = -1; repeatZ <= 1; ++repeatZ)
+            {
+                glm::vec2 offset = glm::vec2(float(repeatX), float(repeatZ))*terrainSize;
+                glm::vec2 regionMin = glm::max(min + offset, glm::vec2(-0.5f*terrainSize));
+                glm::vec2 regionMax = glm::min(max + offset, glm::vec2(0.5f*terrainSize));
+                if(regionMin.x <= regionMax.x && regionMin.y <= regionMax.y)
+                {
+                    regions.push_back(glm::vec4(regionMin, regionMax));
+                }
+            }
+        }
+        return regions;
+    }
+
+    bool isSameQuadtree(const TerrainQuadtree::Quadtree& a, const TerrainQuadtree::Quadtree& b)
+    {
+        if(a.nodes.size() != b.nodes.size())
+        {
+            return false;
+        }
+        for(size_t i = 0; i < a.nodes.size(); ++i)
+        {
+            if(a.nodes[i].boundsMin != b.nodes[i].boundsMin || a.nodes[i].boundsMax != b.nodes[i].boundsMax)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    //highest elevation, as a sine, at which a ray from the surface still hits the terrain
+    float rayCastHorizonSine(const Heightmap::Heightfield& field, const HeightPyramid::Pyramid& pyramid,
+                             const glm::vec2& position, const glm::vec2& direction, float texelSpacing)
+    {
+        //a bit above the surface so that the ray doesn't hit it at its start
+        glm::vec3 origin(position.x, Heightmap::SampleHeight(field, position.x, position.y,
+                                                             Heightmap::FILTER_BILINEAR) + 0.01f, position.y);
+        float low = 0.0f;
+        float high = 0.9999f;
+        HeightPyramid::RayHit hit;
+        for(int i = 0; i <= HORIZON_BISECTION_STEPS; ++i)
+        {
+            float sine = i == 0 ? 0.0f : 0.5f*(low + high);
+            float tangent = sine/glm::sqrt(1.0f - sine*sine);
+            glm::vec3 ray(direction.x, tangent*texelSpacing, direction.y);
+            bool isHidden = HeightPyramid::RayCast(field, pyramid, origin, ray, HORIZON_MAX_DISTANCE, hit);
+            if(i == 0 && !isHidden)
+            {
+                return 0.0f;
+            }
+            (isHidden ? low : high) = sine;
+        }
+        return low;
+    }
+
+    //serial against all cores, the parallel output must be bit identical to the serial one
+    void testHeightmapParallel()
+    {
+        int size = PARALLEL_HEIGHTMAP_SIZE;
+        ui64 texelCount = ui64(size)*ui64(size);
+        std::vector<float> heights[2];
+        std::vector<glm::vec4> normalAndHeight[2];
+        Perlin::MakePerlin(size, 42);
+        for(int mode = 0; mode < 2; ++mode)
+        {
+            Parallel::SetWorkerCount(mode == 0 ? 1 : 0);
+            heights[mode].resize(texelCount);
+            normalAndHeight[mode].resize(texelCount);
+            Heightmap::GenerateHeights(heights[mode].data(), size, 0.0f, 1.0f, FIELD_HEIGHT_SCALE);
+            Heightmap::ComputeNormalsAndHeight(heights[mode].data(), size, FIELD_TERRAIN_SIZE,
+                                               normalAndHeight[mode].data());
+        }
+        Parallel::SetWorkerCount(0);
+        Perlin::DestroyPerlin();
+
+        Test::Check(memcmp(heights[0].data(), heights[1].data(), texelCount*sizeof(float)) == 0,
+                    "parallel heights differ from serial");
+        Test::Check(memcmp(normalAndHeight[0].data(), normalAndHeight[1].data(), texelCount*sizeof(glm::vec4)) == 0,
+                    "parallel normals differ from serial");
+    }
+
+    void testHeightfieldPacking()
+    {
+        const TerrainFixture& terrain = getTerrain();
+        float maxHeightError = 0.0f;
+        float minNormalDot = 1.0f;
+        for(int x = 0; x < FIELD_SIZE; ++x)
+        {
+            for(int z = 0; z < FIELD_SIZE; ++z)
+            {
+                const glm::vec4& reference = terrain.normalAndHeight[x*FIELD_SIZE + z];
+                const Heightmap::CompactTexel& texel = terrain.compact[Heightmap::MortonIndex(x, z)];
+                maxHeightError = glm::max(maxHeightError,
+                                          glm::abs(Heightmap::DecodeHeight(texel, FIELD_HEIGHT_SCALE) - reference.w));
+                minNormalDot = glm::min(minNormalDot, glm::dot(Heightmap::DecodeNormal(texel), glm::vec3(reference)));
+            }
+        }
+        //half a 16 bits step, plus float rounding
+        Test::Check(maxHeightError <= FIELD_HEIGHT_SCALE/65535.0f, "height error " + std::to_string(maxHeightError));
+        Test::Check(minNormalDot >= COMPACT_NORMAL_MIN_DOT, "normal dot " + std::to_string(minNormalDot));
+    }
+
+    void testHeightfieldSampling()
+    {
+        const TerrainFixture& terrain = getTerrain();
+        const Heightmap::Heightfield& field = terrain.field;
+
+        //random positions, some of them outside of the map to go through the wrapping
+        std::vector<float> x(SAMPLE_COUNT);
+        std::vector<float> z(SAMPLE_COUNT);
+        Math::SeedRandomGenerator(13);
+        for(int i = 0; i < SAMPLE_COUNT; ++i)
+        {
+            x[i] = Math::RandRange(-0.5f*FIELD_SIZE, 1.5f*FIELD_SIZE);
+            z[i] = Math::RandRange(-0.5f*FIELD_SIZE, 1.5f*FIELD_SIZE);
+        }
+
+        const char* filterNames[Heightmap::FILTER_COUNT] = { "nearest", "bilinear", "bicubic" };
+        std::vector<float> batchHeights(SAMPLE_COUNT);
+        for(int f = 0; f < Heightmap::FILTER_COUNT; ++f)
+        {
+            Heightmap::Filter filter = Heightmap::Filter(f);
+            Heightmap::SampleHeights(field, x.data(), z.data(), batchHeights.data(), SAMPLE_COUNT, filter);
+            float maxDiff = 0.0f;
+            for(int i = 0; i < SAMPLE_COUNT; ++i)
+            {
+                maxDiff = glm::max(maxDiff, glm::abs(Heightmap::SampleHeight(field, x[i], z[i], filter) -
+                                                     batchHeights[i]));
+            }
+            Test::Check(maxDiff <= FIELD_HEIGHT_SCALE*SAMPLE_BATCH_TOLERANCE, std::string(filterNames[f]) +
+                        " batch differs from single samples by " + std::to_string(maxDiff));
+        }
+
+        std::vector<glm::vec3> normals(SAMPLE_COUNT);
+        Heightmap::SampleNormals(field, x.data(), z.data(), normals.data(), SAMPLE_COUNT, Heightmap::FILTER_BILINEAR);
+        float minNormalDot = 1.0f;
+        for(int i = 0; i < SAMPLE_COUNT; ++i)
+        {
+            minNormalDot = glm::min(minNormalDot, glm::dot(normals[i], Heightmap::SampleNormal(
+                                                               field, x[i], z[i], Heightmap::FILTER_BILINEAR)));
+        }
+        Test::Check(minNormalDot >= 1.0f - 1e-5f, "normals batch differs from single samples");
+
+        //every filter goes through the texel values at the texel centers
+        float maxCenterError = 0.0f;
+        for(int i = 0; i < FIELD_SIZE; i += 7)
+        {
+            int xTexel = i;
+            int zTexel = (i*3) % FIELD_SIZE;
+            float expected = Heightmap::DecodeHeight(terrain.compact[Heightmap::MortonIndex(xTexel, zTexel)],
+                                                     FIELD_HEIGHT_SCALE);
+            for(int f = 0; f < Heightmap::FILTER_COUNT; ++f)
+            {
+                float sampled = Heightmap::SampleHeight(field, xTexel + 0.5f, zTexel + 0.5f, Heightmap::Filter(f));
+                maxCenterError = glm::max(maxCenterError, glm::abs(sampled - expected));
+            }
+        }
+        Test::Check(maxCenterError <= FIELD_HEIGHT_SCALE*SAMPLE_BATCH_TOLERANCE,
+                    "samples at texel centers are off by " + std::to_string(maxCenterError));
+    }
+
+    void testHeightPyramidRayCast()
+    {
+        const TerrainFixture& terrain = getTerrain();
+        const Heightmap::Heightfield& field = terrain.field;
+        float size = float(FIELD_SIZE);
+        float heightScale = FIELD_HEIGHT_SCALE;
+
+        //from above the terrain, looking in every direction, mostly down.
+        //Long enough to go through a few periods of the heightfield
+        std::vector<glm::vec3> origins(RAYCAST_COUNT);
+        std::vector<glm::vec3> directions(RAYCAST_COUNT);
+        std::vector<glm::vec3> ends(RAYCAST_COUNT);
+        float maxDistance = RAYCAST_PERIODS*size;
+        Math::SeedRandomGenerator(17);
+        for(int i = 0; i < RAYCAST_COUNT; ++i)
+        {
+            origins[i] = glm::vec3(Math::RandRange(0.5f, size + 0.5f), 0.0f, Math::RandRange(0.5f, size + 0.5f));
+            origins[i].y = Heightmap::SampleHeight(field, origins[i].x, origins[i].z, Heightmap::FILTER_BILINEAR) +
+                    Math::RandRange(0.001f, 0.3f)*heightScale;
+            float angle = Math::RandRange(0.0f, 2.0f*glm::pi<float>());
+            //height units per texel
+            float slope = Math::RandRange(-1.0f, 0.1f)*heightScale/maxDistance;
+            directions[i] = glm::vec3(glm::cos(angle), slope, glm::sin(angle));
+            ends[i] = origins[i] + directions[i]*maxDistance;
+        }
+
+        std::vector<HeightPyramid::RayHit> hits(RAYCAST_COUNT);
+        ui32 errorCount = 0;
+        ui32 hitCount = 0;
+        for(int i = 0; i < RAYCAST_COUNT; ++i)
+        {
+            HeightPyramid::RayHit& hit = hits[i];
+            HeightPyramid::RayCast(field, terrain.pyramid, origins[i], directions[i], maxDistance, hit);
+            float marchDistance = 0.0f;
+            bool marchHit = BenchScenes::MarchRay(field, origins[i], directions[i], maxDistance, marchDistance);
+            hitCount += hit.hasHit ? 1 : 0;
+
+            if(marchHit && !hit.hasHit)
+            {
+                ++errorCount;
+            }
+            else if(hit.hasHit)
+            {
+                float surface = Heightmap::SampleHeight(field, hit.position.x, hit.position.z,
+                                                        Heightmap::FILTER_BILINEAR);
+                //on the surface, and not after a crossing the march found
+                if(glm::abs(hit.position.y - surface) > heightScale*1e-4f ||
+                   (marchHit && hit.distance > marchDistance + 1e-3f))
+                {
+                    ++errorCount;
+                }
+            }
+        }
+        Test::Check(errorCount == 0, std::to_string(errorCount) + " wrong ray casts out of " +
+                    std::to_string(RAYCAST_COUNT));
+        Test::Check(hitCount > RAYCAST_COUNT/4, "only " + std::to_string(hitCount) + " rays hit the terrain");
+
+        std::vector<HeightPyramid::RayHit> segmentHits(RAYCAST_COUNT);
+        HeightPyramid::IntersectSegments(field, terrain.pyramid, origins.data(), ends.data(),
+                                         segmentHits.data(), RAYCAST_COUNT);
+        ui32 segmentErrors = 0;
+        for(int i = 0; i < RAYCAST_COUNT; ++i)
+        {
+            if(segmentHits[i].hasHit != hits[i].hasHit ||
+               glm::abs(segmentHits[i].distance*maxDistance - hits[i].distance) > 1e-2f)
+            {
+                ++segmentErrors;
+            }
+        }
+        Test::Check(segmentErrors == 0, std::to_string(segmentErrors) + " segments differ from the ray casts");
+
+        //the same rays from other periods of the heightfield hit the same surface
+        ui32 periodErrors = 0;
+        ui32 crossingCount = 0;
+        for(int i = 0; i < RAYCAST_COUNT; ++i)
+        {
+            glm::vec3 offset(float(rand() % 9 - 4)*size, 0.0f, float(rand() % 9 - 4)*size);
+            HeightPyramid::RayHit hit;
+            HeightPyramid::RayCast(field, terrain.pyramid, origins[i] + offset, directions[i], maxDistance, hit);
+            if(hit.hasHit != hits[i].hasHit ||
+               (hit.hasHit && (glm::abs(hit.distance - hits[i].distance) > 1e-2f ||
+                               glm::length(hit.position - offset - hits[i].position) > 1e-2f)))
+            {
+                ++periodErrors;
+            }
+            glm::vec3 hitTexel = hits[i].position;
+            crossingCount += hits[i].hasHit && (hitTexel.x < 0.5f || hitTexel.z < 0.5f ||
+                                                hitTexel.x >= size + 0.5f || hitTexel.z >= size + 0.5f) ? 1 : 0;
+        }
+        Test::Check(periodErrors == 0, std::to_string(periodErrors) + " rays hit elsewhere from another period");
+        Test::Check(crossingCount > 0, "no ray hit past the first period");
+    }
+
+    void testHeightPyramidRanges()
+    {
+        const TerrainFixture& terrain = getTerrain();
+        ui32 size = FIELD_SIZE;
+
+        //patch sized regions anywhere, some wrapping around the edges.
+        //Checked against the texels under the cells of each region
+        ui32 rangeErrors = 0;
+        ui32 mask = size - 1;
+        Math::SeedRandomGenerator(19);
+        for(int i = 0; i < RANGE_QUERY_COUNT; ++i)
+        {
+            glm::vec2 start(Math::RandRange(-0.5f, float(size)), Math::RandRange(-0.5f, float(size)));
+            glm::vec2 extent(Math::RandRange(1.0f, 64.0f), Math::RandRange(1.0f, 64.0f));
+            glm::vec4 region(start, start + extent);
+            HeightPyramid::HeightRange range = HeightPyramid::GetRange(terrain.field, terrain.pyramid, region.x,
+                                                                       region.y, region.z, region.w);
+            ui16 minHeight = 0xFFFF;
+            ui16 maxHeight = 0;
+            int firstX = int(glm::floor(region.x - 0.5f));
+            int firstZ = int(glm::floor(region.y - 0.5f));
+            int lastX = int(glm::floor(region.z - 0.5f)) + 1;
+            int lastZ = int(glm::floor(region.w - 0.5f)) + 1;
+            for(int x = firstX; x <= lastX; ++x)
+            {
+                for(int z = firstZ; z <= lastZ; ++z)
+                {
+                    ui16 height = terrain.compact[Heightmap::MortonIndex(ui32(x) & mask, ui32(z) & mask)].height;
+                    minHeight = glm::min(minHeight, height);
+                    maxHeight = glm::max(maxHeight, height);
+                }
+            }
+            rangeErrors += range.min != minHeight || range.max != maxHeight ? 1 : 0;
+        }
+        Test::Check(rangeErrors == 0, std::to_string(rangeErrors) + " wrong ranges out of " +
+                    std::to_string(RANGE_QUERY_COUNT));
+    }
+
+    //culling of the patches with the height ranges under them must keep every patch with
+    //a visible point of the surface
+    void testTerrainBounds()
+    {
+        const TerrainFixture& terrain = getTerrain();
+        const Heightmap::Heightfield& field = terrain.field;
+        ui32 patchesPerSide = FIELD_SIZE / BOUNDS_PATCH_TEXELS;
+        float worldPerTexel = FIELD_TERRAIN_SIZE / float(FIELD_SIZE);
+        float patchSize = float(BOUNDS_PATCH_TEXELS)*worldPerTexel;
+        float toHeight = FIELD_HEIGHT_SCALE / 65535.0f;
+
+        std::vector<glm::vec2> ranges(patchesPerSide*patchesPerSide);
+        for(ui32 x = 0; x < patchesPerSide; ++x)
+        {
+            for(ui32 z = 0; z < patchesPerSide; ++z)
+            {
+                HeightPyramid::HeightRange range =
+                        HeightPyramid::GetRange(field, terrain.pyramid, float(x*BOUNDS_PATCH_TEXELS),
+                                                float(z*BOUNDS_PATCH_TEXELS), float((x + 1)*BOUNDS_PATCH_TEXELS),
+                                                float((z + 1)*BOUNDS_PATCH_TEXELS));
+                ranges[x*patchesPerSide + z] = glm::vec2(float(range.min)*toHeight - TERRAIN_BOUNDS_SKIRT,
+                                                         float(range.max)*toHeight + TERRAIN_BOUNDS_SKIRT);
+            }
+        }
+        TerrainQuadtree::Quadtree tree;
+        TerrainQuadtree::Build(patchesPerSide, patchSize, glm::vec3(0.0f), ranges, tree);
+
+        //standing near the middle of the map
+        FrustrumCulling::UpdateCulling(BenchScenes::Projection());
+        float center = float(FIELD_SIZE)*0.5f;
+        glm::vec3 cameraPosition(center*worldPerTexel,
+                                 Heightmap::SampleHeight(field, center, center, Heightmap::FILTER_BILINEAR) + 30.0f,
+                                 center*worldPerTexel);
+        ui32 visibleCount = 0;
+        ui32 keptCount = 0;
+        ui32 missedCount = 0;
+        std::vector<bool> kept;
+        for(int view = 0; view < 8; ++view)
+        {
+            //four directions, looking slightly down then slightly up
+            float angle = float(view)*0.5f*glm::pi<float>() + 0.3f;
+            float height = view < 4 ? -200.0f : 400.0f;
+            glm::vec3 target = cameraPosition + glm::vec3(glm::cos(angle)*2000.0f, height, glm::sin(angle)*2000.0f);
+            glm::mat4 viewMatrix = glm::lookAt(cameraPosition, target, glm::vec3(0.0f, 1.0f, 0.0f));
+            BenchScenes::PatchVisibility(tree, viewMatrix, kept);
+
+            for(ui32 x = 0; x < patchesPerSide; ++x)
+            {
+                for(ui32 z = 0; z < patchesPerSide; ++z)
+                {
+                    bool visible = false;
+                    float step = float(BOUNDS_PATCH_TEXELS)/float(BOUNDS_SAMPLES - 1);
+                    for(int i = 0; i < BOUNDS_SAMPLES && !visible; ++i)
+                    {
+                        for(int j = 0; j < BOUNDS_SAMPLES && !visible; ++j)
+                        {
+                            float texelX = float(x*BOUNDS_PATCH_TEXELS) + float(i)*step;
+                            float texelZ = float(z*BOUNDS_PATCH_TEXELS) + float(j)*step;
+                            glm::vec4 point(texelX*worldPerTexel,
+                                            Heightmap::SampleHeight(field, texelX, texelZ, Heightmap::FILTER_BILINEAR),
+                                            texelZ*worldPerTexel, 1.0f);
+                            visible = FrustrumCulling::IsSphereInFrustrum(viewMatrix*point, 0.0f);
+                        }
+                    }
+                    ui32 patch = x*patchesPerSide + z;
+                    visibleCount += visible ? 1 : 0;
+                    keptCount += kept[patch] ? 1 : 0;
+                    missedCount += visible && !kept[patch] ? 1 : 0;
+                }
+            }
+        }
+        Test::Check(missedCount == 0, std::to_string(missedCount) + " visible patches culled by their height range");
+        Test::Check(keptCount < patchesPerSide*patchesPerSide*8, "no patch culled");
+        Debug::Log("terrain bounds : " + std::to_string(visibleCount) + " patches visible, " +
+                   std::to_string(keptCount) + " kept by their height ranges");
+    }
+
+    //partial updates after a few brushes against everything rebuilt from the final heights
+    void testTerrainBrush()
+    {
+        const TerrainFixture& terrain = getTerrain();
+        float terrainSize = FIELD_TERRAIN_SIZE;
+        float heightScale = FIELD_HEIGHT_SCALE;
+        ui32 size = FIELD_SIZE;
+        std::vector<Heightmap::GPUTexel> upload;
+
+        //the brush normals are the heightmap ones, up to the 16 bits heights and the compact encoding
+        std::vector<Heightmap::CompactTexel> recomputed = terrain.compact;
+        TerrainBrush::TexelRect fullRect = { 0, 0, i32(size) - 1, i32(size) - 1 };
+        upload.resize(TerrainBrush::GetTexelCount(fullRect));
+        TerrainBrush::UpdateNormals(recomputed.data(), size, terrainSize, heightScale, fullRect, upload.data());
+        float minNormalDot = 1.0f;
+        for(size_t i = 0; i < terrain.compact.size(); ++i)
+        {
+            minNormalDot = glm::min(minNormalDot, glm::dot(Heightmap::DecodeNormal(terrain.compact[i]),
+                                                           Heightmap::DecodeNormal(recomputed[i])));
+        }
+        Test::Check(minNormalDot >= COMPACT_NORMAL_MIN_DOT, "brush normals differ from the heightmap ones, dot " +
+                    std::to_string(minNormalDot));
+
+        //from there, the partial updates must give exactly the full update normals
+        std::vector<Heightmap::CompactTexel> edited = recomputed;
+        Heightmap::Heightfield field;
+        field.texels = edited.data();
+        field.size = size;
+        field.heightScale = heightScale;
+
+        HeightPyramid::Pyramid pyramid;
+        HeightPyramid::Build(field, pyramid);
+
+        ui32 patchesPerSide = size/BRUSH_PATCH_TEXELS;
+        float patchSize = terrainSize/float(patchesPerSide);
+        glm::vec3 origin(-0.5f*terrainSize, 0.0f, -0.5f*terrainSize);
+        TerrainQuadtree::PatchHeightQuery getHeightRange = [&](ui32 x, ui32 z)
+        {
+            float minX = float(x*BRUSH_PATCH_TEXELS);
+            float minZ = float(z*BRUSH_PATCH_TEXELS);
+            HeightPyramid::HeightRange range = HeightPyramid::GetRange(field, pyramid, minX, minZ,
+                                                                       minX + BRUSH_PATCH_TEXELS,
+                                                                       minZ + BRUSH_PATCH_TEXELS);
+            return glm::vec2(float(range.min), float(range.max))*(heightScale/65535.0f);
+        };
+        std::vector<glm::vec2> patchRanges(patchesPerSide*patchesPerSide);
+        auto getPatchRanges = [&]()
+        {
+            for(ui32 x = 0; x < patchesPerSide; ++x)
+            {
+                for(ui32 z = 0; z < patchesPerSide; ++z)
+                {
+                    patchRanges[x*patchesPerSide + z] = getHeightRange(x, z);
+                }
+            }
+        };
+        getPatchRanges();
+        TerrainQuadtree::Quadtree tree;
+        TerrainQuadtree::Build(patchesPerSide, patchSize, origin, patchRanges, tree);
+
+        //same mapping as the terrain, texel centers at + 0.5
+        float halfTerrainSize = 0.5f*terrainSize;
+        TreeLayout::HeightQuery getHeight = [&](const glm::vec3& pos)
+        {
+            glm::vec2 texel = (glm::vec2(pos.x, pos.z)/terrainSize + 0.5f)*float(size);
+            return Heightmap::SampleHeight(field, texel.x, texel.y, Heightmap::FILTER_BILINEAR);
+        };
+        TreeLayout::NormalQuery getNormal = [&](const glm::vec3& pos)
+        {
+            glm::vec2 texel = (glm::vec2(pos.x, pos.z)/terrainSize + 0.5f)*float(size);
+            return Heightmap::SampleNormal(field, texel.x, texel.y, Heightmap::FILTER_BILINEAR);
+        };
+        std::vector<TreeLayout::TreeGroup> groups;
+        TreeLayout::GenerateTreeGroups(0.0f, 0.0f, 1.0f, heightScale, halfTerrainSize, getHeight, getNormal, groups);
+
+        //one of each, the last two across the heightfield edges
+        std::vector<TerrainBrush::Brush> brushes(5);
+        brushes[0].type = TerrainBrush::BRUSH_CRATER;
+        brushes[0].start = glm::vec3(100.0f, 0.0f, 120.0f);
+        brushes[0].radius = 24.0f;
+        brushes[0].strength = 0.05f*heightScale;
+        brushes[1].type = TerrainBrush::BRUSH_ROAD;
+        brushes[1].start = glm::vec3(300.0f, 0.1f*heightScale, 40.0f);
+        brushes[1].end = glm::vec3(420.0f, 0.15f*heightScale, 200.0f);
+        brushes[1].radius = 6.0f;
+        brushes[2].type = TerrainBrush::BRUSH_FLATTEN;
+        brushes[2].start = glm::vec3(250.0f, 0.2f*heightScale, 300.0f);
+        brushes[2].radius = 40.0f;
+        brushes[2].strength = 0.8f;
+        brushes[3].type = TerrainBrush::BRUSH_RAISE;
+        brushes[3].start = glm::vec3(5.0f, 0.0f, float(size) - 4.0f);
+        brushes[3].radius = 20.0f;
+        brushes[3].strength = 0.03f*heightScale;
+        brushes[4].type = TerrainBrush::BRUSH_CRATER;
+        brushes[4].start = glm::vec3(float(size) - 2.0f, 0.0f, 0.5f*float(size));
+        brushes[4].radius = 30.0f;
+        brushes[4].strength = 0.05f*heightScale;
+
+        ui32 outsideErrors = 0;
+        ui32 changedTexels = 0;
+        std::vector<Heightmap::CompactTexel> before;
+        for(const TerrainBrush::Brush& brush : brushes)
+        {
+            before = edited;
+            TerrainBrush::TexelRect normalsRect = BenchScenes::DeformHeightfield(edited.data(), size, terrainSize,
+                                                                                 heightScale, pyramid, brush, upload);
+            TerrainBrush::TexelRect heightsRect = TerrainBrush::GetBrushRect(brush, size);
+            for(ui32 x = 0; x < size; ++x)
+            {
+                for(ui32 z = 0; z < size; ++z)
+                {
+                    const Heightmap::CompactTexel& a = before[Heightmap::MortonIndex(x, z)];
+                    const Heightmap::CompactTexel& b = edited[Heightmap::MortonIndex(x, z)];
+                    bool heightChanged = a.height != b.height;
+                    bool normalChanged = a.normalX != b.normalX || a.normalY != b.normalY;
+                    changedTexels += heightChanged ? 1 : 0;
+                    if((heightChanged && !isInRect(heightsRect, size, x, z)) ||
+                       (normalChanged && !isInRect(normalsRect, size, x, z)))
+                    {
+                        ++outsideErrors;
+                    }
+                }
+            }
+
+            for(const glm::vec4& region : brushWorldRegions(normalsRect, size, terrainSize))
+            {
+                glm::ivec2 minPatch = glm::clamp(glm::ivec2(glm::floor((glm::vec2(region.x, region.y) -
+                                                                        glm::vec2(origin.x, origin.z))/patchSize)),
+                                                 glm::ivec2(0), glm::ivec2(patchesPerSide - 1));
+                glm::ivec2 maxPatch = glm::clamp(glm::ivec2(glm::floor((glm::vec2(region.z, region.w) -
+                                                                        glm::vec2(origin.x, origin.z))/patchSize)),
+                                                 glm::ivec2(0), glm::ivec2(patchesPerSide - 1));
+                TerrainQuadtree::UpdateHeightRanges(tree, ui32(minPatch.x), ui32(minPatch.y),
+                                                    ui32(maxPatch.x), ui32(maxPatch.y), getHeightRange);
+                TreeLayout::UpdateTreeGroups(0.0f, 0.0f, 1.0f, heightScale, halfTerrainSize, getHeight, getNormal,
+                                             glm::vec2(region.x, region.y), glm::vec2(region.z, region.w), groups);
+            }
+        }
+        Test::Check(changedTexels > 0, "the brushes changed nothing");
+        Test::Check(outsideErrors == 0, std::to_string(outsideErrors) + " texels changed outside of the dirty rects");
+
+        //everything again from the final heights
+        std::vector<Heightmap::CompactTexel> reference = edited;
+        TerrainBrush::UpdateNormals(reference.data(), size, terrainSize, heightScale, fullRect, upload.data());
+        Test::Check(memcmp(reference.data(), edited.data(), edited.size()*sizeof(Heightmap::CompactTexel)) == 0,
+                    "normals differ from a full update");
+
+        HeightPyramid::Pyramid referencePyramid;
+        HeightPyramid::Build(field, referencePyramid);
+        ui32 pyramidErrors = 0;
+        for(size_t level = 0; level < pyramid.levels.size(); ++level)
+        {
+            for(size_t i = 0; i < pyramid.levels[level].size(); ++i)
+            {
+                const HeightPyramid::HeightRange& a = pyramid.levels[level][i];
+                const HeightPyramid::HeightRange& b = referencePyramid.levels[level][i];
+                pyramidErrors += (a.min != b.min || a.max != b.max) ? 1 : 0;
+            }
+        }
+        Test::Check(pyramidErrors == 0, std::to_string(pyramidErrors) + " pyramid nodes differ from a rebuild");
+
+        getPatchRanges();
+        TerrainQuadtree::Quadtree referenceTree;
+        TerrainQuadtree::Build(patchesPerSide, patchSize, origin, patchRanges, referenceTree);
+        Test::Check(isSameQuadtree(tree, referenceTree), "patch bounds differ from a rebuild");
+
+        std::vector<TreeLayout::TreeGroup> referenceGroups;
+        TreeLayout::GenerateTreeGroups(0.0f, 0.0f, 1.0f, heightScale, halfTerrainSize, getHeight, getNormal,
+                                       referenceGroups);
+        auto groupOrder = [](const TreeLayout::TreeGroup& a, const TreeLayout::TreeGroup& b)
+        {
+            return a.position.x < b.position.x || (a.position.x == b.position.x && a.position.y < b.position.y);
+        };
+        std::sort(groups.begin(), groups.end(), groupOrder);
+        std::sort(referenceGroups.begin(), referenceGroups.end(), groupOrder);
+        bool sameGroups = groups.size() == referenceGroups.size();
+        for(size_t i = 0; sameGroups && i < groups.size(); ++i)
+        {
+            sameGroups = groups[i].position == referenceGroups[i].position &&
+                    groups[i].radius == referenceGroups[i].radius && groups[i].height == referenceGroups[i].height &&
+                    groups[i].gridIndex == referenceGroups[i].gridIndex;
+        }
+        Test::Check(sameGroups, "tree groups differ from a full placement");
+    }
+
+    bool loadPatchedHeightmapCache(const std::vector<char>& bytes, ui64 position, ui32 value, ui64 fileBytes,
+                                   ui64 paramsHash)
+    {
+        std::vector<char> patched(bytes.begin(), bytes.begin() + fileBytes);
+        memcpy(patched.data() + position, &value, sizeof(value));
+        HeightmapCache::CachedHeightmap cached;
+        bool loaded = Tools::WriteFileAtomically(CORRUPT_HEIGHTMAP_CACHE_FILE,
+                                                 { { patched.data(), patched.size() } }) &&
+                HeightmapCache::Load(CORRUPT_HEIGHTMAP_CACHE_FILE, paramsHash, HEIGHTMAP_CACHE_SIZE, cached);
+        HeightmapCache::Release(cached);
+        std::remove(CORRUPT_HEIGHTMAP_CACHE_FILE);
+        return loaded;
+    }
+
+    //round trip, then refused for other params, another size, another version or a truncated file
+    void testHeightmapCache()
+    {
+        ui32 size = HEIGHTMAP_CACHE_SIZE;
+        std::vector<Heightmap::GPUTexel> texels(size*size);
+        for(ui32 i = 0; i < size*size; ++i)
+        {
+            texels[i].normalX = ui16(i);
+            texels[i].normalY = ui16(i*7);
+            texels[i].unused = 0;
+            texels[i].height = ui16(i*31);
+        }
+        Heightmap::Params params;
+        params.size = size;
+        ui64 hash = Heightmap::HashParams(params);
+
+        HeightmapCache::CachedHeightmap cached;
+        Test::Check(HeightmapCache::Save(HEIGHTMAP_CACHE_FILE, hash, size, texels.data()) &&
+                    HeightmapCache::Load(HEIGHTMAP_CACHE_FILE, hash, size, cached) && cached.size == size &&
+                    memcmp(cached.texels, texels.data(), texels.size()*sizeof(Heightmap::GPUTexel)) == 0,
+                    "cache round trip failed");
+        HeightmapCache::Release(cached);
+        Test::Check(cached.mapping == nullptr && cached.texels == nullptr, "cache not released");
+
+        Test::Check(!HeightmapCache::Load(HEIGHTMAP_CACHE_FILE, hash + 1, size, cached),
+                    "cache of other params loaded");
+        HeightmapCache::Release(cached);
+        Test::Check(!HeightmapCache::Load(HEIGHTMAP_CACHE_FILE, hash, size*2, cached),
+                    "cache of another size loaded");
+        HeightmapCache::Release(cached);
+        Test::Check(!HeightmapCache::Load("missing_" HEIGHTMAP_CACHE_FILE, hash, size, cached),
+                    "missing cache loaded");
+
+        std::vector<char> bytes;
+        {
+            std::ifstream stream(HEIGHTMAP_CACHE_FILE, std::ios::in | std::ios::binary);
+            bytes.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+        }
+        std::remove(HEIGHTMAP_CACHE_FILE);
+        if(bytes.size() < size*size*sizeof(Heightmap::GPUTexel))
+        {
+            Test::Check(false, "could not read " HEIGHTMAP_CACHE_FILE);
+            return;
+        }
+        ui64 fileBytes = bytes.size();
+        ui32 version;
+        memcpy(&version, bytes.data() + HEIGHTMAP_CACHE_VERSION_POSITION, sizeof(version));
+        Test::Check(loadPatchedHeightmapCache(bytes, HEIGHTMAP_CACHE_VERSION_POSITION, version, fileBytes, hash),
+                    "unchanged copy not loaded");
+        Test::Check(!loadPatchedHeightmapCache(bytes, HEIGHTMAP_CACHE_VERSION_POSITION, version + 1, fileBytes, hash),
+                    "cache of another version loaded");
+        Test::Check(!loadPatchedHeightmapCache(bytes, HEIGHTMAP_CACHE_VERSION_POSITION, version, fileBytes - 1, hash),
+                    "truncated cache loaded");
+        Test::Check(!loadPatchedHeightmapCache(bytes, HEIGHTMAP_CACHE_VERSION_POSITION, version, 32, hash),
+                    "truncated header loaded");
+    }
+
+    void testHorizonMap()
+    {
+        const TerrainFixture& terrain = getTerrain();
+        const Heightmap::Heightfield& field = terrain.field;
+        ui32 size = FIELD_SIZE;
+
+        HorizonMap::Settings settings;
+        settings.size = HORIZON_MAP_SIZE;
+        settings.directionCount = HORIZON_DIRECTION_COUNT;
+        settings.maxDistance = HORIZON_MAX_DISTANCE;
+        settings.texelSpacing = FIELD_TERRAIN_SIZE/float(size);
+
+        //serial against all cores, the parallel bake must be bit identical
+        HorizonMap::Map serial;
+        HorizonMap::Map map;
+        Parallel::SetWorkerCount(1);
+        HorizonMap::Bake(field, settings, serial);
+        Parallel::SetWorkerCount(0);
+        HorizonMap::Bake(field, settings, map);
+        Test::Check(serial.texels == map.texels, "parallel bake differs from serial");
+
+        //against brute force ray casts from random texels of the map, the ray casts wrap around
+        //the heightfield like the bake
+        float fieldPerMap = float(size)/float(HORIZON_MAP_SIZE);
+        float maxError = 0.0f;
+        float errorSum = 0.0f;
+        Math::SeedRandomGenerator(23);
+        for(int i = 0; i < HORIZON_RAYCAST_COUNT; ++i)
+        {
+            ui32 x = ui32(rand()) % HORIZON_MAP_SIZE;
+            ui32 z = ui32(rand()) % HORIZON_MAP_SIZE;
+            ui32 direction = ui32(rand()) % HORIZON_DIRECTION_COUNT;
+            glm::vec2 position = (glm::vec2(float(x), float(z)) + 0.5f)*fieldPerMap;
+            float reference = rayCastHorizonSine(field, terrain.pyramid, position,
+                                                 HorizonMap::GetDirection(map, direction), settings.texelSpacing);
+            float baked = HorizonMap::GetHorizonSine(map, x, z, direction);
+            float error = glm::degrees(glm::abs(glm::asin(reference) - glm::asin(baked)));
+            maxError = glm::max(maxError, error);
+            errorSum += error;
+        }
+        float meanError = errorSum/float(HORIZON_RAYCAST_COUNT);
+        Test::Check(maxError <= HORIZON_MAX_ANGLE_ERROR && meanError <= HORIZON_MEAN_ANGLE_ERROR,
+                    "too far from the ray casts, " + std::to_string(meanError) + " degrees on average, " +
+                    std::to_string(maxError) + " at most");
+
+        //a crater rebaked in place, against the whole map baked again
+        std::vector<Heightmap::CompactTexel> edited = terrain.compact;
+        Heightmap::Heightfield editedField = field;
+        editedField.texels = edited.data();
+        TerrainBrush::Brush crater;
+        crater.type = TerrainBrush::BRUSH_CRATER;
+        crater.start = glm::vec3(float(size) - 10.0f, 0.0f, 40.0f);
+        crater.radius = 20.0f;
+        crater.strength = 0.05f*FIELD_HEIGHT_SCALE;
+        TerrainBrush::ApplyBrush(edited.data(), size, FIELD_HEIGHT_SCALE, crater);
+        HorizonMap::Map updated = map;
+        HorizonMap::UpdateRegion(editedField, updated, TerrainBrush::GetBrushRect(crater, size));
+        HorizonMap::Map rebaked;
+        HorizonMap::Bake(editedField, settings, rebaked);
+        Test::Check(updated.texels == rebaked.texels, "region update differs from a full bake");
+
+        //cache round trip, refused once the heights change
+        HorizonMap::Map loaded;
+        ui64 hash = HorizonMap::Hash(field, settings);
+        Test::Check(HorizonMap::Save(HORIZON_FILE, hash, map) &&
+                    HorizonMap::Load(HORIZON_FILE, settings, hash, loaded) && loaded.texels == map.texels,
+                    "cache round trip failed");
+        Test::Check(!HorizonMap::Load(HORIZON_FILE, settings, HorizonMap::Hash(editedField, settings), loaded),
+                    "cache of other heights loaded");
+        std::remove(HORIZON_FILE);
+    }
+
+    //every patch in view is drawn exactly once, merged or not
+    void testTerrainQuadtree()
+    {
+        //rolling hills, patches as high as they are wide around them
+        ui32 patchesPerSide = QUADTREE_PATCHES_PER_SIDE;
+        float patchSize = QUADTREE_PATCH_SIZE;
+        float halfSize = float(patchesPerSide)*patchSize*0.5f;
+        glm::vec3 origin(-halfSize, 0.0f, -halfSize);
+        std::vector<glm::vec2> heightRanges(patchesPerSide*patchesPerSide);
+        for(ui32 x = 0; x < patchesPerSide; ++x)
+        {
+            for(ui32 z = 0; z < patchesPerSide; ++z)
+            {
+                glm::vec3 center = origin + glm::vec3(float(x) + 0.5f, 0.0f, float(z) + 0.5f)*patchSize;
+                float height = 20.0f*glm::sin(center.x*0.001f)*glm::cos(center.z*0.001f);
+                heightRanges[x*patchesPerSide + z] = glm::vec2(height - patchSize*0.5f, height + patchSize*0.5f);
+            }
+        }
+        TerrainQuadtree::Quadtree tree;
+        TerrainQuadtree::Build(patchesPerSide, patchSize, origin, heightRanges, tree);
+
+        FrustrumCulling::UpdateCulling(BenchScenes::Projection());
+        glm::vec3 cameraPosition(0.0f, 200.0f, 0.0f);
+        glm::mat4 viewMatrix = glm::lookAt(cameraPosition, glm::vec3(1000.0f, 150.0f, 300.0f),
+                                           glm::vec3(0.0f, 1.0f, 0.0f));
+        TerrainQuadtree::LodSettings lod;
+        lod.maxTessDistance = halfSize*2.0f;
+        lod.lodMultiplier = Quality::TerrainLodMultiplier;
+
+        std::vector<glm::vec4> instances;
+        TerrainQuadtree::SelectionStats stats;
+        TerrainQuadtree::SelectPatches(tree, viewMatrix, cameraPosition, lod, instances, stats);
+        std::vector<bool> visible;
+        BenchScenes::PatchVisibility(tree, viewMatrix, visible);
+
+        std::vector<ui32> drawCount(visible.size(), 0);
+        ui32 tooCloseCount = 0;
+        for(const glm::vec4& instance : instances)
+        {
+            ui32 firstX = ui32(glm::round((instance.x - origin.x)/patchSize));
+            ui32 firstZ = ui32(glm::round((instance.z - origin.z)/patchSize));
+            ui32 size = ui32(glm::round(instance.w/patchSize));
+            for(ui32 x = firstX; x < firstX + size && x < patchesPerSide; ++x)
+            {
+                for(ui32 z = firstZ; z < firstZ + size && z < patchesPerSide; ++z)
+                {
+                    ++drawCount[x*patchesPerSide + z];
+                }
+            }
+            //merged patches must stay at the minimum tessellation all over their footprint
+            if(size > 1)
+            {
+                glm::vec2 closest = glm::clamp(glm::vec2(cameraPosition.x, cameraPosition.z),
+                                               glm::vec2(instance.x, instance.z),
+                                               glm::vec2(instance.x, instance.z) + instance.w);
+                float distance = glm::length(glm::vec2(cameraPosition.x, cameraPosition.z) - closest);
+                tooCloseCount += TerrainQuadtree::GetTessellationLevel(distance, patchSize, lod) >
+                        TERRAIN_MIN_TESS_LEVEL ? 1 : 0;
+            }
+        }
+        ui32 missedCount = 0;
+        ui32 twiceCount = 0;
+        for(ui32 i = 0; i < visible.size(); ++i)
+        {
+            twiceCount += drawCount[i] > 1 ? 1 : 0;
+            missedCount += visible[i] && drawCount[i] == 0 ? 1 : 0;
+        }
+        Test::Check(missedCount == 0, std::to_string(missedCount) + " patches in view not drawn");
+        Test::Check(twiceCount == 0, std::to_string(twiceCount) + " patches drawn twice");
+        Test::Check(tooCloseCount == 0, std::to_string(tooCloseCount) + " patches merged too close");
+        Test::Check(stats.drawnPatches + stats.culledPatches == visible.size(), "patches counted wrong");
+    }
+
+    //pages of a camera walk, checking the residency after every frame
+    void testClipmap()
+    {
+        Clipmap::Settings settings;
+        settings.levelCount = CLIPMAP_LEVEL_COUNT;
+        settings.tilesPerLevel = CLIPMAP_TILES_PER_LEVEL;
+        settings.tileSize = CLIPMAP_TILE_SIZE;
+        settings.size = CLIPMAP_SIZE;
+
+        Clipmap::State state;
+        std::vector<Clipmap::Page> pages;
+        Clipmap::Init(settings, state);
+        ui32 outOfWindowCount = 0;
+        ui32 nonResidentCount = 0;
+        ui32 badPageCount = 0;
+        auto checkLevels = [&]()
+        {
+            for(ui32 level = 0; level < settings.levelCount; ++level)
+            {
+                const Clipmap::Level& levelState = state.levels[level];
+                const Clipmap::TileRect& valid = levelState.valid;
+                if(Clipmap::IsEmpty(valid))
+                {
+                    continue;
+                }
+                if(valid.minX < levelState.window.minX || valid.minZ < levelState.window.minZ ||
+                   valid.maxX > levelState.window.maxX || valid.maxZ > levelState.window.maxZ)
+                {
+                    ++outOfWindowCount;
+                }
+                for(i32 x = valid.minX; x < valid.maxX; ++x)
+                {
+                    for(i32 z = valid.minZ; z < valid.maxZ; ++z)
+                    {
+                        nonResidentCount += Clipmap::IsResident(state, level, x, z) ? 0 : 1;
+                    }
+                }
+            }
+        };
+        for(ui32 frame = 0; frame < CLIPMAP_FRAME_COUNT; ++frame)
+        {
+            glm::vec2 camera = BenchScenes::ClipmapCameraPath(frame, CLIPMAP_SIZE);
+            Clipmap::Update(state, camera.x, camera.y);
+            //only tiles of the windows that are not there yet
+            for(const Clipmap::Page& page : state.pending)
+            {
+                const Clipmap::TileRect& window = state.levels[page.level].window;
+                bool inWindow = i32(page.tileX) >= window.minX && i32(page.tileX) < window.maxX &&
+                        i32(page.tileZ) >= window.minZ && i32(page.tileZ) < window.maxZ;
+                if(!inWindow || Clipmap::IsResident(state, page.level, i32(page.tileX), i32(page.tileZ)) ||
+                   page.slotX != page.tileX % CLIPMAP_TILES_PER_LEVEL ||
+                   page.slotZ != page.tileZ % CLIPMAP_TILES_PER_LEVEL)
+                {
+                    ++badPageCount;
+                }
+            }
+            Clipmap::TakePages(state, CLIPMAP_PAGES_PER_FRAME, pages);
+            badPageCount += pages.size() > CLIPMAP_PAGES_PER_FRAME ? 1 : 0;
+            checkLevels();
+        }
+
+        //a still camera ends up with every window resident
+        glm::vec2 camera = BenchScenes::ClipmapCameraPath(CLIPMAP_FRAME_COUNT, CLIPMAP_SIZE);
+        ui32 drainFrames = 0;
+        do
+        {
+            Clipmap::Update(state, camera.x, camera.y);
+            Clipmap::TakePages(state, CLIPMAP_PAGES_PER_FRAME, pages);
+            ++drainFrames;
+        }
+        while(!state.pending.empty() && drainFrames < CLIPMAP_FRAME_COUNT);
+        Clipmap::Update(state, camera.x, camera.y);
+        Test::Check(state.pending.empty(), "pages still pending after the camera stopped");
+        ui32 partialCount = 0;
+        for(const Clipmap::Level& level : state.levels)
+        {
+            const Clipmap::TileRect& valid = level.valid;
+            const Clipmap::TileRect& window = level.window;
+            partialCount += valid.minX != window.minX || valid.minZ != window.minZ ||
+                    valid.maxX != window.maxX || valid.maxZ != window.maxZ ? 1 : 0;
+        }
+        checkLevels();
+
+        Test::Check(badPageCount == 0, std::to_string(badPageCount) +
+                    " pages uploaded twice, out of their window or slot");
+        Test::Check(outOfWindowCount == 0 && nonResidentCount == 0, "valid tiles out of their window or not resident");
+        Test::Check(partialCount == 0, std::to_string(partialCount) + " levels not filled once the camera stopped");
+    }
+
+    void testTiledHeightfield()
+    {
+        ui32 size = TILED_HEIGHTFIELD_SIZE;
+        ui32 tileSize = TILED_HEIGHTFIELD_TILE_SIZE;
+        float heightScale = 1000.0f;
+        TiledHeightfield::HeightSource getHeight = [heightScale](ui32 x, ui32 z) -> float
+        {
+            return heightScale*(0.5f + 0.25f*glm::sin(float(x)*0.02f) + 0.2f*glm::cos(float(z)*0.013f));
+        };
+
+        TiledHeightfield::File file;
+        if(!TiledHeightfield::Write(TILED_HEIGHTFIELD_FILE, size, tileSize, heightScale, 2.0f, getHeight) ||
+           !TiledHeightfield::Open(TILED_HEIGHTFIELD_FILE, file))
+        {
+            Test::Check(false, "could not write and open " TILED_HEIGHTFIELD_FILE);
+            std::remove(TILED_HEIGHTFIELD_FILE);
+            return;
+        }
+
+        //level 0 holds the quantized source, level 1 the 2x2 averages of it
+        ui32 sourceErrors = 0;
+        std::vector<Heightmap::GPUTexel> level0(size*size);
+        std::vector<Heightmap::GPUTexel> level1(size*size/4);
+        TiledHeightfield::ReadLevel(file, 0, level0.data());
+        TiledHeightfield::ReadLevel(file, 1, level1.data());
+        for(ui32 x = 0; x < size; ++x)
+        {
+            for(ui32 z = 0; z < size; ++z)
+            {
+                const Heightmap::GPUTexel* tile = TiledHeightfield::GetTile(file, 0, x / tileSize, z / tileSize);
+                ui16 height = tile[(x % tileSize)*tileSize + z % tileSize].height;
+                float expected = getHeight(x, z)/heightScale*65535.0f;
+                sourceErrors += glm::abs(float(height) - expected) > 1.0f || height != level0[x*size + z].height ? 1 : 0;
+            }
+        }
+        ui32 averageErrors = 0;
+        for(ui32 x = 0; x < size/2; ++x)
+        {
+            for(ui32 z = 0; z < size/2; ++z)
+            {
+                float average = 0.0f;
+                for(ui32 i = 0; i < 4; ++i)
+                {
+                    average += float(level0[(x*2 + (i >> 1))*size + z*2 + (i & 1)].height)*0.25f;
+                }
+                averageErrors += glm::abs(float(level1[x*(size/2) + z].height) - average) > 1.0f ? 1 : 0;
+            }
+        }
+        Test::Check(sourceErrors == 0, std::to_string(sourceErrors) + " texels differ from their source");
+        Test::Check(averageErrors == 0, std::to_string(averageErrors) + " level 1 texels differ from the averages");
+
+        //ranges hold every texel the region touches
+        ui32 rangeErrors = 0;
+        Math::SeedRandomGenerator(17);
+        for(ui32 i = 0; i < RANGE_QUERY_COUNT; ++i)
+        {
+            glm::vec2 start(Math::RandRange(-8.0f, float(size)), Math::RandRange(-8.0f, float(size)));
+            glm::vec2 extent(Math::RandRange(1.0f, 150.0f), Math::RandRange(1.0f, 150.0f));
+            glm::vec4 region(start, start + extent);
+            HeightPyramid::HeightRange range = TiledHeightfield::GetRange(file, region.x, region.y, region.z, region.w);
+            i32 maxCoord = i32(size) - 1;
+            i32 lastX = glm::clamp(i32(glm::floor(region.z - 0.5f)) + 1, 0, maxCoord);
+            i32 lastZ = glm::clamp(i32(glm::floor(region.w - 0.5f)) + 1, 0, maxCoord);
+            for(i32 x = glm::clamp(i32(glm::floor(region.x - 0.5f)), 0, maxCoord); x <= lastX; ++x)
+            {
+                for(i32 z = glm::clamp(i32(glm::floor(region.y - 0.5f)), 0, maxCoord); z <= lastZ; ++z)
+                {
+                    ui16 height = level0[x*size + z].height;
+                    rangeErrors += height < range.min || height > range.max ? 1 : 0;
+                }
+            }
+        }
+        Test::Check(rangeErrors == 0, std::to_string(rangeErrors) + " texels out of their range");
+
+        TiledHeightfield::Close(file);
+        std::remove(TILED_HEIGHTFIELD_FILE);
+    }
+
+    //patches a copy of a valid file, Open must refuse it rather than map tiles out of the file
+    bool openPatchedHeightfield(const std::vector<char>& bytes, ui64 position, ui64 value, ui64 fileBytes)
+    {
+        std::vector<char> patched(bytes.begin(), bytes.begin() + fileBytes);
+        memcpy(patched.data() + position, &value, sizeof(value));
+        TiledHeightfield::File file;
+        bool opened = Tools::WriteFileAtomically(CORRUPT_HEIGHTFIELD_FILE, { { patched.data(), patched.size() } }) &&
+                TiledHeightfield::Open(CORRUPT_HEIGHTFIELD_FILE, file);
+        TiledHeightfield::Close(file);
+        std::remove(CORRUPT_HEIGHTFIELD_FILE);
+        return opened;
+    }
+
+    void testTiledHeightfieldValidation()
+    {
+        ui32 tileSize = TILED_HEIGHTFIELD_TILE_SIZE;
+        ui64 tileBytes = ui64(tileSize)*ui64(tileSize)*sizeof(Heightmap::GPUTexel);
+        TiledHeightfield::HeightSource getHeight = [](ui32 x, ui32 z) -> float
+        {
+            return float(x + z);
+        };
+        std::vector<char> bytes;
+        if(TiledHeightfield::Write(TILED_HEIGHTFIELD_FILE, tileSize*2, tileSize, 1000.0f, 2.0f, getHeight))
+        {
+            std::ifstream stream(TILED_HEIGHTFIELD_FILE, std::ios::in | std::ios::binary);
+            bytes.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+        }
+        std::remove(TILED_HEIGHTFIELD_FILE);
+        if(bytes.size() < TILED_FIRST_TILE_POSITION + tileBytes)
+        {
+            Test::Check(false, "could not write " TILED_HEIGHTFIELD_FILE);
+            return;
+        }
+        ui64 fileBytes = bytes.size();
+        ui64 dataOffset;
+        memcpy(&dataOffset, bytes.data() + TILED_DATA_OFFSET_POSITION, sizeof(dataOffset));
+
+        Test::Check(openPatchedHeightfield(bytes, TILED_DATA_OFFSET_POSITION, dataOffset, fileBytes),
+                    "unchanged copy not opened");
+        Test::Check(!openPatchedHeightfield(bytes, TILED_DATA_OFFSET_POSITION, TILED_FIRST_TILE_POSITION, fileBytes),
+                    "tile table overlapping the tiles opened");
+        Test::Check(!openPatchedHeightfield(bytes, TILED_FIRST_TILE_POSITION, fileBytes - tileBytes/2, fileBytes),
+                    "tile ending past the file opened");
+        Test::Check(!openPatchedHeightfield(bytes, TILED_FIRST_TILE_POSITION, ~0ull - 8, fileBytes),
+                    "tile offset wrapping around opened");
+        Test::Check(!openPatchedHeightfield(bytes, TILED_DATA_OFFSET_POSITION, dataOffset, fileBytes - 1),
+                    "truncated file opened");
+    }
+}
+
+namespace SCE
+{
+
+namespace Test
+{
+    void AddTerrainTests()
+    {
+        Add("heightmap_parallel", testHeightmapParallel);
+        Add("heightfield_packing", testHeightfieldPacking);
+        Add("heightfield_sampling", testHeightfieldSampling);
+        Add("height_pyramid_raycast", testHeightPyramidRayCast);
+        Add("height_pyramid_ranges", testHeightPyramidRanges);
+        Add("terrain_bounds", testTerrainBounds);
+        Add("terrain_brush", testTerrainBrush);
+        Add("heightmap_cache", testHeightmapCache);
+        Add("horizon_map", testHorizonMap);
+        Add("terrain_quadtree", testTerrainQuadtree);
+        Add("clipmap", testClipmap);
+        Add("tiled_heightfield", testTiledHeightfield);
+        Add("tiled_heightfield_validation", testTiledHeightfieldValidation);
+    }
+}
+
+}
@@ -0,0 +1,70 @@
+/******PROJECT:Sand Castle Engine******/
+/**************************************/
+/*********AUTHOR:Gwenn AUBERT**********/
+/***********FILE:SCETest.cpp***********/
+/**************************************/
+
+#include "SCETest.hpp"
+#include "../headers/SCETools.hpp"
+
+#include <vector>
+
+namespace SCE
+{
+
+namespace Test
+{
+    namespace
+    {
+        struct Case
+        {
+            std::string name;
+            Body        body;
+        };
+
+        std::vector<Case>   cases;
+        const Case*         runningCase = nullptr;
+        ui32                failedChecks = 0;
+    }
+
+    void Add(const std::string& name, const Body& body)
+    {
+        Case testCase = { name, body };
+        cases.push_back(testCase);
+    }
+
+    void Check(bool condition, const std::string& message)
+    {
+        Debug::Assert(runningCase != nullptr, "Check called outside of a test case");
+        if(!condition)
+        {
+            ++failedChecks;
+            Debug::LogError(runningCase->name + " : " + message);
+        }
+    }
+
+    ui32 RunAll(const std::string& filter)
+    {
+        ui32 runCount = 0;
+        ui32 failedCount = 0;
+        for(const Case& testCase : cases)
+        {
+            if(!filter.empty() && testCase.name.find(filter) == std::string::npos)
+            {
+                continue;
+            }
+            runningCase = &testCase;
+            failedChecks = 0;
+            testCase.body();
+            runningCase = nullptr;
+
+            ++runCount;
+            failedCount += failedChecks > 0 ? 1 : 0;
+            Debug::Log((failedChecks > 0 ? "FAILED " : "passed ") + testCase.name);
+        }
+        Debug::Log(std::to_string(runCount - failedCount) + " of " + std::to_string(runCount) + " tests passed");
+        return failedCount;
+    }
+}
+
+}
@@ -0,0 +1,39 @@
+/******PROJECT:Sand Castle Engine******/
+/**************************************/
+/*********AUTHOR:Gwenn AUBERT**********/
+/***********FILE:SCETest.hpp***********/
+/**************************************/
+#ifndef SCE_TEST_HPP
+#define SCE_TEST_HPP
+
+#include "../headers/SCEDefines.hpp"
+#include <functional>
+
+//Minimal test harness : named cases run one after the other, a failed check is logged
+//and the case keeps going so that every failure of a run shows up at once.
+namespace SCE
+{
+
+    namespace Test
+    {
+        typedef std::function<void()> Body;
+
+        //cases run in the order they were added
+        void        Add(const std::string& name, const Body& body);
+
+        //fails the running case when condition is false
+        void        Check(bool condition, const std::string& message);
+
+        //runs the cases whose name contains filter, all of them if it is empty,
+        //returns how many failed
+        ui32        RunAll(const std::string& filter);
+
+        //cases of each test file
+        void        AddCoreTests();
+        void        AddTerrainTests();
+        void        AddTreeTests();
+    }
+
+}
+
+#endif
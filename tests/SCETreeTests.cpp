@@ -0,0 +1,445 @@
+/******PROJECT:Sand Castle Engine******/
+/**************************************/
+/*********AUTHOR:Gwenn AUBERT**********/
+/********FILE:SCETreeTests.cpp*********/
+/**************************************/
+
+#include "SCETest.hpp"
+#include "../bench/SCEBenchScenes.hpp"
+#include "../headers/SCETools.hpp"
+#include "../headers/SCEFrustrumCulling.hpp"
+#include "../headers/SCETreeLayout.hpp"
+#include "../headers/SCEImpostorCache.hpp"
+#include "../headers/SCEQuality.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <fstream>
+#include <algorithm>
+#include <tuple>
+#include <cstring>
+#include <cstdio>
+
+#define TREES_HALF_TERRAIN_SIZE 8000.0f
+//tree density multipliers checked against placements from scratch
+#define TREES_DENSITIES {1, 2}
+//camera path checked against placements from scratch, long enough to evict groups
+#define TREES_PATH_STEPS 24
+#define TREES_PATH_STEP 600.0f
+//camera walking back and forth a few meters per update, over a dense forest
+#define TREES_WALK_STEPS 20
+#define TREES_WALK_STEP 2.0f
+#define TREES_WALK_DENSITY 4
+#define TREES_WALK_COPIES 3
+//one cell over the whole world, so every group is tested like before the grid
+#define TREES_SCAN_CELL_SIZE 1e9f
+#define INSTANCE_ENCODE_COUNT 10000
+//atlas of 6x6 views, like the trees, with smaller views
+#define IMPOSTOR_CACHE_ANGLES (6*6)
+#define IMPOSTOR_CACHE_VIEW_SIZE 32
+#define IMPOSTOR_CACHE_FILE "test_impostor.cache"
+#define IMPOSTOR_SOURCE_FILE "test_impostor_source.tmp"
+
+using namespace SCE;
+
+namespace
+{
+    //the lists are in the order the updates patched them, compare them sorted
+    std::vector<TreeLayout::CompactInstance> getSortedList(const std::vector<TreeLayout::CompactInstance>& list)
+    {
+        std::vector<TreeLayout::CompactInstance> sorted = list;
+        std::sort(sorted.begin(), sorted.end(),
+                  [](const TreeLayout::CompactInstance& a, const TreeLayout::CompactInstance& b) -> bool
+        {
+            return std::tie(a.x, a.z, a.y, a.packed) < std::tie(b.x, b.z, b.y, b.packed);
+        });
+        return sorted;
+    }
+
+    bool isSameInstanceList(const std::vector<TreeLayout::CompactInstance>& a,
+                            const std::vector<TreeLayout::CompactInstance>& b)
+    {
+        std::vector<TreeLayout::CompactInstance> sortedA = getSortedList(a);
+        std::vector<TreeLayout::CompactInstance> sortedB = getSortedList(b);
+        return a.size() == b.size() && (a.empty() ||
+                memcmp(sortedA.data(), sortedB.data(), a.size()*sizeof(TreeLayout::CompactInstance)) == 0);
+    }
+
+    //pages of the lists the last update wrote
+    ui32 getWrittenPageCount(const TreeLayout::TreeInstances& instances)
+    {
+        ui32 count = 0;
+        for(ui32 list = 0; list < TREE_LIST_COUNT; ++list)
+        {
+            ui32 pageCount = (ui32(TreeLayout::GetInstanceList(instances, list).size()) +
+                              TREE_INSTANCE_PAGE_SIZE - 1)/TREE_INSTANCE_PAGE_SIZE;
+            for(ui32 page = 0; page < pageCount; ++page)
+            {
+                count += instances.pageUpdates[list][page] == instances.update ? 1 : 0;
+            }
+        }
+        return count;
+    }
+
+    bool isSameInstances(const TreeLayout::TreeInstances& a, const TreeLayout::TreeInstances& b)
+    {
+        for(int lod = 0; lod < TREE_LOD_COUNT; ++lod)
+        {
+            if(!isSameInstanceList(a.trees[lod], b.trees[lod]))
+            {
+                return false;
+            }
+        }
+        return isSameInstanceList(a.impostors, b.impostors) &&
+                a.visibleGroupCount == b.visibleGroupCount && a.culledGroupCount == b.culledGroupCount;
+    }
+
+    //Same trees and LODs, the impostors may face the camera of an older update. Their yaw is at
+    //most TREE_IMPOSTOR_REFACE_ANGLE and a yaw step away, their atlas cell next to the exact one
+    bool isSimilarInstances(const TreeLayout::TreeInstances& a, const TreeLayout::TreeInstances& exact)
+    {
+        for(int lod = 0; lod < TREE_LOD_COUNT; ++lod)
+        {
+            if(!isSameInstanceList(a.trees[lod], exact.trees[lod]))
+            {
+                return false;
+            }
+        }
+        if(a.impostors.size() != exact.impostors.size() || a.visibleGroupCount != exact.visibleGroupCount ||
+           a.culledGroupCount != exact.culledGroupCount)
+        {
+            return false;
+        }
+
+        const float maxYawError = TREE_IMPOSTOR_REFACE_ANGLE + 2.0f*glm::pi<float>()/float(1 << TREE_INSTANCE_YAW_BITS);
+        std::vector<TreeLayout::CompactInstance> impostors = getSortedList(a.impostors);
+        std::vector<TreeLayout::CompactInstance> exactImpostors = getSortedList(exact.impostors);
+        for(size_t i = 0; i < impostors.size(); ++i)
+        {
+            glm::vec3 position, exactPosition;
+            float scale, exactScale, yaw, exactYaw;
+            ui32 view, exactView;
+            TreeLayout::DecodeInstance(impostors[i], position, scale, yaw, view);
+            TreeLayout::DecodeInstance(exactImpostors[i], exactPosition, exactScale, exactYaw, exactView);
+            float yawError = glm::abs(glm::mod(yaw - exactYaw + glm::pi<float>(), 2.0f*glm::pi<float>()) -
+                                      glm::pi<float>());
+            ui32 viewDistance = (view + NB_IMPOSTOR_ANGLES - exactView) % NB_IMPOSTOR_ANGLES;
+            if(position != exactPosition || scale != exactScale || yawError > maxYawError + 1e-5f ||
+               (viewDistance > 1 && viewDistance < NB_IMPOSTOR_ANGLES - 1))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    //low rolling hills, flat enough for trees to spawn wherever the noise allows it.
+    //The bump is raised to check that edited placements are dropped
+    struct TreeScene
+    {
+        TreeScene() : bump(0.0f), bumpHeight(0.0f), halfTerrainSize(TREES_HALF_TERRAIN_SIZE),
+            cameraPosition(0.0f, 200.0f, 0.0f), cameraTarget(1000.0f, 150.0f, 300.0f), cancel(false)
+        {
+            getHeight = [this](const glm::vec3& pos) -> float
+            {
+                bool isInBump = pos.x >= bump.x && pos.z >= bump.y && pos.x <= bump.z && pos.z <= bump.w;
+                return 20.0f*glm::sin(pos.x*0.001f)*glm::cos(pos.z*0.001f) + (isInBump ? bumpHeight : 0.0f);
+            };
+            getNormal = [](const glm::vec3&) -> glm::vec3
+            {
+                return glm::vec3(0.0f, 1.0f, 0.0f);
+            };
+            getHeights = [this](const float* x, const float* z, float* heights, int count)
+            {
+                for(int i = 0; i < count; ++i)
+                {
+                    heights[i] = getHeight(glm::vec3(x[i], 0.0f, z[i]));
+                }
+            };
+            lookAt(glm::vec3(0.0f));
+        }
+
+        void generateGroups()
+        {
+            groups.clear();
+            TreeLayout::GenerateTreeGroups(0.0f, 0.0f, 1.0f, 10000.0f, halfTerrainSize, getHeight, getNormal, groups);
+            TreeLayout::BuildGroupGrid(groups, TREE_GROUP_GRID_CELL_SIZE, grid);
+            TreeLayout::BuildGroupGrid(groups, TREES_SCAN_CELL_SIZE, scanGrid);
+        }
+
+        void lookAt(const glm::vec3& offset)
+        {
+            cameraPosition = glm::vec3(0.0f, 200.0f, 0.0f) + offset;
+            viewMatrix = glm::lookAt(cameraPosition, cameraTarget + offset, glm::vec3(0.0f, 1.0f, 0.0f));
+        }
+
+        void computeVisibility(const TreeLayout::GroupGrid& groupGrid, TreeLayout::PlacementCache& cache,
+                               TreeLayout::TreeInstances& instances)
+        {
+            TreeLayout::ComputeVisibilityAndLOD(groups, groupGrid, viewMatrix, glm::vec3(0.0f), cameraPosition,
+                                                halfTerrainSize, getHeights, cancel, cache, instances);
+        }
+
+        glm::vec4                           bump;
+        float                               bumpHeight;
+        float                               halfTerrainSize;
+        glm::vec3                           cameraPosition;
+        glm::vec3                           cameraTarget;
+        glm::mat4                           viewMatrix;
+        TreeLayout::HeightQuery             getHeight;
+        TreeLayout::NormalQuery             getNormal;
+        TreeLayout::HeightBatchQuery        getHeights;
+        Parallel::CancelToken               cancel;
+        std::vector<TreeLayout::TreeGroup>  groups;
+        TreeLayout::GroupGrid               grid;
+        TreeLayout::GroupGrid               scanGrid;
+    };
+
+    //the grid and the cached placements must give what testing every group and placing from scratch gives
+    void testTreesVisibility()
+    {
+        FrustrumCulling::UpdateCulling(BenchScenes::Projection());
+        float baseSpacing = Quality::Trees::BaseSpacing;
+        TreeScene scene;
+        TreeLayout::TreeInstances instances;
+        TreeLayout::TreeInstances reference;
+        for(int density : TREES_DENSITIES)
+        {
+            Quality::Trees::BaseSpacing = baseSpacing/glm::sqrt(float(density));
+            scene.generateGroups();
+            TreeLayout::PlacementCache cache;
+            scene.computeVisibility(scene.grid, cache, instances);
+            //a second update goes through the cached placements, and has nothing to write
+            scene.computeVisibility(scene.grid, cache, instances);
+            Test::Check(getWrittenPageCount(instances) == 0, "density x" + std::to_string(density) +
+                        " lists written again by an update without any change");
+            TreeLayout::PlacementCache coldCache;
+            scene.computeVisibility(scene.scanGrid, coldCache, reference);
+            Test::Check(isSameInstances(instances, reference), "density x" + std::to_string(density) +
+                        " differs from placing from scratch");
+            Test::Check(!instances.impostors.empty() && !instances.trees[0].empty(), "no trees in view");
+        }
+        Quality::Trees::BaseSpacing = baseSpacing;
+        scene.generateGroups();
+
+        //along a path where groups come in and out of range, then after the terrain changed
+        TreeLayout::PlacementCache cache;
+        ui32 differentUpdates = 0;
+        for(int step = 0; step <= TREES_PATH_STEPS; ++step)
+        {
+            glm::vec3 offset(TREES_PATH_STEP*float(step), 0.0f, -0.5f*TREES_PATH_STEP*float(step));
+            if(step == TREES_PATH_STEPS)
+            {
+                //back to the start, over a raised part of the terrain
+                offset = glm::vec3(0.0f);
+                scene.bump = glm::vec4(500.0f, -500.0f, 2000.0f, 1500.0f);
+                scene.bumpHeight = 50.0f;
+                TreeLayout::InvalidatePlacements(glm::vec2(scene.bump.x, scene.bump.y),
+                                                 glm::vec2(scene.bump.z, scene.bump.w), cache);
+            }
+            scene.lookAt(offset);
+            scene.computeVisibility(scene.grid, cache, instances);
+            TreeLayout::PlacementCache coldCache;
+            scene.computeVisibility(scene.scanGrid, coldCache, reference);
+            differentUpdates += isSameInstances(instances, reference) ? 0 : 1;
+        }
+        Test::Check(differentUpdates == 0, std::to_string(differentUpdates) + " updates along the path differ "
+                    "from testing every group and placing from scratch");
+
+        //a cancelled update stops before placing any tree
+        scene.cancel = true;
+        scene.computeVisibility(scene.grid, cache, instances);
+        scene.cancel = false;
+        Test::Check(instances.impostors.empty() && instances.trees[0].empty(), "cancelled update still ran");
+    }
+
+    //small camera moves, keeping the LODs of the groups that don't need them computed again
+    void testTreesWalk()
+    {
+        FrustrumCulling::UpdateCulling(BenchScenes::Projection());
+        float baseSpacing = Quality::Trees::BaseSpacing;
+        Quality::Trees::BaseSpacing = baseSpacing/glm::sqrt(float(TREES_WALK_DENSITY));
+        TreeScene scene;
+        scene.generateGroups();
+
+        TreeLayout::PlacementCache walkCache;
+        TreeLayout::PlacementCache fullCache;
+        //the updates take turns writing copies of the lists, like with the triple buffer
+        TreeLayout::TreeInstances walkInstances[TREES_WALK_COPIES];
+        TreeLayout::TreeInstances reference;
+        ui32 differentUpdates = 0;
+        ui64 relodCount = 0;
+        ui64 visibleCount = 0;
+        for(ui32 step = 0; step < 2*TREES_WALK_STEPS; ++step)
+        {
+            //forward then back
+            float along = TREES_WALK_STEP*float(step < TREES_WALK_STEPS ? step : 2*TREES_WALK_STEPS - step);
+            scene.lookAt(glm::normalize(scene.cameraTarget - glm::vec3(0.0f, 200.0f, 0.0f))*along);
+            TreeLayout::TreeInstances& instances = walkInstances[step % TREES_WALK_COPIES];
+            scene.computeVisibility(scene.grid, walkCache, instances);
+            TreeLayout::InvalidateLods(fullCache);
+            scene.computeVisibility(scene.grid, fullCache, reference);
+            differentUpdates += isSimilarInstances(instances, reference) ? 0 : 1;
+            relodCount += instances.relodGroupCount;
+            visibleCount += instances.visibleGroupCount;
+        }
+        Quality::Trees::BaseSpacing = baseSpacing;
+        Test::Check(differentUpdates == 0, std::to_string(differentUpdates) +
+                    " updates keeping the LODs of the last ones differ from computing them again");
+        Test::Check(relodCount < visibleCount, "LODs of every visible group computed again at each update");
+    }
+
+    //what the shaders get back from the compact instances
+    void testInstanceEncoding()
+    {
+        glm::vec3 cameraPosition(0.0f, 300.0f, 0.0f);
+        const float yawStep = 2.0f*glm::pi<float>()/float(1 << TREE_INSTANCE_YAW_BITS);
+        const float scaleStep = TREE_INSTANCE_MAX_SCALE/float((1 << TREE_INSTANCE_SCALE_BITS) - 1);
+        ui32 errors = 0;
+        float maxMatrixError = 0.0f;
+        Math::SeedRandomGenerator(47);
+        for(int i = 0; i < INSTANCE_ENCODE_COUNT; ++i)
+        {
+            glm::vec3 position(Math::RandRange(-TREES_HALF_TERRAIN_SIZE, TREES_HALF_TERRAIN_SIZE),
+                               Math::RandRange(0.0f, 100.0f),
+                               Math::RandRange(-TREES_HALF_TERRAIN_SIZE, TREES_HALF_TERRAIN_SIZE));
+            float scale = Math::RandRange(0.8f, 1.8f);
+            float noise = Math::RandRange(-0.6f, 0.6f);
+            glm::vec3 dirToCam = glm::normalize(cameraPosition - position);
+            float angle = glm::atan(-1.0f, 0.0f) - glm::atan(dirToCam.z, dirToCam.x);
+            TreeLayout::CompactInstance instance =
+                    TreeLayout::EncodeInstance(position, scale, angle,
+                                               TreeLayout::GetImpostorView(noise*-10.0f + angle, NB_IMPOSTOR_ANGLES));
+
+            //the position and the index come back unchanged, the scale and the yaw within half a step
+            glm::vec3 decodedPosition;
+            float decodedScale, yaw;
+            ui32 view;
+            TreeLayout::DecodeInstance(instance, decodedPosition, decodedScale, yaw, view);
+            float yawError = glm::abs(glm::mod(yaw - angle + glm::pi<float>(), 2.0f*glm::pi<float>()) -
+                                      glm::pi<float>());
+            glm::vec4 mapping = TreeLayout::GetImpostorMapping(noise*-10.0f + angle, NB_IMPOSTOR_ANGLES,
+                                                               IMPOSTOR_FLIP_X, BILLBOARD_BORDER);
+            if(decodedPosition != position || glm::abs(decodedScale - scale) > 0.5f*scaleStep + 1e-5f ||
+               yawError > 0.5f*yawStep + 1e-5f ||
+               TreeLayout::GetImpostorViewMapping(view, NB_IMPOSTOR_ANGLES, IMPOSTOR_FLIP_X,
+                                                  BILLBOARD_BORDER) != mapping)
+            {
+                ++errors;
+            }
+
+            //the model matrix the shaders make, against the one that used to be uploaded
+            glm::mat4 reference = glm::translate(glm::mat4(1.0f), position)*
+                    glm::rotate(glm::mat4(1.0f), angle, glm::vec3(0.0f, 1.0f, 0.0f))*
+                    glm::scale(glm::mat4(1.0f), glm::vec3(scale));
+            glm::mat4 model = TreeLayout::GetInstanceMatrix(instance);
+            for(int column = 0; column < 4; ++column)
+            {
+                glm::vec4 difference = glm::abs(model[column] - reference[column]);
+                maxMatrixError = glm::max(maxMatrixError, glm::max(glm::max(difference.x, difference.y),
+                                                                   glm::max(difference.z, difference.w)));
+            }
+        }
+        //every bit of the index field, and scales out of range
+        for(ui32 index = 0; index < (1u << TREE_INSTANCE_INDEX_BITS); ++index)
+        {
+            glm::vec3 position;
+            float scale, yaw;
+            ui32 decodedIndex;
+            TreeLayout::DecodeInstance(TreeLayout::EncodeInstance(glm::vec3(0.0f), 2.0f*TREE_INSTANCE_MAX_SCALE,
+                                                                  -1.0f, index),
+                                       position, scale, yaw, decodedIndex);
+            if(decodedIndex != index || scale != TREE_INSTANCE_MAX_SCALE)
+            {
+                ++errors;
+            }
+        }
+        Test::Check(errors == 0, std::to_string(errors) + " instances decode wrong");
+        Test::Check(maxMatrixError <= 1e-3f, "model matrices within " + std::to_string(maxMatrixError) +
+                    " of the mat4s");
+    }
+
+    //views of a disc in the middle of each atlas cell, empty around like the captured trees
+    void testImpostorCache()
+    {
+        ImpostorCache::Settings settings;
+        settings.nbAngles = IMPOSTOR_CACHE_ANGLES;
+        settings.texSize = IMPOSTOR_CACHE_VIEW_SIZE;
+        settings.border = 0.05f;
+
+        ImpostorCache::Atlas atlas;
+        atlas.size = ImpostorCache::GetAtlasSize(settings);
+        atlas.billboardSize = glm::vec3(5.0f, 12.0f, 5.0f);
+        atlas.diffuse.assign(ui64(atlas.size)*ui64(atlas.size), 0);
+        atlas.normal.assign(atlas.diffuse.size(), 0);
+        Math::SeedRandomGenerator(50);
+        float radius = 0.4f*float(settings.texSize);
+        for(ui32 y = 0; y < atlas.size; ++y)
+        {
+            for(ui32 x = 0; x < atlas.size; ++x)
+            {
+                glm::vec2 cellPosition = glm::vec2(float(x % settings.texSize), float(y % settings.texSize)) -
+                        0.5f*float(settings.texSize);
+                if(glm::length(cellPosition) < radius)
+                {
+                    ui64 texel = ui64(Math::RandRange(1.0f, 65535.0f)) | (ui64(0xFFFF) << 48);
+                    atlas.diffuse[y*atlas.size + x] = texel;
+                    atlas.normal[y*atlas.size + x] = texel ^ 0x0000FFFF0000ull;
+                }
+            }
+        }
+
+        //round trip, refused for other settings or sources
+        ui64 hash = ImpostorCache::Hash(settings, std::vector<std::string>(), std::vector<float>());
+        ImpostorCache::Atlas loaded;
+        Test::Check(ImpostorCache::Save(IMPOSTOR_CACHE_FILE, settings, hash, atlas) &&
+                    ImpostorCache::Load(IMPOSTOR_CACHE_FILE, settings, hash, loaded) &&
+                    loaded.diffuse == atlas.diffuse && loaded.normal == atlas.normal &&
+                    loaded.billboardSize == atlas.billboardSize, "round trip failed");
+        ImpostorCache::Atlas refused;
+        Test::Check(!ImpostorCache::Load(IMPOSTOR_CACHE_FILE, settings, hash + 1, refused), "other key loaded");
+        ImpostorCache::Settings otherSettings = settings;
+        otherSettings.border = 0.1f;
+        Test::Check(ImpostorCache::Hash(otherSettings, std::vector<std::string>(), std::vector<float>()) != hash &&
+                    ImpostorCache::Hash(settings, std::vector<std::string>(), std::vector<float>(1, 0.5f)) != hash,
+                    "settings or values don't change the key");
+
+        //a changed source file changes the key
+        std::string sourceFilename = std::string(ENGINE_RESSOURCE_PATH) + IMPOSTOR_SOURCE_FILE;
+        std::vector<std::string> sources(1, IMPOSTOR_SOURCE_FILE);
+        std::ofstream(sourceFilename.c_str(), std::ios::out | std::ios::binary) << "bark";
+        ui64 sourceHash = ImpostorCache::Hash(settings, sources, std::vector<float>());
+        std::ofstream(sourceFilename.c_str(), std::ios::out | std::ios::binary) << "leaf";
+        ui64 changedHash = ImpostorCache::Hash(settings, sources, std::vector<float>());
+        std::remove(sourceFilename.c_str());
+        ui64 missingHash = ImpostorCache::Hash(settings, sources, std::vector<float>());
+        Test::Check(sourceHash != changedHash && sourceHash != missingHash && changedHash != missingHash,
+                    "source files don't change the key");
+
+        //a truncated file is refused
+        std::ifstream file(IMPOSTOR_CACHE_FILE, std::ios::in | std::ios::binary | std::ios::ate);
+        std::vector<char> bytes(size_t(file.tellg()));
+        file.seekg(0, std::ios::beg);
+        file.read(bytes.data(), bytes.size());
+        file.close();
+        std::ofstream(IMPOSTOR_CACHE_FILE, std::ios::out | std::ios::binary | std::ios::trunc).write(
+                    bytes.data(), bytes.size() - 4);
+        Test::Check(!ImpostorCache::Load(IMPOSTOR_CACHE_FILE, settings, hash, refused), "truncated file loaded");
+        std::remove(IMPOSTOR_CACHE_FILE);
+    }
+}
+
+namespace SCE
+{
+
+namespace Test
+{
+    void AddTreeTests()
+    {
+        Add("trees_visibility", testTreesVisibility);
+        Add("trees_walk", testTreesWalk);
+        Add("instance_encoding", testInstanceEncoding);
+        Add("impostor_cache", testImpostorCache);
+    }
+}
+
+}
@@ -0,0 +1,39 @@
+/******PROJECT:Sand Castle Engine******/
+/**************************************/
+/*********AUTHOR:Gwenn AUBERT**********/
+/**********FILE:sce_tests.cpp**********/
+/**************************************/
+
+//Tests of the engine code that runs without a window or a GL context, registered with ctest.
+//usage : sce_tests [--filter name]
+//Returns 1 when a test fails. The mesh file test needs SCE_Assets next to the executable.
+
+#include "SCETest.hpp"
+#include "../headers/SCETools.hpp"
+
+using namespace SCE;
+
+int main(int argc, char** argv)
+{
+    std::string filter;
+    for(int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if(arg == "--filter" && i + 1 < argc)
+        {
+            filter = argv[++i];
+        }
+        else
+        {
+            Debug::LogError("Unknown argument : " + arg);
+            Debug::Log("usage : sce_tests [--filter name]");
+            return 2;
+        }
+    }
+
+    Test::AddCoreTests();
+    Test::AddTerrainTests();
+    Test::AddTreeTests();
+
+    return Test::RunAll(filter) > 0 ? 1 : 0;
+}
@@ -0,0 +1,65 @@
+/******PROJECT:Sand Castle Engine******/
+/**************************************/
+/*********AUTHOR:Gwenn AUBERT**********/
+/******FILE:sce_impostor_bake.cpp******/
+/**************************************/
+
+//Pre-renders the tree impostor atlases loaded by TerrainTrees, so that the first launch
+//doesn't pay for the capture either. Run from the directory containing SCE_Assets.
+//The capture needs a GL context : this opens the engine window like the playground does.
+//usage : sce_impostor_bake [--force]
+//Without --force, an up to date cache is kept as it is.
+
+#include "../headers/SCE.hpp"
+#include "../headers/SCECore.hpp"
+#include "../headers/SCETerrainTrees.hpp"
+
+#include <cstdio>
+#include <fstream>
+
+using namespace SCE;
+
+int main(int argc, char** argv)
+{
+    bool force = false;
+    for(int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if(arg == "--force")
+        {
+            force = true;
+        }
+        else
+        {
+            Debug::Log("usage : sce_impostor_bake [--force]");
+            return 1;
+        }
+    }
+
+#if USE_IMPOSTORS
+    SCECore engine;
+    engine.InitEngine("SCE impostor bake");
+
+    std::string filename = TerrainTrees::GetImpostorCacheFilename();
+    if(force)
+    {
+        remove(filename.c_str());
+    }
+
+    //loads the cache if it is up to date, captures the views and writes it otherwise
+    {
+        TerrainTrees trees;
+    }
+
+    if(!std::ifstream(filename.c_str()))
+    {
+        Debug::LogError("No impostor cache written to " + filename);
+        return 1;
+    }
+    Debug::Log(filename + " : up to date");
+    return 0;
+#else
+    Debug::Log("Impostors are disabled, nothing to bake");
+    return 0;
+#endif
+}
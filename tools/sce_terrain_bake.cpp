@@ -0,0 +1,188 @@
+/******PROJECT:Sand Castle Engine******/
+/**************************************/
+/*********AUTHOR:Gwenn AUBERT**********/
+/******FILE:sce_terrain_bake.cpp*******/
+/**************************************/
+
+//Pre-generates the terrain heightmap caches loaded by Terrain::Init, so that the first launch
+//doesn't pay for the generation either. Run from the directory containing SCE_Assets.
+//usage : sce_terrain_bake [--terrain-size 16000] [--patch-size 600] [--size 1024]...
+//Without --size, bakes the sizes used by every quality level (debug, release and final builds).
+//With --import-dem, converts a raw 16 bit little endian x major elevation grid into the tiled
+//heightfield streamed by the clipmap terrain instead :
+//sce_terrain_bake --import-dem dem.raw --dem-size 16384 [--texel-spacing 1] [--height-scale 2000]
+//                 [--tile-size 256] [--out SCE_Assets/Terrain/terrain.tiles]
+
+#include "../headers/SCETools.hpp"
+#include "../headers/SCEPerlin.hpp"
+#include "../headers/SCEHeightmap.hpp"
+#include "../headers/SCEHeightmapCache.hpp"
+#include "../headers/SCEMemory.hpp"
+#include "../headers/SCETiledHeightfield.hpp"
+
+#include <fstream>
+
+#define DEFAULT_TERRAIN_SIZE 16000.0f
+#define DEFAULT_PATCH_SIZE 600.0f
+#define QUALITY_LEVEL_SIZES {512, 1024, 4096}
+#define DEFAULT_TEXEL_SPACING 1.0f
+#define DEFAULT_DEM_HEIGHT_SCALE 2000.0f
+#define DEFAULT_TILE_SIZE 256
+#define DEFAULT_TILED_FILE ENGINE_RESSOURCE_PATH "Terrain/terrain.tiles"
+
+using namespace SCE;
+
+namespace
+{
+    bool bakeHeightmap(float terrainSize, float patchSize, ui32 size)
+    {
+        Heightmap::Params params = Heightmap::GetTerrainParams(terrainSize, patchSize, size);
+        ui64 paramsHash = Heightmap::HashParams(params);
+        std::string filename = HeightmapCache::GetCacheFilename(size);
+
+        HeightmapCache::CachedHeightmap cached;
+        if(HeightmapCache::Load(filename, paramsHash, size, cached))
+        {
+            HeightmapCache::Release(cached);
+            Debug::Log(filename + " : up to date");
+            return true;
+        }
+
+        Debug::Log(filename + " : generating " + std::to_string(size) + "x" + std::to_string(size));
+        ui64 texelCount = ui64(size)*ui64(size);
+        std::vector<float> heightmap(texelCount);
+        std::vector<glm::vec4> normalAndHeight(texelCount);
+        std::vector<Heightmap::GPUTexel> texels(texelCount);
+
+        Perlin::MakePerlin(ui16(size), params.seed);
+        Heightmap::GenerateHeights(heightmap.data(), size, params.offset, params.startScale, params.heightScale);
+        Heightmap::ComputeNormalsAndHeight(heightmap.data(), size, params.terrainSize, normalAndHeight.data());
+        Heightmap::PackGPUTexels(normalAndHeight.data(), size, params.heightScale, texels.data());
+        Perlin::DestroyPerlin();
+
+        return HeightmapCache::Save(filename, paramsHash, size, texels.data());
+    }
+
+    bool isPowerOfTwo(ui32 value)
+    {
+        return value != 0 && (value & (value - 1)) == 0;
+    }
+
+    bool importDem(const std::string& demFilename, ui32 demSize, float texelSpacing, float heightScale,
+                   ui32 tileSize, const std::string& outFilename)
+    {
+        if(!isPowerOfTwo(demSize) || !isPowerOfTwo(tileSize) || tileSize > demSize)
+        {
+            Debug::LogError("The DEM and tile sizes must be powers of two, with tiles smaller than the DEM");
+            return false;
+        }
+
+        std::ifstream demFile(demFilename, std::ios::in | std::ios::binary);
+        if(!demFile.is_open())
+        {
+            Debug::LogError("Could not open " + demFilename);
+            return false;
+        }
+        std::vector<ui16> heights(ui64(demSize)*ui64(demSize));
+        demFile.read((char*)heights.data(), std::streamsize(SCE::Memory::VectorBytes(heights)));
+        if(!demFile)
+        {
+            Debug::LogError(demFilename + " is smaller than " + std::to_string(demSize) + "x" +
+                            std::to_string(demSize) + " 16 bit heights");
+            return false;
+        }
+
+        Debug::Log(outFilename + " : importing " + demFilename);
+        float toHeight = heightScale / 65535.0f;
+        return TiledHeightfield::Write(outFilename, demSize, tileSize, heightScale, texelSpacing,
+                                       [&heights, demSize, toHeight](ui32 x, ui32 z)
+        {
+            return float(heights[ui64(x)*demSize + z])*toHeight;
+        });
+    }
+}
+
+int main(int argc, char** argv)
+{
+    float terrainSize = DEFAULT_TERRAIN_SIZE;
+    float patchSize = DEFAULT_PATCH_SIZE;
+    std::vector<ui32> sizes;
+    std::string demFilename;
+    ui32 demSize = 0;
+    float texelSpacing = DEFAULT_TEXEL_SPACING;
+    float demHeightScale = DEFAULT_DEM_HEIGHT_SCALE;
+    ui32 tileSize = DEFAULT_TILE_SIZE;
+    std::string outFilename = DEFAULT_TILED_FILE;
+
+    for(int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if(arg == "--terrain-size" && hasValue)
+        {
+            terrainSize = float(atof(argv[++i]));
+        }
+        else if(arg == "--patch-size" && hasValue)
+        {
+            patchSize = float(atof(argv[++i]));
+        }
+        else if(arg == "--size" && hasValue)
+        {
+            sizes.push_back(ui32(atoi(argv[++i])));
+        }
+        else if(arg == "--import-dem" && hasValue)
+        {
+            demFilename = argv[++i];
+        }
+        else if(arg == "--dem-size" && hasValue)
+        {
+            demSize = ui32(atoi(argv[++i]));
+        }
+        else if(arg == "--texel-spacing" && hasValue)
+        {
+            texelSpacing = float(atof(argv[++i]));
+        }
+        else if(arg == "--height-scale" && hasValue)
+        {
+            demHeightScale = float(atof(argv[++i]));
+        }
+        else if(arg == "--tile-size" && hasValue)
+        {
+            tileSize = ui32(atoi(argv[++i]));
+        }
+        else if(arg == "--out" && hasValue)
+        {
+            outFilename = argv[++i];
+        }
+        else
+        {
+            Debug::LogError("Unknown argument : " + arg);
+            Debug::Log("usage : sce_terrain_bake [--terrain-size size] [--patch-size size] [--size texels]...");
+            Debug::Log("        sce_terrain_bake --import-dem file --dem-size texels [--texel-spacing size] "
+                       "[--height-scale height] [--tile-size texels] [--out file]");
+            return 2;
+        }
+    }
+
+    if(!demFilename.empty())
+    {
+        return importDem(demFilename, demSize, texelSpacing, demHeightScale, tileSize, outFilename) ? 0 : 1;
+    }
+
+    if(sizes.empty())
+    {
+        sizes = QUALITY_LEVEL_SIZES;
+    }
+
+    int failCount = 0;
+    for(ui32 size : sizes)
+    {
+        if(size == 0 || size > 0xFFFF || !bakeHeightmap(terrainSize, patchSize, size))
+        {
+            Debug::LogError("Could not bake heightmap of size " + std::to_string(size));
+            ++failCount;
+        }
+    }
+
+    return failCount > 0 ? 1 : 0;
+}